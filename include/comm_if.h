@@ -6,6 +6,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -28,9 +29,134 @@ void comm_setDumpFlag(int flag);
 int  comm_getDumpFlag(void);
 
 
+/************************ Begin of Reactor ************************/
+typedef unsigned long  tReactorHandle;
+
+tReactorHandle comm_reactorInit(int threadNum);
+void comm_reactorUninit(tReactorHandle handle);
+void comm_setReactor(tReactorHandle handle);
+tReactorHandle comm_getReactor(void);
+/************************ End   of Reactor ************************/
+
+
+/************************ Begin of Pool ************************/
+#define POOL_CLASS_NUM (8)
+
+typedef struct _tPoolStat
+{
+    unsigned int   size;      /* buffer size of the class (0 is over-sized) */
+    unsigned long  totalNum;  /* buffers held by the pool */
+    unsigned long  usedNum;   /* buffers in use */
+    unsigned long  memory;    /* bytes held by the pool */
+} tPoolStat;
+
+int  comm_poolSetClass(unsigned int *pSize, int num);
+int  comm_poolGetStat(tPoolStat *pStat, int num);
+unsigned long comm_poolGetMemory(void);
+/************************ End   of Pool ************************/
+
+
+/************************ Begin of Buffer ************************/
+/*
+*  Reference-counted message buffer from the pool. A buffer callback owns
+*  the buffer it is given: keep it with comm_bufRetain() or pass it on, and
+*  drop every reference with comm_bufRelease().
+*/
+typedef struct _tCommBuf
+{
+    unsigned char  *pData;
+    size_t          size;      /* data length */
+    size_t          capacity;  /* buffer size */
+} tCommBuf;
+
+tCommBuf *comm_bufAlloc(size_t capacity);
+tCommBuf *comm_bufRetain(tCommBuf *pBuf);
+void      comm_bufRelease(tCommBuf *pBuf);
+/************************ End   of Buffer ************************/
+
+
+/************************ Begin of Frame ************************/
+#define COMM_FRAME_MAX_SIZE (64 * 1024 * 1024)
+
+/*
+*  Length-prefixed message framing of the stream handles:
+*    [ magic (magicSize bytes) ][ length (lenSize bytes) ][ payload ]
+*
+*  A framed handle passes exactly one complete payload to the receive
+*  callback, and its Send functions put the header in front of the data.
+*/
+typedef struct _tCommFrame
+{
+    unsigned int  magic;
+    int           magicSize;  /* 0, 1, 2 or 4 bytes */
+    int           lenSize;    /* 2 or 4 bytes */
+    int           bigEndian;  /* byte order of the magic and the length */
+    int           inclusive;  /* the length counts the header too */
+    size_t        maxSize;    /* max. payload size (0 is COMM_FRAME_MAX_SIZE) */
+} tCommFrame;
+/************************ End   of Frame ************************/
+
+
+/************************ Begin of Queue ************************/
+/*
+*  Bounded send queue of a connection served by the reactor. A send
+*  writes what the socket takes without blocking and queues the rest,
+*  the reactor writes the queue when the socket is writable again.
+*
+*  The watermark callback reports the queue growing over highMark and
+*  draining back to lowMark, so the producers can be throttled.
+*/
+typedef struct _tCommQueue
+{
+    size_t  maxSize;   /* max. queued bytes, a send over it fails */
+    size_t  highMark;  /* high-water mark (0 is no watermark callback) */
+    size_t  lowMark;   /* low-water mark, less than highMark */
+} tCommQueue;
+/************************ End   of Queue ************************/
+
+
+/************************ Begin of Capture ************************/
+typedef unsigned long  tPcapHandle;
+
+#define COMM_PCAP_RING_SIZE (4 * 1024 * 1024)
+#define COMM_PCAP_SNAP_LEN  (65535)
+
+/*
+*  pcapng capture of the messages sent and received by the tapped handles.
+*  A tapped handle copies its messages to a lock-free ring, a background
+*  thread writes them to the file, and a message is dropped if the ring is
+*  full. Each handle is an interface of the file:
+*    Raw             ==> LINKTYPE_ETHERNET, the frame as is
+*    UDP             ==> LINKTYPE_RAW, IP and UDP headers are synthesized
+*    TCP, IPC, ...   ==> LINKTYPE_USER0, [ connection ID (4 bytes) ][ message ]
+*
+*  The connection ID is in big-endian, it is the user ID of a server's
+*  client and 0 otherwise. The rotated files are named <path>.0, <path>.1, ...
+*/
+typedef struct _tCommPcap
+{
+    size_t        ringSize;  /* ring bytes (0 is COMM_PCAP_RING_SIZE) */
+    unsigned int  snapLen;   /* max. captured bytes of a message (0 is COMM_PCAP_SNAP_LEN) */
+    size_t        maxSize;   /* rotate the file over maxSize bytes (0 is no limit) */
+    unsigned int  maxTime;   /* rotate the file after maxTime seconds (0 is no limit) */
+    unsigned int  maxFiles;  /* keep the last maxFiles rotated files (0 is all) */
+} tCommPcap;
+
+tPcapHandle comm_pcapInit(char *pPath, tCommPcap *pCfg);
+void comm_pcapUninit(tPcapHandle handle);
+int  comm_pcapGetStat(
+         tPcapHandle     handle,
+         unsigned long  *pPackets,
+         unsigned long  *pDrops
+     );
+/************************ End   of Capture ************************/
+
+
 /************************ Begin of UDP ************************/
 typedef unsigned long  tUdpIpv4Handle;
 typedef unsigned long  tUdpIpv6Handle;
+typedef unsigned long  tUdpIpv4DestHandle;
+typedef unsigned long  tUdpIpv6DestHandle;
 /*
 *  UDP IPv4:
 *    pAddr ==> (struct sockaddr_in *)
@@ -44,13 +170,104 @@ typedef void (*tUdpRecvCb)(
             unsigned short   size,
             struct sockaddr *pAddr
         );
+typedef void (*tUdpBufCb)(
+            void            *pArg,
+            tCommBuf        *pBuf,
+            struct sockaddr *pAddr
+        );
+
+#define COMM_UDP_BATCH_NUM (32)
+
+/*
+*  One datagram of the batch receiving and sending:
+*    receive ==> pData / size of pBuf, the callback owns pBuf
+*    send    ==> pData / size to addr, pBuf is not used
+*/
+typedef struct _tUdpMsg
+{
+    unsigned char           *pData;
+    size_t                   size;
+    tCommBuf                *pBuf;
+    union
+    {
+        struct sockaddr      sa;
+        struct sockaddr_in   ipv4;
+        struct sockaddr_in6  ipv6;
+    } addr;
+} tUdpMsg;
+
+typedef void (*tUdpBatchCb)(
+            void            *pArg,
+            tUdpMsg         *pMsg,
+            int              num
+        );
+typedef void (*tUdpGroCb)(
+            void            *pArg,
+            tCommBuf        *pBuf,
+            size_t           segSize,
+            struct sockaddr *pAddr
+        );
+typedef void (*tUdpShardCb)(
+            void            *pArg,
+            int              shard,
+            tCommBuf        *pBuf,
+            struct sockaddr *pAddr
+        );
 
 tUdpIpv4Handle comm_udpIpv4Init(
                    unsigned short  portNum,
                    tUdpRecvCb      pRecvFunc,
                    void           *pArg
                );
+tUdpIpv4Handle comm_udpIpv4InitBuf(
+                   unsigned short  portNum,
+                   tUdpBufCb       pBufFunc,
+                   void           *pArg
+               );
+tUdpIpv4Handle comm_udpIpv4InitGroup(
+                   unsigned short  portNum,
+                   tUdpBufCb       pBufFunc,
+                   void           *pArg
+               );
+tUdpIpv4Handle comm_udpIpv4InitBatch(
+                   unsigned short  portNum,
+                   int             batchNum,
+                   tUdpBatchCb     pBatchFunc,
+                   void           *pArg
+               );
+tUdpIpv4Handle comm_udpIpv4InitGro(
+                   unsigned short  portNum,
+                   tUdpGroCb       pGroFunc,
+                   void           *pArg
+               );
+tUdpIpv4Handle comm_udpIpv4InitSharded(
+                   unsigned short  portNum,
+                   int             shardNum,
+                   tUdpShardCb     pShardFunc,
+                   void           *pArg
+               );
 void comm_udpIpv4Uninit(tUdpIpv4Handle handle);
+int  comm_udpIpv4SetRecvSize(tUdpIpv4Handle handle, size_t size);
+int  comm_udpIpv4JoinGroup(
+         tUdpIpv4Handle  handle,
+         char           *pGroupStr,
+         char           *pSourceStr,
+         char           *pIfName
+     );
+int  comm_udpIpv4LeaveGroup(
+         tUdpIpv4Handle  handle,
+         char           *pGroupStr,
+         char           *pSourceStr,
+         char           *pIfName
+     );
+int  comm_udpIpv4SetMulticast(
+         tUdpIpv4Handle  handle,
+         int             ttl,
+         int             loop,
+         char           *pIfName
+     );
+int  comm_udpIpv4SetFilter(tUdpIpv4Handle handle, char *pExpr);
+int  comm_udpIpv4SetTap(tUdpIpv4Handle handle, tPcapHandle pcap);
 int  comm_udpIpv4Send(
          tUdpIpv4Handle  handle,
          char           *pIpStr,
@@ -58,11 +275,50 @@ int  comm_udpIpv4Send(
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_udpIpv4SendEx(
+            tUdpIpv4Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            unsigned char  *pData,
+            size_t          size
+        );
+ssize_t comm_udpIpv4Sendv(
+            tUdpIpv4Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            struct iovec   *pIov,
+            int             num
+        );
+int  comm_udpIpv4SendBatch(tUdpIpv4Handle handle, tUdpMsg *pMsg, int num);
+ssize_t comm_udpIpv4SendGso(
+            tUdpIpv4Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            unsigned char  *pData,
+            size_t          size,
+            size_t          segSize
+        );
+tUdpIpv4DestHandle comm_udpIpv4OpenDest(
+                       tUdpIpv4Handle  handle,
+                       char           *pIpStr,
+                       unsigned short  portNum
+                   );
+void comm_udpIpv4CloseDest(tUdpIpv4DestHandle dest);
+ssize_t comm_udpIpv4SendTo(
+            tUdpIpv4DestHandle  dest,
+            unsigned char      *pData,
+            size_t              size
+        );
 int  comm_udpIpv4Recv(
          tUdpIpv4Handle  handle,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_udpIpv4RecvEx(
+            tUdpIpv4Handle  handle,
+            unsigned char  *pData,
+            size_t          size
+        );
 int  comm_udpIpv4GetAddr(char *pIfName, unsigned char *pIpv4Addr);
 
 tUdpIpv6Handle comm_udpIpv6Init(
@@ -70,7 +326,55 @@ tUdpIpv6Handle comm_udpIpv6Init(
                    tUdpRecvCb      pRecvFunc,
                    void           *pArg
                );
+tUdpIpv6Handle comm_udpIpv6InitBuf(
+                   unsigned short  portNum,
+                   tUdpBufCb       pBufFunc,
+                   void           *pArg
+               );
+tUdpIpv6Handle comm_udpIpv6InitGroup(
+                   unsigned short  portNum,
+                   tUdpBufCb       pBufFunc,
+                   void           *pArg
+               );
+tUdpIpv6Handle comm_udpIpv6InitBatch(
+                   unsigned short  portNum,
+                   int             batchNum,
+                   tUdpBatchCb     pBatchFunc,
+                   void           *pArg
+               );
+tUdpIpv6Handle comm_udpIpv6InitGro(
+                   unsigned short  portNum,
+                   tUdpGroCb       pGroFunc,
+                   void           *pArg
+               );
+tUdpIpv6Handle comm_udpIpv6InitSharded(
+                   unsigned short  portNum,
+                   int             shardNum,
+                   tUdpShardCb     pShardFunc,
+                   void           *pArg
+               );
 void comm_udpIpv6Uninit(tUdpIpv6Handle handle);
+int  comm_udpIpv6SetRecvSize(tUdpIpv6Handle handle, size_t size);
+int  comm_udpIpv6JoinGroup(
+         tUdpIpv6Handle  handle,
+         char           *pGroupStr,
+         char           *pSourceStr,
+         char           *pIfName
+     );
+int  comm_udpIpv6LeaveGroup(
+         tUdpIpv6Handle  handle,
+         char           *pGroupStr,
+         char           *pSourceStr,
+         char           *pIfName
+     );
+int  comm_udpIpv6SetMulticast(
+         tUdpIpv6Handle  handle,
+         int             ttl,
+         int             loop,
+         char           *pIfName
+     );
+int  comm_udpIpv6SetFilter(tUdpIpv6Handle handle, char *pExpr);
+int  comm_udpIpv6SetTap(tUdpIpv6Handle handle, tPcapHandle pcap);
 int  comm_udpIpv6Send(
          tUdpIpv6Handle  handle,
          char           *pIpStr,
@@ -78,11 +382,50 @@ int  comm_udpIpv6Send(
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_udpIpv6SendEx(
+            tUdpIpv6Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            unsigned char  *pData,
+            size_t          size
+        );
+ssize_t comm_udpIpv6Sendv(
+            tUdpIpv6Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            struct iovec   *pIov,
+            int             num
+        );
+int  comm_udpIpv6SendBatch(tUdpIpv6Handle handle, tUdpMsg *pMsg, int num);
+ssize_t comm_udpIpv6SendGso(
+            tUdpIpv6Handle  handle,
+            char           *pIpStr,
+            unsigned short  portNum,
+            unsigned char  *pData,
+            size_t          size,
+            size_t          segSize
+        );
+tUdpIpv6DestHandle comm_udpIpv6OpenDest(
+                       tUdpIpv6Handle  handle,
+                       char           *pIpStr,
+                       unsigned short  portNum
+                   );
+void comm_udpIpv6CloseDest(tUdpIpv6DestHandle dest);
+ssize_t comm_udpIpv6SendTo(
+            tUdpIpv6DestHandle  dest,
+            unsigned char      *pData,
+            size_t              size
+        );
 int  comm_udpIpv6Recv(
          tUdpIpv6Handle  handle,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_udpIpv6RecvEx(
+            tUdpIpv6Handle  handle,
+            unsigned char  *pData,
+            size_t          size
+        );
 int  comm_udpIpv6GetAddr(char *pIfName, unsigned char *pIpv6Addr);
 /************************ End   of UDP ************************/
 
@@ -95,6 +438,7 @@ typedef void (*tTcpClientRecvCb)(
                  unsigned char  *pData,
                  unsigned short  size
              );
+typedef void (*tTcpClientBufCb)(void *pArg, tCommBuf *pBuf);
 typedef void (*tTcpClientExitCb)(void *pArg, int code);
 
 tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
@@ -103,7 +447,16 @@ tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
                          tTcpClientExitCb  pExitFunc,
                          void             *pArg
                      );
+tTcpIpv4ClientHandle comm_tcpIpv4ClientInitBuf(
+                         unsigned short    portNum,
+                         tTcpClientBufCb   pBufFunc,
+                         tTcpClientExitCb  pExitFunc,
+                         void             *pArg
+                     );
 void comm_tcpIpv4ClientUninit(tTcpIpv4ClientHandle handle);
+int  comm_tcpIpv4ClientSetRecvSize(tTcpIpv4ClientHandle handle, size_t size);
+int  comm_tcpIpv4ClientSetFrame(tTcpIpv4ClientHandle handle, tCommFrame *pFrame);
+int  comm_tcpIpv4ClientSetTap(tTcpIpv4ClientHandle handle, tPcapHandle pcap);
 int  comm_tcpIpv4ClientConnect(
          tTcpIpv4ClientHandle  handle,
          char                 *pAddr,
@@ -114,6 +467,16 @@ int  comm_tcpIpv4ClientSend(
          unsigned char        *pData,
          unsigned short        size
      );
+ssize_t comm_tcpIpv4ClientSendEx(
+            tTcpIpv4ClientHandle  handle,
+            unsigned char        *pData,
+            size_t                size
+        );
+ssize_t comm_tcpIpv4ClientSendv(
+            tTcpIpv4ClientHandle  handle,
+            struct iovec         *pIov,
+            int                   num
+        );
 
 tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
                          unsigned short    portNum,
@@ -121,7 +484,16 @@ tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
                          tTcpClientExitCb  pExitFunc,
                          void             *pArg
                      );
+tTcpIpv6ClientHandle comm_tcpIpv6ClientInitBuf(
+                         unsigned short    portNum,
+                         tTcpClientBufCb   pBufFunc,
+                         tTcpClientExitCb  pExitFunc,
+                         void             *pArg
+                     );
 void comm_tcpIpv6ClientUninit(tTcpIpv6ClientHandle handle);
+int  comm_tcpIpv6ClientSetRecvSize(tTcpIpv6ClientHandle handle, size_t size);
+int  comm_tcpIpv6ClientSetFrame(tTcpIpv6ClientHandle handle, tCommFrame *pFrame);
+int  comm_tcpIpv6ClientSetTap(tTcpIpv6ClientHandle handle, tPcapHandle pcap);
 int  comm_tcpIpv6ClientConnect(
          tTcpIpv6ClientHandle  handle,
          char                 *pAddr,
@@ -132,6 +504,16 @@ int  comm_tcpIpv6ClientSend(
          unsigned char        *pData,
          unsigned short        size
      );
+ssize_t comm_tcpIpv6ClientSendEx(
+            tTcpIpv6ClientHandle  handle,
+            unsigned char        *pData,
+            size_t                size
+        );
+ssize_t comm_tcpIpv6ClientSendv(
+            tTcpIpv6ClientHandle  handle,
+            struct iovec         *pIov,
+            int                   num
+        );
 /************************ End   of TCP Client ************************/
 
 
@@ -145,7 +527,6 @@ typedef struct _tTcpUser
     struct sockaddr_in6  addrIpv6;
     int                  fd;
     pthread_t            thread;
-    unsigned char        recvMsg[COMM_BUF_SIZE+1];
 } tTcpUser;
 
 typedef void (*tTcpServerRecvCb)(
@@ -154,8 +535,14 @@ typedef void (*tTcpServerRecvCb)(
                  unsigned char  *pData,
                  unsigned short  size
              );
+typedef void (*tTcpServerBufCb)(
+                 void      *pArg,
+                 tTcpUser  *pUser,
+                 tCommBuf  *pBuf
+             );
 typedef void (*tTcpServerAcptCb)(void *pArg, tTcpUser *pUser);
 typedef void (*tTcpServerExitCb)(void *pArg, tTcpUser *pUser);
+typedef void (*tTcpServerWaterCb)(void *pArg, tTcpUser *pUser, int high);
 
 tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
                          unsigned short    portNum,
@@ -165,17 +552,48 @@ tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
                          tTcpServerRecvCb  pRecvFunc,
                          void             *pArg
                      );
+tTcpIpv4ServerHandle comm_tcpIpv4ServerInitBuf(
+                         unsigned short    portNum,
+                         int               maxUserNum,
+                         tTcpServerAcptCb  pAcptFunc,
+                         tTcpServerExitCb  pExitFunc,
+                         tTcpServerBufCb   pBufFunc,
+                         void             *pArg
+                     );
 void comm_tcpIpv4ServerUninit(tTcpIpv4ServerHandle handle);
+int  comm_tcpIpv4ServerSetRecvSize(tTcpIpv4ServerHandle handle, size_t size);
+int  comm_tcpIpv4ServerSetFrame(tTcpIpv4ServerHandle handle, tCommFrame *pFrame);
+int  comm_tcpIpv4ServerSetTap(tTcpIpv4ServerHandle handle, tPcapHandle pcap);
+int  comm_tcpIpv4ServerSetSendQueue(
+         tTcpIpv4ServerHandle  handle,
+         tCommQueue           *pQueue,
+         tTcpServerWaterCb     pWaterFunc
+     );
 int  comm_tcpIpv4ServerSend(
          tTcpUser       *pUser,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_tcpIpv4ServerSendEx(
+            tTcpUser       *pUser,
+            unsigned char  *pData,
+            size_t          size
+        );
+ssize_t comm_tcpIpv4ServerSendv(
+            tTcpUser      *pUser,
+            struct iovec  *pIov,
+            int            num
+        );
 void comm_tcpIpv4ServerSendAllClient(
          tTcpIpv4ServerHandle  handle,
          unsigned char        *pData,
          unsigned short        size
      );
+void comm_tcpIpv4ServerSendAllClientEx(
+         tTcpIpv4ServerHandle  handle,
+         unsigned char        *pData,
+         size_t                size
+     );
 int  comm_tcpIpv4ServerGetClientNum(tTcpIpv4ServerHandle handle);
 
 tTcpIpv6ServerHandle comm_tcpIpv6ServerInit(
@@ -186,17 +604,48 @@ tTcpIpv6ServerHandle comm_tcpIpv6ServerInit(
                          tTcpServerRecvCb  pRecvFunc,
                          void             *pArg
                      );
+tTcpIpv6ServerHandle comm_tcpIpv6ServerInitBuf(
+                         unsigned short    portNum,
+                         int               maxUserNum,
+                         tTcpServerAcptCb  pAcptFunc,
+                         tTcpServerExitCb  pExitFunc,
+                         tTcpServerBufCb   pBufFunc,
+                         void             *pArg
+                     );
 void comm_tcpIpv6ServerUninit(tTcpIpv6ServerHandle handle);
+int  comm_tcpIpv6ServerSetRecvSize(tTcpIpv6ServerHandle handle, size_t size);
+int  comm_tcpIpv6ServerSetFrame(tTcpIpv6ServerHandle handle, tCommFrame *pFrame);
+int  comm_tcpIpv6ServerSetTap(tTcpIpv6ServerHandle handle, tPcapHandle pcap);
+int  comm_tcpIpv6ServerSetSendQueue(
+         tTcpIpv6ServerHandle  handle,
+         tCommQueue           *pQueue,
+         tTcpServerWaterCb     pWaterFunc
+     );
 int  comm_tcpIpv6ServerSend(
          tTcpUser       *pUser,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_tcpIpv6ServerSendEx(
+            tTcpUser       *pUser,
+            unsigned char  *pData,
+            size_t          size
+        );
+ssize_t comm_tcpIpv6ServerSendv(
+            tTcpUser      *pUser,
+            struct iovec  *pIov,
+            int            num
+        );
 void comm_tcpIpv6ServerSendAllClient(
          tTcpIpv6ServerHandle  handle,
          unsigned char        *pData,
          unsigned short        size
      );
+void comm_tcpIpv6ServerSendAllClientEx(
+         tTcpIpv6ServerHandle  handle,
+         unsigned char        *pData,
+         size_t                size
+     );
 int  comm_tcpIpv6ServerGetClientNum(tTcpIpv6ServerHandle handle);
 /************************ End   of TCP Server ************************/
 
@@ -208,26 +657,114 @@ typedef void (*tRawRecvCb)(
             unsigned char  *pData,
             unsigned short  size
         );
+typedef void (*tRawBufCb)(void *pArg, tCommBuf *pBuf);
+
+#define COMM_RAW_RING_BLOCK_SIZE  (1 << 20)
+#define COMM_RAW_RING_BLOCK_NUM   (64)
+#define COMM_RAW_RING_FRAME_SIZE  (2048)
+#define COMM_RAW_RING_TIMEOUT     (10)
+
+/*
+*  TPACKET_V3 receive ring / TPACKET_V2 transmit ring (0 is the default):
+*    blockSize ==> multiple of the page size
+*    frameSize ==> max. frame of one slot, multiple of 16
+*    timeout   ==> ms to pass a partly filled block (receive ring only)
+*/
+typedef struct _tRawRing
+{
+    unsigned int    blockSize;
+    unsigned int    blockNum;
+    unsigned int    frameSize;
+    unsigned int    timeout;
+} tRawRing;
+
+/*
+*  One frame of the receive ring, pData points into the ring and is
+*  valid in the callback only. sec / nsec is the kernel timestamp.
+*/
+typedef struct _tRawFrame
+{
+    unsigned char  *pData;
+    unsigned int    size;
+    unsigned int    wireLen;
+    unsigned int    sec;
+    unsigned int    nsec;
+} tRawFrame;
+
+typedef void (*tRawRingCb)(void *pArg, tRawFrame *pFrame, int num);
+
+/* Fan-out modes */
+#define COMM_RAW_FANOUT_HASH      (0)  /* by flow, keeps a flow in order */
+#define COMM_RAW_FANOUT_LB        (1)  /* round-robin */
+#define COMM_RAW_FANOUT_CPU       (2)  /* by the receiving CPU */
+#define COMM_RAW_FANOUT_ROLLOVER  (3)  /* to the next member when one is full */
+
+typedef void (*tRawFanoutCb)(void *pArg, int member, tCommBuf *pBuf);
 
 tRawHandle comm_rawSockInit(
                char       *pEthDev,
                tRawRecvCb  pRecvFunc,
                void       *pArg
            );
+tRawHandle comm_rawSockInitBuf(
+               char       *pEthDev,
+               tRawBufCb   pBufFunc,
+               void       *pArg
+           );
+tRawHandle comm_rawSockInitRing(
+               char       *pEthDev,
+               tRawRing   *pRing,
+               tRawRingCb  pRingFunc,
+               void       *pArg
+           );
+tRawHandle comm_rawSockInitFanout(
+               char          *pEthDev,
+               int            memberNum,
+               int            mode,
+               tRawFanoutCb   pFanoutFunc,
+               void          *pArg
+           );
 void comm_rawSockUninit(tRawHandle handle);
+int  comm_rawSockSetRecvSize(tRawHandle handle, size_t size);
 int  comm_rawSockSend(
          tRawHandle      handle,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_rawSockSendEx(
+            tRawHandle      handle,
+            unsigned char  *pData,
+            size_t          size
+        );
 int  comm_rawSockRecv(
          tRawHandle      handle,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_rawSockRecvEx(
+            tRawHandle      handle,
+            unsigned char  *pData,
+            size_t          size
+        );
 int  comm_rawPromiscMode(tRawHandle handle, int enable);
+int  comm_rawSetFilter(tRawHandle handle, char *pExpr);
+int  comm_rawSetTap(tRawHandle handle, tPcapHandle pcap);
 int  comm_rawGetMtu(tRawHandle handle);
 unsigned char *comm_rawGetHwAddr(tRawHandle handle);
+int  comm_rawGetStat(
+         tRawHandle     handle,
+         unsigned int  *pPackets,
+         unsigned int  *pDrops
+     );
+int  comm_rawSockSetTxRing(tRawHandle handle, tRawRing *pRing);
+unsigned char *comm_rawTxReserve(tRawHandle handle, size_t *pRoom);
+int  comm_rawTxCommit(tRawHandle handle, size_t size);
+ssize_t comm_rawTxFlush(tRawHandle handle, int wait);
+int  comm_rawTxStatus(
+         tRawHandle     handle,
+         unsigned int  *pPending,
+         unsigned int  *pErrors
+     );
 /************************ End   of Raw ************************/
 
 
@@ -256,6 +793,11 @@ int  comm_fifoWritePut(
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_fifoWritePutEx(
+            tFifoHandle     handle,
+            unsigned char  *pData,
+            size_t          size
+        );
 /************************ End   of FIFO ************************/
 
 
@@ -267,24 +809,47 @@ typedef void (*tIpcDgramRecvCb)(
                  unsigned short  size,
                  char           *pPath
              );
+typedef void (*tIpcDgramBufCb)(
+                 void      *pArg,
+                 tCommBuf  *pBuf,
+                 char      *pPath
+             );
 
 tIpcDgramHandle comm_ipcDgramInit(
                     char            *pFileName,
                     tIpcDgramRecvCb  pRecvFunc,
                     void            *pArg
                 );
+tIpcDgramHandle comm_ipcDgramInitBuf(
+                    char            *pFileName,
+                    tIpcDgramBufCb   pBufFunc,
+                    void            *pArg
+                );
 void comm_ipcDgramUninit(tIpcDgramHandle handle);
+int  comm_ipcDgramSetRecvSize(tIpcDgramHandle handle, size_t size);
+int  comm_ipcDgramSetTap(tIpcDgramHandle handle, tPcapHandle pcap);
 int  comm_ipcDgramSend(
          tIpcDgramHandle  handle,
          char            *pFileName,
          unsigned char   *pData,
          unsigned short   size
      );
+ssize_t comm_ipcDgramSendEx(
+            tIpcDgramHandle  handle,
+            char            *pFileName,
+            unsigned char   *pData,
+            size_t           size
+        );
 int  comm_ipcDgramRecv(
          tIpcDgramHandle  handle,
          unsigned char   *pData,
          unsigned short   size
      );
+ssize_t comm_ipcDgramRecvEx(
+            tIpcDgramHandle  handle,
+            unsigned char   *pData,
+            size_t           size
+        );
 /************************ End   of IPC Dgram ************************/
 
 
@@ -295,6 +860,7 @@ typedef void (*tIpcClientRecvCb)(
                  unsigned char  *pData,
                  unsigned short  size
              );
+typedef void (*tIpcClientBufCb)(void *pArg, tCommBuf *pBuf);
 typedef void (*tIpcClientExitCb)(void *pArg, int code);
 
 tIpcStreamClientHandle comm_ipcStreamClientInit(
@@ -303,7 +869,16 @@ tIpcStreamClientHandle comm_ipcStreamClientInit(
                            tIpcClientExitCb  pExitFunc,
                            void             *pArg
                        );
+tIpcStreamClientHandle comm_ipcStreamClientInitBuf(
+                           char             *pFileName,
+                           tIpcClientBufCb   pBufFunc,
+                           tIpcClientExitCb  pExitFunc,
+                           void             *pArg
+                       );
 void comm_ipcStreamClientUninit(tIpcStreamClientHandle handle);
+int  comm_ipcStreamClientSetRecvSize(tIpcStreamClientHandle handle, size_t size);
+int  comm_ipcStreamClientSetFrame(tIpcStreamClientHandle handle, tCommFrame *pFrame);
+int  comm_ipcStreamClientSetTap(tIpcStreamClientHandle handle, tPcapHandle pcap);
 int  comm_ipcStreamClientConnect(
          tIpcStreamClientHandle  handle,
          char                   *pFileName
@@ -313,6 +888,16 @@ int  comm_ipcStreamClientSend(
          unsigned char          *pData,
          unsigned short          size
      );
+ssize_t comm_ipcStreamClientSendEx(
+            tIpcStreamClientHandle  handle,
+            unsigned char          *pData,
+            size_t                  size
+        );
+ssize_t comm_ipcStreamClientSendv(
+            tIpcStreamClientHandle  handle,
+            struct iovec           *pIov,
+            int                     num
+        );
 
 typedef unsigned long  tIpcStreamServerHandle;
 typedef struct _tIpcUser
@@ -321,7 +906,6 @@ typedef struct _tIpcUser
     char           fileName[256];
     int            fd;
     pthread_t      thread;
-    unsigned char  recvMsg[COMM_BUF_SIZE+1];
 } tIpcUser;
 
 typedef void (*tIpcServerRecvCb)(
@@ -330,6 +914,11 @@ typedef void (*tIpcServerRecvCb)(
                  unsigned char  *pData,
                  unsigned short  size
              );
+typedef void (*tIpcServerBufCb)(
+                 void      *pArg,
+                 tIpcUser  *pUser,
+                 tCommBuf  *pBuf
+             );
 typedef void (*tIpcServerAcptCb)(void *pArg, tIpcUser *pUser);
 typedef void (*tIpcServerExitCb)(void *pArg, tIpcUser *pUser);
 
@@ -341,17 +930,43 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
                            tIpcServerRecvCb  pRecvFunc,
                            void             *pArg
                        );
+tIpcStreamServerHandle comm_ipcStreamInitServerBuf(
+                           char             *pFileName,
+                           int               maxUserNum,
+                           tIpcServerAcptCb  pAcptFunc,
+                           tIpcServerExitCb  pExitFunc,
+                           tIpcServerBufCb   pBufFunc,
+                           void             *pArg
+                       );
 void comm_ipcStreamUninitServer(tIpcStreamServerHandle handle);
+int  comm_ipcStreamServerSetRecvSize(tIpcStreamServerHandle handle, size_t size);
+int  comm_ipcStreamServerSetFrame(tIpcStreamServerHandle handle, tCommFrame *pFrame);
+int  comm_ipcStreamServerSetTap(tIpcStreamServerHandle handle, tPcapHandle pcap);
 int  comm_ipcStreamServerSend(
          tIpcUser       *pUser,
          unsigned char  *pData,
          unsigned short  size
      );
+ssize_t comm_ipcStreamServerSendEx(
+            tIpcUser       *pUser,
+            unsigned char  *pData,
+            size_t          size
+        );
+ssize_t comm_ipcStreamServerSendv(
+            tIpcUser      *pUser,
+            struct iovec  *pIov,
+            int            num
+        );
 void comm_ipcStreamServerSendAllClient(
          tIpcStreamServerHandle  handle,
          unsigned char          *pData,
          unsigned short          size
      );
+void comm_ipcStreamServerSendAllClientEx(
+         tIpcStreamServerHandle  handle,
+         unsigned char          *pData,
+         size_t                  size
+     );
 int  comm_ipcStreamServerGetClientNum(tIpcStreamServerHandle handle);
 /************************ End   of IPC Stream ************************/
 
@@ -366,11 +981,60 @@ typedef void (*tNetlinkRecvCb)(
              );
 typedef void (*tNetlinkExitCb)(void *pArg, int code);
 
+#define COMM_NETLINK_BATCH_NUM (32)
+#define COMM_NETLINK_RECV_SIZE (32768)
+#define COMM_NETLINK_TIMEOUT   (1000)
+#define COMM_IFCACHE_TIMEOUT   (1000)  /* dump deadline of the interface cache */
+
+/*
+*  One netlink message of the batch receiving and sending, pData / size is
+*  the payload behind struct nlmsghdr. A multi-part reply is a series of
+*  messages with NLM_F_MULTI in flags and is ended by the type NLMSG_DONE.
+*/
+typedef struct _tNetlinkMsg
+{
+    unsigned char  *pData;
+    size_t          size;
+    unsigned short  type;
+    unsigned short  flags;
+    unsigned int    seqNum;
+    unsigned int    pid;  /* sender's port ID, receive only */
+} tNetlinkMsg;
+
+typedef void (*tNetlinkBatchCb)(
+                 void         *pArg,
+                 tNetlinkMsg  *pMsg,
+                 int           num
+             );
+
+/*
+*  Reply callback of a request, num is 0 when the request is completed:
+*    error 0 (ACK / NLMSG_DONE), -errno (NLMSG_ERROR), -ETIMEDOUT, -ECANCELED
+*/
+typedef void (*tNetlinkReplyCb)(
+                 void          *pArg,
+                 unsigned int   seqNum,
+                 int            error,
+                 tNetlinkMsg   *pMsg,
+                 int            num
+             );
+
 tNetlinkHandle comm_netlinkInit(
                    tNetlinkRecvCb  pRecvFunc,
                    tNetlinkExitCb  pExitFunc,
                    void           *pArg
                );
+tNetlinkHandle comm_netlinkInitBatch(
+                   tNetlinkBatchCb  pBatchFunc,
+                   tNetlinkExitCb   pExitFunc,
+                   void            *pArg
+               );
+tNetlinkHandle comm_netlinkInitTrans(
+                   int              protocol,
+                   tNetlinkBatchCb  pBatchFunc,
+                   tNetlinkExitCb   pExitFunc,
+                   void            *pArg
+               );
 void comm_netlinkUninit(tNetlinkHandle handle);
 int  comm_netlinkSendToKernel(
          tNetlinkHandle  handle,
@@ -380,17 +1044,71 @@ int  comm_netlinkSendToKernel(
          unsigned short  flags,
          unsigned int    seqNum
      );
+int  comm_netlinkSendBatch(tNetlinkHandle handle, tNetlinkMsg *pMsg, int num);
+int  comm_netlinkJoinGroup(tNetlinkHandle handle, unsigned int group);
+int  comm_netlinkRequest(
+         tNetlinkHandle   handle,
+         tNetlinkMsg     *pMsg,
+         int              num,
+         unsigned int     timeout,
+         tNetlinkReplyCb  pReplyFunc,
+         void            *pArg
+     );
+void comm_setIfCacheTimeout(unsigned int timeout);
 /************************ End   of Netlink ************************/
 
 
 /************************ Begin of UART ************************/
 typedef unsigned long  tUartHandle;
+typedef unsigned long  tUartGroupHandle;
 typedef void (*tUartRecvCb)(
             void           *pArg,
             unsigned char  *pData,
             unsigned short  size
         );
 
+typedef struct _tUartStat
+{
+    unsigned long  rxBytes;   /* bytes received */
+    unsigned long  rxCount;   /* receive callbacks */
+    unsigned long  txBytes;   /* bytes sent */
+    unsigned long  txCount;   /* uart_send() calls */
+    unsigned long  errorNum;  /* read and write errors */
+} tUartStat;
+
+/*
+*  Frame decoders of the UART receiving, the receive callback is given
+*  exactly one complete frame:
+*    UART_FRAME_SLIP       RFC 1055, ended by END (0xC0), passed unescaped
+*    UART_FRAME_COBS       ended by 0x00, passed decoded
+*    UART_FRAME_DELIMITER  ended by the delimiter byte, passed without it
+*    UART_FRAME_LENGTH     [ lenOffset bytes ][ length (lenSize bytes) ]
+*                          [ length + lenAdjust bytes ], passed whole
+*    UART_FRAME_IDLE       ended by a silence of the line, 3.5 characters
+*                          of the baud rate as Modbus RTU by default
+*
+*  The empty frames are skipped, the over-sized and broken ones are
+*  dropped and counted as errors.
+*/
+#define UART_FRAME_NONE       (0)
+#define UART_FRAME_SLIP       (1)
+#define UART_FRAME_COBS       (2)
+#define UART_FRAME_DELIMITER  (3)
+#define UART_FRAME_LENGTH     (4)
+#define UART_FRAME_IDLE       (5)
+
+typedef struct _tUartFrame
+{
+    int            type;
+    unsigned char  delimiter;  /* UART_FRAME_DELIMITER */
+    int            lenOffset;  /* UART_FRAME_LENGTH: bytes in front of the length */
+    int            lenSize;    /* UART_FRAME_LENGTH: 1, 2 or 4 bytes */
+    int            bigEndian;  /* UART_FRAME_LENGTH: byte order of the length */
+    int            lenAdjust;  /* UART_FRAME_LENGTH: added to the length for the bytes after it */
+    unsigned int   idleTime;   /* UART_FRAME_IDLE: micro-seconds (0 is 3.5 characters) */
+    size_t         maxSize;    /* max. frame size (0 is COMM_BUF_SIZE) */
+} tUartFrame;
+
 tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg);
 void uart_closeDev(tUartHandle handle);
 int  uart_configDev(
@@ -399,8 +1117,19 @@ int  uart_configDev(
          int          parity,
          int          waitTime
      );
+int  uart_setIdleTime(tUartHandle handle, unsigned int idleTime);
+int  uart_setFrame(tUartHandle handle, tUartFrame *pFrame);
 int  uart_send(tUartHandle handle, unsigned char *pData, unsigned short size);
 int  uart_baudRate(int baudRate);
+int  uart_getStat(tUartHandle handle, tUartStat *pStat);
+tUartGroupHandle uart_groupInit(int threadNum, int pin);
+void uart_groupUninit(tUartGroupHandle group);
+tUartHandle uart_groupOpenDev(
+                tUartGroupHandle  group,
+                char             *pDevName,
+                tUartRecvCb       pRecvFunc,
+                void             *pArg
+            );
 /************************ End   of UART ************************/
 
 
@@ -0,0 +1,1205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_bpf.h"
+
+
+#define BPF_NODE_MAX   (1024)
+#define BPF_LABEL_MAX  ((BPF_NODE_MAX * 2) + 32)
+#define BPF_TOKEN_MAX  (64)
+
+/* The return value of an accepted packet, never trims it */
+#define BPF_ACCEPT  (0xFFFFFFFF)
+
+/* Ethernet header size, the IP header follows it */
+#define BPF_ETH_HLEN  (14)
+
+/*
+* Scratch memory of a packet socket program, filled once by the prologue
+* and shared by the primitives:
+*   BPF_MEM_PROTO : (IP version << 8) | IP protocol or IPv6 next header,
+*                   0 is not IP
+*   BPF_MEM_PORT  : offset of the TCP / UDP / SCTP ports, 0 is none
+*                   (other protocols, IPv4 fragments, IPv6 extensions)
+*/
+#define BPF_MEM_PROTO  (0)
+#define BPF_MEM_PORT   (1)
+#define BPF_IP_PROTO(version, proto)  (((version) << 8) | (proto))
+
+#define NODE_AND    (0)
+#define NODE_OR     (1)
+#define NODE_NOT    (2)
+#define NODE_CMP    (3)
+#define NODE_CONST  (4)
+
+#define DIR_SRC  (1)
+#define DIR_DST  (2)
+#define DIR_ANY  (DIR_SRC | DIR_DST)
+
+
+/* one node of the expression tree */
+typedef struct _tBpfNode
+{
+    int             kind;
+    int             left;
+    int             right;
+
+    /* NODE_CMP: load, mask and compare, NODE_CONST: val */
+    unsigned short  size;  /* BPF_B / BPF_H / BPF_W */
+    unsigned short  mode;  /* BPF_ABS / BPF_IND (after BPF_MEM_PORT) / BPF_MEM */
+    unsigned int    off;
+    unsigned int    mask;
+    unsigned short  op;    /* BPF_JEQ / BPF_JSET */
+    unsigned int    val;
+} tBpfNode;
+
+/* one instruction with the labels of its jumps */
+typedef struct _tBpfInsn
+{
+    struct sock_filter  code;
+    int                 lTrue;
+    int                 lFalse;
+} tBpfInsn;
+
+typedef struct _tBpfComp
+{
+    int        link;
+    char      *pCur;
+    char       token[BPF_TOKEN_MAX];
+    int        full;      /* the node table overflow is logged */
+    int        prologue;  /* the scratch memory is used */
+
+    tBpfNode   node[BPF_NODE_MAX];
+    int        nodeNum;
+
+    tBpfInsn  *pInsn;
+    int        insnNum;
+    int        label[BPF_LABEL_MAX];
+    int        labelNum;
+} tBpfComp;
+
+
+static int _bpfExpr(tBpfComp *pComp);
+
+
+/**
+*  Read the next token of the expression.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*/
+static void _bpfNext(tBpfComp *pComp)
+{
+    char *pCur = pComp->pCur;
+    int len = 0;
+
+
+    while (isspace( (unsigned char)*pCur ))
+    {
+        pCur++;
+    }
+
+    if (('(' == *pCur) || (')' == *pCur) || ('!' == *pCur))
+    {
+        pComp->token[len++] = *pCur++;
+    }
+    else if ((('&' == pCur[0]) && ('&' == pCur[1])) ||
+             (('|' == pCur[0]) && ('|' == pCur[1])))
+    {
+        pComp->token[len++] = *pCur++;
+        pComp->token[len++] = *pCur++;
+    }
+    else
+    {
+        while (( *pCur ) &&
+               ( !isspace( (unsigned char)*pCur ) ) &&
+               ( !strchr("()!&|", *pCur) ) &&
+               (len < (BPF_TOKEN_MAX - 1)))
+        {
+            pComp->token[len++] = *pCur++;
+        }
+    }
+
+    pComp->token[len] = 0x00;
+    pComp->pCur = pCur;
+}
+
+/**
+*  Check the current token.
+*  @param [in]  pComp   A @ref tBpfComp object.
+*  @param [in]  pWord   Expected word.
+*  @returns  Match(1) or not(0).
+*/
+static int _bpfIs(tBpfComp *pComp, char *pWord)
+{
+    return (0 == strcmp(pComp->token, pWord));
+}
+
+/**
+*  Report a syntax error at the current token.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  pMsg   Error message.
+*  @returns  Failure(-1).
+*/
+static int _bpfError(tBpfComp *pComp, char *pMsg)
+{
+    LOG_ERROR("filter: %s near '%s'\n", pMsg, pComp->token);
+    return -1;
+}
+
+/**
+*  Parse a number.
+*  @param [in]   pComp  A @ref tBpfComp object.
+*  @param [in]   pStr   Number string.
+*  @param [in]   max    Max. value.
+*  @param [out]  pVal   Number.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _bpfNumber(tBpfComp *pComp, char *pStr, unsigned long max, unsigned int *pVal)
+{
+    unsigned long val;
+    char *pEnd;
+
+
+    errno = 0;
+    val = strtoul(pStr, &pEnd, 0);
+    if ((0 == pStr[0]) || (*pEnd) || (errno) || (val > max))
+    {
+        return _bpfError(pComp, "wrong number");
+    }
+
+    *pVal = val;
+    return 0;
+}
+
+/**
+*  Add a node to the expression tree.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  kind   Node kind.
+*  @param [in]  left   Left child.
+*  @param [in]  right  Right child.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfNode(tBpfComp *pComp, int kind, int left, int right)
+{
+    tBpfNode *pNode;
+
+    if ((left < 0) || (right < 0))
+    {
+        return -1;
+    }
+
+    if (pComp->nodeNum >= BPF_NODE_MAX)
+    {
+        if ( !pComp->full )
+        {
+            LOG_ERROR("filter: expression is too long\n");
+            pComp->full = 1;
+        }
+        return -1;
+    }
+
+    pNode = &(pComp->node[pComp->nodeNum]);
+    memset(pNode, 0x00, sizeof( tBpfNode ));
+    pNode->kind = kind;
+    pNode->left = left;
+    pNode->right = right;
+
+    return pComp->nodeNum++;
+}
+
+/**
+*  Add a node that loads a packet field, masks and compares it.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  size   BPF_B / BPF_H / BPF_W.
+*  @param [in]  mode   BPF_ABS, BPF_IND after the port offset, or BPF_MEM.
+*  @param [in]  off    Field offset (scratch memory slot of BPF_MEM).
+*  @param [in]  mask   Field mask (0xFFFFFFFF is no mask).
+*  @param [in]  op     BPF_JEQ / BPF_JSET.
+*  @param [in]  val    Compared value.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfCmp(
+    tBpfComp        *pComp,
+    unsigned short   size,
+    unsigned short   mode,
+    unsigned int     off,
+    unsigned int     mask,
+    unsigned short   op,
+    unsigned int     val
+)
+{
+    int index = _bpfNode(pComp, NODE_CMP, 0, 0);
+
+    if (index >= 0)
+    {
+        pComp->node[index].size = size;
+        pComp->node[index].mode = mode;
+        pComp->node[index].off = off;
+        pComp->node[index].mask = mask;
+        pComp->node[index].op = op;
+        pComp->node[index].val = val;
+    }
+
+    return index;
+}
+
+/**
+*  Add a node of a constant result.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  val    True(1) or false(0).
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfConst(tBpfComp *pComp, int val)
+{
+    int index = _bpfNode(pComp, NODE_CONST, 0, 0);
+
+    if (index >= 0)
+    {
+        pComp->node[index].val = (val != 0);
+    }
+
+    return index;
+}
+
+/**
+*  Match the Ethernet type.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  type   Ethernet type.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfEtherType(tBpfComp *pComp, unsigned int type)
+{
+    if (BPF_LINK_ETHER == pComp->link)
+    {
+        return _bpfCmp(pComp, BPF_H, BPF_ABS, 12, 0xFFFFFFFF, BPF_JEQ, type);
+    }
+
+    /* a UDP socket gets its own family only */
+    return _bpfConst(
+               pComp,
+               (type == ((BPF_LINK_UDP4 == pComp->link) ? ETH_P_IP : ETH_P_IPV6))
+           );
+}
+
+/**
+*  Match the IP protocol, or the IPv6 next header. A packet socket tests
+*  the protocol stored by the prologue, only the requested family is built.
+*  @param [in]  pComp    A @ref tBpfComp object.
+*  @param [in]  version  IPv4(4), IPv6(6) or both(0).
+*  @param [in]  proto    IP protocol.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfProto(tBpfComp *pComp, int version, unsigned int proto)
+{
+    if (BPF_LINK_ETHER != pComp->link)
+    {
+        /* a UDP socket gets UDP of its own family only */
+        if (((4 == version) && (BPF_LINK_UDP6 == pComp->link)) ||
+            ((6 == version) && (BPF_LINK_UDP4 == pComp->link)))
+        {
+            return _bpfConst(pComp, 0);
+        }
+
+        return _bpfConst(pComp, (IPPROTO_UDP == proto));
+    }
+
+    pComp->prologue = 1;
+
+    if (0 == version)
+    {
+        return _bpfNode(
+                   pComp,
+                   NODE_OR,
+                   _bpfProto(pComp, 4, proto),
+                   _bpfProto(pComp, 6, proto)
+               );
+    }
+
+    return _bpfCmp(
+               pComp,
+               BPF_W,
+               BPF_MEM,
+               BPF_MEM_PROTO,
+               0xFFFFFFFF,
+               BPF_JEQ,
+               BPF_IP_PROTO(version, proto)
+           );
+}
+
+/**
+*  Compare the source or destination port.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  dir    DIR_SRC / DIR_DST / DIR_ANY.
+*  @param [in]  port   Port number.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfPortCmp(tBpfComp *pComp, int dir, unsigned int port)
+{
+    if (DIR_ANY == dir)
+    {
+        return _bpfNode(
+                   pComp,
+                   NODE_OR,
+                   _bpfPortCmp(pComp, DIR_SRC, port),
+                   _bpfPortCmp(pComp, DIR_DST, port)
+               );
+    }
+
+    if (BPF_LINK_ETHER != pComp->link)
+    {
+        /* the packet starts at the UDP header */
+        return _bpfCmp(pComp, BPF_H, BPF_ABS, ((DIR_SRC == dir) ? 0 : 2), 0xFFFFFFFF, BPF_JEQ, port);
+    }
+
+    return _bpfCmp(pComp, BPF_H, BPF_IND, ((DIR_SRC == dir) ? 0 : 2), 0xFFFFFFFF, BPF_JEQ, port);
+}
+
+/**
+*  Match a TCP, UDP or SCTP port, of the first IPv4 fragment or of IPv6
+*  without extension headers.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  dir    DIR_SRC / DIR_DST / DIR_ANY.
+*  @param [in]  port   Port number.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfPort(tBpfComp *pComp, int dir, unsigned int port)
+{
+    if (BPF_LINK_ETHER != pComp->link)
+    {
+        return _bpfPortCmp(pComp, dir, port);
+    }
+
+    /* the prologue found the ports, or stored 0 */
+    pComp->prologue = 1;
+    return _bpfNode(
+               pComp,
+               NODE_AND,
+               _bpfNode(
+                   pComp,
+                   NODE_NOT,
+                   _bpfCmp(pComp, BPF_W, BPF_MEM, BPF_MEM_PORT, 0xFFFFFFFF, BPF_JEQ, 0),
+                   0
+               ),
+               _bpfPortCmp(pComp, dir, port)
+           );
+}
+
+/**
+*  Match an IPv4 host or network.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  dir    DIR_SRC / DIR_DST / DIR_ANY.
+*  @param [in]  addr   IPv4 address in host byte order.
+*  @param [in]  mask   Network mask in host byte order.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfHost(tBpfComp *pComp, int dir, unsigned int addr, unsigned int mask)
+{
+    unsigned int off;
+
+    if (DIR_ANY == dir)
+    {
+        return _bpfNode(
+                   pComp,
+                   NODE_OR,
+                   _bpfHost(pComp, DIR_SRC, addr, mask),
+                   _bpfHost(pComp, DIR_DST, addr, mask)
+               );
+    }
+
+    off = (DIR_SRC == dir) ? 12 : 16;
+    switch ( pComp->link )
+    {
+        case BPF_LINK_ETHER:
+            return _bpfNode(
+                       pComp,
+                       NODE_AND,
+                       _bpfEtherType(pComp, ETH_P_IP),
+                       _bpfCmp(pComp, BPF_W, BPF_ABS, (BPF_ETH_HLEN + off), mask, BPF_JEQ, (addr & mask))
+                   );
+        case BPF_LINK_UDP4:
+            /* the IPv4 header is before the packet */
+            return _bpfCmp(pComp, BPF_W, BPF_ABS, (SKF_NET_OFF + off), mask, BPF_JEQ, (addr & mask));
+        default:
+            LOG_ERROR("filter: no IPv4 host on an IPv6 UDP socket\n");
+            return -1;
+    }
+}
+
+/**
+*  Parse a TCP, UDP or SCTP primitive, with the port of that protocol.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfProtoPort(tBpfComp *pComp)
+{
+    unsigned int proto;
+    unsigned int val;
+    int dir = DIR_ANY;
+    int index;
+
+
+    if ( _bpfIs(pComp, "tcp") )
+    {
+        proto = IPPROTO_TCP;
+    }
+    else if ( _bpfIs(pComp, "udp") )
+    {
+        proto = IPPROTO_UDP;
+    }
+    else
+    {
+        proto = IPPROTO_SCTP;
+    }
+    _bpfNext( pComp );
+
+    index = _bpfProto(pComp, 0, proto);
+
+    if ( _bpfIs(pComp, "src") )
+    {
+        dir = DIR_SRC;
+        _bpfNext( pComp );
+    }
+    else if ( _bpfIs(pComp, "dst") )
+    {
+        dir = DIR_DST;
+        _bpfNext( pComp );
+    }
+
+    if ( !_bpfIs(pComp, "port") )
+    {
+        if (dir != DIR_ANY)
+        {
+            return _bpfError(pComp, "src / dst needs port");
+        }
+        return index;
+    }
+
+    _bpfNext( pComp );
+    if (_bpfNumber(pComp, pComp->token, 65535, &val) != 0)
+    {
+        return -1;
+    }
+    _bpfNext( pComp );
+
+    return _bpfNode(pComp, NODE_AND, index, _bpfPort(pComp, dir, val));
+}
+
+/**
+*  Parse a primitive.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfPrimitive(tBpfComp *pComp)
+{
+    struct in_addr addr;
+    unsigned int mask;
+    unsigned int len;
+    unsigned int val;
+    char *pSlash;
+    int dir = DIR_ANY;
+    int index;
+    int net;
+
+
+    if ( _bpfIs(pComp, "src") )
+    {
+        dir = DIR_SRC;
+        _bpfNext( pComp );
+    }
+    else if ( _bpfIs(pComp, "dst") )
+    {
+        dir = DIR_DST;
+        _bpfNext( pComp );
+    }
+
+    if (_bpfIs(pComp, "host") || _bpfIs(pComp, "net"))
+    {
+        net = _bpfIs(pComp, "net");
+        _bpfNext( pComp );
+
+        len = 32;
+        pSlash = strchr(pComp->token, '/');
+        if ( pSlash )
+        {
+            *pSlash = 0x00;
+            if (( !net ) || (_bpfNumber(pComp, (pSlash + 1), 32, &len) != 0))
+            {
+                return _bpfError(pComp, "wrong prefix length");
+            }
+        }
+
+        if (inet_pton(AF_INET, pComp->token, &addr) != 1)
+        {
+            return _bpfError(pComp, "wrong IPv4 address");
+        }
+        _bpfNext( pComp );
+
+        mask = (0 == len) ? 0 : (0xFFFFFFFF << (32 - len));
+        return _bpfHost(pComp, dir, ntohl( addr.s_addr ), mask);
+    }
+
+    if ( _bpfIs(pComp, "port") )
+    {
+        _bpfNext( pComp );
+        if (_bpfNumber(pComp, pComp->token, 65535, &val) != 0)
+        {
+            return -1;
+        }
+        _bpfNext( pComp );
+        return _bpfPort(pComp, dir, val);
+    }
+
+    if (_bpfIs(pComp, "tcp") || _bpfIs(pComp, "udp") || _bpfIs(pComp, "sctp"))
+    {
+        if (dir != DIR_ANY)
+        {
+            return _bpfError(pComp, "src / dst goes after the protocol");
+        }
+        return _bpfProtoPort( pComp );
+    }
+
+    if (dir != DIR_ANY)
+    {
+        return _bpfError(pComp, "src / dst needs host, net or port");
+    }
+
+    index = -2;
+    if ( _bpfIs(pComp, "ip") )
+    {
+        index = _bpfEtherType(pComp, ETH_P_IP);
+    }
+    else if ( _bpfIs(pComp, "ip6") )
+    {
+        index = _bpfEtherType(pComp, ETH_P_IPV6);
+    }
+    else if ( _bpfIs(pComp, "arp") )
+    {
+        index = _bpfEtherType(pComp, ETH_P_ARP);
+    }
+    else if ( _bpfIs(pComp, "icmp") )
+    {
+        index = _bpfProto(pComp, 4, IPPROTO_ICMP);
+    }
+    else if ( _bpfIs(pComp, "icmp6") )
+    {
+        index = _bpfProto(pComp, 6, IPPROTO_ICMPV6);
+    }
+
+    if (index != -2)
+    {
+        _bpfNext( pComp );
+        return index;
+    }
+
+    if ( _bpfIs(pComp, "ether") )
+    {
+        _bpfNext( pComp );
+        if ( !_bpfIs(pComp, "proto") )
+        {
+            return _bpfError(pComp, "ether needs proto");
+        }
+        _bpfNext( pComp );
+        if (_bpfNumber(pComp, pComp->token, 65535, &val) != 0)
+        {
+            return -1;
+        }
+        _bpfNext( pComp );
+        return _bpfEtherType(pComp, val);
+    }
+
+    if ( _bpfIs(pComp, "proto") )
+    {
+        _bpfNext( pComp );
+        if (_bpfNumber(pComp, pComp->token, 255, &val) != 0)
+        {
+            return -1;
+        }
+        _bpfNext( pComp );
+        return _bpfProto(pComp, 0, val);
+    }
+
+    return _bpfError(pComp, ((pComp->token[0]) ? "unknown primitive" : "missing primitive"));
+}
+
+/**
+*  Parse a factor.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfFactor(tBpfComp *pComp)
+{
+    int index;
+
+    if (_bpfIs(pComp, "not") || _bpfIs(pComp, "!"))
+    {
+        _bpfNext( pComp );
+        return _bpfNode(pComp, NODE_NOT, _bpfFactor( pComp ), 0);
+    }
+
+    if ( _bpfIs(pComp, "(") )
+    {
+        _bpfNext( pComp );
+        index = _bpfExpr( pComp );
+        if (index < 0)
+        {
+            return -1;
+        }
+
+        if ( !_bpfIs(pComp, ")") )
+        {
+            return _bpfError(pComp, "missing ')'");
+        }
+        _bpfNext( pComp );
+        return index;
+    }
+
+    return _bpfPrimitive( pComp );
+}
+
+/**
+*  Parse a term.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfTerm(tBpfComp *pComp)
+{
+    int index = _bpfFactor( pComp );
+
+    while ((index >= 0) && (_bpfIs(pComp, "and") || _bpfIs(pComp, "&&")))
+    {
+        _bpfNext( pComp );
+        index = _bpfNode(pComp, NODE_AND, index, _bpfFactor( pComp ));
+    }
+
+    return index;
+}
+
+/**
+*  Parse an expression.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Node index (-1 is failed).
+*/
+static int _bpfExpr(tBpfComp *pComp)
+{
+    int index = _bpfTerm( pComp );
+
+    while ((index >= 0) && (_bpfIs(pComp, "or") || _bpfIs(pComp, "||")))
+    {
+        _bpfNext( pComp );
+        index = _bpfNode(pComp, NODE_OR, index, _bpfTerm( pComp ));
+    }
+
+    return index;
+}
+
+/**
+*  Allocate a jump label.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Label (-1 is failed).
+*/
+static int _bpfLabel(tBpfComp *pComp)
+{
+    if (pComp->labelNum >= BPF_LABEL_MAX)
+    {
+        return -1;
+    }
+
+    pComp->label[pComp->labelNum] = -1;
+    return pComp->labelNum++;
+}
+
+/**
+*  Place a jump label at the next instruction.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  label  Label.
+*/
+static void _bpfPlace(tBpfComp *pComp, int label)
+{
+    pComp->label[label] = pComp->insnNum;
+}
+
+/**
+*  Emit an instruction.
+*  @param [in]  pComp   A @ref tBpfComp object.
+*  @param [in]  code    Operation code.
+*  @param [in]  k       Operand.
+*  @param [in]  lTrue   Label of the true jump (-1 is none).
+*  @param [in]  lFalse  Label of the false jump (-1 is none).
+*  @returns  Success(0) or failure(-1).
+*/
+static int _bpfEmit(
+    tBpfComp        *pComp,
+    unsigned short   code,
+    unsigned int     k,
+    int              lTrue,
+    int              lFalse
+)
+{
+    tBpfInsn *pInsn;
+
+    if (pComp->insnNum >= BPF_MAXINSNS)
+    {
+        if ( !pComp->full )
+        {
+            LOG_ERROR("filter: program is too long\n");
+            pComp->full = 1;
+        }
+        return -1;
+    }
+
+    pInsn = &(pComp->pInsn[pComp->insnNum++]);
+    memset(pInsn, 0x00, sizeof( tBpfInsn ));
+    pInsn->code.code = code;
+    pInsn->code.k = k;
+    pInsn->lTrue = lTrue;
+    pInsn->lFalse = lFalse;
+
+    return 0;
+}
+
+/**
+*  Emit a conditional jump that falls through when it does not match.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @param [in]  code   Operation code.
+*  @param [in]  k      Operand.
+*  @param [in]  label  Label of the true jump.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _bpfEmitIf(tBpfComp *pComp, unsigned short code, unsigned int k, int label)
+{
+    int next = _bpfLabel( pComp );
+
+    if ((next < 0) || (_bpfEmit(pComp, code, k, label, next) != 0))
+    {
+        return -1;
+    }
+
+    _bpfPlace(pComp, next);
+    return 0;
+}
+
+/**
+*  Emit the prologue that finds the IP protocol and the port offset of
+*  a packet once, and stores them to the scratch memory.
+*  @param [in]  pComp  A @ref tBpfComp object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _bpfPrologue(tBpfComp *pComp)
+{
+    int lIpv4 = _bpfLabel( pComp );
+    int lIpv6 = _bpfLabel( pComp );
+    int lPort4 = _bpfLabel( pComp );
+    int lPort6 = _bpfLabel( pComp );
+    int lNoPort = _bpfLabel( pComp );
+    int lEnd = _bpfLabel( pComp );
+    int error = 0;
+
+
+    if (lEnd < 0)
+    {
+        return -1;
+    }
+
+    /* not IP */
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_H | BPF_ABS), 12, -1, -1);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), ETH_P_IP, lIpv4);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), ETH_P_IPV6, lIpv6);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_IMM), 0, -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PROTO, -1, -1);
+    error |= _bpfEmit(pComp, (BPF_JMP | BPF_JA), 0, lNoPort, -1);
+
+    /* IPv4, the ports of the first fragment after the header length */
+    _bpfPlace(pComp, lIpv4);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_B | BPF_ABS), (BPF_ETH_HLEN + 9), -1, -1);
+    error |= _bpfEmit(pComp, (BPF_ALU | BPF_OR | BPF_K), BPF_IP_PROTO(4, 0), -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PROTO, -1, -1);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(4, IPPROTO_TCP), lPort4);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(4, IPPROTO_UDP), lPort4);
+    error |= _bpfEmit(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(4, IPPROTO_SCTP), lPort4, lNoPort);
+    _bpfPlace(pComp, lPort4);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_H | BPF_ABS), (BPF_ETH_HLEN + 6), -1, -1);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JSET | BPF_K), 0x1FFF, lNoPort);
+    error |= _bpfEmit(pComp, (BPF_LDX | BPF_B | BPF_MSH), BPF_ETH_HLEN, -1, -1);
+    error |= _bpfEmit(pComp, (BPF_MISC | BPF_TXA), 0, -1, -1);
+    error |= _bpfEmit(pComp, (BPF_ALU | BPF_ADD | BPF_K), BPF_ETH_HLEN, -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PORT, -1, -1);
+    error |= _bpfEmit(pComp, (BPF_JMP | BPF_JA), 0, lEnd, -1);
+
+    /* IPv6, the ports right after the fixed header */
+    _bpfPlace(pComp, lIpv6);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_B | BPF_ABS), (BPF_ETH_HLEN + 6), -1, -1);
+    error |= _bpfEmit(pComp, (BPF_ALU | BPF_OR | BPF_K), BPF_IP_PROTO(6, 0), -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PROTO, -1, -1);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(6, IPPROTO_TCP), lPort6);
+    error |= _bpfEmitIf(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(6, IPPROTO_UDP), lPort6);
+    error |= _bpfEmit(pComp, (BPF_JMP | BPF_JEQ | BPF_K), BPF_IP_PROTO(6, IPPROTO_SCTP), lPort6, lNoPort);
+    _bpfPlace(pComp, lPort6);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_IMM), (BPF_ETH_HLEN + 40), -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PORT, -1, -1);
+    error |= _bpfEmit(pComp, (BPF_JMP | BPF_JA), 0, lEnd, -1);
+
+    _bpfPlace(pComp, lNoPort);
+    error |= _bpfEmit(pComp, (BPF_LD | BPF_IMM), 0, -1, -1);
+    error |= _bpfEmit(pComp, BPF_ST, BPF_MEM_PORT, -1, -1);
+    _bpfPlace(pComp, lEnd);
+
+    return ((error != 0) ? -1 : 0);
+}
+
+/**
+*  Generate the code of a node, it jumps to one of the two labels.
+*  @param [in]  pComp   A @ref tBpfComp object.
+*  @param [in]  index   Node index.
+*  @param [in]  lTrue   Label if the node matches.
+*  @param [in]  lFalse  Label if the node does not match.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _bpfGen(tBpfComp *pComp, int index, int lTrue, int lFalse)
+{
+    tBpfNode *pNode = &(pComp->node[index]);
+    int label;
+
+
+    switch ( pNode->kind )
+    {
+        case NODE_CONST:
+            return _bpfEmit(pComp, (BPF_JMP | BPF_JA), 0, ((pNode->val) ? lTrue : lFalse), -1);
+
+        case NODE_NOT:
+            return _bpfGen(pComp, pNode->left, lFalse, lTrue);
+
+        case NODE_AND:
+        case NODE_OR:
+            label = _bpfLabel( pComp );
+            if ((label < 0) ||
+                (_bpfGen(
+                     pComp,
+                     pNode->left,
+                     ((NODE_AND == pNode->kind) ? label : lTrue),
+                     ((NODE_AND == pNode->kind) ? lFalse : label)
+                 ) != 0))
+            {
+                return -1;
+            }
+
+            _bpfPlace(pComp, label);
+            return _bpfGen(pComp, pNode->right, lTrue, lFalse);
+
+        default:
+            if (BPF_IND == pNode->mode)
+            {
+                /* X = port offset */
+                if (_bpfEmit(pComp, (BPF_LDX | BPF_W | BPF_MEM), BPF_MEM_PORT, -1, -1) != 0)
+                {
+                    return -1;
+                }
+            }
+
+            if (_bpfEmit(
+                    pComp,
+                    (BPF_LD | pNode->size | pNode->mode),
+                    pNode->off,
+                    -1,
+                    -1
+                ) != 0)
+            {
+                return -1;
+            }
+
+            if ((pNode->mask != 0xFFFFFFFF) &&
+                (_bpfEmit(pComp, (BPF_ALU | BPF_AND | BPF_K), pNode->mask, -1, -1) != 0))
+            {
+                return -1;
+            }
+
+            return _bpfEmit(pComp, (BPF_JMP | pNode->op | BPF_K), pNode->val, lTrue, lFalse);
+    }
+}
+
+/**
+*  Resolve the jump labels to the instruction offsets. A conditional
+*  jump over 255 instructions jumps to a BPF_JA after it instead, which
+*  moves the following code, so the jumps are checked again until none
+*  is added.
+*  @param [in]   pComp  A @ref tBpfComp object.
+*  @param [out]  ppCode  Program, the caller frees it.
+*  @returns  Number of instructions (-1 is failed).
+*/
+static int _bpfResolve(tBpfComp *pComp, struct sock_filter **ppCode)
+{
+    struct sock_filter *pCode;
+    unsigned char *pFar;  /* BPF_JA of the true(1) / false(2) jump */
+    tBpfInsn *pInsn;
+    int *pPos;
+    int changed;
+    int pos;
+    int jt;
+    int jf;
+    int i;
+
+
+    pPos = malloc( sizeof( int ) * (pComp->insnNum + 1) );
+    pFar = calloc(pComp->insnNum, sizeof( unsigned char ));
+    if ((NULL == pPos) || (NULL == pFar))
+    {
+        LOG_ERROR("fail to allocate filter compiler\n");
+        free( pPos );
+        free( pFar );
+        return -1;
+    }
+
+    do
+    {
+        changed = 0;
+
+        for (i=0, pos=0; i<pComp->insnNum; i++)
+        {
+            pPos[i] = pos;
+            pos += 1 + (pFar[i] & 1) + ((pFar[i] >> 1) & 1);
+        }
+        pPos[i] = pos;
+
+        if (pos > BPF_MAXINSNS)
+        {
+            LOG_ERROR("filter: program is too long\n");
+            free( pPos );
+            free( pFar );
+            return -1;
+        }
+
+        /* all the jumps are forward */
+        for (i=0; i<pComp->insnNum; i++)
+        {
+            pInsn = &(pComp->pInsn[i]);
+            if ((pInsn->lTrue < 0) || ((BPF_JMP | BPF_JA) == pInsn->code.code))
+            {
+                continue;
+            }
+
+            jt = pPos[pComp->label[pInsn->lTrue]] - (pPos[i] + 1);
+            jf = pPos[pComp->label[pInsn->lFalse]] - (pPos[i] + 1);
+            if ((jt > 255) && !(pFar[i] & 1))
+            {
+                pFar[i] |= 1;
+                changed = 1;
+            }
+            if ((jf > 255) && !(pFar[i] & 2))
+            {
+                pFar[i] |= 2;
+                changed = 1;
+            }
+        }
+    } while ( changed );
+
+    pCode = malloc( sizeof( struct sock_filter ) * pos );
+    if (NULL == pCode)
+    {
+        LOG_ERROR("fail to allocate filter program\n");
+        free( pPos );
+        free( pFar );
+        return -1;
+    }
+
+    for (i=0; i<pComp->insnNum; i++)
+    {
+        pInsn = &(pComp->pInsn[i]);
+        pos = pPos[i];
+        pCode[pos] = pInsn->code;
+        if (pInsn->lTrue < 0)
+        {
+            continue;
+        }
+
+        if ((BPF_JMP | BPF_JA) == pInsn->code.code)
+        {
+            pCode[pos].k = pPos[pComp->label[pInsn->lTrue]] - (pos + 1);
+            continue;
+        }
+
+        jt = pPos[pComp->label[pInsn->lTrue]] - (pos + 1);
+        jf = pPos[pComp->label[pInsn->lFalse]] - (pos + 1);
+        if (pFar[i] & 1)
+        {
+            pos++;
+            pCode[pos] = (struct sock_filter)BPF_STMT((BPF_JMP | BPF_JA), (jt - 1));
+            jf--;
+            jt = 0;
+        }
+        if (pFar[i] & 2)
+        {
+            pos++;
+            pCode[pos] = (struct sock_filter)BPF_STMT((BPF_JMP | BPF_JA), (jf - 1));
+            jf = (pFar[i] & 1) ? 1 : 0;
+        }
+        else if (pFar[i] & 1)
+        {
+            /* the false jump goes over the BPF_JA */
+            jf++;
+        }
+
+        pCode[pPos[i]].jt = jt;
+        pCode[pPos[i]].jf = jf;
+    }
+
+    pos = pPos[pComp->insnNum];
+    free( pPos );
+    free( pFar );
+
+    *ppCode = pCode;
+    return pos;
+}
+
+/**
+*  Compile a filter expression to a classic BPF program.
+*  @param [in]   pExpr  Filter expression.
+*  @param [in]   link   BPF_LINK_ETHER / BPF_LINK_UDP4 / BPF_LINK_UDP6.
+*  @param [out]  pProg  Program, released by @ref comm_bpfFree.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_bpfCompile(char *pExpr, int link, struct sock_fprog *pProg)
+{
+    struct sock_filter *pCode = NULL;
+    tBpfComp *pComp;
+    int lTrue;
+    int lFalse;
+    int root;
+    int len;
+    int i;
+
+
+    memset(pProg, 0x00, sizeof( struct sock_fprog ));
+
+    pComp = malloc( sizeof( tBpfComp ) );
+    if (NULL == pComp)
+    {
+        LOG_ERROR("fail to allocate filter compiler\n");
+        return -1;
+    }
+
+    memset(pComp, 0x00, sizeof( tBpfComp ));
+    pComp->link = link;
+    pComp->pCur = pExpr;
+    pComp->pInsn = malloc( sizeof( tBpfInsn ) * BPF_MAXINSNS );
+    if (NULL == pComp->pInsn)
+    {
+        LOG_ERROR("fail to allocate filter compiler\n");
+        free( pComp );
+        return -1;
+    }
+
+    _bpfNext( pComp );
+    root = _bpfExpr( pComp );
+    if ((root >= 0) && (pComp->token[0]))
+    {
+        root = _bpfError(pComp, "unexpected token");
+    }
+
+    lTrue = _bpfLabel( pComp );
+    lFalse = _bpfLabel( pComp );
+    if ((root < 0) ||
+        ((pComp->prologue) && (_bpfPrologue( pComp ) != 0)) ||
+        (_bpfGen(pComp, root, lTrue, lFalse) != 0))
+    {
+        goto _BPF_FAIL;
+    }
+
+    _bpfPlace(pComp, lTrue);
+    _bpfEmit(pComp, (BPF_RET | BPF_K), BPF_ACCEPT, -1, -1);
+    _bpfPlace(pComp, lFalse);
+    if (_bpfEmit(pComp, (BPF_RET | BPF_K), 0, -1, -1) != 0)
+    {
+        goto _BPF_FAIL;
+    }
+
+    len = _bpfResolve(pComp, &pCode);
+    if (len < 0)
+    {
+        goto _BPF_FAIL;
+    }
+
+    for (i=0; i<len; i++)
+    {
+        LOG_3(
+            "(%03d) code 0x%04x jt %3u jf %3u k 0x%08x\n",
+            i,
+            pCode[i].code,
+            pCode[i].jt,
+            pCode[i].jf,
+            pCode[i].k
+        );
+    }
+
+    pProg->len = len;
+    pProg->filter = pCode;
+
+    free( pComp->pInsn );
+    free( pComp );
+    return 0;
+
+_BPF_FAIL:
+    LOG_ERROR("fail to compile filter '%s'\n", pExpr);
+    free( pComp->pInsn );
+    free( pComp );
+    return -1;
+}
+
+/**
+*  Release a compiled program.
+*  @param [in]  pProg  Program from @ref comm_bpfCompile.
+*/
+void comm_bpfFree(struct sock_fprog *pProg)
+{
+    free( pProg->filter );
+    pProg->filter = NULL;
+    pProg->len = 0;
+}
+
+/**
+*  Compile a filter expression and attach it to a socket, so that the
+*  packets it rejects are dropped in the kernel.
+*  @param [in]  fd     Socket file descriptor.
+*  @param [in]  pExpr  Filter expression (NULL or empty detaches the filter).
+*  @param [in]  link   BPF_LINK_ETHER / BPF_LINK_UDP4 / BPF_LINK_UDP6.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_bpfAttach(int fd, char *pExpr, int link)
+{
+    struct sock_fprog prog;
+    int dummy = 0;
+    int error;
+
+
+    if ((NULL == pExpr) || (0x00 == pExpr[0]))
+    {
+        if ((setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &dummy, sizeof( dummy )) < 0) &&
+            (errno != ENOENT))
+        {
+            perror( "SO_DETACH_FILTER" );
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (comm_bpfCompile(pExpr, link, &prog) != 0)
+    {
+        return -1;
+    }
+
+    error = setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof( prog ));
+    if (error < 0)
+    {
+        perror( "SO_ATTACH_FILTER" );
+    }
+
+    comm_bpfFree( &prog );
+    return ((error < 0) ? -1 : 0);
+}
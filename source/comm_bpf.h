@@ -0,0 +1,54 @@
+#ifndef __COMM_BPF_H__
+#define __COMM_BPF_H__
+
+#include <linux/filter.h>
+#include "comm_if.h"
+
+
+/* Where the filtered packet starts */
+#define BPF_LINK_ETHER  (0)  /* packet socket, at the Ethernet header */
+#define BPF_LINK_UDP4   (1)  /* IPv4 UDP socket, at the UDP header */
+#define BPF_LINK_UDP6   (2)  /* IPv6 UDP socket, at the UDP header */
+
+
+/**
+*  Compile a filter expression to a classic BPF program.
+*
+*  expr      := term { ( or | || ) term }
+*  term      := factor { ( and | && ) factor }
+*  factor    := ( not | ! ) factor | '(' expr ')' | primitive
+*  primitive := [ src | dst ] host A.B.C.D
+*             | [ src | dst ] net A.B.C.D[/len]
+*             | [ src | dst ] port N
+*             | ( tcp | udp | sctp ) [ [ src | dst ] port N ]
+*             | ip | ip6 | arp | icmp | icmp6
+*             | ether proto N | proto N
+*
+*  A program of the packet socket finds the IP protocol and the port
+*  offset of a packet once, and the primitives test the saved values.
+*
+*  @param [in]   pExpr  Filter expression.
+*  @param [in]   link   BPF_LINK_ETHER / BPF_LINK_UDP4 / BPF_LINK_UDP6.
+*  @param [out]  pProg  Program, released by @ref comm_bpfFree.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_bpfCompile(char *pExpr, int link, struct sock_fprog *pProg);
+
+/**
+*  Release a compiled program.
+*  @param [in]  pProg  Program from @ref comm_bpfCompile.
+*/
+void comm_bpfFree(struct sock_fprog *pProg);
+
+/**
+*  Compile a filter expression and attach it to a socket, so that the
+*  packets it rejects are dropped in the kernel.
+*  @param [in]  fd     Socket file descriptor.
+*  @param [in]  pExpr  Filter expression (NULL or empty detaches the filter).
+*  @param [in]  link   BPF_LINK_ETHER / BPF_LINK_UDP4 / BPF_LINK_UDP6.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_bpfAttach(int fd, char *pExpr, int link);
+
+
+#endif /* __COMM_BPF_H__ */
@@ -0,0 +1,100 @@
+#define _GNU_SOURCE  /* pthread_setaffinity_np(), CPU_COUNT() */
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_cpu.h"
+
+
+/**
+*  Get the CPU of a worker from the CPUs this process may run on.
+*  @param [in]  index  Worker index.
+*  @returns  CPU number (-1 is failed).
+*/
+static int _cpuOf(int index)
+{
+    cpu_set_t cpuSet;
+    int count;
+    int cpu;
+
+
+    if (sched_getaffinity(0, sizeof( cpu_set_t ), &cpuSet) != 0)
+    {
+        perror( "sched_getaffinity" );
+        return -1;
+    }
+
+    count = CPU_COUNT( &cpuSet );
+    if (count <= 0)
+    {
+        return -1;
+    }
+
+    index %= count;
+    for (cpu=0; cpu<CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpuSet) && (0 == index--))
+        {
+            return cpu;
+        }
+    }
+
+    return -1;
+}
+
+/**
+*  Get the number of CPUs this process may run on.
+*  @param [in]  max  Max. number to return.
+*  @returns  Number of CPUs (1 at least).
+*/
+int comm_cpuNum(int max)
+{
+    cpu_set_t cpuSet;
+    int count;
+
+
+    if (sched_getaffinity(0, sizeof( cpu_set_t ), &cpuSet) != 0)
+    {
+        return 1;
+    }
+
+    count = CPU_COUNT( &cpuSet );
+    if (count > max)
+    {
+        count = max;
+    }
+
+    return ((count > 0) ? count : 1);
+}
+
+/**
+*  Pin a worker thread to one of the CPUs this process may run on, the
+*  workers 0, 1, 2, ... take the allowed CPUs in turn. A worker that can
+*  not be pinned still works, thus it is only warned.
+*  @param [in]  thread  Worker thread.
+*  @param [in]  index   Worker index.
+*/
+void comm_cpuPin(pthread_t thread, int index)
+{
+    cpu_set_t cpuSet;
+    int cpu;
+
+
+    cpu = _cpuOf( index );
+    if (cpu < 0)
+    {
+        return;
+    }
+
+    CPU_ZERO( &cpuSet );
+    CPU_SET(cpu, &cpuSet);
+
+    if (pthread_setaffinity_np(thread, sizeof( cpu_set_t ), &cpuSet) != 0)
+    {
+        LOG_WARN("fail to pin worker %d to CPU %d\n", index, cpu);
+        return;
+    }
+
+    LOG_2("worker %d is pinned to CPU %d\n", index, cpu);
+}
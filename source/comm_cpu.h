@@ -0,0 +1,24 @@
+#ifndef __COMM_CPU_H__
+#define __COMM_CPU_H__
+
+#include <pthread.h>
+
+
+/**
+*  Get the number of CPUs this process may run on.
+*  @param [in]  max  Max. number to return.
+*  @returns  Number of CPUs (1 at least).
+*/
+int  comm_cpuNum(int max);
+
+/**
+*  Pin a worker thread to one of the CPUs this process may run on, the
+*  workers 0, 1, 2, ... take the allowed CPUs in turn. A worker that can
+*  not be pinned still works, thus it is only warned.
+*  @param [in]  thread  Worker thread.
+*  @param [in]  index   Worker index.
+*/
+void comm_cpuPin(pthread_t thread, int index);
+
+
+#endif /* __COMM_CPU_H__ */
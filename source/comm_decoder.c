@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_pool.h"
+#include "comm_decoder.h"
+
+
+/* SLIP special characters (RFC 1055) */
+#define SLIP_END      (0xC0)
+#define SLIP_ESC      (0xDB)
+#define SLIP_ESC_END  (0xDC)
+#define SLIP_ESC_ESC  (0xDD)
+
+/* Max. frame size of the receive callback */
+#define DECODER_MAX_SIZE (0xFFFF)
+
+
+/**
+*  Find the first of two byte values. It takes 16 bytes a step with SSE2,
+*  the single value search is left to memchr() of the C library.
+*  @param [in]  pData  Data bytes.
+*  @param [in]  len    Data length.
+*  @param [in]  a      First value.
+*  @param [in]  b      Second value.
+*  @returns  Address of the found byte (NULL is not found).
+*/
+static unsigned char *_decoderScan2(
+    unsigned char  *pData,
+    size_t          len,
+    unsigned char   a,
+    unsigned char   b
+)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    __m128i va = _mm_set1_epi8( (char)a );
+    __m128i vb = _mm_set1_epi8( (char)b );
+    __m128i v;
+    int mask;
+
+    for (; (i + 16) <= len; i += 16)
+    {
+        v = _mm_loadu_si128( (const __m128i *)(pData + i) );
+        mask = _mm_movemask_epi8(
+                   _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb))
+               );
+        if (mask != 0)
+        {
+            return (pData + i + __builtin_ctz( mask ));
+        }
+    }
+#endif
+
+    for (; i<len; i++)
+    {
+        if ((pData[i] == a) || (pData[i] == b))
+        {
+            return (pData + i);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+*  Read the length field of a length-prefixed frame.
+*  @param [in]  pData  Field bytes.
+*  @param [in]  size   Field size (1, 2 or 4).
+*  @param [in]  big    Big endian(1) or little endian(0).
+*  @returns  Field value.
+*/
+static size_t _decoderGetField(unsigned char *pData, int size, int big)
+{
+    size_t value = 0;
+    int i;
+
+    for (i=0; i<size; i++)
+    {
+        if ( big )
+        {
+            value = (value << 8) | pData[i];
+        }
+        else
+        {
+            value |= ((size_t)pData[i] << (i * 8));
+        }
+    }
+
+    return value;
+}
+
+/**
+*  Append bytes to the frame in progress.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Data bytes.
+*  @param [in]  len       Data length.
+*  @returns  Number of dropped frames (1 if the frame becomes over-sized).
+*/
+static int _decoderAppend(tDecoder *pDecoder, unsigned char *pData, size_t len)
+{
+    if ( pDecoder->discard )
+    {
+        return 0;
+    }
+
+    if ((pDecoder->len + len) > pDecoder->bufSize)
+    {
+        LOG_2("%s: frame is over %zu bytes\n", __func__, pDecoder->maxSize);
+        pDecoder->discard = 1;
+        pDecoder->len = 0;
+        return 1;
+    }
+
+    memcpy((pDecoder->pBuf + pDecoder->len), pData, len);
+    pDecoder->len += len;
+    return 0;
+}
+
+/**
+*  Deliver a frame and start the next one.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Frame bytes.
+*  @param [in]  len       Frame length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*/
+static void _decoderDeliver(
+    tDecoder         *pDecoder,
+    unsigned char    *pData,
+    size_t            len,
+    tDecoderFrameCb   pFunc,
+    void             *pArg
+)
+{
+    if ((!pDecoder->discard) && (len > 0))
+    {
+        pFunc(pArg, pData, len);
+    }
+
+    pDecoder->len = 0;
+    pDecoder->need = 0;
+    pDecoder->escape = 0;
+    pDecoder->discard = 0;
+}
+
+/**
+*  Decode a COBS frame in place.
+*  @param [in]  pData  Encoded bytes without the 0x00 terminator.
+*  @param [in]  len    Encoded length.
+*  @returns  Decoded length (-1 is a broken frame).
+*/
+static int _decoderCobs(unsigned char *pData, size_t len)
+{
+    size_t in = 0;
+    size_t out = 0;
+    unsigned char code;
+
+    while (in < len)
+    {
+        code = pData[in++];
+        if ((in + code - 1) > len)
+        {
+            return -1;
+        }
+
+        memmove((pData + out), (pData + in), (code - 1));
+        out += (code - 1);
+        in  += (code - 1);
+
+        if ((code < 0xFF) && (in < len))
+        {
+            pData[out++] = 0x00;
+        }
+    }
+
+    return out;
+}
+
+/**
+*  SLIP decoder.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Received bytes.
+*  @param [in]  len       Received length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*  @returns  Number of dropped frames.
+*/
+static int _decoderSlip(
+    tDecoder         *pDecoder,
+    unsigned char    *pData,
+    size_t            len,
+    tDecoderFrameCb   pFunc,
+    void             *pArg
+)
+{
+    unsigned char *pEnd = (pData + len);
+    unsigned char *pNext;
+    unsigned char byte;
+    int drops = 0;
+
+    while (pData < pEnd)
+    {
+        if ( pDecoder->escape )
+        {
+            /* a wrong escaped byte is kept as it is */
+            byte = *pData++;
+            if (SLIP_ESC_END == byte)
+            {
+                byte = SLIP_END;
+            }
+            else if (SLIP_ESC_ESC == byte)
+            {
+                byte = SLIP_ESC;
+            }
+            pDecoder->escape = 0;
+            drops += _decoderAppend(pDecoder, &byte, 1);
+            continue;
+        }
+
+        pNext = _decoderScan2(pData, (pEnd - pData), SLIP_END, SLIP_ESC);
+        if (NULL == pNext)
+        {
+            drops += _decoderAppend(pDecoder, pData, (pEnd - pData));
+            break;
+        }
+
+        drops += _decoderAppend(pDecoder, pData, (pNext - pData));
+        if (SLIP_END == *pNext)
+        {
+            _decoderDeliver(pDecoder, pDecoder->pBuf, pDecoder->len, pFunc, pArg);
+        }
+        else
+        {
+            pDecoder->escape = 1;
+        }
+        pData = (pNext + 1);
+    }
+
+    return drops;
+}
+
+/**
+*  Delimiter and COBS decoders, a frame ends with the delimiter byte. A
+*  frame that is all in the received bytes is passed in place.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Received bytes.
+*  @param [in]  len       Received length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*  @returns  Number of dropped frames.
+*/
+static int _decoderDelimiter(
+    tDecoder         *pDecoder,
+    unsigned char    *pData,
+    size_t            len,
+    tDecoderFrameCb   pFunc,
+    void             *pArg
+)
+{
+    unsigned char delimiter;
+    unsigned char *pEnd = (pData + len);
+    unsigned char *pNext;
+    unsigned char *pFrame;
+    size_t frameLen;
+    int decodeLen;
+    int drops = 0;
+
+    delimiter = (UART_FRAME_COBS == pDecoder->cfg.type) ? 0x00 : pDecoder->cfg.delimiter;
+
+    while (pData < pEnd)
+    {
+        pNext = memchr(pData, delimiter, (pEnd - pData));
+        if (NULL == pNext)
+        {
+            drops += _decoderAppend(pDecoder, pData, (pEnd - pData));
+            break;
+        }
+
+        if ((0 == pDecoder->len) && (!pDecoder->discard))
+        {
+            /* the delimiter byte gives the room after the frame */
+            pFrame = pData;
+            frameLen = (pNext - pData);
+            if (frameLen > pDecoder->bufSize)
+            {
+                drops++;
+                frameLen = 0;
+            }
+        }
+        else
+        {
+            drops += _decoderAppend(pDecoder, pData, (pNext - pData));
+            pFrame = pDecoder->pBuf;
+            frameLen = pDecoder->len;
+        }
+
+        if ((UART_FRAME_COBS == pDecoder->cfg.type) && (frameLen > 0) &&
+            (!pDecoder->discard))
+        {
+            decodeLen = _decoderCobs(pFrame, frameLen);
+            if (decodeLen < 0)
+            {
+                LOG_2("%s: broken COBS frame\n", __func__);
+                drops++;
+                decodeLen = 0;
+            }
+            else if ((size_t)decodeLen > pDecoder->maxSize)
+            {
+                LOG_2("%s: frame is over %zu bytes\n", __func__, pDecoder->maxSize);
+                drops++;
+                decodeLen = 0;
+            }
+            frameLen = decodeLen;
+        }
+
+        _decoderDeliver(pDecoder, pFrame, frameLen, pFunc, pArg);
+        pData = (pNext + 1);
+    }
+
+    return drops;
+}
+
+/**
+*  Length-prefixed decoder.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Received bytes.
+*  @param [in]  len       Received length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*  @returns  Number of dropped frames.
+*/
+static int _decoderLength(
+    tDecoder         *pDecoder,
+    unsigned char    *pData,
+    size_t            len,
+    tDecoderFrameCb   pFunc,
+    void             *pArg
+)
+{
+    tUartFrame *pCfg = &(pDecoder->cfg);
+    size_t hdrSize = (pCfg->lenOffset + pCfg->lenSize);
+    unsigned char *pEnd = (pData + len);
+    long long total;
+    size_t copy;
+    int drops = 0;
+
+    while (pData < pEnd)
+    {
+        if (0 == pDecoder->need)
+        {
+            copy = (hdrSize - pDecoder->len);
+            if (copy > (size_t)(pEnd - pData))
+            {
+                copy = (pEnd - pData);
+            }
+            memcpy((pDecoder->pBuf + pDecoder->len), pData, copy);
+            pDecoder->len += copy;
+            pData += copy;
+
+            if (pDecoder->len < hdrSize)
+            {
+                break;
+            }
+
+            total = (long long)hdrSize + pCfg->lenAdjust +
+                    _decoderGetField(
+                        (pDecoder->pBuf + pCfg->lenOffset),
+                        pCfg->lenSize,
+                        pCfg->bigEndian
+                    );
+            if (total < (long long)hdrSize)
+            {
+                /* nothing to re-synchronize with, drop the header */
+                LOG_2("%s: wrong frame length %lld\n", __func__, total);
+                pDecoder->len = 0;
+                drops++;
+                continue;
+            }
+
+            if (total > (long long)pDecoder->maxSize)
+            {
+                /* skip the frame by its length */
+                LOG_2("%s: frame is over %zu bytes\n", __func__, pDecoder->maxSize);
+                pDecoder->discard = 1;
+                drops++;
+            }
+            pDecoder->need = total;
+        }
+
+        copy = (pDecoder->need - pDecoder->len);
+        if (copy > (size_t)(pEnd - pData))
+        {
+            copy = (pEnd - pData);
+        }
+        if ( !pDecoder->discard )
+        {
+            memcpy((pDecoder->pBuf + pDecoder->len), pData, copy);
+        }
+        pDecoder->len += copy;
+        pData += copy;
+
+        if (pDecoder->len == pDecoder->need)
+        {
+            _decoderDeliver(pDecoder, pDecoder->pBuf, pDecoder->len, pFunc, pArg);
+        }
+    }
+
+    return drops;
+}
+
+/**
+*  Initialize a frame decoder. The idle-gap framing has no decoder, it
+*  is done by the idle time of the receiving.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pCfg      A @ref tUartFrame object (NULL is no decoder).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_decoderInit(tDecoder *pDecoder, tUartFrame *pCfg)
+{
+    memset(pDecoder, 0x00, sizeof( tDecoder ));
+
+    if ((NULL == pCfg) || (UART_FRAME_NONE == pCfg->type) ||
+        (UART_FRAME_IDLE == pCfg->type))
+    {
+        return 0;
+    }
+
+    if ((pCfg->type != UART_FRAME_SLIP) && (pCfg->type != UART_FRAME_COBS) &&
+        (pCfg->type != UART_FRAME_DELIMITER) && (pCfg->type != UART_FRAME_LENGTH))
+    {
+        LOG_ERROR("%s: wrong frame type %d\n", __func__, pCfg->type);
+        return -1;
+    }
+
+    if (UART_FRAME_LENGTH == pCfg->type)
+    {
+        if ((pCfg->lenSize != 1) && (pCfg->lenSize != 2) && (pCfg->lenSize != 4))
+        {
+            LOG_ERROR("%s: wrong length size %d\n", __func__, pCfg->lenSize);
+            return -1;
+        }
+
+        if (pCfg->lenOffset < 0)
+        {
+            LOG_ERROR("%s: wrong length offset %d\n", __func__, pCfg->lenOffset);
+            return -1;
+        }
+    }
+
+    pDecoder->cfg = *pCfg;
+    pDecoder->maxSize = pCfg->maxSize;
+    if (0 == pDecoder->maxSize)
+    {
+        pDecoder->maxSize = COMM_BUF_SIZE;
+    }
+    if (pDecoder->maxSize > DECODER_MAX_SIZE)
+    {
+        pDecoder->maxSize = DECODER_MAX_SIZE;
+    }
+
+    if ((UART_FRAME_LENGTH == pCfg->type) &&
+        (pDecoder->maxSize < (size_t)(pCfg->lenOffset + pCfg->lenSize)))
+    {
+        LOG_ERROR("%s: max. size is less than the header\n", __func__);
+        return -1;
+    }
+
+    /* a COBS frame is one code byte for each 254 bytes longer encoded */
+    pDecoder->bufSize = pDecoder->maxSize;
+    if (UART_FRAME_COBS == pCfg->type)
+    {
+        pDecoder->bufSize += ((pDecoder->maxSize / 254) + 1);
+    }
+
+    pDecoder->pBuf = comm_poolAlloc(pDecoder->bufSize + 1);
+    if (NULL == pDecoder->pBuf)
+    {
+        LOG_ERROR("fail to allocate frame buffer\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Un-initialize a frame decoder.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*/
+void comm_decoderUninit(tDecoder *pDecoder)
+{
+    if ( pDecoder->pBuf )
+    {
+        comm_poolFree( pDecoder->pBuf );
+    }
+    memset(pDecoder, 0x00, sizeof( tDecoder ));
+}
+
+/**
+*  Put the received bytes to the decoder and deliver the complete frames.
+*  An empty frame is skipped, an over-sized or broken one is dropped.
+*  The received bytes may be changed in place.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Received bytes.
+*  @param [in]  len       Received length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*  @returns  Number of dropped frames.
+*/
+int comm_decoderPut(
+    tDecoder         *pDecoder,
+    unsigned char    *pData,
+    size_t            len,
+    tDecoderFrameCb   pFunc,
+    void             *pArg
+)
+{
+    switch ( pDecoder->cfg.type )
+    {
+        case UART_FRAME_SLIP:
+            return _decoderSlip(pDecoder, pData, len, pFunc, pArg);
+        case UART_FRAME_COBS:
+        case UART_FRAME_DELIMITER:
+            return _decoderDelimiter(pDecoder, pData, len, pFunc, pArg);
+        case UART_FRAME_LENGTH:
+            return _decoderLength(pDecoder, pData, len, pFunc, pArg);
+        default:
+            break;
+    }
+
+    return 0;
+}
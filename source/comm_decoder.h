@@ -0,0 +1,73 @@
+#ifndef __COMM_DECODER_H__
+#define __COMM_DECODER_H__
+
+#include "comm_if.h"
+
+
+/**
+*  Complete frame callback, the frame buffer is reused after it returns.
+*  There is one byte of room after the frame.
+*  @param [in]  pArg   Owner's argument.
+*  @param [in]  pData  Frame bytes.
+*  @param [in]  len    Frame length.
+*/
+typedef void (*tDecoderFrameCb)(void *pArg, unsigned char *pData, int len);
+
+typedef struct _tDecoder
+{
+    tUartFrame     cfg;
+
+    /* reassembly state of the stream */
+    unsigned char *pBuf;
+    size_t         bufSize;  /* max. frame size before decoding */
+    size_t         maxSize;
+    size_t         len;
+    size_t         need;     /* length-prefixed frame size (0 is unknown) */
+    int            escape;   /* SLIP escape byte pending */
+    int            discard;  /* drop the bytes until the next frame */
+} tDecoder;
+
+
+/**
+*  Initialize a frame decoder. The idle-gap framing has no decoder, it
+*  is done by the idle time of the receiving.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pCfg      A @ref tUartFrame object (NULL is no decoder).
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_decoderInit(tDecoder *pDecoder, tUartFrame *pCfg);
+
+/**
+*  Un-initialize a frame decoder.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*/
+void comm_decoderUninit(tDecoder *pDecoder);
+
+/**
+*  Put the received bytes to the decoder and deliver the complete frames.
+*  An empty frame is skipped, an over-sized or broken one is dropped.
+*  The received bytes may be changed in place.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @param [in]  pData     Received bytes.
+*  @param [in]  len       Received length.
+*  @param [in]  pFunc     Complete frame callback.
+*  @param [in]  pArg      Callback argument.
+*  @returns  Number of dropped frames.
+*/
+int  comm_decoderPut(
+         tDecoder         *pDecoder,
+         unsigned char    *pData,
+         size_t            len,
+         tDecoderFrameCb   pFunc,
+         void             *pArg
+     );
+
+/**
+*  Check if the decoder is enabled.
+*  @param [in]  pDecoder  A @ref tDecoder object.
+*  @returns  Enabled(1) or disabled(0).
+*/
+#define comm_decoderEnabled(pDecoder) (NULL != (pDecoder)->pBuf)
+
+
+#endif /* __COMM_DECODER_H__ */
@@ -7,6 +7,8 @@
 #include <sys/stat.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
 
 
 typedef struct _tFifoContext
@@ -20,8 +22,8 @@ typedef struct _tFifoContext
     void          *pArg;
     pthread_t      thread;
     int            running;
-
-    unsigned char  recvMsg[COMM_BUF_SIZE+1];
+    tReactorHandle reactor;
+    tReactorEvent  event;
 } tFifoContext;
 
 
@@ -86,6 +88,64 @@ static void _closeFifoRead(tFifoContext *pContext)
     LOG_2("FIFO %s is closed\n", pContext->fileName);
 }
 
+/**
+*  Read data and pass it to the FIFO get callback.
+*  @param [in]  pContext  A @ref tFifoContext object.
+*  @returns  Data length (-1 is closed).
+*/
+static int _fifoGetMsg(tFifoContext *pContext)
+{
+    unsigned char *pBuf;
+    int len;
+
+
+    pBuf = comm_poolAlloc( COMM_BUF_SIZE + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("fd(%d) ... read\n", pContext->fd);
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_poolFree, pBuf);
+    len = read(
+              pContext->fd,
+              pBuf,
+              COMM_BUF_SIZE
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        LOG_ERROR("FIFO is closed\n");
+        comm_reactorDelEvent( &(pContext->event) );
+        close( pContext->fd );
+        pContext->fd = -1;
+        /* notify FIFO is closed */
+        if ( pContext->pCloseFunc )
+        {
+            pContext->pCloseFunc(pContext->pArg, len);
+        }
+        comm_poolFree( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- %s\n", pContext->fileName);
+    LOG_DUMP("FIFO: read", pBuf, len);
+
+    if ( pContext->pGetFunc )
+    {
+        pContext->pGetFunc(
+                      pContext->pArg,
+                      pBuf,
+                      len
+                  );
+    }
+
+    comm_poolFree( pBuf );
+    return len;
+}
+
 /**
 *  Thread function for FIFO read.
 *  @param [in]  pArg  A @ref tFifoContext object.
@@ -93,7 +153,6 @@ static void _closeFifoRead(tFifoContext *pContext)
 static void *_fifoGetTask(void *pArg)
 {
     tFifoContext *pContext = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -101,38 +160,12 @@ static void *_fifoGetTask(void *pArg)
 
     while ( pContext->running )
     {
-        LOG_3("fd(%d) ... read\n", pContext->fd);
         pthread_testcancel();
-        len = read(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE
-              );
-        if (len <= 0)
+        if (_fifoGetMsg( pContext ) < 0)
         {
-            LOG_ERROR("FIFO is closed\n");
-            close( pContext->fd );
-            pContext->fd = -1;
-            /* notify FIFO is closed */
-            if ( pContext->pCloseFunc )
-            {
-                pContext->pCloseFunc(pContext->pArg, len);
-            }
             break;
         }
         pthread_testcancel();
-
-        LOG_3("<- %s\n", pContext->fileName);
-        LOG_DUMP("FIFO: read", pContext->recvMsg, len);
-
-        if ( pContext->pGetFunc )
-        {
-            pContext->pGetFunc(
-                          pContext->pArg,
-                          pContext->recvMsg,
-                          len
-                      );
-        }
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -141,6 +174,21 @@ static void *_fifoGetTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for FIFO read.
+*  @param [in]  pArg    A @ref tFifoContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _fifoGetEvent(void *pArg, unsigned int events)
+{
+    tFifoContext *pContext = pArg;
+
+    if (_fifoGetMsg( pContext ) < 0)
+    {
+        pContext->running = 0;
+    }
+}
+
 /**
 *  Initial read only FIFO.
 *  @param [in]  pFileName   FIFO file name.
@@ -198,6 +246,29 @@ tFifoHandle comm_fifoReadInit(
 
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _fifoGetEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach FIFO to reactor\n");
+            _closeFifoRead( pContext );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = g_reactor;
+        goto _DONE;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -217,10 +288,24 @@ tFifoHandle comm_fifoReadInit(
 
     pthread_attr_destroy( &tattr );
 
+_DONE:
     LOG_1("FIFO read only initialized\n");
     return ((tFifoHandle)pContext);
 }
 
+/**
+*  Release a read only FIFO when it is no more received.
+*  @param [in]  pArg  A @ref tFifoContext object.
+*/
+static void _fifoReadRelease(void *pArg)
+{
+    tFifoContext *pContext = pArg;
+
+    _closeFifoRead( pContext );
+    free( pContext );
+    LOG_1("FIFO read only un-initialized\n");
+}
+
 /**
 *  Un-initial read only FIFO.
 *  @param [in]  handle  FIFO handle.
@@ -231,14 +316,18 @@ void comm_fifoReadUninit(tFifoHandle handle)
 
     if ( pContext )
     {
-        pthread_cancel( pContext->thread );
-
         pContext->running = 0;
-        _closeFifoRead( pContext );
 
-        pthread_join(pContext->thread, NULL);
-        free( pContext );
-        LOG_1("FIFO read only un-initialized\n");
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _fifoReadRelease, pContext);
+        }
+        else
+        {
+            pthread_cancel( pContext->thread );
+            pthread_join(pContext->thread, NULL);
+            _fifoReadRelease( pContext );
+        }
     }
 }
 
@@ -369,9 +458,25 @@ int comm_fifoWritePut(
     unsigned char  *pData,
     unsigned short  size
 )
+{
+    return comm_fifoWritePutEx(handle, pData, size);
+}
+
+/**
+*  Put data into write only FIFO.
+*  @param [in]  handle  FIFO handle.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_fifoWritePutEx(
+    tFifoHandle     handle,
+    unsigned char  *pData,
+    size_t          size
+)
 {
     tFifoContext *pContext = (tFifoContext *)handle;
-    int error;
+    ssize_t error;
 
 
     if (NULL == pContext)
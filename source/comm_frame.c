@@ -0,0 +1,486 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_frame.h"
+
+
+/* Buffers sent without allocating a vector */
+#define FRAME_IOV_NUM (8)
+
+#ifndef IOV_MAX
+#define IOV_MAX (1024)
+#endif
+
+
+/**
+*  Read a header field.
+*  @param [in]  pData  Field bytes.
+*  @param [in]  size   Field size (1, 2 or 4).
+*  @param [in]  big    Big endian(1) or little endian(0).
+*  @returns  Field value.
+*/
+static unsigned int _frameGetField(unsigned char *pData, int size, int big)
+{
+    unsigned int value = 0;
+    int i;
+
+    for (i=0; i<size; i++)
+    {
+        if ( big )
+        {
+            value = (value << 8) | pData[i];
+        }
+        else
+        {
+            value |= ((unsigned int)pData[i] << (i * 8));
+        }
+    }
+
+    return value;
+}
+
+/**
+*  Write a header field.
+*  @param [in]  pData  Field bytes.
+*  @param [in]  size   Field size (1, 2 or 4).
+*  @param [in]  big    Big endian(1) or little endian(0).
+*  @param [in]  value  Field value.
+*/
+static void _framePutField(unsigned char *pData, int size, int big, unsigned int value)
+{
+    int i;
+
+    for (i=0; i<size; i++)
+    {
+        if ( big )
+        {
+            pData[size - 1 - i] = (value >> (i * 8)) & 0xFF;
+        }
+        else
+        {
+            pData[i] = (value >> (i * 8)) & 0xFF;
+        }
+    }
+}
+
+/**
+*  Parse a complete header to the payload length.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _frameParseHeader(tFrame *pFrame)
+{
+    tCommFrame *pCfg = &(pFrame->cfg);
+    unsigned int magic;
+    size_t len;
+
+    if (pCfg->magicSize > 0)
+    {
+        magic = _frameGetField(pFrame->hdr, pCfg->magicSize, pCfg->bigEndian);
+        if (magic != pCfg->magic)
+        {
+            LOG_ERROR("wrong frame magic 0x%x\n", magic);
+            return -1;
+        }
+    }
+
+    len = _frameGetField(
+              (pFrame->hdr + pCfg->magicSize),
+              pCfg->lenSize,
+              pCfg->bigEndian
+          );
+    if ( pCfg->inclusive )
+    {
+        if (len < (size_t)pFrame->hdrSize)
+        {
+            LOG_ERROR("wrong frame length %zu\n", len);
+            return -1;
+        }
+        len -= pFrame->hdrSize;
+    }
+
+    if (len > pCfg->maxSize)
+    {
+        LOG_ERROR("frame length %zu is over %zu\n", len, pCfg->maxSize);
+        return -1;
+    }
+
+    pFrame->msgLen = len;
+    return 0;
+}
+
+/**
+*  Initialize the framing of a connection.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  pCfg    A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_frameInit(tFrame *pFrame, tCommFrame *pCfg)
+{
+    size_t maxLen;
+
+    memset(pFrame, 0x00, sizeof( tFrame ));
+
+    if (NULL == pCfg)
+    {
+        return 0;
+    }
+
+    if ((pCfg->magicSize != 0) && (pCfg->magicSize != 1) &&
+        (pCfg->magicSize != 2) && (pCfg->magicSize != 4))
+    {
+        LOG_ERROR("%s: wrong magic size %d\n", __func__, pCfg->magicSize);
+        return -1;
+    }
+
+    if ((pCfg->lenSize != 2) && (pCfg->lenSize != 4))
+    {
+        LOG_ERROR("%s: wrong length size %d\n", __func__, pCfg->lenSize);
+        return -1;
+    }
+
+    pFrame->cfg = *pCfg;
+    pFrame->hdrSize = pCfg->magicSize + pCfg->lenSize;
+
+    /* the largest payload the length field can carry */
+    maxLen = (2 == pCfg->lenSize) ? 0xFFFF : 0xFFFFFFFF;
+    if ( pCfg->inclusive )
+    {
+        maxLen -= pFrame->hdrSize;
+    }
+
+    if (0 == pFrame->cfg.maxSize)
+    {
+        pFrame->cfg.maxSize = COMM_FRAME_MAX_SIZE;
+    }
+    if (pFrame->cfg.maxSize > maxLen)
+    {
+        pFrame->cfg.maxSize = maxLen;
+    }
+
+    return 0;
+}
+
+/**
+*  Drop the partial message of a connection.
+*  @param [in]  pFrame  A @ref tFrame object.
+*/
+void comm_frameReset(tFrame *pFrame)
+{
+    if ( pFrame->pMsg )
+    {
+        comm_bufRelease( pFrame->pMsg );
+        pFrame->pMsg = NULL;
+    }
+    pFrame->hdrLen = 0;
+    pFrame->msgLen = 0;
+}
+
+/**
+*  Get the buffer for the next receive. A message payload in progress is
+*  received in place, otherwise a new buffer of the receive size is taken.
+*  @param [in]   pFrame    A @ref tFrame object.
+*  @param [in]   recvSize  Receive size of the handle.
+*  @param [out]  ppData    Where to receive.
+*  @param [out]  pRoom     How many bytes to receive.
+*  @returns  A @ref tCommBuf object owned by the caller (NULL is failed).
+*/
+tCommBuf *comm_frameRecvBuf(
+    tFrame          *pFrame,
+    size_t           recvSize,
+    unsigned char  **ppData,
+    size_t          *pRoom
+)
+{
+    tCommBuf *pBuf;
+
+    if ( pFrame->pMsg )
+    {
+        /* the rest of a large payload goes straight to its buffer */
+        pBuf = comm_bufRetain( pFrame->pMsg );
+        *ppData = pBuf->pData + pBuf->size;
+        *pRoom  = pFrame->msgLen - pBuf->size;
+        return pBuf;
+    }
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if ( pBuf )
+    {
+        *ppData = pBuf->pData;
+        *pRoom  = recvSize;
+    }
+
+    return pBuf;
+}
+
+/**
+*  Put the received bytes to the framing and deliver the complete messages.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  pBuf    A @ref tCommBuf object from @ref comm_frameRecvBuf.
+*  @param [in]  len     Received length.
+*  @param [in]  pFunc   Complete message callback.
+*  @param [in]  pArg    Callback argument.
+*  @returns  Success(0) or failure(-1, wrong header).
+*/
+int comm_framePut(
+    tFrame       *pFrame,
+    tCommBuf     *pBuf,
+    size_t        len,
+    tFrameMsgCb   pFunc,
+    void         *pArg
+)
+{
+    tCommBuf *pMsg;
+    unsigned char *pData;
+    size_t num;
+
+
+    if (pBuf == pFrame->pMsg)
+    {
+        pBuf->size += len;
+        if (pBuf->size == pFrame->msgLen)
+        {
+            pFrame->pMsg = NULL;
+            pFrame->hdrLen = 0;
+            comm_bufRelease( pBuf );
+            pFunc(pArg, pBuf);
+            return 0;
+        }
+
+        comm_bufRelease( pBuf );
+        return 0;
+    }
+
+    pData = pBuf->pData;
+
+    while (len > 0)
+    {
+        if (pFrame->hdrLen < pFrame->hdrSize)
+        {
+            num = pFrame->hdrSize - pFrame->hdrLen;
+            if (num > len)
+            {
+                num = len;
+            }
+            memcpy((pFrame->hdr + pFrame->hdrLen), pData, num);
+            pFrame->hdrLen += num;
+            pData += num;
+            len -= num;
+
+            if (pFrame->hdrLen < pFrame->hdrSize)
+            {
+                break;
+            }
+
+            if (_frameParseHeader( pFrame ) != 0)
+            {
+                comm_bufRelease( pBuf );
+                comm_frameReset( pFrame );
+                return -1;
+            }
+        }
+
+        if ((len == pFrame->msgLen) && (len > 0))
+        {
+            /* the last message fills the buffer, pass it without copy */
+            pBuf->capacity -= (pData - pBuf->pData);
+            pBuf->pData = pData;
+            pBuf->size  = len;
+            pFrame->hdrLen = 0;
+            pFunc(pArg, pBuf);
+            return 0;
+        }
+
+        pMsg = comm_bufAlloc( pFrame->msgLen + 1 );
+        if (NULL == pMsg)
+        {
+            LOG_ERROR("fail to allocate %zu bytes message\n", pFrame->msgLen);
+            comm_bufRelease( pBuf );
+            comm_frameReset( pFrame );
+            return -1;
+        }
+
+        num = (len < pFrame->msgLen) ? len : pFrame->msgLen;
+        memcpy(pMsg->pData, pData, num);
+        pMsg->size = num;
+        pData += num;
+        len -= num;
+
+        if (num < pFrame->msgLen)
+        {
+            /* wait for the rest of the payload */
+            pFrame->pMsg = pMsg;
+            break;
+        }
+
+        pFrame->hdrLen = 0;
+        pFunc(pArg, pMsg);
+    }
+
+    comm_bufRelease( pBuf );
+    return 0;
+}
+
+/**
+*  Make the frame header of a message.
+*  @param [in]   pFrame  A @ref tFrame object.
+*  @param [in]   size    Payload size.
+*  @param [out]  pHdr    Header bytes (8 bytes at least).
+*  @returns  Header size (0 is no framing, -1 is over the max. size).
+*/
+int comm_frameHeader(tFrame *pFrame, size_t size, unsigned char *pHdr)
+{
+    tCommFrame *pCfg = &(pFrame->cfg);
+
+    if ( !comm_frameEnabled( pFrame ) )
+    {
+        return 0;
+    }
+
+    if (size > pCfg->maxSize)
+    {
+        LOG_ERROR("%s: size %zu is over %zu\n", __func__, size, pCfg->maxSize);
+        return -1;
+    }
+
+    _framePutField(pHdr, pCfg->magicSize, pCfg->bigEndian, pCfg->magic);
+    _framePutField(
+        (pHdr + pCfg->magicSize),
+        pCfg->lenSize,
+        pCfg->bigEndian,
+        (pCfg->inclusive ? (size + pFrame->hdrSize) : size)
+    );
+
+    return pFrame->hdrSize;
+}
+
+/**
+*  Send one message of several buffers, with the frame header in front if
+*  the framing is enabled.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  fd      Socket file descriptor.
+*  @param [in]  pIov    Data buffers.
+*  @param [in]  num     Number of data buffers.
+*  @returns  Message length (-1 is failed). A non-blocking socket that
+*            would block after a part of the message returns the payload
+*            bytes of that part, a framed stream is then broken.
+*/
+ssize_t comm_frameSendv(
+    tFrame        *pFrame,
+    int            fd,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    unsigned char hdr[8];
+    struct iovec iov[FRAME_IOV_NUM];
+    struct iovec *pVec = iov;
+    struct iovec *pCur;
+    struct msghdr msg;
+    size_t size = 0;
+    size_t total;
+    size_t sent = 0;
+    ssize_t len;
+    int hdrSize;
+    int cnt = 0;
+    int i;
+
+
+    if ((num <= 0) || (num >= IOV_MAX))
+    {
+        LOG_ERROR("%s: wrong buffer number %d\n", __func__, num);
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* a private copy that can be advanced over the partial writes */
+    if ((num + 1) > FRAME_IOV_NUM)
+    {
+        pVec = malloc(sizeof( struct iovec ) * (num + 1));
+        if (NULL == pVec)
+        {
+            LOG_ERROR("%s: fail to allocate %d iovec\n", __func__, num);
+            return -1;
+        }
+    }
+
+    for (i=0; i<num; i++)
+    {
+        size += pIov[i].iov_len;
+    }
+
+    hdrSize = comm_frameHeader(pFrame, size, hdr);
+    if (hdrSize < 0)
+    {
+        if (pVec != iov)
+        {
+            free( pVec );
+        }
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    if (hdrSize > 0)
+    {
+        pVec[0].iov_base = hdr;
+        pVec[0].iov_len  = hdrSize;
+        cnt = 1;
+    }
+
+    memcpy((pVec + cnt), pIov, (sizeof( struct iovec ) * num));
+    cnt += num;
+    total = size + hdrSize;
+
+    /* header and payload in as few system calls as possible */
+    pCur = pVec;
+    while (sent < total)
+    {
+        memset(&msg, 0x00, sizeof( struct msghdr ));
+        msg.msg_iov    = pCur;
+        msg.msg_iovlen = cnt;
+
+        len = sendmsg(fd, &msg, 0);
+        if (len < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            break;
+        }
+        sent += len;
+
+        /* skip the written part */
+        while ((cnt > 0) && ((size_t)len >= pCur->iov_len))
+        {
+            len -= pCur->iov_len;
+            pCur++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            pCur->iov_base = (unsigned char *)pCur->iov_base + len;
+            pCur->iov_len -= len;
+        }
+    }
+
+    if (pVec != iov)
+    {
+        free( pVec );
+    }
+
+    if (0 == sent)
+    {
+        return -1;
+    }
+
+    /* a non-blocking socket may take a part only, the payload bytes of it */
+    return (sent > (size_t)hdrSize) ? (ssize_t)(sent - hdrSize) : 0;
+}
+
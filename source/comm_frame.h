@@ -0,0 +1,110 @@
+#ifndef __COMM_FRAME_H__
+#define __COMM_FRAME_H__
+
+#include <sys/uio.h>
+#include "comm_if.h"
+
+
+/**
+*  Complete message callback, the callback owns the buffer.
+*  @param [in]  pArg  Owner's argument.
+*  @param [in]  pBuf  A @ref tCommBuf object of one message payload.
+*/
+typedef void (*tFrameMsgCb)(void *pArg, tCommBuf *pBuf);
+
+typedef struct _tFrame
+{
+    tCommFrame     cfg;
+    int            hdrSize;  /* 0 is no framing */
+
+    /* reassembly state of one connection */
+    unsigned char  hdr[8];
+    int            hdrLen;
+    tCommBuf      *pMsg;
+    size_t         msgLen;
+} tFrame;
+
+
+/**
+*  Initialize the framing of a connection.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  pCfg    A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_frameInit(tFrame *pFrame, tCommFrame *pCfg);
+
+/**
+*  Drop the partial message of a connection.
+*  @param [in]  pFrame  A @ref tFrame object.
+*/
+void comm_frameReset(tFrame *pFrame);
+
+/**
+*  Get the buffer for the next receive. A message payload in progress is
+*  received in place, otherwise a new buffer of the receive size is taken.
+*  @param [in]   pFrame    A @ref tFrame object.
+*  @param [in]   recvSize  Receive size of the handle.
+*  @param [out]  ppData    Where to receive.
+*  @param [out]  pRoom     How many bytes to receive.
+*  @returns  A @ref tCommBuf object owned by the caller (NULL is failed).
+*/
+tCommBuf *comm_frameRecvBuf(
+              tFrame          *pFrame,
+              size_t           recvSize,
+              unsigned char  **ppData,
+              size_t          *pRoom
+          );
+
+/**
+*  Put the received bytes to the framing and deliver the complete messages.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  pBuf    A @ref tCommBuf object from @ref comm_frameRecvBuf.
+*  @param [in]  len     Received length.
+*  @param [in]  pFunc   Complete message callback.
+*  @param [in]  pArg    Callback argument.
+*  @returns  Success(0) or failure(-1, wrong header).
+*/
+int  comm_framePut(
+         tFrame       *pFrame,
+         tCommBuf     *pBuf,
+         size_t        len,
+         tFrameMsgCb   pFunc,
+         void         *pArg
+     );
+
+/**
+*  Make the frame header of a message.
+*  @param [in]   pFrame  A @ref tFrame object.
+*  @param [in]   size    Payload size.
+*  @param [out]  pHdr    Header bytes (8 bytes at least).
+*  @returns  Header size (0 is no framing, -1 is over the max. size).
+*/
+int  comm_frameHeader(tFrame *pFrame, size_t size, unsigned char *pHdr);
+
+/**
+*  Send one message of several buffers, with the frame header in front if
+*  the framing is enabled.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @param [in]  fd      Socket file descriptor.
+*  @param [in]  pIov    Data buffers.
+*  @param [in]  num     Number of data buffers.
+*  @returns  Message length (-1 is failed). A non-blocking socket that
+*            would block after a part of the message returns the payload
+*            bytes of that part, a framed stream is then broken.
+*/
+ssize_t comm_frameSendv(
+            tFrame        *pFrame,
+            int            fd,
+            struct iovec  *pIov,
+            int            num
+        );
+
+/**
+*  Check if the framing is enabled.
+*  @param [in]  pFrame  A @ref tFrame object.
+*  @returns  Enabled(1) or disabled(0).
+*/
+#define comm_frameEnabled(pFrame) ((pFrame)->hdrSize > 0)
+
+
+#endif /* __COMM_FRAME_H__ */
@@ -0,0 +1,865 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_netlink.h"
+#include "comm_ifcache.h"
+
+
+/* Slots of the interface name hash, a power of 2 */
+#define IFCACHE_SLOT_NUM  (1024)
+
+/* Slot states */
+#define IFCACHE_FREE  (0)  /* never used, a lookup stops here */
+#define IFCACHE_USED  (1)
+#define IFCACHE_DEAD  (2)  /* removed, a lookup goes on */
+
+/* Removed slots that make the table rehashed */
+#define IFCACHE_DEAD_MAX  (IFCACHE_SLOT_NUM / 4)
+
+
+/*
+*  One interface, written by the netlink receiving thread only. The
+*  sequence number is odd while the slot is being written, a reader copies
+*  the slot and tries again if the sequence number has changed.
+*/
+typedef struct _tIfCacheSlot
+{
+    unsigned int   seq;
+    int            state;
+    char           name[IFNAMSIZ];
+    tIfCacheInfo   info;
+} tIfCacheSlot;
+
+typedef struct _tIfCacheContext
+{
+    tIfCacheSlot    *pSlot;
+    unsigned int     seq;  /* odd while the whole table is being rewritten */
+    int              deadNum;
+    tNetlinkHandle   netlink;
+    int              ready;  /* the dumps are complete */
+
+    /* the dumps, the first ones are waited for by the initializing thread */
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+    int              linkDone;
+    int              dumping;
+    int              overflow;  /* notifications are lost during the dumps */
+    int              done;
+    int              error;
+} tIfCacheContext;
+
+
+static tIfCacheContext g_ifCache;
+static pthread_once_t  g_ifCacheOnce = PTHREAD_ONCE_INIT;
+static unsigned int    g_ifCacheTimeout = COMM_IFCACHE_TIMEOUT;
+
+
+/**
+*  Hash an interface name (FNV-1a).
+*  @param [in]  pName  A string of network interface name.
+*  @returns  Hash value.
+*/
+static unsigned int _ifCacheHash(char *pName)
+{
+    unsigned int hash = 2166136261U;
+    int i;
+
+    for (i=0; (i<IFNAMSIZ) && (pName[i]); i++)
+    {
+        hash ^= (unsigned char)pName[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/**
+*  Start writing a slot.
+*  @param [in]  pSlot  A @ref tIfCacheSlot object.
+*/
+static void _ifCacheWriteBegin(tIfCacheSlot *pSlot)
+{
+    __atomic_store_n(&(pSlot->seq), (pSlot->seq + 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+/**
+*  Finish writing a slot.
+*  @param [in]  pSlot  A @ref tIfCacheSlot object.
+*/
+static void _ifCacheWriteEnd(tIfCacheSlot *pSlot)
+{
+    __atomic_store_n(&(pSlot->seq), (pSlot->seq + 1), __ATOMIC_RELEASE);
+}
+
+/**
+*  Start rewriting the whole table.
+*/
+static void _ifCacheTableBegin(void)
+{
+    __atomic_store_n(&(g_ifCache.seq), (g_ifCache.seq + 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+/**
+*  Finish rewriting the whole table.
+*/
+static void _ifCacheTableEnd(void)
+{
+    __atomic_store_n(&(g_ifCache.seq), (g_ifCache.seq + 1), __ATOMIC_RELEASE);
+}
+
+/**
+*  Find the slot of an interface index, for the writer only.
+*  @param [in]  index  Interface index.
+*  @returns  A @ref tIfCacheSlot object (NULL is not found).
+*/
+static tIfCacheSlot *_ifCacheFindIndex(int index)
+{
+    int i;
+
+    for (i=0; i<IFCACHE_SLOT_NUM; i++)
+    {
+        if ((IFCACHE_USED == g_ifCache.pSlot[i].state) &&
+            (index == g_ifCache.pSlot[i].info.index))
+        {
+            return &(g_ifCache.pSlot[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+*  Add an interface to its hash position, for the writer only.
+*  @param [in]  pName  A string of network interface name.
+*  @param [in]  index  Interface index.
+*  @returns  A @ref tIfCacheSlot object (NULL is full).
+*/
+static tIfCacheSlot *_ifCacheAdd(char *pName, int index)
+{
+    tIfCacheSlot *pSlot;
+    tIfCacheSlot *pFree = NULL;
+    unsigned int hash = _ifCacheHash( pName );
+    int i;
+
+    for (i=0; i<IFCACHE_SLOT_NUM; i++)
+    {
+        pSlot = &(g_ifCache.pSlot[(hash + i) & (IFCACHE_SLOT_NUM - 1)]);
+        if (IFCACHE_USED == pSlot->state)
+        {
+            if (0 == strncmp(pSlot->name, pName, IFNAMSIZ))
+            {
+                /* re-created with a new index */
+                pFree = pSlot;
+                break;
+            }
+            continue;
+        }
+
+        if (NULL == pFree)
+        {
+            pFree = pSlot;
+        }
+        if (IFCACHE_FREE == pSlot->state)
+        {
+            break;
+        }
+    }
+
+    if (NULL == pFree)
+    {
+        LOG_WARN("interface cache is full, %s is not cached\n", pName);
+        return NULL;
+    }
+
+    if (IFCACHE_DEAD == pFree->state)
+    {
+        g_ifCache.deadNum--;
+    }
+
+    _ifCacheWriteBegin( pFree );
+    pFree->state = IFCACHE_USED;
+    memset(pFree->name, 0x00, IFNAMSIZ);
+    strncpy(pFree->name, pName, (IFNAMSIZ - 1));
+    memset(&(pFree->info), 0x00, sizeof( tIfCacheInfo ));
+    pFree->info.index = index;
+    _ifCacheWriteEnd( pFree );
+    return pFree;
+}
+
+/**
+*  Empty the table, for the writer only. The caller marks the whole table
+*  being rewritten.
+*/
+static void _ifCacheClear(void)
+{
+    int i;
+
+    for (i=0; i<IFCACHE_SLOT_NUM; i++)
+    {
+        if (g_ifCache.pSlot[i].state != IFCACHE_FREE)
+        {
+            _ifCacheWriteBegin( &(g_ifCache.pSlot[i]) );
+            g_ifCache.pSlot[i].state = IFCACHE_FREE;
+            _ifCacheWriteEnd( &(g_ifCache.pSlot[i]) );
+        }
+    }
+
+    g_ifCache.deadNum = 0;
+}
+
+/**
+*  Put the interfaces again without the removed slots, which make the
+*  lookups of the names not in the cache longer, for the writer only.
+*/
+static void _ifCacheRehash(void)
+{
+    tIfCacheSlot *pCopy;
+    tIfCacheSlot *pSlot;
+    int num = 0;
+    int i;
+
+
+    pCopy = malloc( sizeof( tIfCacheSlot ) * IFCACHE_SLOT_NUM );
+    if (NULL == pCopy)
+    {
+        LOG_WARN("fail to rehash interface cache\n");
+        return;
+    }
+
+    for (i=0; i<IFCACHE_SLOT_NUM; i++)
+    {
+        if (IFCACHE_USED == g_ifCache.pSlot[i].state)
+        {
+            pCopy[num++] = g_ifCache.pSlot[i];
+        }
+    }
+
+    /* a lookup tries again until the table is complete */
+    _ifCacheTableBegin();
+    _ifCacheClear();
+    for (i=0; i<num; i++)
+    {
+        pSlot = _ifCacheAdd(pCopy[i].name, pCopy[i].info.index);
+        if ( pSlot )
+        {
+            _ifCacheWriteBegin( pSlot );
+            pSlot->info = pCopy[i].info;
+            _ifCacheWriteEnd( pSlot );
+        }
+    }
+    _ifCacheTableEnd();
+
+    free( pCopy );
+    LOG_2("interface cache is rehashed with %d interfaces\n", num);
+}
+
+/**
+*  Remove an interface, for the writer only.
+*  @param [in]  pSlot  A @ref tIfCacheSlot object.
+*/
+static void _ifCacheDel(tIfCacheSlot *pSlot)
+{
+    _ifCacheWriteBegin( pSlot );
+    pSlot->state = IFCACHE_DEAD;
+    _ifCacheWriteEnd( pSlot );
+
+    g_ifCache.deadNum++;
+    if (g_ifCache.deadNum >= IFCACHE_DEAD_MAX)
+    {
+        _ifCacheRehash();
+    }
+}
+
+/**
+*  Apply RTM_NEWLINK / RTM_DELLINK.
+*  @param [in]  pMsg  A @ref tNetlinkMsg object.
+*/
+static void _ifCacheLink(tNetlinkMsg *pMsg)
+{
+    struct ifinfomsg *pIfInfo = (struct ifinfomsg *)pMsg->pData;
+    struct rtattr *pAttr;
+    tIfCacheSlot *pSlot;
+    tIfCacheInfo info;
+    char *pName = NULL;
+    int mtu = -1;
+    unsigned char *pHwAddr = NULL;
+    int hwAddrLen = 0;
+    int len;
+
+
+    if (pMsg->size < NLMSG_ALIGN( sizeof( struct ifinfomsg ) ))
+    {
+        return;
+    }
+
+    len = pMsg->size - NLMSG_ALIGN( sizeof( struct ifinfomsg ) );
+    for (pAttr = IFLA_RTA( pIfInfo ); RTA_OK(pAttr, len); pAttr = RTA_NEXT(pAttr, len))
+    {
+        switch ( pAttr->rta_type )
+        {
+            case IFLA_IFNAME:
+                pName = (char *)RTA_DATA( pAttr );
+                break;
+            case IFLA_MTU:
+                memcpy(&mtu, RTA_DATA( pAttr ), sizeof( int ));
+                break;
+            case IFLA_ADDRESS:
+                pHwAddr = (unsigned char *)RTA_DATA( pAttr );
+                hwAddrLen = RTA_PAYLOAD( pAttr );
+                break;
+            default:
+                break;
+        }
+    }
+
+    pSlot = _ifCacheFindIndex( pIfInfo->ifi_index );
+
+    if (RTM_DELLINK == pMsg->type)
+    {
+        if ( pSlot )
+        {
+            LOG_2("interface %s is removed\n", pSlot->name);
+            _ifCacheDel( pSlot );
+        }
+        return;
+    }
+
+    if (NULL == pName)
+    {
+        return;
+    }
+
+    if ((pSlot) && (strncmp(pSlot->name, pName, IFNAMSIZ) != 0))
+    {
+        /* renamed, move it with its addresses to the new hash position */
+        LOG_2("interface %s is renamed to %s\n", pSlot->name, pName);
+        info = pSlot->info;
+        _ifCacheDel( pSlot );
+        pSlot = _ifCacheAdd(pName, pIfInfo->ifi_index);
+        if (NULL == pSlot)
+        {
+            return;
+        }
+        _ifCacheWriteBegin( pSlot );
+        pSlot->info = info;
+        _ifCacheWriteEnd( pSlot );
+    }
+    else if (NULL == pSlot)
+    {
+        pSlot = _ifCacheAdd(pName, pIfInfo->ifi_index);
+        if (NULL == pSlot)
+        {
+            return;
+        }
+    }
+
+    _ifCacheWriteBegin( pSlot );
+    pSlot->info.flags = pIfInfo->ifi_flags;
+    if (mtu >= 0)
+    {
+        pSlot->info.mtu = mtu;
+    }
+    if ( pHwAddr )
+    {
+        memset(pSlot->info.hwAddr, 0x00, ETH_ALEN);
+        memcpy(
+            pSlot->info.hwAddr,
+            pHwAddr,
+            ((hwAddrLen < ETH_ALEN) ? hwAddrLen : ETH_ALEN)
+        );
+    }
+    _ifCacheWriteEnd( pSlot );
+}
+
+/**
+*  Add or remove an address of a list.
+*  @param [in]  pList    Address list.
+*  @param [in]  pNum     Number of addresses.
+*  @param [in]  pAddr    Address.
+*  @param [in]  addrLen  Address length (4 or 16).
+*  @param [in]  add      Add(1) or remove(0).
+*/
+static void _ifCacheAddrList(
+    unsigned char *pList,
+    int           *pNum,
+    unsigned char *pAddr,
+    int            addrLen,
+    int            add
+)
+{
+    int i;
+
+    for (i=0; i<(*pNum); i++)
+    {
+        if (0 == memcmp((pList + (i * addrLen)), pAddr, addrLen))
+        {
+            break;
+        }
+    }
+
+    if ( add )
+    {
+        if ((i == (*pNum)) && ((*pNum) < IFCACHE_ADDR_NUM))
+        {
+            memcpy((pList + (i * addrLen)), pAddr, addrLen);
+            (*pNum)++;
+        }
+    }
+    else if (i < (*pNum))
+    {
+        /* keep the order, the first one is the primary address */
+        memmove(
+            (pList + (i * addrLen)),
+            (pList + ((i + 1) * addrLen)),
+            (((*pNum) - i - 1) * addrLen)
+        );
+        (*pNum)--;
+    }
+}
+
+/**
+*  Apply RTM_NEWADDR / RTM_DELADDR.
+*  @param [in]  pMsg  A @ref tNetlinkMsg object.
+*/
+static void _ifCacheAddr(tNetlinkMsg *pMsg)
+{
+    struct ifaddrmsg *pIfAddr = (struct ifaddrmsg *)pMsg->pData;
+    struct rtattr *pAttr;
+    tIfCacheSlot *pSlot;
+    unsigned char *pAddress = NULL;
+    unsigned char *pLocal = NULL;
+    unsigned char *pAddr;
+    char *pLabel = NULL;
+    int add = (RTM_NEWADDR == pMsg->type);
+    int len;
+
+
+    if (pMsg->size < NLMSG_ALIGN( sizeof( struct ifaddrmsg ) ))
+    {
+        return;
+    }
+
+    len = pMsg->size - NLMSG_ALIGN( sizeof( struct ifaddrmsg ) );
+    for (pAttr = IFA_RTA( pIfAddr ); RTA_OK(pAttr, len); pAttr = RTA_NEXT(pAttr, len))
+    {
+        switch ( pAttr->rta_type )
+        {
+            case IFA_ADDRESS:
+                pAddress = (unsigned char *)RTA_DATA( pAttr );
+                break;
+            case IFA_LOCAL:
+                pLocal = (unsigned char *)RTA_DATA( pAttr );
+                break;
+            case IFA_LABEL:
+                pLabel = (char *)RTA_DATA( pAttr );
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* the local address of a point-to-point link is IFA_LOCAL */
+    pAddr = ( pLocal ) ? pLocal : pAddress;
+    pSlot = _ifCacheFindIndex( pIfAddr->ifa_index );
+    if ((NULL == pAddr) || (NULL == pSlot))
+    {
+        return;
+    }
+
+    if (AF_INET == pIfAddr->ifa_family)
+    {
+        if ((pLabel) && (strncmp(pLabel, pSlot->name, IFNAMSIZ) != 0))
+        {
+            /* an alias like eth0:1 */
+            return;
+        }
+
+        _ifCacheWriteBegin( pSlot );
+        _ifCacheAddrList(
+            &(pSlot->info.ipv4Addr[0][0]),
+            &(pSlot->info.ipv4Num),
+            pAddr,
+            4,
+            add
+        );
+        _ifCacheWriteEnd( pSlot );
+    }
+    else if (AF_INET6 == pIfAddr->ifa_family)
+    {
+        _ifCacheWriteBegin( pSlot );
+        _ifCacheAddrList(
+            &(pSlot->info.ipv6Addr[0][0]),
+            &(pSlot->info.ipv6Num),
+            pAddr,
+            16,
+            add
+        );
+        _ifCacheWriteEnd( pSlot );
+    }
+}
+
+/**
+*  Apply the rtnetlink messages of a dump or a notification.
+*  @param [in]  pArg  Not used.
+*  @param [in]  pMsg  Messages.
+*  @param [in]  num   Number of messages.
+*/
+static void _ifCacheNotify(void *pArg, tNetlinkMsg *pMsg, int num)
+{
+    int i;
+
+    for (i=0; i<num; i++)
+    {
+        switch ( pMsg[i].type )
+        {
+            case RTM_NEWLINK:
+            case RTM_DELLINK:
+                _ifCacheLink( &(pMsg[i]) );
+                break;
+            case RTM_NEWADDR:
+            case RTM_DELADDR:
+                _ifCacheAddr( &(pMsg[i]) );
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void _ifCacheReply(
+    void         *pArg,
+    unsigned int  seqNum,
+    int           error,
+    tNetlinkMsg  *pMsg,
+    int           num
+);
+
+/**
+*  Request a dump of the links or the addresses.
+*  @param [in]  type  RTM_GETLINK / RTM_GETADDR.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _ifCacheRequest(unsigned short type)
+{
+    union
+    {
+        struct ifinfomsg  link;
+        struct ifaddrmsg  addr;
+    } req;
+    tNetlinkMsg msg;
+
+
+    memset(&req, 0x00, sizeof( req ));
+    memset(&msg, 0x00, sizeof( tNetlinkMsg ));
+    msg.pData = (unsigned char *)&req;
+    msg.type  = type;
+    msg.flags = NLM_F_DUMP;
+    if (RTM_GETLINK == type)
+    {
+        req.link.ifi_family = AF_UNSPEC;
+        msg.size = sizeof( struct ifinfomsg );
+    }
+    else
+    {
+        req.addr.ifa_family = AF_UNSPEC;
+        msg.size = sizeof( struct ifaddrmsg );
+    }
+
+    if (comm_netlinkRequest(
+            g_ifCache.netlink,
+            &msg,
+            1,
+            __atomic_load_n(&g_ifCacheTimeout, __ATOMIC_RELAXED),
+            _ifCacheReply,
+            NULL
+        ) < 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Dump the links and then the addresses again, for the writer only. The
+*  table is emptied first, so that the interfaces and the addresses
+*  removed while the notifications were lost go away.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _ifCacheDumpAgain(void)
+{
+    g_ifCache.dumping = 1;
+    g_ifCache.overflow = 0;
+    g_ifCache.linkDone = 0;
+
+    _ifCacheTableBegin();
+    _ifCacheClear();
+    _ifCacheTableEnd();
+
+    if (_ifCacheRequest( RTM_GETLINK ) != 0)
+    {
+        g_ifCache.dumping = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Finish the dumps, the cache is ready unless they failed. It wakes up
+*  the initializing thread at the first dumps.
+*  @param [in]  error  Error code of the dumps.
+*/
+static void _ifCacheDumpDone(int error)
+{
+    g_ifCache.dumping = 0;
+
+    if ((0 == error) && ( g_ifCache.overflow ))
+    {
+        /* the dumps may miss the changes of the lost notifications */
+        error = _ifCacheDumpAgain();
+        if (0 == error)
+        {
+            return;
+        }
+    }
+
+    if (0 == error)
+    {
+        __atomic_store_n(&(g_ifCache.ready), 1, __ATOMIC_RELEASE);
+    }
+    else if ( g_ifCache.done )
+    {
+        LOG_ERROR("failed to dump interfaces again (%d)\n", error);
+    }
+
+    pthread_mutex_lock( &(g_ifCache.mutex) );
+    g_ifCache.error = error;
+    g_ifCache.done = 1;
+    pthread_cond_signal( &(g_ifCache.cond) );
+    pthread_mutex_unlock( &(g_ifCache.mutex) );
+}
+
+/**
+*  Reply callback of the dumps. The kernel serves one dump of a socket at
+*  a time, thus the address dump follows the link dump.
+*  @param [in]  pArg    Not used.
+*  @param [in]  seqNum  Sequence number.
+*  @param [in]  error   Error code.
+*  @param [in]  pMsg    Messages.
+*  @param [in]  num     Number of messages (0 is completed).
+*/
+static void _ifCacheReply(
+    void         *pArg,
+    unsigned int  seqNum,
+    int           error,
+    tNetlinkMsg  *pMsg,
+    int           num
+)
+{
+    if (num > 0)
+    {
+        _ifCacheNotify(pArg, pMsg, num);
+        return;
+    }
+
+    if ((0 == error) && ( !g_ifCache.linkDone ))
+    {
+        g_ifCache.linkDone = 1;
+        error = _ifCacheRequest( RTM_GETADDR );
+        if (0 == error)
+        {
+            return;
+        }
+    }
+
+    _ifCacheDumpDone( error );
+}
+
+/**
+*  Overflow callback of the rtnetlink socket. The cache is not used until
+*  it is dumped again, the lookups fall back to the system calls.
+*  @param [in]  pArg  Not used.
+*/
+static void _ifCacheOverflow(void *pArg)
+{
+    LOG_WARN("interface cache lost notifications, dump again\n");
+    __atomic_store_n(&(g_ifCache.ready), 0, __ATOMIC_RELEASE);
+
+    if ( g_ifCache.dumping )
+    {
+        /* dumped again when the current dumps are done */
+        g_ifCache.overflow = 1;
+        return;
+    }
+
+    if (_ifCacheDumpAgain() != 0)
+    {
+        LOG_ERROR("failed to dump interfaces again\n");
+    }
+}
+
+/**
+*  Initialize the interface cache, called once.
+*/
+static void _ifCacheInit(void)
+{
+    pthread_mutex_init(&(g_ifCache.mutex), NULL);
+    pthread_cond_init(&(g_ifCache.cond), NULL);
+
+    g_ifCache.pSlot = calloc(IFCACHE_SLOT_NUM, sizeof( tIfCacheSlot ));
+    if (NULL == g_ifCache.pSlot)
+    {
+        LOG_ERROR("fail to allocate interface cache\n");
+        return;
+    }
+
+    /* the first dumps are set before any callback */
+    g_ifCache.dumping = 1;
+
+    g_ifCache.netlink = comm_netlinkInitTransThread(
+                            NETLINK_ROUTE,
+                            _ifCacheNotify,
+                            NULL,
+                            NULL
+                        );
+    if (0 == g_ifCache.netlink)
+    {
+        LOG_ERROR("failed to open rtnetlink for interface cache\n");
+        goto _FAIL;
+    }
+
+    comm_netlinkSetOverflow(g_ifCache.netlink, _ifCacheOverflow);
+
+    /* subscribe before the dumps, so that no change is missed */
+    if ((comm_netlinkJoinGroup(g_ifCache.netlink, RTNLGRP_LINK) != 0) ||
+        (comm_netlinkJoinGroup(g_ifCache.netlink, RTNLGRP_IPV4_IFADDR) != 0) ||
+        (comm_netlinkJoinGroup(g_ifCache.netlink, RTNLGRP_IPV6_IFADDR) != 0))
+    {
+        goto _FAIL;
+    }
+
+    if (_ifCacheRequest( RTM_GETLINK ) != 0)
+    {
+        goto _FAIL;
+    }
+
+    /* a request always completes, at the latest by its timeout */
+    pthread_mutex_lock( &(g_ifCache.mutex) );
+    while ( !g_ifCache.done )
+    {
+        pthread_cond_wait(&(g_ifCache.cond), &(g_ifCache.mutex));
+    }
+    pthread_mutex_unlock( &(g_ifCache.mutex) );
+
+    if (g_ifCache.error != 0)
+    {
+        LOG_ERROR("failed to dump interfaces (%d)\n", g_ifCache.error);
+        goto _FAIL;
+    }
+
+    LOG_1("interface cache initialized\n");
+    return;
+
+_FAIL:
+    if ( g_ifCache.netlink )
+    {
+        comm_netlinkUninit( g_ifCache.netlink );
+        g_ifCache.netlink = 0;
+    }
+    free( g_ifCache.pSlot );
+    g_ifCache.pSlot = NULL;
+}
+
+/**
+*  Set the deadline of the interface cache dumps, the first lookup waits
+*  for the first dumps up to it. It is set before the first lookup.
+*  @param [in]  timeout  Deadline in milliseconds (0 is COMM_IFCACHE_TIMEOUT).
+*/
+void comm_setIfCacheTimeout(unsigned int timeout)
+{
+    __atomic_store_n(
+        &g_ifCacheTimeout,
+        (( timeout ) ? timeout : COMM_IFCACHE_TIMEOUT),
+        __ATOMIC_RELAXED
+    );
+}
+
+/**
+*  Look up an interface by name. The cache is filled by rtnetlink dumps
+*  at the first call and then kept current by the link and address
+*  notifications, a lookup takes no lock and makes no system call.
+*  The IPv4 addresses are the ones labeled with the interface name, an
+*  alias like "eth0:1" is not in the cache.
+*  @param [in]   pIfName  A string of network interface name.
+*  @param [out]  pInfo    A @ref tIfCacheInfo object.
+*  @returns  Found(0) or not found / cache unavailable(-1).
+*/
+int comm_ifCacheGet(char *pIfName, tIfCacheInfo *pInfo)
+{
+    tIfCacheSlot *pSlot;
+    unsigned int tableSeq;
+    unsigned int hash;
+    unsigned int seq;
+    int state;
+    int found = 0;
+    int i;
+
+
+    pthread_once(&g_ifCacheOnce, _ifCacheInit);
+
+    if ((NULL == pIfName) || (NULL == pInfo) ||
+        (0 == __atomic_load_n(&(g_ifCache.ready), __ATOMIC_ACQUIRE)))
+    {
+        return -1;
+    }
+
+    hash = _ifCacheHash( pIfName );
+
+    /* the whole table is rewritten by a rehash or a dump again */
+    do
+    {
+        tableSeq = __atomic_load_n(&(g_ifCache.seq), __ATOMIC_ACQUIRE);
+        if (tableSeq & 1)
+        {
+            continue;
+        }
+
+        found = 0;
+        for (i=0; i<IFCACHE_SLOT_NUM; i++)
+        {
+            pSlot = &(g_ifCache.pSlot[(hash + i) & (IFCACHE_SLOT_NUM - 1)]);
+
+            do
+            {
+                seq = __atomic_load_n(&(pSlot->seq), __ATOMIC_ACQUIRE);
+                state = pSlot->state;
+                found = ((IFCACHE_USED == state) &&
+                         (0 == strncmp(pSlot->name, pIfName, IFNAMSIZ)));
+                if ( found )
+                {
+                    *pInfo = pSlot->info;
+                }
+                __atomic_thread_fence( __ATOMIC_ACQUIRE );
+            } while ((seq & 1) || (seq != __atomic_load_n(&(pSlot->seq), __ATOMIC_RELAXED)));
+
+            if ((found) || (IFCACHE_FREE == state))
+            {
+                break;
+            }
+        }
+
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    } while ((tableSeq & 1) || (tableSeq != __atomic_load_n(&(g_ifCache.seq), __ATOMIC_RELAXED)));
+
+    return (( found ) ? 0 : -1);
+}
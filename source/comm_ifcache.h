@@ -0,0 +1,37 @@
+#ifndef __COMM_IFCACHE_H__
+#define __COMM_IFCACHE_H__
+
+#include <linux/if_ether.h> /* ETH_ALEN */
+
+
+/* Max. addresses of each family kept for an interface */
+#define IFCACHE_ADDR_NUM  (8)
+
+/* Interface information copied out of the cache */
+typedef struct _tIfCacheInfo
+{
+    int            index;
+    int            mtu;
+    unsigned int   flags;
+    unsigned char  hwAddr[ETH_ALEN];
+    int            ipv4Num;
+    unsigned char  ipv4Addr[IFCACHE_ADDR_NUM][4];
+    int            ipv6Num;
+    unsigned char  ipv6Addr[IFCACHE_ADDR_NUM][16];
+} tIfCacheInfo;
+
+
+/**
+*  Look up an interface by name. The cache is filled by rtnetlink dumps
+*  at the first call and then kept current by the link and address
+*  notifications, a lookup takes no lock and makes no system call.
+*  The IPv4 addresses are the ones labeled with the interface name, an
+*  alias like "eth0:1" is not in the cache.
+*  @param [in]   pIfName  A string of network interface name.
+*  @param [out]  pInfo    A @ref tIfCacheInfo object.
+*  @returns  Found(0) or not found / cache unavailable(-1).
+*/
+int  comm_ifCacheGet(char *pIfName, tIfCacheInfo *pInfo);
+
+
+#endif /* __COMM_IFCACHE_H__ */
@@ -2,11 +2,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_pcap.h"
 
 
 typedef struct _tIpcDgramContext
@@ -15,11 +19,14 @@ typedef struct _tIpcDgramContext
     int              fd;
 
     tIpcDgramRecvCb  pRecvFunc;
+    tIpcDgramBufCb   pBufFunc;
+    size_t           recvSize;
     void            *pArg;
     pthread_t        thread;
     int              running;
-
-    unsigned char    recvMsg[COMM_BUF_SIZE+1];
+    tReactorHandle   reactor;
+    tReactorEvent    event;
+    tPcapTap         tap;
 } tIpcDgramContext;
 
 
@@ -80,56 +87,127 @@ static void _ipcDgramUninit(tIpcDgramContext *pContext)
 }
 
 /**
-*  Thread function for IPC datagram receiving.
-*  @param [in]  pArg  A @ref tIpcDgramContext object.
+*  Receive a message and pass it to the IPC datagram receive callback.
+*  @param [in]  pContext  A @ref tIpcDgramContext object.
+*  @param [in]  flags     recvfrom() flags.
+*  @returns  Message length (-1 is failed).
 */
-static void *_ipcDgramRecvTask(void *pArg)
+/**
+*  Copy an IPC datagram to the capture of the handle.
+*  @param [in]  pContext  A @ref tIpcDgramContext object.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  pData     A pointer of message.
+*  @param [in]  size      Message size.
+*/
+static void _ipcDgramTap(
+    tIpcDgramContext *pContext,
+    int               outbound,
+    unsigned char    *pData,
+    size_t            size
+)
+{
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pData;
+        iov.iov_len  = size;
+        comm_pcapWriteConn(pTap, outbound, 0, &iov, 1);
+    }
+}
+
+static int _ipcDgramRecvMsg(tIpcDgramContext *pContext, int flags)
 {
-    tIpcDgramContext *pContext = pArg;
     struct sockaddr_un recvAddr;
     socklen_t recvAddrLen;
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
     int len;
 
 
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
 
     /* address for the source app */
     recvAddrLen = sizeof( struct sockaddr_un );
     memset(&recvAddr, 0x00, recvAddrLen);
 
-    while ( pContext->running )
+    LOG_3("%s ... recvfrom\n", pContext->localPath);
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recvfrom(
+              pContext->fd,
+              pBuf->pData,
+              recvSize,
+              flags,
+              (struct sockaddr *)(&recvAddr),
+              &recvAddrLen
+          );
+    pthread_cleanup_pop( 0 );
+    if (len < 0)
     {
-        LOG_3("%s ... recvfrom\n", pContext->localPath);
-        pthread_testcancel();
-        len = recvfrom(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0,
-                  (struct sockaddr *)(&recvAddr),
-                  &recvAddrLen
-              );
-        if (len < 0)
+        if (EAGAIN == errno)
         {
-            LOG_ERROR("fail to receive IPC datagram\n");
-            perror( "recvfrom" );
-            break;
+            comm_bufRelease( pBuf );
+            return 0;
         }
-        pthread_testcancel();
+        LOG_ERROR("fail to receive IPC datagram\n");
+        perror( "recvfrom" );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- %s\n", recvAddr.sun_path);
+    LOG_DUMP("IPC datagram recv", pBuf->pData, len);
+    _ipcDgramTap(pContext, PCAP_IN, pBuf->pData, len);
+
+    if ( pContext->pBufFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pBufFunc(pContext->pArg, pBuf, recvAddr.sun_path);
+        return len;
+    }
+
+    if ( pContext->pRecvFunc )
+    {
+        pContext->pRecvFunc(
+            pContext->pArg,
+            pBuf->pData,
+            len,
+            recvAddr.sun_path
+        );
+    }
+
+    comm_bufRelease( pBuf );
+    return len;
+}
+
+/**
+*  Thread function for IPC datagram receiving.
+*  @param [in]  pArg  A @ref tIpcDgramContext object.
+*/
+static void *_ipcDgramRecvTask(void *pArg)
+{
+    tIpcDgramContext *pContext = pArg;
 
-        LOG_3("<- %s\n", recvAddr.sun_path);
-        LOG_DUMP("IPC datagram recv", pContext->recvMsg, len);
 
-        if ( pContext->pRecvFunc )
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    while ( pContext->running )
+    {
+        pthread_testcancel();
+        if (_ipcDgramRecvMsg(pContext, 0) < 0)
         {
-            pContext->pRecvFunc(
-                pContext->pArg,
-                pContext->recvMsg,
-                len,
-                recvAddr.sun_path
-            );
+            break;
         }
+        pthread_testcancel();
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -138,16 +216,34 @@ static void *_ipcDgramRecvTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for IPC datagram receiving.
+*  @param [in]  pArg    A @ref tIpcDgramContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _ipcDgramRecvEvent(void *pArg, unsigned int events)
+{
+    tIpcDgramContext *pContext = pArg;
+
+    if (_ipcDgramRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        comm_reactorDelEvent( &(pContext->event) );
+        pContext->running = 0;
+    }
+}
+
 /**
 *  Initialize IPC datagram.
 *  @param [in]  pFileName  Application's socket file name.
 *  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pBufFunc   Application's buffer callback function.
 *  @param [in]  pArg       Application's argument.
 *  @returns  IPC datagram handle.
 */
-tIpcDgramHandle comm_ipcDgramInit(
+static tIpcDgramHandle _ipcDgramOpen(
     char            *pFileName,
     tIpcDgramRecvCb  pRecvFunc,
+    tIpcDgramBufCb   pBufFunc,
     void            *pArg
 )
 {
@@ -166,7 +262,9 @@ tIpcDgramHandle comm_ipcDgramInit(
     memset(pContext, 0x00, sizeof( tIpcDgramContext ));
     strncpy(pContext->localPath, pFileName, 255);
     pContext->pRecvFunc = pRecvFunc;
+    pContext->pBufFunc = pBufFunc;
     pContext->pArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
     error = _ipcDgramInit( pContext );
@@ -178,7 +276,7 @@ tIpcDgramHandle comm_ipcDgramInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPC receive function\n");
         goto _DONE;
@@ -186,6 +284,29 @@ tIpcDgramHandle comm_ipcDgramInit(
 
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _ipcDgramRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPC datagram to reactor\n");
+            _ipcDgramUninit( pContext );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = g_reactor;
+        goto _DONE;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -210,6 +331,51 @@ _DONE:
     return ((tIpcDgramHandle)pContext);
 }
 
+/**
+*  Initialize IPC datagram.
+*  @param [in]  pFileName  Application's socket file name.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPC datagram handle.
+*/
+tIpcDgramHandle comm_ipcDgramInit(
+    char            *pFileName,
+    tIpcDgramRecvCb  pRecvFunc,
+    void            *pArg
+)
+{
+    return _ipcDgramOpen(pFileName, pRecvFunc, NULL, pArg);
+}
+
+/**
+*  Initialize IPC datagram with zero-copy buffers.
+*  @param [in]  pFileName  Application's socket file name.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPC datagram handle.
+*/
+tIpcDgramHandle comm_ipcDgramInitBuf(
+    char            *pFileName,
+    tIpcDgramBufCb   pBufFunc,
+    void            *pArg
+)
+{
+    return _ipcDgramOpen(pFileName, NULL, pBufFunc, pArg);
+}
+
+/**
+*  Release an IPC datagram when it is no more received.
+*  @param [in]  pArg  A @ref tIpcDgramContext object.
+*/
+static void _ipcDgramRelease(void *pArg)
+{
+    tIpcDgramContext *pContext = pArg;
+
+    _ipcDgramUninit( pContext );
+    free( pContext );
+    LOG_1("IPC datagram un-initialized\n");
+}
+
 /**
 *  Un-initialize IPC datagram.
 *  @param [in]  handle  IPC datagram handle.
@@ -220,24 +386,91 @@ void comm_ipcDgramUninit(tIpcDgramHandle handle)
 
     if ( pContext )
     {
-        if ( pContext->pRecvFunc )
+        pContext->running = 0;
+
+        if ( pContext->reactor )
         {
-            pthread_cancel( pContext->thread );
+            comm_reactorDelEventFree(&(pContext->event), _ipcDgramRelease, pContext);
+            return;
         }
 
-        pContext->running = 0;
-        _ipcDgramUninit( pContext );
-
-        if ( pContext->pRecvFunc )
+        if (( pContext->pRecvFunc ) || ( pContext->pBufFunc ))
         {
+            pthread_cancel( pContext->thread );
             pthread_join(pContext->thread, NULL);
         }
 
-        free( pContext );
-        LOG_1("IPC datagram un-initialized\n");
+        _ipcDgramRelease( pContext );
     }
 }
 
+/**
+*  Set the receive size of the IPC datagram socket.
+*  @param [in]  handle  IPC datagram handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ipcDgramSetRecvSize(tIpcDgramHandle handle, size_t size)
+{
+    tIpcDgramContext *pContext = (tIpcDgramContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
+
+    pContext->recvSize = size;
+    return 0;
+}
+
+/**
+*  Tap the IPC datagram socket, so that the messages it sends and receives
+*  are copied to a pcapng capture with the connection ID 0.
+*  @param [in]  handle  IPC datagram handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ipcDgramSetTap(tIpcDgramHandle handle, tPcapHandle pcap)
+{
+    tIpcDgramContext *pContext = (tIpcDgramContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "ipc-dgram:%.80s", pContext->localPath);
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
+}
+
 /**
 *  Send message from an application to another.
 *  @param [in]  handle     IPC datagram handle.
@@ -252,11 +485,29 @@ int comm_ipcDgramSend(
     unsigned char   *pData,
     unsigned short   size
 )
+{
+    return comm_ipcDgramSendEx(handle, pFileName, pData, size);
+}
+
+/**
+*  Send message from an application to another.
+*  @param [in]  handle     IPC datagram handle.
+*  @param [in]  pFileName  Destination application's socket file name.
+*  @param [in]  pData      A pointer of data buffer.
+*  @param [in]  size       Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcDgramSendEx(
+    tIpcDgramHandle  handle,
+    char            *pFileName,
+    unsigned char   *pData,
+    size_t           size
+)
 {
     tIpcDgramContext *pContext = (tIpcDgramContext *)handle;
     struct sockaddr_un sendAddr;
     socklen_t destAddrLen;
-    int error;
+    ssize_t error;
 
 
     if (NULL == pContext)
@@ -303,8 +554,10 @@ int comm_ipcDgramSend(
     {
         LOG_ERROR("fail to send IPC datagram\n");
         perror( "sendto" );
+        return error;
     }
 
+    _ipcDgramTap(pContext, PCAP_OUT, pData, error);
     return error;
 }
 
@@ -320,11 +573,27 @@ int comm_ipcDgramRecv(
     unsigned char   *pData,
     unsigned short   size
 )
+{
+    return comm_ipcDgramRecvEx(handle, pData, size);
+}
+
+/**
+*  Receive message from an application to another.
+*  @param [in]  handle  IPC datagram handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data buffer size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcDgramRecvEx(
+    tIpcDgramHandle  handle,
+    unsigned char   *pData,
+    size_t           size
+)
 {
     tIpcDgramContext *pContext = (tIpcDgramContext *)handle;
     struct sockaddr_un recvAddr;
     socklen_t recvAddrLen;
-    int len;
+    ssize_t len;
 
 
     if (NULL == pContext)
@@ -339,9 +608,9 @@ int comm_ipcDgramRecv(
         return -1;
     }
 
-    if ( pContext->pRecvFunc )
+    if (( pContext->pRecvFunc ) || ( pContext->pBufFunc ))
     {
-        LOG_WARN("%s: pRecvFunc exists\n", __func__);
+        LOG_WARN("%s: receive function exists\n", __func__);
         return -1;
     }
 
@@ -378,6 +647,7 @@ int comm_ipcDgramRecv(
 
     LOG_3("<- %s\n", recvAddr.sun_path);
     LOG_DUMP("IPC datagram recv", pData, len);
+    _ipcDgramTap(pContext, PCAP_IN, pData, len);
 
     return len;
 }
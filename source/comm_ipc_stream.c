@@ -2,11 +2,17 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_frame.h"
+#include "comm_table.h"
+#include "comm_pcap.h"
 
 
 typedef struct _tIpcStreamClientContext
@@ -16,12 +22,17 @@ typedef struct _tIpcStreamClientContext
     int               fd;
 
     tIpcClientRecvCb  pClientRecvFunc;
+    tIpcClientBufCb   pClientBufFunc;
+    size_t            recvSize;
+    tFrame            frame;
+    tPcapTap          tap;
+    pthread_mutex_t   sendMutex;
     tIpcClientExitCb  pClientExitFunc;
     void             *pClientArg;
     pthread_t         thread;
     int               running;
-
-    unsigned char     recvMsg[COMM_BUF_SIZE+1];
+    tReactorHandle    reactor;
+    tReactorEvent     event;
 } tIpcStreamClientContext;
 
 
@@ -81,6 +92,114 @@ static void _ipcStreamUninitClient(tIpcStreamClientContext *pContext)
     LOG_2("IPC %s is closed\n", pContext->localPath);
 }
 
+/**
+*  Pass one message to the IPC stream client receive callback.
+*  @param [in]  pArg  A @ref tIpcStreamClientContext object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _ipcStreamClientMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tIpcStreamClientContext *pContext = pArg;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, 0, &iov, 1);
+    }
+
+    if ( pContext->pClientBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pClientBufFunc(pContext->pClientArg, pBuf);
+        return;
+    }
+
+    if ( pContext->pClientRecvFunc )
+    {
+        pContext->pClientRecvFunc(
+                      pContext->pClientArg,
+                      pBuf->pData,
+                      pBuf->size
+                  );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Receive a message and pass it to the IPC stream client receive callback.
+*  @param [in]  pContext  A @ref tIpcStreamClientContext object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _ipcStreamClientRecvMsg(tIpcStreamClientContext *pContext, int flags)
+{
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(&(pContext->frame), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("%s ... recv\n", pContext->localPath);
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pContext->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_1("IPC stream server was terminated\n");
+        comm_reactorDelEvent( &(pContext->event) );
+        close( pContext->fd );
+        pContext->fd = -1;
+        /* notify the client that server is closed */
+        if ( pContext->pClientExitFunc )
+        {
+            pContext->pClientExitFunc(pContext->pClientArg, len);
+        }
+        comm_frameReset( &(pContext->frame) );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- %s\n", pContext->remotePath);
+    LOG_DUMP("IPC stream client recv", pData, len);
+
+    if ( comm_frameEnabled( &(pContext->frame) ) )
+    {
+        if (comm_framePut(&(pContext->frame), pBuf, len, _ipcStreamClientMsgFunc, pContext) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pContext->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _ipcStreamClientMsgFunc(pContext, pBuf);
+    return len;
+}
+
 /**
 *  Thread function for IPC stream client receiving.
 *  @param [in]  pArg  A @ref tIpcStreamClientContext object.
@@ -88,7 +207,6 @@ static void _ipcStreamUninitClient(tIpcStreamClientContext *pContext)
 static void *_ipcStreamClientRecvTask(void *pArg)
 {
     tIpcStreamClientContext *pContext = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -96,39 +214,12 @@ static void *_ipcStreamClientRecvTask(void *pArg)
 
     while ( pContext->running )
     {
-        LOG_3("%s ... recv\n", pContext->localPath);
         pthread_testcancel();
-        len = recv(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len <= 0)
+        if (_ipcStreamClientRecvMsg(pContext, 0) < 0)
         {
-            LOG_1("IPC stream server was terminated\n");
-            close( pContext->fd );
-            pContext->fd = -1;
-            /* notify the client that server is closed */
-            if ( pContext->pClientExitFunc )
-            {
-                pContext->pClientExitFunc(pContext->pClientArg, len);
-            }
             break;
         }
         pthread_testcancel();
-
-        LOG_3("<- %s\n", pContext->remotePath);
-        LOG_DUMP("IPC stream client recv", pContext->recvMsg, len);
-
-        if ( pContext->pClientRecvFunc )
-        {
-            pContext->pClientRecvFunc(
-                          pContext->pClientArg,
-                          pContext->recvMsg,
-                          len
-                      );
-        }
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -137,17 +228,34 @@ static void *_ipcStreamClientRecvTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for IPC stream client receiving.
+*  @param [in]  pArg    A @ref tIpcStreamClientContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _ipcStreamClientRecvEvent(void *pArg, unsigned int events)
+{
+    tIpcStreamClientContext *pContext = pArg;
+
+    if (_ipcStreamClientRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        pContext->running = 0;
+    }
+}
+
 /**
 *  Initialize IPC stream client.
 *  @param [in]  pFileName  Application's socket file name.
 *  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pBufFunc   Application's buffer callback function.
 *  @param [in]  pExitFunc  Application's exit callback function.
 *  @param [in]  pArg       Application's argument.
 *  @returns  IPC stream client handle.
 */
-tIpcStreamClientHandle comm_ipcStreamClientInit(
+static tIpcStreamClientHandle _ipcStreamClientOpen(
     char             *pFileName,
     tIpcClientRecvCb  pRecvFunc,
+    tIpcClientBufCb   pBufFunc,
     tIpcClientExitCb  pExitFunc,
     void             *pArg
 )
@@ -166,8 +274,10 @@ tIpcStreamClientHandle comm_ipcStreamClientInit(
     memset(pContext, 0x00, sizeof( tIpcStreamClientContext ));
     strncpy(pContext->localPath, pFileName, 255);
     pContext->pClientRecvFunc = pRecvFunc;
+    pContext->pClientBufFunc = pBufFunc;
     pContext->pClientExitFunc = pExitFunc;
     pContext->pClientArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
     error = _ipcStreamInitClient( pContext );
@@ -179,7 +289,7 @@ tIpcStreamClientHandle comm_ipcStreamClientInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPC stream receive function\n");
     }
@@ -189,10 +299,64 @@ tIpcStreamClientHandle comm_ipcStreamClientInit(
         LOG_1("ignore IPC stream exit function\n");
     }
 
+    pthread_mutex_init(&(pContext->sendMutex), NULL);
+
     LOG_1("IPC stream client initialized\n");
     return ((tIpcStreamClientHandle)pContext);
 }
 
+/**
+*  Initialize IPC stream client.
+*  @param [in]  pFileName  Application's socket file name.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPC stream client handle.
+*/
+tIpcStreamClientHandle comm_ipcStreamClientInit(
+    char             *pFileName,
+    tIpcClientRecvCb  pRecvFunc,
+    tIpcClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _ipcStreamClientOpen(pFileName, pRecvFunc, NULL, pExitFunc, pArg);
+}
+
+/**
+*  Initialize IPC stream client with zero-copy buffers.
+*  @param [in]  pFileName  Application's socket file name.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPC stream client handle.
+*/
+tIpcStreamClientHandle comm_ipcStreamClientInitBuf(
+    char             *pFileName,
+    tIpcClientBufCb   pBufFunc,
+    tIpcClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _ipcStreamClientOpen(pFileName, NULL, pBufFunc, pExitFunc, pArg);
+}
+
+/**
+*  Release an IPC stream client when it is no more received.
+*  @param [in]  pArg  A @ref tIpcStreamClientContext object.
+*/
+static void _ipcStreamClientRelease(void *pArg)
+{
+    tIpcStreamClientContext *pContext = pArg;
+
+    _ipcStreamUninitClient( pContext );
+    comm_frameReset( &(pContext->frame) );
+    pthread_mutex_destroy( &(pContext->sendMutex) );
+    free( pContext );
+
+    LOG_1("IPC stream client un-initialized\n");
+}
+
 /**
 *  Un-initialize IPC stream client.
 *  @param [in]  handle  IPC stream client handle.
@@ -203,16 +367,20 @@ void comm_ipcStreamClientUninit(tIpcStreamClientHandle handle)
 
     if ( pContext )
     {
+        if ( pContext->reactor )
+        {
+            pContext->running = 0;
+            comm_reactorDelEventFree(&(pContext->event), _ipcStreamClientRelease, pContext);
+            return;
+        }
+
         if ( pContext->running )
         {
             pthread_cancel( pContext->thread );
             pContext->running = 0;
         }
 
-        _ipcStreamUninitClient( pContext );
-        free( pContext );
-
-        LOG_1("IPC stream client un-initialized\n");
+        _ipcStreamClientRelease( pContext );
     }
 }
 
@@ -268,6 +436,28 @@ int comm_ipcStreamClientConnect(
 
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _ipcStreamClientRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPC stream client to reactor\n");
+            pContext->running = 0;
+            return -1;
+        }
+
+        pContext->reactor = g_reactor;
+        return 0;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
@@ -291,21 +481,16 @@ int comm_ipcStreamClientConnect(
 }
 
 /**
-*  Send message to an IPC stream server.
+*  Set the message framing of the IPC stream client, before connecting.
 *  @param [in]  handle  IPC stream client handle.
-*  @param [in]  pData   A pointer of data buffer.
-*  @param [in]  size    Data size.
-*  @returns  Message length (-1 is failed).
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
 */
-int comm_ipcStreamClientSend(
-    tIpcStreamClientHandle  handle,
-    unsigned char          *pData,
-    unsigned short          size
-)
+int comm_ipcStreamClientSetFrame(tIpcStreamClientHandle handle, tCommFrame *pFrame)
 {
     tIpcStreamClientContext *pContext = (tIpcStreamClientContext *)handle;
-    int error;
-
+    tCommFrame cfg;
+    tFrame frame;
 
     if (NULL == pContext)
     {
@@ -313,188 +498,546 @@ int comm_ipcStreamClientSend(
         return -1;
     }
 
-    if (pContext->fd < 0)
+    if ( pContext->running )
     {
-        LOG_ERROR("%s: %s is not ready\n", __func__, pContext->localPath);
+        LOG_WARN("%s: already connected\n", __func__);
         return -1;
     }
 
-    if (NULL == pData)
+    if ( pFrame )
     {
-        LOG_WARN("%s: pData is NULL\n", __func__);
-        return -1;
+        cfg = *pFrame;
+        if (( pContext->pClientRecvFunc ) && (0 == cfg.maxSize))
+        {
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
+        }
+        pFrame = &cfg;
     }
 
-    if (0 == size)
+    if (comm_frameInit(&frame, pFrame) != 0)
     {
-        LOG_WARN("%s: size is 0\n", __func__);
         return -1;
     }
 
-    LOG_3("-> %s\n", pContext->remotePath);
-    LOG_DUMP("IPC stream client send", pData, size);
-
-    error = send(
-                pContext->fd,
-                pData,
-                size,
-                0
-            );
-    if (error < 0)
+    if (( pFrame ) && ( pContext->pClientRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
     {
-        LOG_ERROR("fail to send IPC stream\n");
-        perror( "send" );
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
     }
 
-    return error;
+    comm_frameReset( &(pContext->frame) );
+    pContext->frame = frame;
+    return 0;
 }
 
-
-
-#define IPC_USER_NUM (32)
-
-typedef struct _tIpcStreamServerContext
-{
-    char              localPath[256];
-    int               fd;
-
-    tIpcUser         *pUser[IPC_USER_NUM];
-    int               userNum;
-    int               maxUserNum;
-
-    tIpcServerAcptCb  pServerAcptFunc;
-    tIpcServerExitCb  pServerExitFunc;
-    tIpcServerRecvCb  pServerRecvFunc;
-    void             *pServerArg;
-    pthread_t         thread;
-    int               running;
-} tIpcStreamServerContext;
-
-static tIpcUser *_ipcStreamAcceptClient(
-    tIpcStreamServerContext *pContext,
-    char                    *pFileName,
-    int                      fd
-);
-static void _ipcStreamDisconnectClient(
-    tIpcStreamServerContext *pContext,
-    tIpcUser                *pUser
-);
-
-
 /**
-*  Initialize a stream UNIX domain socket.
-*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
+*  Set the receive size of the IPC stream client.
+*  @param [in]  handle  IPC stream client handle.
+*  @param [in]  size    Max. message size of one receive.
 *  @returns  Success(0) or failure(-1).
 */
-static int _ipcStreamInitServer(tIpcStreamServerContext *pContext)
+int comm_ipcStreamClientSetRecvSize(tIpcStreamClientHandle handle, size_t size)
 {
-    struct sockaddr_un bindAddr;
-    socklen_t bindAddrLen;
-    int fd;
-
-
-    unlink( pContext->localPath );
+    tIpcStreamClientContext *pContext = (tIpcStreamClientContext *)handle;
 
-    fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0)
+    if (NULL == pContext)
     {
-        perror( "socket" );
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
         return -1;
     }
 
-    bindAddrLen = sizeof( struct sockaddr_un );
-    memset(&bindAddr, 0x00, bindAddrLen);
-    bindAddr.sun_family = AF_UNIX;
-    strcpy(bindAddr.sun_path, pContext->localPath);
-
-    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    if ((0 == size) || (size > INT_MAX))
     {
-        perror( "bind" );
-        close( fd );
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
         return -1;
     }
 
-    pContext->fd = fd;
-
-    LOG_2("IPC %s is ready\n", pContext->localPath);
-    return 0;
-}
-
-/**
-*  Un-initialize a stream UNIX domain socket.
-*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
-*/
-static void _ipcStreamUninitServer(tIpcStreamServerContext *pContext)
-{
-    if (pContext->fd > 0)
+    if ((pContext->pClientRecvFunc) && (size > USHRT_MAX))
     {
-        close( pContext->fd );
-        pContext->fd = -1;
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
     }
 
-    unlink( pContext->localPath );
-
-    LOG_2("IPC %s is closed\n", pContext->localPath);
+    pContext->recvSize = size;
+    return 0;
 }
 
 /**
-*  Thread function for the IPC stream server receiving.
-*  @param [in]  pArg  A @ref tIpcUser object.
+*  Tap the IPC stream client, so that the messages it sends and receives
+*  are copied to a pcapng capture with the connection ID 0.
+*  @param [in]  handle  IPC stream client handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
 */
-static void *_ipcStreamServerRecvTask(void *pArg)
+int comm_ipcStreamClientSetTap(tIpcStreamClientHandle handle, tPcapHandle pcap)
 {
-    tIpcStreamServerContext *pContext;
-    tIpcUser *pUser = pArg;
-    int len;
-
-
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
+    tIpcStreamClientContext *pContext = (tIpcStreamClientContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
 
-    pContext = pUser->pServer;
 
-    while (pUser->fd > 0)
+    if (NULL == pContext)
     {
-        LOG_3("%s ... recv\n", pUser->fileName);
-        pthread_testcancel();
-        len = recv(
-                  pUser->fd,
-                  pUser->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len < 0)
-        {
-            LOG_1(
-                "IPC client %s connection closed\n",
-                pUser->fileName
-            );
-            close( pUser->fd );
-            pUser->fd = -1;
-            /* notify the server that client is closed */
-            if ( pContext->pServerExitFunc )
-            {
-                pContext->pServerExitFunc(pContext->pServerArg, pUser);
-            }
-            break;
-        }
-        pthread_testcancel();
-
-        LOG_3("<- %s\n", pUser->fileName);
-        LOG_DUMP("IPC stream server recv", pUser->recvMsg, len);
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        if ( pContext->pServerRecvFunc )
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "ipc-client:%.80s", pContext->localPath);
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
         {
-            pContext->pServerRecvFunc(
-                          pContext->pServerArg,
-                          pUser,
-                          pUser->recvMsg,
-                          len
-                      );
+            return -1;
         }
     }
 
-    LOG_2("stop the thread: %s\n", __func__);
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
+}
+
+/**
+*  Send message to an IPC stream server.
+*  @param [in]  handle  IPC stream client handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
+*/
+int comm_ipcStreamClientSend(
+    tIpcStreamClientHandle  handle,
+    unsigned char          *pData,
+    unsigned short          size
+)
+{
+    return comm_ipcStreamClientSendEx(handle, pData, size);
+}
+
+/**
+*  Send message to an IPC stream server.
+*  @param [in]  handle  IPC stream client handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcStreamClientSendEx(
+    tIpcStreamClientHandle  handle,
+    unsigned char          *pData,
+    size_t                  size
+)
+{
+    tIpcStreamClientContext *pContext = (tIpcStreamClientContext *)handle;
+    struct iovec iov;
+    tPcapTap *pTap;
+    ssize_t error;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: %s is not ready\n", __func__, pContext->localPath);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s\n", pContext->remotePath);
+    LOG_DUMP("IPC stream client send", pData, size);
+
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, &iov, 1);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, &iov, 1);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPC stream\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to IPC stream server, the message
+*  is not interleaved with the other senders of the handle.
+*  @param [in]  handle  IPC stream client handle.
+*  @param [in]  pIov    Data buffers.
+*  @param [in]  num     Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcStreamClientSendv(
+    tIpcStreamClientHandle  handle,
+    struct iovec           *pIov,
+    int                     num
+)
+{
+    tIpcStreamClientContext *pContext = (tIpcStreamClientContext *)handle;
+    tPcapTap *pTap;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: %s is not ready\n", __func__, pContext->localPath);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %s\n", pContext->remotePath);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPC stream client send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, pIov, num);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, pIov, num);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPC stream\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+
+
+/* Table ID, framing and send lock of a client, private to the library */
+typedef struct _tIpcUserEntry
+{
+    tIpcUser         user;
+    tTableId         id;
+    tFrame           frame;
+    pthread_mutex_t  sendMutex;
+    int              refNum;  /* the user table and the senders to all */
+} tIpcUserEntry;
+
+#define IPC_USER_ID(pUser)    (((tIpcUserEntry *)(pUser))->id)
+#define IPC_USER_FRAME(pUser) (&(((tIpcUserEntry *)(pUser))->frame))
+#define IPC_USER_MUTEX(pUser) (&(((tIpcUserEntry *)(pUser))->sendMutex))
+#define IPC_USER_REF(pUser)   (((tIpcUserEntry *)(pUser))->refNum)
+
+/* Connection ID of a client in the capture, the slot of its table ID */
+#define IPC_USER_CONN(pUser)  ((unsigned int)IPC_USER_ID(pUser))
+
+typedef struct _tIpcSendAll
+{
+    unsigned char  *pData;
+    size_t          size;
+    tPcapTap       *pTap;
+
+    /* clients referenced under the table lock, sent after it */
+    tIpcUser      **ppUser;
+    int             userNum;
+    int             maxNum;
+} tIpcSendAll;
+
+/**
+*  Send one message of several buffers to a client, the message is not
+*  interleaved with the other senders of the client.
+*  @param [in]  pUser  A @ref tIpcUser object.
+*  @param [in]  pIov   Data buffers.
+*  @param [in]  num    Number of data buffers.
+*  @param [in]  pTap   A @ref tPcapTap object of the server.
+*  @returns  Message length (-1 is failed).
+*/
+static ssize_t _ipcStreamServerSendv(
+    tIpcUser      *pUser,
+    struct iovec  *pIov,
+    int            num,
+    tPcapTap      *pTap
+)
+{
+    ssize_t error;
+
+    pthread_mutex_lock( IPC_USER_MUTEX(pUser) );
+    error = comm_frameSendv(IPC_USER_FRAME(pUser), pUser->fd, pIov, num);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, IPC_USER_CONN(pUser), pIov, num);
+    }
+    pthread_mutex_unlock( IPC_USER_MUTEX(pUser) );
+
+    return error;
+}
+
+typedef struct _tIpcStreamServerContext
+{
+    char              localPath[256];
+    int               fd;
+
+    tTable            userTable;
+    int               maxUserNum;
+
+    tIpcServerAcptCb  pServerAcptFunc;
+    tIpcServerExitCb  pServerExitFunc;
+    tIpcServerRecvCb  pServerRecvFunc;
+    tIpcServerBufCb   pServerBufFunc;
+    size_t            recvSize;
+    tFrame            frame;
+    tPcapTap          tap;
+    void             *pServerArg;
+    pthread_t         thread;
+    int               running;
+} tIpcStreamServerContext;
+
+static tIpcUser *_ipcStreamAcceptClient(
+    tIpcStreamServerContext *pContext,
+    char                    *pFileName,
+    int                      fd
+);
+static void _ipcStreamDisconnectClient(
+    tIpcStreamServerContext *pContext,
+    tIpcUser                *pUser
+);
+static void _ipcStreamFreeClient(
+    tIpcStreamServerContext *pContext,
+    tIpcUser                *pUser,
+    int                      closed
+);
+
+
+/**
+*  Initialize a stream UNIX domain socket.
+*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _ipcStreamInitServer(tIpcStreamServerContext *pContext)
+{
+    struct sockaddr_un bindAddr;
+    socklen_t bindAddrLen;
+    int fd;
+
+
+    unlink( pContext->localPath );
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror( "socket" );
+        return -1;
+    }
+
+    bindAddrLen = sizeof( struct sockaddr_un );
+    memset(&bindAddr, 0x00, bindAddrLen);
+    bindAddr.sun_family = AF_UNIX;
+    strcpy(bindAddr.sun_path, pContext->localPath);
+
+    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    {
+        perror( "bind" );
+        close( fd );
+        return -1;
+    }
+
+    pContext->fd = fd;
+
+    LOG_2("IPC %s is ready\n", pContext->localPath);
+    return 0;
+}
+
+/**
+*  Un-initialize a stream UNIX domain socket.
+*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
+*/
+static void _ipcStreamUninitServer(tIpcStreamServerContext *pContext)
+{
+    if (pContext->fd > 0)
+    {
+        close( pContext->fd );
+        pContext->fd = -1;
+    }
+
+    unlink( pContext->localPath );
+
+    LOG_2("IPC %s is closed\n", pContext->localPath);
+}
+
+/**
+*  Pass one message to the IPC stream server receive callback.
+*  @param [in]  pArg  A @ref tIpcUser object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _ipcStreamServerMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tIpcUser *pUser = pArg;
+    tIpcStreamServerContext *pContext = pUser->pServer;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, IPC_USER_CONN(pUser), &iov, 1);
+    }
+
+    if ( pContext->pServerBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pServerBufFunc(pContext->pServerArg, pUser, pBuf);
+        return;
+    }
+
+    if ( pContext->pServerRecvFunc )
+    {
+        pContext->pServerRecvFunc(
+                     pContext->pServerArg,
+                     pUser,
+                     pBuf->pData,
+                     pBuf->size
+                 );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Receive a message and pass it to the IPC stream server receive callback.
+*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
+*  @param [in]  pUser     A @ref tIpcUser object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _ipcStreamServerRecvMsg(
+    tIpcStreamServerContext *pContext,
+    tIpcUser                *pUser,
+    int                      flags
+)
+{
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(IPC_USER_FRAME(pUser), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("%s ... recv\n", pUser->fileName);
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pUser->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_1(
+            "IPC client %s connection closed\n",
+            pUser->fileName
+        );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- %s\n", pUser->fileName);
+    LOG_DUMP("IPC stream server recv", pData, len);
+
+    if ( comm_frameEnabled( IPC_USER_FRAME(pUser) ) )
+    {
+        if (comm_framePut(IPC_USER_FRAME(pUser), pBuf, len, _ipcStreamServerMsgFunc, pUser) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pUser->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _ipcStreamServerMsgFunc(pUser, pBuf);
+    return len;
+}
+
+/**
+*  Thread function for the IPC stream server receiving.
+*  @param [in]  pArg  A @ref tIpcUser object.
+*/
+static void *_ipcStreamServerRecvTask(void *pArg)
+{
+    tIpcStreamServerContext *pContext;
+    tIpcUser *pUser = pArg;
+
+
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    pContext = pUser->pServer;
+
+    while (pUser->fd > 0)
+    {
+        pthread_testcancel();
+        if (_ipcStreamServerRecvMsg(pContext, pUser, 0) < 0)
+        {
+            break;
+        }
+        pthread_testcancel();
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
 
     _ipcStreamDisconnectClient(pContext, pUser);
 
@@ -515,7 +1058,7 @@ static void *_ipcStreamServerListenTask(void *pArg)
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
     LOG_2("start the thread: %s\n", __func__);
 
-    if (listen(pContext->fd, (IPC_USER_NUM << 1)) < 0)
+    if (listen(pContext->fd, SOMAXCONN) < 0)
     {
         perror( "listen" );
         close( pContext->fd );
@@ -572,15 +1115,17 @@ static void *_ipcStreamServerListenTask(void *pArg)
 *  @param [in]  pAcptFunc   Application's accept callback function.
 *  @param [in]  pExitFunc   Application's exit callback function.
 *  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
 *  @param [in]  pArg        Application's argument.
 *  @returns  IPC stream server handle.
 */
-tIpcStreamServerHandle comm_ipcStreamInitServer(
+static tIpcStreamServerHandle _ipcStreamServerOpen(
     char             *pFileName,
     int               maxUserNum,
     tIpcServerAcptCb  pAcptFunc,
     tIpcServerExitCb  pExitFunc,
     tIpcServerRecvCb  pRecvFunc,
+    tIpcServerBufCb   pBufFunc,
     void             *pArg
 )
 {
@@ -602,13 +1147,21 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
     pContext->pServerAcptFunc = pAcptFunc;
     pContext->pServerExitFunc = pExitFunc;
     pContext->pServerRecvFunc = pRecvFunc;
+    pContext->pServerBufFunc = pBufFunc;
     pContext->pServerArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
-    if ((0 == pContext->maxUserNum) || (pContext->maxUserNum > IPC_USER_NUM))
+    pContext->maxUserNum = comm_tableLimit( maxUserNum );
+    if (pContext->maxUserNum != maxUserNum)
+    {
+        LOG_1("set user number to the max. value %d\n", pContext->maxUserNum);
+    }
+
+    if (comm_tableInit(&(pContext->userTable), pContext->maxUserNum) != 0)
     {
-        LOG_1("set user number to the max. value %d\n", IPC_USER_NUM);
-        pContext->maxUserNum = IPC_USER_NUM;
+        free( pContext );
+        return 0;
     }
 
     error = _ipcStreamInitServer( pContext );
@@ -616,6 +1169,7 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
     {
         LOG_ERROR("fail to create IPC stream server\n");
         LOG_ERROR("path: %s\n", pFileName);
+        comm_tableUninit( &(pContext->userTable) );
         free( pContext );
         return 0;
     }
@@ -630,7 +1184,7 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
         LOG_1("ignore IPC stream exit function\n");
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPC stream receive function\n");
     }
@@ -650,14 +1204,75 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
     {
         LOG_ERROR("fail to create IPC stream receiving thread\n");
         _ipcStreamUninitServer( pContext );
+        comm_tableUninit( &(pContext->userTable) );
         free( pContext );
         return 0;
     }
 
     pthread_attr_destroy( &tattr );
 
-    LOG_1("IPC stream server initialized\n");
-    return ((tIpcStreamServerHandle)pContext);
+    LOG_1("IPC stream server initialized\n");
+    return ((tIpcStreamServerHandle)pContext);
+}
+
+/**
+*  Initialize IPC stream server.
+*  @param [in]  pFileName   Application's socket file name.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPC stream server handle.
+*/
+tIpcStreamServerHandle comm_ipcStreamInitServer(
+    char             *pFileName,
+    int               maxUserNum,
+    tIpcServerAcptCb  pAcptFunc,
+    tIpcServerExitCb  pExitFunc,
+    tIpcServerRecvCb  pRecvFunc,
+    void             *pArg
+)
+{
+    return _ipcStreamServerOpen(
+               pFileName,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               pRecvFunc,
+               NULL,
+               pArg
+           );
+}
+
+/**
+*  Initialize IPC stream server with zero-copy buffers.
+*  @param [in]  pFileName   Application's socket file name.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPC stream server handle.
+*/
+tIpcStreamServerHandle comm_ipcStreamInitServerBuf(
+    char             *pFileName,
+    int               maxUserNum,
+    tIpcServerAcptCb  pAcptFunc,
+    tIpcServerExitCb  pExitFunc,
+    tIpcServerBufCb   pBufFunc,
+    void             *pArg
+)
+{
+    return _ipcStreamServerOpen(
+               pFileName,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               NULL,
+               pBufFunc,
+               pArg
+           );
 }
 
 /**
@@ -667,21 +1282,27 @@ tIpcStreamServerHandle comm_ipcStreamInitServer(
 void comm_ipcStreamUninitServer(tIpcStreamServerHandle handle)
 {
     tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
+    tIpcUser *pUser;
     int i;
 
     if ( pContext )
     {
+        pContext->running = 0;
+
         pthread_cancel( pContext->thread );
+        pthread_join(pContext->thread, NULL);
 
-        pContext->running = 0;
-        pContext->userNum = 0;
-        for (i=0; i<pContext->maxUserNum; i++)
+        for (i=0; i<comm_tableSize( &(pContext->userTable) ); i++)
         {
-            _ipcStreamDisconnectClient(pContext, pContext->pUser[i]);
+            pUser = comm_tableDelAt(&(pContext->userTable), i);
+            if ( pUser )
+            {
+                _ipcStreamFreeClient(pContext, pUser, 0);
+            }
         }
         _ipcStreamUninitServer( pContext );
 
-        pthread_join(pContext->thread, NULL);
+        comm_tableUninit( &(pContext->userTable) );
         free( pContext );
         LOG_1("IPC stream server un-initialized\n");
     }
@@ -700,71 +1321,76 @@ static tIpcUser *_ipcStreamAcceptClient(
     int                      fd
 )
 {
-    tIpcUser *pUser = NULL;
+    tIpcUserEntry *pEntry;
+    tIpcUser *pUser;
     pthread_attr_t tattr;
     int error;
-    int i;
 
 
-    if (pContext->userNum >= pContext->maxUserNum)
+    pEntry = malloc( sizeof( tIpcUserEntry ) );
+    if (NULL == pEntry)
+    {
+        LOG_ERROR("user memory was exhausted\n");
+        return NULL;
+    }
+
+    memset(pEntry, 0x00, sizeof( tIpcUserEntry ));
+    pEntry->frame = pContext->frame;
+    pthread_mutex_init(&(pEntry->sendMutex), NULL);
+    pEntry->refNum = 1;
+    pUser = &(pEntry->user);
+    pUser->pServer = pContext;
+    strncpy(pUser->fileName, pFileName, 255);
+    pUser->fd = fd;
+
+    pEntry->id = comm_tableAdd(&(pContext->userTable), pUser);
+    if (0 == pEntry->id)
     {
         LOG_ERROR("user number was exceeded (%d)\n", pContext->maxUserNum);
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
         return NULL;
     }
 
-    for (i=0; i<pContext->maxUserNum; i++)
+    LOG_3("IPC stream create client %s\n", pFileName);
+
+    /* notify the client object to the server application */
+    if ( pContext->pServerAcptFunc )
     {
-        if (NULL == pContext->pUser[i])
-        {
-            pUser = malloc( sizeof( tIpcUser ) );
+        pContext->pServerAcptFunc(pContext->pServerArg, pUser);
+    }
 
-            if ( pUser )
-            {
-                LOG_3("IPC stream create client %s\n", pFileName);
-
-                memset(pUser, 0x00, sizeof( tIpcUser ));
-                pUser->pServer = pContext;
-                strcpy(pUser->fileName, pFileName);
-                pUser->fd = fd;
-
-                pthread_attr_init( &tattr );
-                pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
-
-                error = pthread_create(
-                            &(pUser->thread),
-                            &tattr,
-                            _ipcStreamServerRecvTask,
-                            pUser
-                        );
-                if (error != 0)
-                {
-                    LOG_ERROR("failed to create the client connection thread\n");
-                    free( pUser );
-                    return NULL;
-                }
-
-                pthread_attr_destroy( &tattr );
-
-                /* notify the client object to the server application */
-                if ( pContext->pServerAcptFunc )
-                {
-                    pContext->pServerAcptFunc(pContext->pServerArg, pUser);
-                }
-
-                pContext->pUser[i] = pUser;
-                pContext->userNum++;
-            }
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
-            return pUser;
+    error = pthread_create(
+                &(pUser->thread),
+                &tattr,
+                _ipcStreamServerRecvTask,
+                pUser
+            );
+    if (error != 0)
+    {
+        LOG_ERROR("failed to create the client connection thread\n");
+        comm_tableDel(&(pContext->userTable), pEntry->id);
+        /* the socket is closed by the caller */
+        pUser->fd = -1;
+        if ( pContext->pServerExitFunc )
+        {
+            pContext->pServerExitFunc(pContext->pServerArg, pUser);
         }
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
+        return NULL;
     }
 
-    LOG_ERROR("user memory was exhausted\n");
-    return NULL;
+    pthread_attr_destroy( &tattr );
+
+    return pUser;
 }
 
 /**
-*  Remove the connection of IPC stream client.
+*  Remove the connection of IPC stream client closed by the peer.
 *  @param [in]  pContext  A @ref tIpcStreamServerContext object.
 *  @param [in]  pUser     A @ref tIpcUser object.
 */
@@ -773,34 +1399,175 @@ static void _ipcStreamDisconnectClient(
     tIpcUser                *pUser
 )
 {
-    int i;
+    /* whoever removes the client from the table releases it */
+    if (comm_tableDel(&(pContext->userTable), IPC_USER_ID(pUser)) == pUser)
+    {
+        _ipcStreamFreeClient(pContext, pUser, 1);
+    }
+}
+
+/**
+*  Drop a reference of IPC stream client, the last one closes the socket
+*  and frees the client.
+*  @param [in]  pUser  A @ref tIpcUser object.
+*/
+static void _ipcStreamPutClient(tIpcUser *pUser)
+{
+    if (__sync_sub_and_fetch(&(IPC_USER_REF(pUser)), 1) != 0)
+    {
+        return;
+    }
+
+    if (pUser->fd > 0)
+    {
+        close( pUser->fd );
+        pUser->fd = -1;
+    }
+
+    comm_frameReset( IPC_USER_FRAME(pUser) );
+    pthread_mutex_destroy( IPC_USER_MUTEX(pUser) );
+    free( pUser );
+}
+
+/**
+*  Release IPC stream client removed from the user table.
+*  @param [in]  pContext  A @ref tIpcStreamServerContext object.
+*  @param [in]  pUser     A @ref tIpcUser object.
+*  @param [in]  closed    Closed by the peer in the receiving thread.
+*/
+static void _ipcStreamFreeClient(
+    tIpcStreamServerContext *pContext,
+    tIpcUser                *pUser,
+    int                      closed
+)
+{
+    LOG_3("IPC stream remove client %s\n", pUser->fileName);
+
+    if ( !closed )
+    {
+        pthread_cancel( pUser->thread );
+    }
+
+    /* notify the server that client is closed */
+    if (( closed ) && ( pContext->pServerExitFunc ))
+    {
+        pContext->pServerExitFunc(pContext->pServerArg, pUser);
+    }
+
+    /* the socket is closed after the senders to all */
+    _ipcStreamPutClient( pUser );
+}
+
+/**
+*  Set the message framing of the clients accepted afterwards.
+*  @param [in]  handle  IPC stream server handle.
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ipcStreamServerSetFrame(tIpcStreamServerHandle handle, tCommFrame *pFrame)
+{
+    tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
+    tCommFrame cfg;
+    tFrame frame;
 
-    if ( pUser )
+    if (NULL == pContext)
     {
-        LOG_3("IPC stream remove client %s\n", pUser->fileName);
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        for (i=0; i<pContext->maxUserNum; i++)
+    if ( pFrame )
+    {
+        cfg = *pFrame;
+        if (( pContext->pServerRecvFunc ) && (0 == cfg.maxSize))
         {
-            if (pContext->pUser[i] == pUser)
-            {
-                pContext->pUser[i] = NULL;
-                if (pContext->userNum > 0)
-                {
-                    pContext->userNum--;
-                }
-                break;
-            }
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
         }
+        pFrame = &cfg;
+    }
+
+    if (comm_frameInit(&frame, pFrame) != 0)
+    {
+        return -1;
+    }
+
+    if (( pFrame ) && ( pContext->pServerRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
+    {
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
+    }
+
+    pContext->frame = frame;
+    return 0;
+}
+
+/**
+*  Set the receive size of the IPC stream server clients.
+*  @param [in]  handle  IPC stream server handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ipcStreamServerSetRecvSize(tIpcStreamServerHandle handle, size_t size)
+{
+    tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pServerRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
+
+    pContext->recvSize = size;
+    return 0;
+}
+
+/**
+*  Tap the IPC stream server, so that the messages it sends to and receives
+*  from the clients are copied to a pcapng capture. The connection ID of a
+*  client is its slot in the user table, reused by the later clients.
+*  @param [in]  handle  IPC stream server handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ipcStreamServerSetTap(tIpcStreamServerHandle handle, tPcapHandle pcap)
+{
+    tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
 
-        if (pUser->fd > 0)
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "ipc-server:%.80s", pContext->localPath);
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
         {
-            pthread_cancel( pUser->thread );
-            close( pUser->fd );
-            pUser->fd = -1;
+            return -1;
         }
-
-        free( pUser );
     }
+
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
 }
 
 /**
@@ -816,7 +1583,25 @@ int comm_ipcStreamServerSend(
     unsigned short  size
 )
 {
-    int error;
+    return comm_ipcStreamServerSendEx(pUser, pData, size);
+}
+
+/**
+*  Send message to IPC stream client.
+*  @param [in]  pUser  A @ref tIpcUser object.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcStreamServerSendEx(
+    tIpcUser       *pUser,
+    unsigned char  *pData,
+    size_t          size
+)
+{
+    struct iovec iov;
+    tIpcStreamServerContext *pContext;
+    ssize_t error;
 
 
     if (NULL == pUser)
@@ -846,21 +1631,122 @@ int comm_ipcStreamServerSend(
     LOG_3("-> %s\n", pUser->fileName);
     LOG_DUMP("IPC stream server send", pData, size);
 
-    error = send(
-                pUser->fd,
-                pData,
-                size,
-                0
-            );
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pContext = pUser->pServer;
+    error = _ipcStreamServerSendv(pUser, &iov, 1, &(pContext->tap));
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPC stream\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to IPC stream client, the message
+*  is not interleaved with the other senders of the client.
+*  @param [in]  pUser  A @ref tIpcUser object.
+*  @param [in]  pIov   Data buffers.
+*  @param [in]  num    Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_ipcStreamServerSendv(
+    tIpcUser      *pUser,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    tIpcStreamServerContext *pContext;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pUser)
+    {
+        LOG_ERROR("%s: pUser is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pUser->fd < 0)
+    {
+        LOG_ERROR("%s: %s is not ready\n", __func__, pUser->fileName);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %s\n", pUser->fileName);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPC stream server send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pContext = pUser->pServer;
+    error = _ipcStreamServerSendv(pUser, pIov, num, &(pContext->tap));
     if (error < 0)
     {
         LOG_ERROR("fail to send IPC stream\n");
-        perror( "send" );
+        perror( "sendmsg" );
     }
 
     return error;
 }
 
+/**
+*  Take a reference of one client of the user table, called with the
+*  table lock held.
+*  @param [in]  pArg  A @ref tIpcSendAll object.
+*  @param [in]  pObj  A @ref tIpcUser object.
+*/
+static void _ipcStreamHoldFunc(void *pArg, void *pObj)
+{
+    tIpcSendAll *pSendAll = pArg;
+
+    /* the clients accepted after the table size was read are left out */
+    if (pSendAll->userNum < pSendAll->maxNum)
+    {
+        __sync_fetch_and_add(&(IPC_USER_REF(pObj)), 1);
+        pSendAll->ppUser[pSendAll->userNum++] = pObj;
+    }
+}
+
+/**
+*  Send a message to one referenced client of the user table.
+*  @param [in]  pSendAll  A @ref tIpcSendAll object.
+*  @param [in]  pUser     A @ref tIpcUser object.
+*/
+static void _ipcStreamSendAllFunc(tIpcSendAll *pSendAll, tIpcUser *pUser)
+{
+    struct iovec iov;
+    ssize_t error;
+
+    if (pUser->fd > 0)
+    {
+        iov.iov_base = pSendAll->pData;
+        iov.iov_len  = pSendAll->size;
+
+        error = _ipcStreamServerSendv(pUser, &iov, 1, pSendAll->pTap);
+        if (error < 0)
+        {
+            LOG_ERROR("fail to send IPC stream to fd(%d)\n", pUser->fd);
+            perror( "sendmsg" );
+        }
+    }
+}
+
 /**
 *  Send message to all IPC stream clients.
 *  @param [in]  handle  IPC stream server handle.
@@ -872,14 +1758,28 @@ void comm_ipcStreamServerSendAllClient(
     unsigned char          *pData,
     unsigned short          size
 )
+{
+    comm_ipcStreamServerSendAllClientEx(handle, pData, size);
+}
+
+/**
+*  Send message to all IPC stream clients.
+*  @param [in]  handle  IPC stream server handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*/
+void comm_ipcStreamServerSendAllClientEx(
+    tIpcStreamServerHandle  handle,
+    unsigned char          *pData,
+    size_t                  size
+)
 {
     tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
-    tIpcUser *pUser;
-    int error;
+    tIpcSendAll sendAll;
     int i;
 
 
-    if (0 == pContext->userNum)
+    if (0 == comm_tableNum( &(pContext->userTable) ))
     {
         LOG_WARN("%s: user number is 0\n", __func__);
         return;
@@ -899,25 +1799,26 @@ void comm_ipcStreamServerSendAllClient(
 
     LOG_DUMP("IPC stream send to all clients", pData, size);
 
-    for (i=0; i<pContext->maxUserNum; i++)
+    sendAll.pData   = pData;
+    sendAll.size    = size;
+    sendAll.pTap    = &(pContext->tap);
+    sendAll.userNum = 0;
+    sendAll.maxNum  = comm_tableSize( &(pContext->userTable) );
+    sendAll.ppUser  = malloc( sizeof( tIpcUser * ) * sendAll.maxNum );
+    if (NULL == sendAll.ppUser)
     {
-        pUser = pContext->pUser[i];
+        LOG_ERROR("fail to allocate IPC stream client list\n");
+        return;
+    }
 
-        if (( pUser ) && (pUser->fd > 0))
-        {
-            error = send(
-                        pUser->fd,
-                        pData,
-                        size,
-                        0
-                    );
-            if (error < 0)
-            {
-                LOG_ERROR("fail to send IPC stream to fd(%d)\n", pUser->fd);
-                perror( "send" );
-            }
-        }
+    /* a blocking send must not hold up the accepting and disconnecting */
+    comm_tableForEach(&(pContext->userTable), _ipcStreamHoldFunc, &sendAll);
+    for (i=0; i<sendAll.userNum; i++)
+    {
+        _ipcStreamSendAllFunc(&sendAll, sendAll.ppUser[i]);
+        _ipcStreamPutClient( sendAll.ppUser[i] );
     }
+    free( sendAll.ppUser );
 }
 
 /**
@@ -928,6 +1829,6 @@ void comm_ipcStreamServerSendAllClient(
 int comm_ipcStreamServerGetClientNum(tIpcStreamServerHandle handle)
 {
     tIpcStreamServerContext *pContext = (tIpcStreamServerContext *)handle;
-    return pContext->userNum;
+    return comm_tableNum( &(pContext->userTable) );
 }
 
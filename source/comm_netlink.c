@@ -1,35 +1,277 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <linux/netlink.h> /* struct nlmsghdr */
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_netlink.h"
 
 
+/* Max. iovec of one batch sendmsg(): header, payload and padding */
+#define NETLINK_IOV_NUM  (3 * COMM_NETLINK_BATCH_NUM)
+
+/* Max. outstanding transactions, a power of 2 */
+#define NETLINK_TRANS_NUM  (1024)
+
+/* Interval of the transaction timeout check in milliseconds */
+#define NETLINK_TRANS_TICK  (50)
+
+/* Socket receive buffer for the replies of the outstanding transactions */
+#define NETLINK_TRANS_RCVBUF  (4 * 1024 * 1024)
+
+
+/* Outstanding transaction, in the slot of seqNum % NETLINK_TRANS_NUM, the
+ * sequence numbers of the busy slots are skipped
+ */
+typedef struct _tNetlinkTrans
+{
+    unsigned int     seqNum;  /* 0 is a free slot */
+    tNetlinkReplyCb  pReplyFunc;
+    void            *pArg;
+    long long        deadline;
+} tNetlinkTrans;
+
 typedef struct _tNetlinkContext
 {
     struct sockaddr_nl  localAddr;
+    struct sockaddr_nl  kernelAddr;
+    int                 protocol;
     int                 fd;
 
     tNetlinkRecvCb      pRecvFunc;
+    tNetlinkBatchCb     pBatchFunc;
     tNetlinkExitCb      pExitFunc;
+    tNetlinkOverflowCb  pOverflowFunc;
     void               *pArg;
     pthread_t           thread;
     int                 running;
+    tReactorHandle      reactor;
+    tReactorEvent       event;
 
-    struct nlmsghdr    *pSendNlHdr;
-    struct nlmsghdr    *pRecvNlHdr;
-    struct iovec        sendIov;
-    struct iovec        recvIov;
-    struct msghdr       sendMsg;
-    struct msghdr       recvMsg;
-    unsigned char      *pSendBuf;
     unsigned char      *pRecvBuf;
+    size_t              recvSize;
+
+    /* transactions, pTrans is NULL if not enabled */
+    tNetlinkTrans      *pTrans;
+    int                 transNum;
+    unsigned int        seqNum;
+    long long           sweepTime;
+    pthread_mutex_t     transMutex;
+    pthread_mutex_t     dispatchMutex;
+    int                 timerFd;
+    tReactorEvent       timerEvent;
 } tNetlinkContext;
 
 
+/**
+*  Get the monotonic time in milliseconds.
+*  @returns  Milliseconds.
+*/
+static long long _netlinkNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (((long long)now.tv_sec * 1000) + (now.tv_nsec / 1000000));
+}
+
+/**
+*  Add a transaction with a new sequence number. A long outstanding
+*  transaction keeps its slot, and the next free slot is taken instead.
+*  @param [in]   pContext    A @ref tNetlinkContext object.
+*  @param [in]   pReplyFunc  Reply callback function.
+*  @param [in]   pArg        Reply callback argument.
+*  @param [in]   timeout     Timeout in milliseconds.
+*  @param [out]  pSeqNum     Sequence number of the transaction.
+*  @returns  Success(0) or failure(-1, all slots are outstanding).
+*/
+static int _netlinkTransAdd(
+    tNetlinkContext *pContext,
+    tNetlinkReplyCb  pReplyFunc,
+    void            *pArg,
+    unsigned int     timeout,
+    unsigned int    *pSeqNum
+)
+{
+    tNetlinkTrans *pTrans;
+    unsigned int seqNum;
+    int error = -1;
+
+
+    pthread_mutex_lock( &(pContext->transMutex) );
+
+    seqNum = pContext->seqNum;
+    while (pContext->transNum < NETLINK_TRANS_NUM)
+    {
+        seqNum++;
+        if (0 == seqNum)
+        {
+            /* 0 is the sequence number of the notifications */
+            continue;
+        }
+
+        pTrans = &(pContext->pTrans[seqNum & (NETLINK_TRANS_NUM - 1)]);
+        if (pTrans->seqNum != 0)
+        {
+            continue;
+        }
+
+        pTrans->seqNum     = seqNum;
+        pTrans->pReplyFunc = pReplyFunc;
+        pTrans->pArg       = pArg;
+        pTrans->deadline   = _netlinkNow() + timeout;
+        pContext->seqNum = seqNum;
+        pContext->transNum++;
+        *pSeqNum = seqNum;
+        error = 0;
+        break;
+    }
+
+    pthread_mutex_unlock( &(pContext->transMutex) );
+
+    return error;
+}
+
+/**
+*  Find the transaction of a sequence number.
+*  @param [in]   pContext  A @ref tNetlinkContext object.
+*  @param [in]   seqNum    Sequence number.
+*  @param [in]   done      Remove the transaction if it is found.
+*  @param [out]  pTrans    Copy of the transaction.
+*  @returns  Found(0) or not found(-1).
+*/
+static int _netlinkTransGet(
+    tNetlinkContext *pContext,
+    unsigned int     seqNum,
+    int              done,
+    tNetlinkTrans   *pTrans
+)
+{
+    tNetlinkTrans *pSlot;
+    int error = -1;
+
+
+    if (0 == seqNum)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &(pContext->transMutex) );
+
+    pSlot = &(pContext->pTrans[seqNum & (NETLINK_TRANS_NUM - 1)]);
+    if (seqNum == pSlot->seqNum)
+    {
+        *pTrans = *pSlot;
+        if ( done )
+        {
+            pSlot->seqNum = 0;
+            pContext->transNum--;
+        }
+        error = 0;
+    }
+
+    pthread_mutex_unlock( &(pContext->transMutex) );
+
+    return error;
+}
+
+/**
+*  Complete the timed out transactions with -ETIMEDOUT, or all of them
+*  with -ECANCELED.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  cancel    Complete all transactions.
+*/
+static void _netlinkTransSweep(tNetlinkContext *pContext, int cancel)
+{
+    tNetlinkTrans expired[COMM_NETLINK_BATCH_NUM];
+    tNetlinkTrans *pSlot;
+    long long now = _netlinkNow();
+    int num;
+    int i = 0;
+    int j;
+
+
+    pContext->sweepTime = now + NETLINK_TRANS_TICK;
+
+    while (i < NETLINK_TRANS_NUM)
+    {
+        num = 0;
+
+        pthread_mutex_lock( &(pContext->transMutex) );
+        for (; (i < NETLINK_TRANS_NUM) && (0 != pContext->transNum); i++)
+        {
+            pSlot = &(pContext->pTrans[i]);
+            if ((pSlot->seqNum) && ((cancel) || (now >= pSlot->deadline)))
+            {
+                expired[num++] = *pSlot;
+                pSlot->seqNum = 0;
+                pContext->transNum--;
+                if (COMM_NETLINK_BATCH_NUM == num)
+                {
+                    i++;
+                    break;
+                }
+            }
+        }
+        if (0 == pContext->transNum)
+        {
+            i = NETLINK_TRANS_NUM;
+        }
+        pthread_mutex_unlock( &(pContext->transMutex) );
+
+        for (j=0; j<num; j++)
+        {
+            LOG_2("netlink transaction %u %s\n",
+                expired[j].seqNum,
+                ((cancel) ? "is cancelled" : "timed out")
+            );
+            expired[j].pReplyFunc(
+                expired[j].pArg,
+                expired[j].seqNum,
+                ((cancel) ? -ECANCELED : -ETIMEDOUT),
+                NULL,
+                0
+            );
+        }
+    }
+}
+
+/**
+*  Pass the received messages to a transaction or to the receive callback.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  pTrans    A @ref tNetlinkTrans object (NULL is not a reply).
+*  @param [in]  pMsg      Messages.
+*  @param [in]  num       Number of messages.
+*/
+static void _netlinkDispatch(
+    tNetlinkContext *pContext,
+    tNetlinkTrans   *pTrans,
+    tNetlinkMsg     *pMsg,
+    int              num
+)
+{
+    if (0 == num)
+    {
+        return;
+    }
+
+    if ( pTrans )
+    {
+        pTrans->pReplyFunc(pTrans->pArg, pTrans->seqNum, 0, pMsg, num);
+    }
+    else if ( pContext->pBatchFunc )
+    {
+        pContext->pBatchFunc(pContext->pArg, pMsg, num);
+    }
+}
+
+
 /**
 *  Initialize netlink socket.
 *  @param [in]  pContext  A @ref tNetlinkContext object.
@@ -37,16 +279,12 @@ typedef struct _tNetlinkContext
 */
 static int _netlinkInit(tNetlinkContext *pContext)
 {
-    struct nlmsghdr *pSendNlHdr = NULL;
-    struct nlmsghdr *pRecvNlHdr = NULL;
     struct sockaddr_nl sourAddr;
-    struct sockaddr_nl destAddr;
     socklen_t sourAddrLen;
-    socklen_t destAddrLen;
     int fd;
 
 
-    fd = socket(PF_NETLINK, SOCK_RAW, NETLINK_USERSOCK);
+    fd = socket(PF_NETLINK, SOCK_RAW, pContext->protocol);
     if (fd < 0)
     {
         perror( "socket" );
@@ -63,113 +301,350 @@ static int _netlinkInit(tNetlinkContext *pContext)
         return -1;
     }
 
-
-    /* [1] netlink message buffer for send */
-    pSendNlHdr = (struct nlmsghdr *)malloc(
-                     NLMSG_SPACE(COMM_BUF_SIZE + 1)
-                 );
-    if (NULL == pSendNlHdr)
+    /* the kernel assigns the port ID of an auto-bound socket */
+    if (getsockname(fd, (struct sockaddr *)&sourAddr, &sourAddrLen) < 0)
     {
-        LOG_ERROR("fail to allocate send buffer\n");
+        perror( "getsockname" );
+        close( fd );
+        return -1;
+    }
+    pContext->localAddr.nl_pid = sourAddr.nl_pid;
+
+    /* messages are sent to Linux Kernel by unicast */
+    memset(&(pContext->kernelAddr), 0x00, sizeof( struct sockaddr_nl ));
+    pContext->kernelAddr.nl_family = AF_NETLINK;
+    pContext->kernelAddr.nl_pid    = 0;
+    pContext->kernelAddr.nl_groups = 0;
+
+    /* one datagram carries several messages of a multi-part reply */
+    pContext->recvSize = COMM_NETLINK_RECV_SIZE;
+    pContext->pRecvBuf = malloc( pContext->recvSize + 1 );
+    if (NULL == pContext->pRecvBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
         close( fd );
         return -1;
     }
 
-    destAddrLen = sizeof( struct sockaddr_nl );
-    memset(&destAddr, 0x00, destAddrLen);
-    destAddr.nl_family = AF_NETLINK;
-    destAddr.nl_pid    = 0; /* for Linux Kernel */
-    destAddr.nl_groups = 0; /* unicast */
+    pContext->fd = fd;
 
-    /* Fill the netlink message header */
-    pSendNlHdr->nlmsg_type  = 0;
-    pSendNlHdr->nlmsg_len   = NLMSG_SPACE(COMM_BUF_SIZE);
-    pSendNlHdr->nlmsg_pid   = getpid(); /* self pid */
-    pSendNlHdr->nlmsg_seq   = 0;
-    pSendNlHdr->nlmsg_flags = 0;
+    LOG_2("netlink socket is ready\n");
+    return 0;
+}
 
-    pContext->sendIov.iov_base = (void *)pSendNlHdr;
-    pContext->sendIov.iov_len  = pSendNlHdr->nlmsg_len;
+/**
+*  Un-initialize netlink socket.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*/
+static void _netlinkUninit(tNetlinkContext *pContext)
+{
+    if (pContext->fd > 0)
+    {
+        close( pContext->fd );
+        pContext->fd = -1;
+    }
 
-    pContext->sendMsg.msg_name       = (void *)&destAddr;
-    pContext->sendMsg.msg_namelen    = destAddrLen;
-    pContext->sendMsg.msg_iov        = &(pContext->sendIov);
-    pContext->sendMsg.msg_iovlen     = 1;
-    pContext->sendMsg.msg_control    = NULL;
-    pContext->sendMsg.msg_controllen = 0;
-    pContext->sendMsg.msg_flags      = 0;
+    if ( pContext->pRecvBuf )
+    {
+        free( pContext->pRecvBuf );
+        pContext->pRecvBuf = NULL;
+    }
 
-    /* Fill in the netlink message payload */
-    pContext->pSendBuf = NLMSG_DATA(pSendNlHdr);
-    pContext->pSendBuf[0] = 0x00;
+    LOG_2("netlink socket is closed\n");
+}
+
+/**
+*  Send several messages to kernel space with one sendmsg(), each message
+*  takes exactly its aligned length.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  pMsg      Messages.
+*  @param [in]  num       Number of messages (up to COMM_NETLINK_BATCH_NUM).
+*  @returns  Sent bytes (-1 is failed).
+*/
+static ssize_t _netlinkSendMsg(
+    tNetlinkContext *pContext,
+    tNetlinkMsg     *pMsg,
+    int              num
+)
+{
+    static unsigned char pad[NLMSG_ALIGNTO];
+    struct nlmsghdr nlHdr[COMM_NETLINK_BATCH_NUM];
+    struct iovec iov[NETLINK_IOV_NUM];
+    struct msghdr msg;
+    size_t padSize;
+    ssize_t error;
+    int iovNum = 0;
+    int i;
 
 
-    /* [2] netlink message buffer for receive */
-    pRecvNlHdr = (struct nlmsghdr *)malloc(
-                     NLMSG_SPACE(COMM_BUF_SIZE + 1)
-                 );
-    if (NULL == pRecvNlHdr)
+    for (i=0; i<num; i++)
     {
-        LOG_ERROR("fail to allocate receive buffer\n");
-        free( pSendNlHdr );
-        pSendNlHdr = NULL;
-        close( fd );
-        return -1;
+        nlHdr[i].nlmsg_len   = NLMSG_LENGTH( pMsg[i].size );
+        nlHdr[i].nlmsg_type  = pMsg[i].type;
+        nlHdr[i].nlmsg_flags = pMsg[i].flags;
+        nlHdr[i].nlmsg_seq   = pMsg[i].seqNum;
+        nlHdr[i].nlmsg_pid   = pContext->localAddr.nl_pid;
+
+        iov[iovNum].iov_base = &(nlHdr[i]);
+        iov[iovNum].iov_len  = NLMSG_HDRLEN;
+        iovNum++;
+
+        if (pMsg[i].size > 0)
+        {
+            iov[iovNum].iov_base = pMsg[i].pData;
+            iov[iovNum].iov_len  = pMsg[i].size;
+            iovNum++;
+        }
+
+        /* the next message starts at the aligned offset */
+        padSize = NLMSG_ALIGN( pMsg[i].size ) - pMsg[i].size;
+        if ((padSize > 0) && (i < (num - 1)))
+        {
+            iov[iovNum].iov_base = pad;
+            iov[iovNum].iov_len  = padSize;
+            iovNum++;
+        }
     }
 
-    pRecvNlHdr->nlmsg_type  = 0;
-    pRecvNlHdr->nlmsg_len   = NLMSG_SPACE(COMM_BUF_SIZE);
-    pRecvNlHdr->nlmsg_pid   = 0;
-    pRecvNlHdr->nlmsg_seq   = 0;
-    pRecvNlHdr->nlmsg_flags = 0;
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    msg.msg_name    = &(pContext->kernelAddr);
+    msg.msg_namelen = sizeof( struct sockaddr_nl );
+    msg.msg_iov     = iov;
+    msg.msg_iovlen  = iovNum;
 
-    pContext->recvIov.iov_base = (void *)pRecvNlHdr;
-    pContext->recvIov.iov_len  = pRecvNlHdr->nlmsg_len;
+    error = sendmsg(pContext->fd, &msg, 0);
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send netlink message\n");
+        perror( "sendmsg" );
+    }
 
-    pContext->recvMsg.msg_name       = (void *)&destAddr;
-    pContext->recvMsg.msg_namelen    = destAddrLen;
-    pContext->recvMsg.msg_iov        = &(pContext->recvIov);
-    pContext->recvMsg.msg_iovlen     = 1;
-    pContext->recvMsg.msg_control    = NULL;
-    pContext->recvMsg.msg_controllen = 0;
-    pContext->recvMsg.msg_flags      = 0;
+    return error;
+}
 
-    pContext->pRecvBuf = NLMSG_DATA(pRecvNlHdr);
+/**
+*  Pass every netlink message of a received datagram to its transaction
+*  or to the receive callback.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  len       Datagram length.
+*/
+static void _netlinkParse(tNetlinkContext *pContext, int len)
+{
+    tNetlinkMsg batch[COMM_NETLINK_BATCH_NUM];
+    struct nlmsghdr *pNlHdr;
+    tNetlinkTrans target;
+    tNetlinkTrans trans;
+    tNetlinkTrans *pTarget = NULL;
+    unsigned char last;
+    int batchNum = 0;
+    int error;
+    int rest;
 
 
-    pContext->pSendNlHdr = pSendNlHdr;
-    pContext->pRecvNlHdr = pRecvNlHdr;
-    pContext->fd = fd;
+    rest = len;
+    for (pNlHdr = (struct nlmsghdr *)pContext->pRecvBuf;
+         NLMSG_OK(pNlHdr, rest);
+         pNlHdr = NLMSG_NEXT(pNlHdr, rest))
+    {
+        if (( pContext->pTrans ) &&
+            (0 == _netlinkTransGet(pContext, pNlHdr->nlmsg_seq, 0, &trans)))
+        {
+            if ((NLMSG_ERROR == pNlHdr->nlmsg_type) ||
+                (NLMSG_DONE  == pNlHdr->nlmsg_type))
+            {
+                /* ACK, error or the end of a multi-part reply */
+                _netlinkDispatch(pContext, pTarget, batch, batchNum);
+                batchNum = 0;
+
+                error = 0;
+                if (pNlHdr->nlmsg_len >= NLMSG_LENGTH( sizeof( int ) ))
+                {
+                    memcpy(&error, NLMSG_DATA( pNlHdr ), sizeof( int ));
+                }
+
+                if (0 == _netlinkTransGet(pContext, trans.seqNum, 1, &trans))
+                {
+                    trans.pReplyFunc(trans.pArg, trans.seqNum, error, NULL, 0);
+                }
+                continue;
+            }
 
-    LOG_2("netlink socket is ready\n");
-    return 0;
+            if ((NULL == pTarget) || (pTarget->seqNum != trans.seqNum))
+            {
+                _netlinkDispatch(pContext, pTarget, batch, batchNum);
+                batchNum = 0;
+                target = trans;
+                pTarget = &target;
+            }
+        }
+        else if ( pContext->pBatchFunc )
+        {
+            if ( pTarget )
+            {
+                _netlinkDispatch(pContext, pTarget, batch, batchNum);
+                batchNum = 0;
+                pTarget = NULL;
+            }
+        }
+        else
+        {
+            if ( pContext->pRecvFunc )
+            {
+                /* the callback may terminate the payload, that is the
+                 * first byte of the next message
+                 */
+                last = ((unsigned char *)pNlHdr)[ pNlHdr->nlmsg_len ];
+                pContext->pRecvFunc(
+                    pContext->pArg,
+                    NLMSG_DATA( pNlHdr ),
+                    pNlHdr->nlmsg_len - NLMSG_HDRLEN,
+                    pNlHdr->nlmsg_flags
+                );
+                ((unsigned char *)pNlHdr)[ pNlHdr->nlmsg_len ] = last;
+            }
+            continue;
+        }
+
+        batch[batchNum].pData  = NLMSG_DATA( pNlHdr );
+        batch[batchNum].size   = pNlHdr->nlmsg_len - NLMSG_HDRLEN;
+        batch[batchNum].type   = pNlHdr->nlmsg_type;
+        batch[batchNum].flags  = pNlHdr->nlmsg_flags;
+        batch[batchNum].seqNum = pNlHdr->nlmsg_seq;
+        batch[batchNum].pid    = pNlHdr->nlmsg_pid;
+        batchNum++;
+
+        if (COMM_NETLINK_BATCH_NUM == batchNum)
+        {
+            _netlinkDispatch(pContext, pTarget, batch, batchNum);
+            batchNum = 0;
+        }
+    }
+
+    _netlinkDispatch(pContext, pTarget, batch, batchNum);
 }
 
 /**
-*  Un-initialize netlink socket.
+*  Tell the owner that the receive buffer overflowed.
 *  @param [in]  pContext  A @ref tNetlinkContext object.
 */
-static void _netlinkUninit(tNetlinkContext *pContext)
+static void _netlinkOverflow(tNetlinkContext *pContext)
 {
-    if (pContext->fd > 0)
+    tNetlinkOverflowCb pOverflowFunc;
+    int state;
+
+    pOverflowFunc = __atomic_load_n(&(pContext->pOverflowFunc), __ATOMIC_ACQUIRE);
+    if (NULL == pOverflowFunc)
+    {
+        return;
+    }
+
+    if ( pContext->pTrans )
+    {
+        /* not overlapped with the reply and timeout callbacks */
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        pthread_mutex_lock( &(pContext->dispatchMutex) );
+        pOverflowFunc( pContext->pArg );
+        pthread_mutex_unlock( &(pContext->dispatchMutex) );
+        pthread_setcancelstate(state, NULL);
+    }
+    else
+    {
+        pOverflowFunc( pContext->pArg );
+    }
+}
+
+/**
+*  Receive a datagram and pass every netlink message in it to the netlink
+*  receive callback.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  flags     recvmsg() flags.
+*  @returns  Datagram length (-1 is closed).
+*/
+static int _netlinkRecvMsg(tNetlinkContext *pContext, int flags)
+{
+    struct iovec iov;
+    struct msghdr msg;
+    int state;
+    int len;
+
+
+    iov.iov_base = pContext->pRecvBuf;
+    iov.iov_len  = pContext->recvSize;
+
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    msg.msg_iov    = &iov;
+    msg.msg_iovlen = 1;
+
+    LOG_3("pid(%d) ... recvmsg\n", pContext->localAddr.nl_pid);
+    len = recvmsg(pContext->fd, &msg, flags);
+    if (len <= 0)
     {
+        if ((len < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+        {
+            return 0;
+        }
+        if ((len < 0) && (ENOBUFS == errno))
+        {
+            /* the lost replies are completed by the timeout */
+            LOG_WARN("netlink receive buffer overflowed\n");
+            _netlinkOverflow( pContext );
+            return 0;
+        }
+        LOG_ERROR("netlink socket was terminated\n");
+        comm_reactorDelEvent( &(pContext->event) );
         close( pContext->fd );
         pContext->fd = -1;
+        /* notify that peer netlink shutdown */
+        if ( pContext->pExitFunc )
+        {
+            pContext->pExitFunc(pContext->pArg, len);
+        }
+        return -1;
     }
 
-    if ( pContext->pSendNlHdr )
+    if (msg.msg_flags & MSG_TRUNC)
     {
-        free( pContext->pSendNlHdr );
-        pContext->pSendNlHdr = NULL;
+        LOG_WARN("netlink datagram is truncated to %d bytes\n", len);
     }
 
-    if ( pContext->pRecvNlHdr )
+    LOG_3("<- kernel space\n");
+    LOG_DUMP("netlink recvmsg", pContext->pRecvBuf, len);
+
+    if ( pContext->pTrans )
     {
-        free( pContext->pRecvNlHdr );
-        pContext->pRecvNlHdr = NULL;
+        /* the reply and timeout callbacks of a transaction never overlap */
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        pthread_mutex_lock( &(pContext->dispatchMutex) );
+        _netlinkParse(pContext, len);
+        pthread_mutex_unlock( &(pContext->dispatchMutex) );
+        pthread_setcancelstate(state, NULL);
+    }
+    else
+    {
+        _netlinkParse(pContext, len);
     }
 
-    LOG_2("netlink socket is closed\n");
+    return len;
+}
+
+/**
+*  Complete the timed out transactions once per NETLINK_TRANS_TICK.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*/
+static void _netlinkTimeout(tNetlinkContext *pContext)
+{
+    int state;
+
+    if (_netlinkNow() < pContext->sweepTime)
+    {
+        return;
+    }
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+    pthread_mutex_lock( &(pContext->dispatchMutex) );
+    _netlinkTransSweep(pContext, 0);
+    pthread_mutex_unlock( &(pContext->dispatchMutex) );
+    pthread_setcancelstate(state, NULL);
 }
 
 /**
@@ -179,7 +654,6 @@ static void _netlinkUninit(tNetlinkContext *pContext)
 static void *_netlinkRecvTask(void *pArg)
 {
     tNetlinkContext *pContext = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -187,39 +661,16 @@ static void *_netlinkRecvTask(void *pArg)
 
     while ( pContext->running )
     {
-        LOG_3("pid(%d) ... recvmsg\n", pContext->localAddr.nl_pid);
         pthread_testcancel();
-        len = recvmsg(pContext->fd, &(pContext->recvMsg), 0);
-        if (len <= 0)
+        if (_netlinkRecvMsg(pContext, 0) < 0)
         {
-            LOG_ERROR("IPv4 TCP server was terminated\n");
-            close( pContext->fd );
-            pContext->fd = -1;
-            /* notify that peer netlink shutdown */
-            if ( pContext->pExitFunc )
-            {
-                pContext->pExitFunc(pContext->pArg, len);
-            }
             break;
         }
-        pthread_testcancel();
-
-        LOG_3("<- kernel space\n");
-        LOG_DUMP(
-            "netlink recvmsg",
-            pContext->pRecvBuf,
-            pContext->pRecvNlHdr->nlmsg_len
-        );
-
-        if ( pContext->pRecvFunc )
+        if ( pContext->pTrans )
         {
-            pContext->pRecvFunc(
-                pContext->pArg,
-                pContext->pRecvBuf,
-                pContext->pRecvNlHdr->nlmsg_len,
-                pContext->pRecvNlHdr->nlmsg_flags
-            );
+            _netlinkTimeout( pContext );
         }
+        pthread_testcancel();
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -229,17 +680,150 @@ static void *_netlinkRecvTask(void *pArg)
 }
 
 /**
-*  Initialize netlink.
-*  @param [in]  pFileName  Application's socket file name.
-*  @param [in]  pRecvFunc  Application's receive callback function.
-*  @param [in]  pExitFunc  Application's exit callback function.
-*  @param [in]  pArg       Application's argument.
+*  Reactor event function for netlink socket receiving.
+*  @param [in]  pArg    A @ref tNetlinkContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _netlinkRecvEvent(void *pArg, unsigned int events)
+{
+    tNetlinkContext *pContext = pArg;
+
+    if (_netlinkRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        pContext->running = 0;
+    }
+}
+
+/**
+*  Reactor event function for the transaction timer.
+*  @param [in]  pArg    A @ref tNetlinkContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _netlinkTimerEvent(void *pArg, unsigned int events)
+{
+    tNetlinkContext *pContext = pArg;
+    unsigned long long expired;
+
+    if (read(pContext->timerFd, &expired, sizeof( expired )) > 0)
+    {
+        _netlinkTimeout( pContext );
+    }
+}
+
+/**
+*  Enable the transactions of a netlink socket. The receiving thread wakes
+*  up by SO_RCVTIMEO, and a timer is armed for the reactor, it is added
+*  next to the socket by @ref _netlinkOpen.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*  @param [in]  reactor   Reactor handle (0 is the receiving thread).
+*  @returns  Success(0) or failure(-1).
+*/
+static int _netlinkTransInit(tNetlinkContext *pContext, tReactorHandle reactor)
+{
+    struct itimerspec tick;
+    struct timeval tv;
+    int size = NETLINK_TRANS_RCVBUF;
+
+
+    pContext->pTrans = calloc(NETLINK_TRANS_NUM, sizeof( tNetlinkTrans ));
+    if (NULL == pContext->pTrans)
+    {
+        LOG_ERROR("fail to allocate netlink transactions\n");
+        return -1;
+    }
+
+    pthread_mutex_init(&(pContext->transMutex), NULL);
+    pthread_mutex_init(&(pContext->dispatchMutex), NULL);
+    pContext->sweepTime = _netlinkNow() + NETLINK_TRANS_TICK;
+    pContext->timerFd = -1;
+
+    /* beyond rmem_max if privileged, otherwise up to it */
+    if (setsockopt(pContext->fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof( size )) < 0)
+    {
+        setsockopt(pContext->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ));
+    }
+
+    if ( !reactor )
+    {
+        tv.tv_sec  = 0;
+        tv.tv_usec = (NETLINK_TRANS_TICK * 1000);
+        if (setsockopt(pContext->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv )) < 0)
+        {
+            perror( "setsockopt SO_RCVTIMEO" );
+            return -1;
+        }
+        return 0;
+    }
+
+    pContext->timerFd = timerfd_create(CLOCK_MONOTONIC, (TFD_NONBLOCK | TFD_CLOEXEC));
+    if (pContext->timerFd < 0)
+    {
+        perror( "timerfd_create" );
+        return -1;
+    }
+
+    tick.it_interval.tv_sec  = 0;
+    tick.it_interval.tv_nsec = (NETLINK_TRANS_TICK * 1000000);
+    tick.it_value = tick.it_interval;
+    if (timerfd_settime(pContext->timerFd, 0, &tick, NULL) < 0)
+    {
+        perror( "timerfd_settime" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Un-initialize the transactions after the receiving is stopped, the
+*  outstanding ones are completed with -ECANCELED.
+*  @param [in]  pContext  A @ref tNetlinkContext object.
+*/
+static void _netlinkTransUninit(tNetlinkContext *pContext)
+{
+    if (NULL == pContext->pTrans)
+    {
+        return;
+    }
+
+    if ( comm_reactorAttached( &(pContext->timerEvent) ) )
+    {
+        comm_reactorDelEvent( &(pContext->timerEvent) );
+    }
+
+    if (pContext->timerFd >= 0)
+    {
+        close( pContext->timerFd );
+        pContext->timerFd = -1;
+    }
+
+    _netlinkTransSweep(pContext, 1);
+
+    pthread_mutex_destroy( &(pContext->transMutex) );
+    pthread_mutex_destroy( &(pContext->dispatchMutex) );
+    free( pContext->pTrans );
+    pContext->pTrans = NULL;
+}
+
+/**
+*  Open netlink with one of the receive callbacks.
+*  @param [in]  protocol    Netlink protocol (NETLINK_USERSOCK, NETLINK_ROUTE, ...).
+*  @param [in]  trans       Enable the transactions.
+*  @param [in]  reactor     Reactor handle (0 is the receiving thread).
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pArg        Application's argument.
 *  @returns  Netlink handle.
 */
-tNetlinkHandle comm_netlinkInit(
-    tNetlinkRecvCb  pRecvFunc,
-    tNetlinkExitCb  pExitFunc,
-    void           *pArg
+static tNetlinkHandle _netlinkOpen(
+    int              protocol,
+    int              trans,
+    tReactorHandle   reactor,
+    tNetlinkRecvCb   pRecvFunc,
+    tNetlinkBatchCb  pBatchFunc,
+    tNetlinkExitCb   pExitFunc,
+    void            *pArg
 )
 {
     tNetlinkContext *pContext = NULL;
@@ -255,10 +839,13 @@ tNetlinkHandle comm_netlinkInit(
 
     memset(pContext, 0x00, sizeof( tNetlinkContext ));
     pContext->localAddr.nl_family  = AF_NETLINK;
-    pContext->localAddr.nl_pid     = getpid(); /* self pid */
+    /* self pid, or auto-bound so that several handles can coexist */
+    pContext->localAddr.nl_pid     = ((trans) ? 0 : getpid());
     pContext->localAddr.nl_groups  = 0;        /* not in mcast groups */
-    pContext->pRecvFunc = pRecvFunc;
-    pContext->pExitFunc = pExitFunc;
+    pContext->protocol = protocol;
+    pContext->pRecvFunc  = pRecvFunc;
+    pContext->pBatchFunc = pBatchFunc;
+    pContext->pExitFunc  = pExitFunc;
     pContext->pArg = pArg;
     pContext->fd = -1;
 
@@ -270,7 +857,7 @@ tNetlinkHandle comm_netlinkInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBatchFunc))
     {
         LOG_1("ignore netlink receive function\n");
     }
@@ -280,8 +867,57 @@ tNetlinkHandle comm_netlinkInit(
         LOG_1("ignore netlink exit function\n");
     }
 
+    if ((trans) && (_netlinkTransInit(pContext, reactor) != 0))
+    {
+        LOG_ERROR("failed to enable netlink transactions\n");
+        _netlinkTransUninit( pContext );
+        _netlinkUninit( pContext );
+        free( pContext );
+        return 0;
+    }
+
     pContext->running = 1;
 
+    if ( reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _netlinkRecvEvent,
+                    pContext
+                );
+        if ((0 == error) && (pContext->timerFd >= 0))
+        {
+            /* on the same thread as the socket, the timer never waits for it */
+            error = comm_reactorAddEventNear(
+                        &(pContext->event),
+                        &(pContext->timerEvent),
+                        pContext->timerFd,
+                        EPOLLIN,
+                        _netlinkTimerEvent,
+                        pContext
+                    );
+            if (error != 0)
+            {
+                comm_reactorDelEvent( &(pContext->event) );
+            }
+        }
+        if (error != 0)
+        {
+            LOG_ERROR("failed to attach netlink to reactor\n");
+            _netlinkTransUninit( pContext );
+            _netlinkUninit( pContext );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = reactor;
+        goto _DONE;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -294,6 +930,7 @@ tNetlinkHandle comm_netlinkInit(
     if (error != 0)
     {
         LOG_ERROR("failed to create netlink receiving thread\n");
+        _netlinkTransUninit( pContext );
         _netlinkUninit( pContext );
         free( pContext );
         return 0;
@@ -301,10 +938,106 @@ tNetlinkHandle comm_netlinkInit(
 
     pthread_attr_destroy( &tattr );
 
+_DONE:
     LOG_1("netlink initialized\n");
     return ((tNetlinkHandle)pContext);
 }
 
+/**
+*  Initialize netlink.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  Netlink handle.
+*/
+tNetlinkHandle comm_netlinkInit(
+    tNetlinkRecvCb  pRecvFunc,
+    tNetlinkExitCb  pExitFunc,
+    void           *pArg
+)
+{
+    return _netlinkOpen(NETLINK_USERSOCK, 0, g_reactor, pRecvFunc, NULL, pExitFunc, pArg);
+}
+
+/**
+*  Initialize netlink with batch receiving. Every message of a received
+*  datagram, including the parts of a multi-part reply and its NLMSG_DONE,
+*  is passed to the callback with up to COMM_NETLINK_BATCH_NUM messages
+*  at a time.
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  Netlink handle.
+*/
+tNetlinkHandle comm_netlinkInitBatch(
+    tNetlinkBatchCb  pBatchFunc,
+    tNetlinkExitCb   pExitFunc,
+    void            *pArg
+)
+{
+    if (NULL == pBatchFunc)
+    {
+        LOG_ERROR("%s: pBatchFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    return _netlinkOpen(NETLINK_USERSOCK, 0, g_reactor, NULL, pBatchFunc, pExitFunc, pArg);
+}
+
+/**
+*  Initialize netlink with the transactions of @ref comm_netlinkRequest.
+*  The replies are passed to the callback of their request, and the other
+*  messages (e.g. notifications) to the batch callback.
+*  @param [in]  protocol    Netlink protocol (NETLINK_ROUTE, ...).
+*  @param [in]  pBatchFunc  Application's batch callback function (may be NULL).
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  Netlink handle.
+*/
+tNetlinkHandle comm_netlinkInitTrans(
+    int              protocol,
+    tNetlinkBatchCb  pBatchFunc,
+    tNetlinkExitCb   pExitFunc,
+    void            *pArg
+)
+{
+    return _netlinkOpen(protocol, 1, g_reactor, NULL, pBatchFunc, pExitFunc, pArg);
+}
+
+/**
+*  Initialize netlink with the transactions on its own receiving thread,
+*  even if a reactor is selected.
+*  @param [in]  protocol    Netlink protocol (NETLINK_ROUTE, ...).
+*  @param [in]  pBatchFunc  Batch callback function (may be NULL).
+*  @param [in]  pExitFunc   Exit callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Netlink handle.
+*/
+tNetlinkHandle comm_netlinkInitTransThread(
+    int              protocol,
+    tNetlinkBatchCb  pBatchFunc,
+    tNetlinkExitCb   pExitFunc,
+    void            *pArg
+)
+{
+    return _netlinkOpen(protocol, 1, 0, NULL, pBatchFunc, pExitFunc, pArg);
+}
+
+/**
+*  Release a netlink socket when it is no more received, the timer is on
+*  the same reactor thread and removed without waiting.
+*  @param [in]  pArg  A @ref tNetlinkContext object.
+*/
+static void _netlinkRelease(void *pArg)
+{
+    tNetlinkContext *pContext = pArg;
+
+    _netlinkUninit( pContext );
+    _netlinkTransUninit( pContext );
+    free( pContext );
+    LOG_1("netlink un-initialized\n");
+}
+
 /**
 *  Un-initialize netlink.
 *  @param [in]  handle  Netlink handle.
@@ -315,14 +1048,18 @@ void comm_netlinkUninit(tNetlinkHandle handle)
 
     if ( pContext )
     {
-        pthread_cancel( pContext->thread );
-
         pContext->running = 0;
-        _netlinkUninit( pContext );
 
-        pthread_join(pContext->thread, NULL);
-        free( pContext );
-        LOG_1("netlink un-initialized\n");
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _netlinkRelease, pContext);
+        }
+        else
+        {
+            pthread_cancel( pContext->thread );
+            pthread_join(pContext->thread, NULL);
+            _netlinkRelease( pContext );
+        }
     }
 }
 
@@ -346,7 +1083,7 @@ int comm_netlinkSendToKernel(
 )
 {
     tNetlinkContext *pContext = (tNetlinkContext *)handle;
-    int error;
+    tNetlinkMsg msg;
 
 
     if (NULL == pContext)
@@ -376,19 +1113,252 @@ int comm_netlinkSendToKernel(
     LOG_3("-> kernel space\n");
     LOG_DUMP("netlink sendmsg", pData, size);
 
-    pContext->pSendNlHdr->nlmsg_type  = type;
-    pContext->pSendNlHdr->nlmsg_flags = flags;
-    pContext->pSendNlHdr->nlmsg_seq   = seqNum;
-    pContext->pSendNlHdr->nlmsg_len   = size;
-    memcpy(pContext->pSendBuf, pData, size);
+    msg.pData  = pData;
+    msg.size   = size;
+    msg.type   = type;
+    msg.flags  = flags;
+    msg.seqNum = seqNum;
+    msg.pid    = 0;
 
-    error = sendmsg(pContext->fd, &(pContext->sendMsg), 0);
-    if (error < 0)
+    return _netlinkSendMsg(pContext, &msg, 1);
+}
+
+/**
+*  Send several netlink messages to kernel space. The messages are packed
+*  back to back, COMM_NETLINK_BATCH_NUM of them per sendmsg().
+*  @param [in]  handle  Netlink handle.
+*  @param [in]  pMsg    Messages (pid is not used).
+*  @param [in]  num     Number of messages.
+*  @returns  Number of sent messages (-1 is failed).
+*/
+int comm_netlinkSendBatch(tNetlinkHandle handle, tNetlinkMsg *pMsg, int num)
+{
+    tNetlinkContext *pContext = (tNetlinkContext *)handle;
+    int sent = 0;
+    int count;
+    int i;
+
+
+    if (NULL == pContext)
     {
-        LOG_ERROR("fail to send netlink message\n");
-        perror( "sendmsg" );
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
     }
 
-    return error;
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: netlink socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pMsg)
+    {
+        LOG_WARN("%s: pMsg is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %d netlink messages\n", num);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("netlink sendmsg", pMsg[i].pData, pMsg[i].size);
+    }
+
+    while (sent < num)
+    {
+        count = num - sent;
+        if (count > COMM_NETLINK_BATCH_NUM)
+        {
+            count = COMM_NETLINK_BATCH_NUM;
+        }
+
+        if (_netlinkSendMsg(pContext, (pMsg + sent), count) < 0)
+        {
+            return ((sent > 0) ? sent : -1);
+        }
+        sent += count;
+    }
+
+    return sent;
+}
+
+
+/**
+*  Join a multicast group of the netlink protocol, the notifications are
+*  passed to the receive callback.
+*  @param [in]  handle  Netlink handle.
+*  @param [in]  group   Group number (RTNLGRP_LINK, ...), not a bit mask.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_netlinkJoinGroup(tNetlinkHandle handle, unsigned int group)
+{
+    tNetlinkContext *pContext = (tNetlinkContext *)handle;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: netlink socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (setsockopt(
+            pContext->fd,
+            SOL_NETLINK,
+            NETLINK_ADD_MEMBERSHIP,
+            &group,
+            sizeof( group )
+        ) < 0)
+    {
+        perror( "setsockopt NETLINK_ADD_MEMBERSHIP" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Set the overflow callback of a netlink handle, it is called on the
+*  receiving thread like the batch callback.
+*  @param [in]  handle          Netlink handle.
+*  @param [in]  pOverflowFunc  Overflow callback function (NULL is none).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_netlinkSetOverflow(tNetlinkHandle handle, tNetlinkOverflowCb pOverflowFunc)
+{
+    tNetlinkContext *pContext = (tNetlinkContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    __atomic_store_n(&(pContext->pOverflowFunc), pOverflowFunc, __ATOMIC_RELEASE);
+    return 0;
 }
 
+/**
+*  Send netlink requests to kernel space without waiting for the replies.
+*  Each request gets its own sequence number and NLM_F_REQUEST | NLM_F_ACK,
+*  so many of them are outstanding at once. The reply callback is called
+*  with the reply messages of a request, and then once with num 0 when
+*  the request is completed:
+*    error 0            ==> ACK or NLMSG_DONE
+*    error -errno       ==> NLMSG_ERROR of the kernel
+*    error -ETIMEDOUT   ==> no ACK in the timeout
+*    error -ECANCELED   ==> the handle is un-initialized
+*  @param [in]  handle      Netlink handle of @ref comm_netlinkInitTrans.
+*  @param [in]  pMsg        Requests, seqNum and flags are filled (pid is not used).
+*  @param [in]  num         Number of requests.
+*  @param [in]  timeout     Timeout in milliseconds (0 is COMM_NETLINK_TIMEOUT).
+*  @param [in]  pReplyFunc  Reply callback function.
+*  @param [in]  pArg        Reply callback argument.
+*  @returns  Number of sent requests (-1 is failed).
+*/
+int comm_netlinkRequest(
+    tNetlinkHandle   handle,
+    tNetlinkMsg     *pMsg,
+    int              num,
+    unsigned int     timeout,
+    tNetlinkReplyCb  pReplyFunc,
+    void            *pArg
+)
+{
+    tNetlinkContext *pContext = (tNetlinkContext *)handle;
+    tNetlinkTrans trans;
+    int sent = 0;
+    int count;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: netlink socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pContext->pTrans)
+    {
+        LOG_WARN("%s: transactions are not enabled\n", __func__);
+        return -1;
+    }
+
+    if ((NULL == pMsg) || (NULL == pReplyFunc))
+    {
+        LOG_WARN("%s: pMsg or pReplyFunc is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    if (0 == timeout)
+    {
+        timeout = COMM_NETLINK_TIMEOUT;
+    }
+
+    while (sent < num)
+    {
+        for (count=0; (count < COMM_NETLINK_BATCH_NUM) && ((sent + count) < num); count++)
+        {
+            i = sent + count;
+            if (_netlinkTransAdd(
+                    pContext,
+                    pReplyFunc,
+                    pArg,
+                    timeout,
+                    &(pMsg[i].seqNum)
+                ) != 0)
+            {
+                LOG_2("%s: %d transactions are outstanding\n", __func__, NETLINK_TRANS_NUM);
+                break;
+            }
+            pMsg[i].flags |= (NLM_F_REQUEST | NLM_F_ACK);
+            LOG_DUMP("netlink request", pMsg[i].pData, pMsg[i].size);
+        }
+
+        if (0 == count)
+        {
+            break;
+        }
+
+        if (_netlinkSendMsg(pContext, (pMsg + sent), count) < 0)
+        {
+            /* nothing of this sendmsg() reached the kernel */
+            for (i=sent; i<(sent + count); i++)
+            {
+                _netlinkTransGet(pContext, pMsg[i].seqNum, 1, &trans);
+            }
+            break;
+        }
+        sent += count;
+
+        if (count < COMM_NETLINK_BATCH_NUM)
+        {
+            break;
+        }
+    }
+
+    LOG_3("-> %d netlink requests\n", sent);
+    return ((sent > 0) ? sent : -1);
+}
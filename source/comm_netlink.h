@@ -0,0 +1,41 @@
+#ifndef __COMM_NETLINK_H__
+#define __COMM_NETLINK_H__
+
+#include "comm_if.h"
+
+
+/**
+*  Initialize netlink with the transactions on its own receiving thread,
+*  even if a reactor is selected. It is for the library's long-lived
+*  handles, which must not keep a reactor from being un-initialized.
+*  @param [in]  protocol    Netlink protocol (NETLINK_ROUTE, ...).
+*  @param [in]  pBatchFunc  Batch callback function (may be NULL).
+*  @param [in]  pExitFunc   Exit callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Netlink handle.
+*/
+tNetlinkHandle comm_netlinkInitTransThread(
+                   int              protocol,
+                   tNetlinkBatchCb  pBatchFunc,
+                   tNetlinkExitCb   pExitFunc,
+                   void            *pArg
+               );
+
+/**
+*  Overflow callback, the messages lost by a full receive buffer (e.g.
+*  notifications) must be fetched again.
+*  @param [in]  pArg  Callback argument.
+*/
+typedef void (*tNetlinkOverflowCb)(void *pArg);
+
+/**
+*  Set the overflow callback of a netlink handle, it is called on the
+*  receiving thread like the batch callback.
+*  @param [in]  handle          Netlink handle.
+*  @param [in]  pOverflowFunc  Overflow callback function (NULL is none).
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_netlinkSetOverflow(tNetlinkHandle handle, tNetlinkOverflowCb pOverflowFunc);
+
+
+#endif /* __COMM_NETLINK_H__ */
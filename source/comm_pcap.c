@@ -0,0 +1,1022 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_pcap.h"
+
+
+/* Smallest ring, a record takes a quarter of the ring at most */
+#define PCAP_RING_MIN_SIZE  (64 * 1024)
+
+/* Wait of a tap change for the producers */
+#define PCAP_DRAIN_USEC  (100)
+
+/* stdio buffer of the capture file */
+#define PCAP_FILE_BUF_SIZE  (256 * 1024)
+
+/* pcapng block types */
+#define PCAPNG_SHB  (0x0A0D0D0A)
+#define PCAPNG_IDB  (0x00000001)
+#define PCAPNG_EPB  (0x00000006)
+
+#define PCAPNG_BYTE_ORDER  (0x1A2B3C4D)
+
+/* pcapng option codes */
+#define PCAPNG_OPT_END         (0)
+#define PCAPNG_OPT_IF_NAME     (2)
+#define PCAPNG_OPT_IF_TSRESOL  (9)
+#define PCAPNG_OPT_EPB_FLAGS   (2)
+
+/* epb_flags direction */
+#define PCAPNG_FLAG_INBOUND   (0x1)
+#define PCAPNG_FLAG_OUTBOUND  (0x2)
+
+/* Record of the bytes skipped at the end of the ring */
+#define PCAP_REC_SKIP  (0xFFFF)
+
+#define PCAP_ALIGN(size, n)  (((size) + ((n) - 1)) & ~((size_t)(n) - 1))
+
+
+/* Message record in the ring, followed by the captured bytes */
+typedef struct _tPcapRec
+{
+    uint32_t  len;  /* record bytes, stored last (0 is not committed) */
+    uint16_t  ifId;
+    uint16_t  outbound;
+    uint32_t  capLen;
+    uint32_t  origLen;
+    uint64_t  time;  /* nanoseconds since the Epoch */
+} tPcapRec;
+
+typedef struct _tPcapContext
+{
+    tCommPcap        cfg;
+    char            *pPath;
+
+    /* ring of the records, the ring bytes are zero where nothing is reserved */
+    unsigned char   *pRing;
+    size_t           ringSize;  /* power of 2 */
+    size_t           head __attribute__((aligned(64)));  /* reserved by the producers */
+    unsigned long    drops;
+    size_t           tail __attribute__((aligned(64)));  /* released by the writer */
+    unsigned long    packets;
+
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;      /* wakes up the writer, with the mutex */
+    int              sleeping;  /* the writer waits for a record */
+    tPcapIf         *pIf[PCAP_IF_MAX];
+    int              ifNum;
+
+    /* the current file, used by the writer thread only */
+    FILE            *pFile;
+    unsigned int     fileIndex;
+    size_t           fileSize;
+    time_t           fileTime;
+    int              fileIf[PCAP_IF_MAX];  /* interface ID in the file (-1 is not written) */
+    int              fileIfNum;
+
+    pthread_t        thread;
+    int              running;
+} tPcapContext;
+
+
+/**
+*  Put a 16-bit value in the host byte order.
+*  @param [in]  pBuf   Block buffer.
+*  @param [in]  value  Value.
+*  @returns  Next byte of the block.
+*/
+static unsigned char *_pcapPut16(unsigned char *pBuf, uint16_t value)
+{
+    memcpy(pBuf, &value, sizeof( value ));
+    return (pBuf + sizeof( value ));
+}
+
+/**
+*  Put a 32-bit value in the host byte order.
+*  @param [in]  pBuf   Block buffer.
+*  @param [in]  value  Value.
+*  @returns  Next byte of the block.
+*/
+static unsigned char *_pcapPut32(unsigned char *pBuf, uint32_t value)
+{
+    memcpy(pBuf, &value, sizeof( value ));
+    return (pBuf + sizeof( value ));
+}
+
+/**
+*  Write bytes to the capture file.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @param [in]  pData     Data.
+*  @param [in]  size      Data size.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _pcapWrite(tPcapContext *pContext, void *pData, size_t size)
+{
+    if (fwrite(pData, 1, size, pContext->pFile) != size)
+    {
+        perror( "fwrite" );
+        return -1;
+    }
+
+    pContext->fileSize += size;
+    return 0;
+}
+
+/**
+*  Close the capture file.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*/
+static void _pcapCloseFile(tPcapContext *pContext)
+{
+    if ( pContext->pFile )
+    {
+        fclose( pContext->pFile );
+        pContext->pFile = NULL;
+    }
+}
+
+/**
+*  Open the next capture file and write its section header block. The
+*  rotated files are named <path>.0, <path>.1, ...
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _pcapOpenFile(tPcapContext *pContext)
+{
+    unsigned char block[32];
+    unsigned char *pBuf = block;
+    char path[PATH_MAX];
+    int64_t sectionLen = -1;
+    int i;
+
+
+    if ((pContext->cfg.maxSize > 0) || (pContext->cfg.maxTime > 0))
+    {
+        snprintf(path, PATH_MAX, "%s.%u", pContext->pPath, pContext->fileIndex);
+
+        if ((pContext->cfg.maxFiles > 0) &&
+            (pContext->fileIndex >= pContext->cfg.maxFiles))
+        {
+            char oldPath[PATH_MAX];
+
+            snprintf(
+                oldPath,
+                PATH_MAX,
+                "%s.%u",
+                pContext->pPath,
+                (pContext->fileIndex - pContext->cfg.maxFiles)
+            );
+            unlink( oldPath );
+        }
+    }
+    else
+    {
+        snprintf(path, PATH_MAX, "%s", pContext->pPath);
+    }
+
+    pContext->pFile = fopen(path, "wb");
+    if (NULL == pContext->pFile)
+    {
+        perror( "fopen" );
+        LOG_ERROR("fail to open capture file %s\n", path);
+        return -1;
+    }
+
+    setvbuf(pContext->pFile, NULL, _IOFBF, PCAP_FILE_BUF_SIZE);
+
+    pContext->fileIndex++;
+    pContext->fileSize = 0;
+    pContext->fileTime = time( NULL );
+    for (i=0; i<PCAP_IF_MAX; i++)
+    {
+        pContext->fileIf[i] = -1;
+    }
+    pContext->fileIfNum = 0;
+
+    /* section header block without options */
+    pBuf = _pcapPut32(pBuf, PCAPNG_SHB);
+    pBuf = _pcapPut32(pBuf, 28);
+    pBuf = _pcapPut32(pBuf, PCAPNG_BYTE_ORDER);
+    pBuf = _pcapPut16(pBuf, 1);
+    pBuf = _pcapPut16(pBuf, 0);
+    memcpy(pBuf, &sectionLen, sizeof( sectionLen ));
+    pBuf += sizeof( sectionLen );
+    pBuf = _pcapPut32(pBuf, 28);
+
+    if (_pcapWrite(pContext, block, (pBuf - block)) != 0)
+    {
+        _pcapCloseFile( pContext );
+        return -1;
+    }
+
+    LOG_2("capture file %s is opened\n", path);
+    return 0;
+}
+
+/**
+*  Write the interface description block of an interface to the current
+*  file when the interface is first used in the file.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @param [in]  ifId      Interface ID of the capture.
+*  @returns  Interface ID in the file (-1 is failed).
+*/
+static int _pcapFileIf(tPcapContext *pContext, int ifId)
+{
+    unsigned char block[128];
+    unsigned char *pBuf = block;
+    tPcapIf *pIf = pContext->pIf[ifId];
+    size_t nameLen = strlen( pIf->name );
+    size_t blockLen;
+
+
+    if (pContext->fileIf[ifId] >= 0)
+    {
+        return pContext->fileIf[ifId];
+    }
+
+    /* header, if_name, if_tsresol (nanoseconds), end of options, trailer */
+    blockLen = 16 + (4 + PCAP_ALIGN(nameLen, 4)) + 8 + 4 + 4;
+
+    memset(block, 0x00, sizeof( block ));
+    pBuf = _pcapPut32(pBuf, PCAPNG_IDB);
+    pBuf = _pcapPut32(pBuf, blockLen);
+    pBuf = _pcapPut16(pBuf, pIf->linkType);
+    pBuf = _pcapPut16(pBuf, 0);
+    pBuf = _pcapPut32(pBuf, pContext->cfg.snapLen);
+    pBuf = _pcapPut16(pBuf, PCAPNG_OPT_IF_NAME);
+    pBuf = _pcapPut16(pBuf, nameLen);
+    memcpy(pBuf, pIf->name, nameLen);
+    pBuf += PCAP_ALIGN(nameLen, 4);
+    pBuf = _pcapPut16(pBuf, PCAPNG_OPT_IF_TSRESOL);
+    pBuf = _pcapPut16(pBuf, 1);
+    *pBuf = 9;
+    pBuf += 4;
+    pBuf = _pcapPut32(pBuf, PCAPNG_OPT_END);
+    pBuf = _pcapPut32(pBuf, blockLen);
+
+    if (_pcapWrite(pContext, block, blockLen) != 0)
+    {
+        return -1;
+    }
+
+    pContext->fileIf[ifId] = pContext->fileIfNum++;
+    return pContext->fileIf[ifId];
+}
+
+/**
+*  Write a record to the capture file as an enhanced packet block, the
+*  file is rotated first if it is over the size or the time limit.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @param [in]  pRec      A @ref tPcapRec object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _pcapWriteRec(tPcapContext *pContext, tPcapRec *pRec)
+{
+    static const unsigned char zero[4] = { 0 };
+    unsigned char block[28];
+    unsigned char trailer[16];
+    unsigned char *pBuf;
+    size_t blockLen;
+    int fileIf;
+
+
+    /* header, packet data, epb_flags, end of options, trailer */
+    blockLen = 28 + PCAP_ALIGN(pRec->capLen, 4) + 8 + 4 + 4;
+
+    if ((pContext->fileSize > 0) &&
+        (((pContext->cfg.maxSize > 0) &&
+          (pContext->fileSize + blockLen > pContext->cfg.maxSize)) ||
+         ((pContext->cfg.maxTime > 0) &&
+          (time( NULL ) >= pContext->fileTime + pContext->cfg.maxTime))))
+    {
+        _pcapCloseFile( pContext );
+        if (_pcapOpenFile( pContext ) != 0)
+        {
+            return -1;
+        }
+    }
+
+    fileIf = _pcapFileIf(pContext, pRec->ifId);
+    if (fileIf < 0)
+    {
+        return -1;
+    }
+
+    pBuf = block;
+    pBuf = _pcapPut32(pBuf, PCAPNG_EPB);
+    pBuf = _pcapPut32(pBuf, blockLen);
+    pBuf = _pcapPut32(pBuf, fileIf);
+    pBuf = _pcapPut32(pBuf, (pRec->time >> 32));
+    pBuf = _pcapPut32(pBuf, (pRec->time & 0xFFFFFFFF));
+    pBuf = _pcapPut32(pBuf, pRec->capLen);
+    pBuf = _pcapPut32(pBuf, pRec->origLen);
+
+    pBuf = trailer;
+    pBuf = _pcapPut16(pBuf, PCAPNG_OPT_EPB_FLAGS);
+    pBuf = _pcapPut16(pBuf, 4);
+    pBuf = _pcapPut32(
+               pBuf,
+               (( pRec->outbound ) ? PCAPNG_FLAG_OUTBOUND : PCAPNG_FLAG_INBOUND)
+           );
+    pBuf = _pcapPut32(pBuf, PCAPNG_OPT_END);
+    pBuf = _pcapPut32(pBuf, blockLen);
+
+    if ((_pcapWrite(pContext, block, sizeof( block )) != 0) ||
+        (_pcapWrite(pContext, (pRec + 1), pRec->capLen) != 0) ||
+        (_pcapWrite(pContext, (void *)zero, (PCAP_ALIGN(pRec->capLen, 4) - pRec->capLen)) != 0) ||
+        (_pcapWrite(pContext, trailer, sizeof( trailer )) != 0))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Write the committed records of the ring to the capture file.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @returns  Number of records.
+*/
+static int _pcapDrain(tPcapContext *pContext)
+{
+    size_t mask = pContext->ringSize - 1;
+    size_t tail = pContext->tail;
+    tPcapRec *pRec;
+    uint32_t len;
+    int num = 0;
+
+
+    for (;;)
+    {
+        pRec = (tPcapRec *)(pContext->pRing + (tail & mask));
+        len = __atomic_load_n(&(pRec->len), __ATOMIC_ACQUIRE);
+        if (0 == len)
+        {
+            break;
+        }
+
+        if (pRec->ifId != PCAP_REC_SKIP)
+        {
+            if ((pContext->pFile) && (_pcapWriteRec(pContext, pRec) == 0))
+            {
+                __atomic_fetch_add(&(pContext->packets), 1, __ATOMIC_RELAXED);
+            }
+            else
+            {
+                if ( pContext->pFile )
+                {
+                    LOG_ERROR("fail to write capture file, stop writing\n");
+                    _pcapCloseFile( pContext );
+                }
+                __atomic_fetch_add(&(pContext->drops), 1, __ATOMIC_RELAXED);
+            }
+            num++;
+        }
+
+        /* a record header must read zero until it is committed */
+        memset(pRec, 0x00, len);
+        tail += len;
+        __atomic_store_n(&(pContext->tail), tail, __ATOMIC_RELEASE);
+    }
+
+    return num;
+}
+
+/**
+*  Check if the writer has a committed record to write.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @returns  Pending(1) or empty(0).
+*/
+static int _pcapPending(tPcapContext *pContext)
+{
+    size_t mask = pContext->ringSize - 1;
+    tPcapRec *pRec = (tPcapRec *)(pContext->pRing + (pContext->tail & mask));
+
+    return (__atomic_load_n(&(pRec->len), __ATOMIC_SEQ_CST) != 0);
+}
+
+/**
+*  Wake up the writer if it waits for a record.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*/
+static void _pcapWakeup(tPcapContext *pContext)
+{
+    /* pairs with the writer's flag store before it checks the ring */
+    __atomic_thread_fence( __ATOMIC_SEQ_CST );
+    if ( __atomic_load_n(&(pContext->sleeping), __ATOMIC_RELAXED) )
+    {
+        pthread_mutex_lock( &(pContext->mutex) );
+        pthread_cond_signal( &(pContext->cond) );
+        pthread_mutex_unlock( &(pContext->mutex) );
+    }
+}
+
+/**
+*  Thread function of the capture file writing.
+*  @param [in]  pArg  A @ref tPcapContext object.
+*/
+static void *_pcapWriteTask(void *pArg)
+{
+    tPcapContext *pContext = pArg;
+
+
+    LOG_2("start the thread: %s\n", __func__);
+
+    while ( pContext->running )
+    {
+        if (_pcapDrain( pContext ) > 0)
+        {
+            continue;
+        }
+
+        if ( pContext->pFile )
+        {
+            fflush( pContext->pFile );
+        }
+
+        /* a producer sees the flag or the writer sees its record */
+        pthread_mutex_lock( &(pContext->mutex) );
+        __atomic_store_n(&(pContext->sleeping), 1, __ATOMIC_SEQ_CST);
+        if (( pContext->running ) && ( !_pcapPending( pContext ) ))
+        {
+            pthread_cond_wait(&(pContext->cond), &(pContext->mutex));
+        }
+        __atomic_store_n(&(pContext->sleeping), 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock( &(pContext->mutex) );
+    }
+
+    /* the handles are not tapped any more */
+    _pcapDrain( pContext );
+
+    LOG_2("stop the thread: %s\n", __func__);
+    pthread_exit(NULL);
+}
+
+/**
+*  Reserve a record in the ring. A record that would cross the end of the
+*  ring starts from the beginning, and the bytes left at the end are
+*  reserved as a skip record.
+*  @param [in]  pContext  A @ref tPcapContext object.
+*  @param [in]  len       Record bytes.
+*  @returns  A @ref tPcapRec object (NULL is a full ring).
+*/
+static tPcapRec *_pcapReserve(tPcapContext *pContext, size_t len)
+{
+    size_t mask = pContext->ringSize - 1;
+    size_t head;
+    size_t skip;
+    tPcapRec *pRec;
+
+
+    head = __atomic_load_n(&(pContext->head), __ATOMIC_RELAXED);
+    do
+    {
+        skip = (((head & mask) + len) > pContext->ringSize) ?
+               (pContext->ringSize - (head & mask)) : 0;
+
+        if ((head + skip + len - __atomic_load_n(&(pContext->tail), __ATOMIC_ACQUIRE)) >
+            pContext->ringSize)
+        {
+            __atomic_fetch_add(&(pContext->drops), 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+    } while ( !__atomic_compare_exchange_n(
+                   &(pContext->head),
+                   &head,
+                   (head + skip + len),
+                   1,
+                   __ATOMIC_RELAXED,
+                   __ATOMIC_RELAXED
+               ) );
+
+    if (skip > 0)
+    {
+        pRec = (tPcapRec *)(pContext->pRing + (head & mask));
+        pRec->ifId = PCAP_REC_SKIP;
+        __atomic_store_n(&(pRec->len), skip, __ATOMIC_RELEASE);
+        head += skip;
+    }
+
+    return (tPcapRec *)(pContext->pRing + (head & mask));
+}
+
+
+/**
+*  Count a producer in a handle's tap and load the interface, the interface
+*  is not freed until the producer leaves.
+*  @param [in]   pTap    A @ref tPcapTap object of the handle.
+*  @param [out]  pPhase  Phase the producer is counted in.
+*  @returns  A @ref tPcapIf object (NULL is not tapped).
+*/
+static tPcapIf *_pcapTapEnter(tPcapTap *pTap, int *pPhase)
+{
+    /* counted before the load, which pairs with the store of comm_pcapSetTap */
+    *pPhase = __atomic_load_n(&(pTap->phase), __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&(pTap->users[*pPhase]), 1, __ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&(pTap->pIf), __ATOMIC_SEQ_CST);
+}
+
+/**
+*  Un-count a producer in a handle's tap.
+*  @param [in]  pTap   A @ref tPcapTap object of the handle.
+*  @param [in]  phase  Phase the producer is counted in.
+*/
+static void _pcapTapLeave(tPcapTap *pTap, int phase)
+{
+    __atomic_fetch_sub(&(pTap->users[phase]), 1, __ATOMIC_RELEASE);
+}
+
+/**
+*  Add the interface of a tapped handle to the capture. The interface lives
+*  until the capture is un-initialized, and a handle tapped again gets the
+*  same interface back.
+*  @param [in]  handle    Capture handle.
+*  @param [in]  linkType  Link type of the interface.
+*  @param [in]  pName     Interface name.
+*  @param [in]  pOwner    The tapped handle.
+*  @returns  A @ref tPcapIf object (NULL is failed).
+*/
+tPcapIf *comm_pcapAddIf(
+    tPcapHandle   handle,
+    int           linkType,
+    char         *pName,
+    void         *pOwner
+)
+{
+    tPcapContext *pContext = (tPcapContext *)handle;
+    tPcapIf *pIf = NULL;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return NULL;
+    }
+
+    pthread_mutex_lock( &(pContext->mutex) );
+
+    /* the same handle writes one interface description block only */
+    for (i=0; i<pContext->ifNum; i++)
+    {
+        pIf = pContext->pIf[i];
+        if ((pIf->pOwner == pOwner) &&
+            (pIf->linkType == linkType) &&
+            (0 == strncmp(pIf->name, pName, (sizeof( pIf->name ) - 1))))
+        {
+            goto _DONE;
+        }
+    }
+    pIf = NULL;
+
+    if (pContext->ifNum >= PCAP_IF_MAX)
+    {
+        LOG_ERROR("too many capture interfaces\n");
+        goto _DONE;
+    }
+
+    pIf = malloc( sizeof( tPcapIf ) );
+    if (NULL == pIf)
+    {
+        LOG_ERROR("fail to allocate capture interface\n");
+        goto _DONE;
+    }
+
+    memset(pIf, 0x00, sizeof( tPcapIf ));
+    pIf->pContext = pContext;
+    pIf->pOwner = pOwner;
+    pIf->id = pContext->ifNum;
+    pIf->linkType = linkType;
+    strncpy(pIf->name, pName, sizeof( pIf->name ) - 1);
+
+    pContext->pIf[pContext->ifNum++] = pIf;
+
+_DONE:
+    pthread_mutex_unlock( &(pContext->mutex) );
+    return pIf;
+}
+
+/**
+*  Copy a message to the capture ring without blocking, the message is
+*  dropped if the ring is full or the handle is not tapped.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  pHdr      Synthesized header in front of the message.
+*  @param [in]  hdrSize   Header size.
+*  @param [in]  pIov      Message buffers.
+*  @param [in]  num       Number of message buffers.
+*/
+void comm_pcapWritev(
+    tPcapTap      *pTap,
+    int            outbound,
+    void          *pHdr,
+    size_t         hdrSize,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    tPcapContext *pContext;
+    tPcapIf *pIf;
+    struct timespec now;
+    unsigned char *pData;
+    size_t origLen = hdrSize;
+    size_t capLen;
+    size_t len;
+    tPcapRec *pRec;
+    int phase;
+    int i;
+
+
+    /* the interface and its capture live until the producer leaves */
+    pIf = _pcapTapEnter(pTap, &phase);
+    if (NULL == pIf)
+    {
+        goto _DONE;
+    }
+    pContext = pIf->pContext;
+
+    for (i=0; i<num; i++)
+    {
+        origLen += pIov[i].iov_len;
+    }
+
+    capLen = (origLen > pContext->cfg.snapLen) ? pContext->cfg.snapLen : origLen;
+
+    pRec = _pcapReserve(pContext, PCAP_ALIGN(sizeof( tPcapRec ) + capLen, 8));
+    if (NULL == pRec)
+    {
+        goto _DONE;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    pRec->ifId = pIf->id;
+    pRec->outbound = outbound;
+    pRec->capLen = capLen;
+    pRec->origLen = (origLen > UINT32_MAX) ? UINT32_MAX : origLen;
+    pRec->time = ((uint64_t)now.tv_sec * 1000000000ULL) + now.tv_nsec;
+
+    pData = (unsigned char *)(pRec + 1);
+
+    if (hdrSize > 0)
+    {
+        len = (hdrSize > capLen) ? capLen : hdrSize;
+        memcpy(pData, pHdr, len);
+        pData += len;
+        capLen -= len;
+    }
+
+    for (i=0; (i<num) && (capLen > 0); i++)
+    {
+        len = (pIov[i].iov_len > capLen) ? capLen : pIov[i].iov_len;
+        memcpy(pData, pIov[i].iov_base, len);
+        pData += len;
+        capLen -= len;
+    }
+
+    /* commit the record to the writer */
+    __atomic_store_n(
+        &(pRec->len),
+        PCAP_ALIGN(sizeof( tPcapRec ) + pRec->capLen, 8),
+        __ATOMIC_RELEASE
+    );
+    _pcapWakeup( pContext );
+
+_DONE:
+    _pcapTapLeave(pTap, phase);
+}
+
+/**
+*  Copy a UDP datagram to the capture ring with synthesized IP and UDP
+*  headers. The local address is the unspecified one of the peer's family.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  portNum   Local UDP port number.
+*  @param [in]  pPeer     Peer's address (struct sockaddr_in or sockaddr_in6).
+*  @param [in]  pIov      Datagram buffers.
+*  @param [in]  num       Number of datagram buffers.
+*/
+void comm_pcapWriteUdp(
+    tPcapTap         *pTap,
+    int               outbound,
+    unsigned short    portNum,
+    struct sockaddr  *pPeer,
+    struct iovec     *pIov,
+    int               num
+)
+{
+    unsigned char hdr[sizeof( struct ip6_hdr ) + sizeof( struct udphdr )];
+    struct udphdr *pUdp;
+    unsigned short peerPort;
+    size_t udpLen = sizeof( struct udphdr );
+    size_t ipLen;
+    int i;
+
+
+    for (i=0; i<num; i++)
+    {
+        udpLen += pIov[i].iov_len;
+    }
+
+    memset(hdr, 0x00, sizeof( hdr ));
+
+    if (AF_INET6 == pPeer->sa_family)
+    {
+        struct sockaddr_in6 *pAddr = (struct sockaddr_in6 *)pPeer;
+        struct ip6_hdr *pIp = (struct ip6_hdr *)hdr;
+
+        pIp->ip6_flow = htonl(6 << 28);
+        pIp->ip6_plen = htons( (udpLen > 0xFFFF) ? 0xFFFF : udpLen );
+        pIp->ip6_nxt  = IPPROTO_UDP;
+        pIp->ip6_hlim = 64;
+        if ( outbound )
+        {
+            pIp->ip6_dst = pAddr->sin6_addr;
+        }
+        else
+        {
+            pIp->ip6_src = pAddr->sin6_addr;
+        }
+
+        peerPort = pAddr->sin6_port;
+        ipLen = sizeof( struct ip6_hdr );
+    }
+    else
+    {
+        struct sockaddr_in *pAddr = (struct sockaddr_in *)pPeer;
+        struct iphdr *pIp = (struct iphdr *)hdr;
+        unsigned short *pWord = (unsigned short *)hdr;
+        unsigned int sum = 0;
+
+        ipLen = sizeof( struct iphdr );
+
+        pIp->version  = 4;
+        pIp->ihl      = (ipLen >> 2);
+        pIp->tot_len  = htons( ((ipLen + udpLen) > 0xFFFF) ? 0xFFFF : (ipLen + udpLen) );
+        pIp->ttl      = 64;
+        pIp->protocol = IPPROTO_UDP;
+        if ( outbound )
+        {
+            pIp->daddr = pAddr->sin_addr.s_addr;
+        }
+        else
+        {
+            pIp->saddr = pAddr->sin_addr.s_addr;
+        }
+
+        for (i=0; i<(int)(ipLen >> 1); i++)
+        {
+            sum += pWord[i];
+        }
+        sum = (sum >> 16) + (sum & 0xFFFF);
+        sum += (sum >> 16);
+        pIp->check = ~sum;
+
+        peerPort = pAddr->sin_port;
+    }
+
+    /* zero checksum is not computed */
+    pUdp = (struct udphdr *)(hdr + ipLen);
+    pUdp->uh_sport = ( outbound ) ? htons( portNum ) : peerPort;
+    pUdp->uh_dport = ( outbound ) ? peerPort : htons( portNum );
+    pUdp->uh_ulen  = htons( (udpLen > 0xFFFF) ? 0xFFFF : udpLen );
+
+    comm_pcapWritev(pTap, outbound, hdr, (ipLen + sizeof( struct udphdr )), pIov, num);
+}
+
+/**
+*  Copy a message of a connection to the capture ring, prefixed by the
+*  connection ID in big-endian.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  connId    Connection ID (0 is the only connection).
+*  @param [in]  pIov      Message buffers.
+*  @param [in]  num       Number of message buffers.
+*/
+void comm_pcapWriteConn(
+    tPcapTap      *pTap,
+    int            outbound,
+    unsigned int   connId,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    uint32_t hdr = htonl( connId );
+
+    comm_pcapWritev(pTap, outbound, &hdr, sizeof( hdr ), pIov, num);
+}
+
+/**
+*  Set the interface of a handle's tap. It returns when no producer uses the
+*  previous interface, and the capture is un-initialized after the taps of
+*  all the handles are removed.
+*  @param [in]  pTap  A @ref tPcapTap object of the handle.
+*  @param [in]  pIf   A @ref tPcapIf object (NULL removes the tap).
+*/
+void comm_pcapSetTap(tPcapTap *pTap, tPcapIf *pIf)
+{
+    int phase;
+    int i;
+
+    __atomic_store_n(&(pTap->pIf), pIf, __ATOMIC_SEQ_CST);
+
+    /*
+    * A producer of the previous interface was counted before the store, it
+    * is gone once each phase is seen empty. The new producers are counted
+    * in the other phase, so a busy handle does not keep the wait going.
+    */
+    for (i=0; i<2; i++)
+    {
+        phase = __atomic_load_n(&(pTap->phase), __ATOMIC_SEQ_CST);
+        __atomic_store_n(&(pTap->phase), !phase, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&(pTap->users[phase]), __ATOMIC_ACQUIRE) > 0)
+        {
+            usleep( PCAP_DRAIN_USEC );
+        }
+    }
+}
+
+/**
+*  Initialize a pcapng capture. The tapped handles copy their messages to
+*  a lock-free ring and a background thread writes them to the file.
+*  @param [in]  pPath  Capture file path.
+*  @param [in]  pCfg   A @ref tCommPcap object (NULL is the default).
+*  @returns  Capture handle.
+*/
+tPcapHandle comm_pcapInit(char *pPath, tCommPcap *pCfg)
+{
+    tPcapContext *pContext = NULL;
+    pthread_attr_t tattr;
+    size_t ringSize;
+    int error;
+
+
+    if ((NULL == pPath) || ('\0' == pPath[0]))
+    {
+        LOG_WARN("%s: no capture file\n", __func__);
+        return 0;
+    }
+
+    pContext = malloc( sizeof( tPcapContext ) );
+    if (NULL == pContext)
+    {
+        LOG_ERROR("fail to allocate capture context\n");
+        return 0;
+    }
+
+    memset(pContext, 0x00, sizeof( tPcapContext ));
+    if ( pCfg )
+    {
+        pContext->cfg = *pCfg;
+    }
+
+    ringSize = ( pContext->cfg.ringSize ) ? pContext->cfg.ringSize : COMM_PCAP_RING_SIZE;
+    pContext->ringSize = PCAP_RING_MIN_SIZE;
+    while (pContext->ringSize < ringSize)
+    {
+        pContext->ringSize <<= 1;
+    }
+    pContext->cfg.ringSize = pContext->ringSize;
+
+    if ((0 == pContext->cfg.snapLen) ||
+        (pContext->cfg.snapLen > COMM_PCAP_SNAP_LEN))
+    {
+        pContext->cfg.snapLen = COMM_PCAP_SNAP_LEN;
+    }
+    if (pContext->cfg.snapLen > ((pContext->ringSize >> 2) - sizeof( tPcapRec )))
+    {
+        pContext->cfg.snapLen = ((pContext->ringSize >> 2) - sizeof( tPcapRec ));
+    }
+
+    pContext->pPath = strdup( pPath );
+    pContext->pRing = malloc( pContext->ringSize );
+    if ((NULL == pContext->pPath) || (NULL == pContext->pRing))
+    {
+        LOG_ERROR("fail to allocate capture ring\n");
+        free( pContext->pPath );
+        free( pContext->pRing );
+        free( pContext );
+        return 0;
+    }
+
+    memset(pContext->pRing, 0x00, pContext->ringSize);
+    pthread_mutex_init(&(pContext->mutex), NULL);
+    pthread_cond_init(&(pContext->cond), NULL);
+
+    if (_pcapOpenFile( pContext ) != 0)
+    {
+        pthread_cond_destroy( &(pContext->cond) );
+        pthread_mutex_destroy( &(pContext->mutex) );
+        free( pContext->pPath );
+        free( pContext->pRing );
+        free( pContext );
+        return 0;
+    }
+
+    pContext->running = 1;
+
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+
+    error = pthread_create(
+                &(pContext->thread),
+                &tattr,
+                _pcapWriteTask,
+                pContext
+            );
+    if (error != 0)
+    {
+        LOG_ERROR("fail to create capture writing thread\n");
+        _pcapCloseFile( pContext );
+        pthread_cond_destroy( &(pContext->cond) );
+        pthread_mutex_destroy( &(pContext->mutex) );
+        free( pContext->pPath );
+        free( pContext->pRing );
+        free( pContext );
+        return 0;
+    }
+
+    pthread_attr_destroy( &tattr );
+
+    LOG_1("capture initialized (%s)\n", pPath);
+    return ((tPcapHandle)pContext);
+}
+
+/**
+*  Un-initialize a pcapng capture, the captured messages are written first.
+*  The taps of all the handles must be removed first by comm_pcapSetTap,
+*  which waits for the messages still being copied by the handles.
+*  @param [in]  handle  Capture handle.
+*/
+void comm_pcapUninit(tPcapHandle handle)
+{
+    tPcapContext *pContext = (tPcapContext *)handle;
+    int i;
+
+    if ( pContext )
+    {
+        /* every record reserved is committed, no producer is left */
+        pthread_mutex_lock( &(pContext->mutex) );
+        pContext->running = 0;
+        pthread_cond_signal( &(pContext->cond) );
+        pthread_mutex_unlock( &(pContext->mutex) );
+        pthread_join(pContext->thread, NULL);
+
+        _pcapCloseFile( pContext );
+
+        for (i=0; i<pContext->ifNum; i++)
+        {
+            free( pContext->pIf[i] );
+        }
+
+        pthread_cond_destroy( &(pContext->cond) );
+        pthread_mutex_destroy( &(pContext->mutex) );
+        free( pContext->pPath );
+        free( pContext->pRing );
+        free( pContext );
+        LOG_1("capture un-initialized\n");
+    }
+}
+
+/**
+*  Get the statistics of a pcapng capture.
+*  @param [in]   handle    Capture handle.
+*  @param [out]  pPackets  Messages written to the files.
+*  @param [out]  pDrops    Messages dropped by a full ring or a failed file.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_pcapGetStat(
+    tPcapHandle     handle,
+    unsigned long  *pPackets,
+    unsigned long  *pDrops
+)
+{
+    tPcapContext *pContext = (tPcapContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pPackets )
+    {
+        *pPackets = __atomic_load_n(&(pContext->packets), __ATOMIC_RELAXED);
+    }
+    if ( pDrops )
+    {
+        *pDrops = __atomic_load_n(&(pContext->drops), __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#ifndef __COMM_PCAP_H__
+#define __COMM_PCAP_H__
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include "comm_if.h"
+
+
+/* Link types of the tapped handles */
+#define PCAP_LINK_ETHERNET  (1)    /* LINKTYPE_ETHERNET */
+#define PCAP_LINK_RAW       (101)  /* LINKTYPE_RAW, IPv4 or IPv6 packet */
+#define PCAP_LINK_USER0     (147)  /* LINKTYPE_USER0, connection ID and message */
+
+/* Max. interfaces of a capture */
+#define PCAP_IF_MAX  (256)
+
+/* Interface name buffer */
+#define PCAP_IF_NAME_SIZE  (96)
+
+/* Direction of a captured message */
+#define PCAP_IN   (0)
+#define PCAP_OUT  (1)
+
+/* Interface of a tapped handle, owned by the capture */
+typedef struct _tPcapIf
+{
+    struct _tPcapContext  *pContext;
+    void                  *pOwner;  /* the tapped handle */
+    int                    id;
+    int                    linkType;
+    char                   name[PCAP_IF_NAME_SIZE];
+} tPcapIf;
+
+/* Tap slot of a handle, it counts the producers which may use its interface */
+typedef struct _tPcapTap
+{
+    tPcapIf  *pIf;       /* NULL is not tapped */
+    int       phase;     /* users[] counting the new producers */
+    int       users[2];
+} tPcapTap;
+
+
+/**
+*  Add the interface of a tapped handle to the capture. The interface lives
+*  until the capture is un-initialized, and a handle tapped again gets the
+*  same interface back.
+*  @param [in]  handle    Capture handle.
+*  @param [in]  linkType  Link type of the interface.
+*  @param [in]  pName     Interface name.
+*  @param [in]  pOwner    The tapped handle.
+*  @returns  A @ref tPcapIf object (NULL is failed).
+*/
+tPcapIf *comm_pcapAddIf(
+             tPcapHandle   handle,
+             int           linkType,
+             char         *pName,
+             void         *pOwner
+         );
+
+/**
+*  Copy a message to the capture ring without blocking, the message is
+*  dropped if the ring is full or the handle is not tapped.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  pHdr      Synthesized header in front of the message.
+*  @param [in]  hdrSize   Header size.
+*  @param [in]  pIov      Message buffers.
+*  @param [in]  num       Number of message buffers.
+*/
+void comm_pcapWritev(
+         tPcapTap      *pTap,
+         int            outbound,
+         void          *pHdr,
+         size_t         hdrSize,
+         struct iovec  *pIov,
+         int            num
+     );
+
+/**
+*  Copy a UDP datagram to the capture ring with synthesized IP and UDP
+*  headers. The local address is the unspecified one of the peer's family.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  portNum   Local UDP port number.
+*  @param [in]  pPeer     Peer's address (struct sockaddr_in or sockaddr_in6).
+*  @param [in]  pIov      Datagram buffers.
+*  @param [in]  num       Number of datagram buffers.
+*/
+void comm_pcapWriteUdp(
+         tPcapTap         *pTap,
+         int               outbound,
+         unsigned short    portNum,
+         struct sockaddr  *pPeer,
+         struct iovec     *pIov,
+         int               num
+     );
+
+/**
+*  Copy a message of a connection to the capture ring, prefixed by the
+*  connection ID in big-endian.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  connId    Connection ID (0 is the only connection).
+*  @param [in]  pIov      Message buffers.
+*  @param [in]  num       Number of message buffers.
+*/
+void comm_pcapWriteConn(
+         tPcapTap      *pTap,
+         int            outbound,
+         unsigned int   connId,
+         struct iovec  *pIov,
+         int            num
+     );
+
+/**
+*  Set the interface of a handle's tap. It returns when no producer uses the
+*  previous interface, and the capture is un-initialized after the taps of
+*  all the handles are removed.
+*  @param [in]  pTap  A @ref tPcapTap object of the handle.
+*  @param [in]  pIf   A @ref tPcapIf object (NULL removes the tap).
+*/
+void comm_pcapSetTap(tPcapTap *pTap, tPcapIf *pIf);
+
+/**
+*  Check if a handle is tapped, the message is built for the capture only
+*  then. The interface is checked again by the producer.
+*  @param [in]  pTap  A @ref tPcapTap object of the handle.
+*  @returns  Tapped(1) or not(0).
+*/
+#define comm_pcapTapped(pTap) \
+    (NULL != __atomic_load_n(&((pTap)->pIf), __ATOMIC_RELAXED))
+
+
+#endif /* __COMM_PCAP_H__ */
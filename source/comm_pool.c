@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_pool.h"
+
+
+/* Buffers kept by each thread and by the pool for every size class */
+#define POOL_CACHE_NUM (8)
+#define POOL_FREE_NUM  (256)
+
+#define POOL_CLASS_LARGE (-1)
+
+/* Message buffers may point their data into the middle of the storage */
+#define POOL_BUF_HDR(pBuf) ((tPoolHdr *)((char *)(pBuf) - offsetof(tPoolHdr, h.buf)))
+
+
+typedef union _tPoolHdr
+{
+    struct
+    {
+        union _tPoolHdr *pNext;
+        int              cls;
+        unsigned int     size;
+
+        /* message view of the buffer */
+        tCommBuf         buf;
+        int              refCount;
+    } h;
+
+    /* keep the data behind the header aligned */
+    long double  align;
+} tPoolHdr;
+
+typedef struct _tPoolClass
+{
+    unsigned int     size;
+
+    pthread_mutex_t  mutex;
+    tPoolHdr        *pFree;
+    int              freeNum;
+
+    unsigned long    totalNum;
+    unsigned long    usedNum;
+} tPoolClass;
+
+typedef struct _tPoolCache
+{
+    tPoolHdr  *pFree[POOL_CLASS_NUM];
+    int        freeNum[POOL_CLASS_NUM];
+} tPoolCache;
+
+
+static tPoolClass g_poolClass[POOL_CLASS_NUM] = {
+    { .size =   256, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .size =  2048, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .size =  8192, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .size = 65536, .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .mutex = PTHREAD_MUTEX_INITIALIZER },
+    { .mutex = PTHREAD_MUTEX_INITIALIZER }
+};
+static int g_poolClassNum = 4;
+
+static unsigned long g_poolLargeNum = 0;
+static unsigned long g_poolLargeMemory = 0;
+
+static pthread_once_t g_poolOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t  g_poolKey;
+static __thread tPoolCache *t_pPoolCache = NULL;
+
+
+/**
+*  Put a free buffer to the shared list of its size class.
+*  @param [in]  pClass  A @ref tPoolClass object.
+*  @param [in]  pHdr    A @ref tPoolHdr object.
+*/
+static void _poolPut(tPoolClass *pClass, tPoolHdr *pHdr)
+{
+    pthread_mutex_lock( &(pClass->mutex) );
+    if ((pHdr->h.size == pClass->size) && (pClass->freeNum < POOL_FREE_NUM))
+    {
+        pHdr->h.pNext = pClass->pFree;
+        pClass->pFree = pHdr;
+        pClass->freeNum++;
+        pHdr = NULL;
+    }
+    pthread_mutex_unlock( &(pClass->mutex) );
+
+    if ( pHdr )
+    {
+        __sync_fetch_and_sub(&(pClass->totalNum), 1);
+        free( pHdr );
+    }
+}
+
+/**
+*  Give the cached buffers of an exiting thread back to the pool.
+*  @param [in]  pArg  A @ref tPoolCache object.
+*/
+static void _poolCacheFlush(void *pArg)
+{
+    tPoolCache *pCache = pArg;
+    tPoolHdr *pHdr;
+    int i;
+
+    t_pPoolCache = NULL;
+
+    for (i=0; i<POOL_CLASS_NUM; i++)
+    {
+        while ( pCache->pFree[i] )
+        {
+            pHdr = pCache->pFree[i];
+            pCache->pFree[i] = pHdr->h.pNext;
+            _poolPut(&(g_poolClass[i]), pHdr);
+        }
+    }
+
+    free( pCache );
+}
+
+/**
+*  Create the thread-specific key of the buffer caches.
+*/
+static void _poolKeyInit(void)
+{
+    pthread_key_create(&g_poolKey, _poolCacheFlush);
+}
+
+/**
+*  Get the buffer cache of the calling thread.
+*  @returns  A @ref tPoolCache object (NULL is failed).
+*/
+static tPoolCache *_poolCacheGet(void)
+{
+    if (NULL == t_pPoolCache)
+    {
+        pthread_once(&g_poolOnce, _poolKeyInit);
+
+        t_pPoolCache = malloc( sizeof( tPoolCache ) );
+        if ( t_pPoolCache )
+        {
+            memset(t_pPoolCache, 0x00, sizeof( tPoolCache ));
+            pthread_setspecific(g_poolKey, t_pPoolCache);
+        }
+    }
+
+    return t_pPoolCache;
+}
+
+/**
+*  Find the smallest size class of a buffer size.
+*  @param [in]  size  Buffer size.
+*  @returns  Class index (@ref POOL_CLASS_LARGE is none).
+*/
+static int _poolClass(unsigned int size)
+{
+    int i;
+
+    for (i=0; i<g_poolClassNum; i++)
+    {
+        if (size <= g_poolClass[i].size)
+        {
+            return i;
+        }
+    }
+
+    return POOL_CLASS_LARGE;
+}
+
+/**
+*  Take a buffer from the pool.
+*  @param [in]  size  Required buffer size.
+*  @returns  Buffer pointer (NULL is failed).
+*/
+void *comm_poolAlloc(unsigned int size)
+{
+    tPoolCache *pCache;
+    tPoolClass *pClass;
+    tPoolHdr *pHdr = NULL;
+    int cls;
+
+
+    cls = _poolClass( size );
+    if (POOL_CLASS_LARGE == cls)
+    {
+        pHdr = malloc(sizeof( tPoolHdr ) + size);
+        if (NULL == pHdr)
+        {
+            LOG_ERROR("fail to allocate %u bytes buffer\n", size);
+            return NULL;
+        }
+        pHdr->h.cls  = POOL_CLASS_LARGE;
+        pHdr->h.size = size;
+        __sync_fetch_and_add(&g_poolLargeNum, 1);
+        __sync_fetch_and_add(&g_poolLargeMemory, size);
+        return (pHdr + 1);
+    }
+
+    pClass = &(g_poolClass[cls]);
+
+    pCache = _poolCacheGet();
+    if (( pCache ) && ( pCache->pFree[cls] ))
+    {
+        /* fast path without locking */
+        pHdr = pCache->pFree[cls];
+        pCache->pFree[cls] = pHdr->h.pNext;
+        pCache->freeNum[cls]--;
+
+        if (pHdr->h.size != pClass->size)
+        {
+            /* cached before the size classes were changed */
+            __sync_fetch_and_sub(&(pClass->totalNum), 1);
+            free( pHdr );
+            pHdr = NULL;
+        }
+    }
+
+    if (NULL == pHdr)
+    {
+        pthread_mutex_lock( &(pClass->mutex) );
+        if ( pClass->pFree )
+        {
+            pHdr = pClass->pFree;
+            pClass->pFree = pHdr->h.pNext;
+            pClass->freeNum--;
+        }
+        pthread_mutex_unlock( &(pClass->mutex) );
+
+        if (NULL == pHdr)
+        {
+            pHdr = malloc(sizeof( tPoolHdr ) + pClass->size);
+            if (NULL == pHdr)
+            {
+                LOG_ERROR("fail to allocate %u bytes buffer\n", pClass->size);
+                return NULL;
+            }
+            pHdr->h.cls  = cls;
+            pHdr->h.size = pClass->size;
+            __sync_fetch_and_add(&(pClass->totalNum), 1);
+        }
+    }
+
+    pHdr->h.pNext = NULL;
+    __sync_fetch_and_add(&(pClass->usedNum), 1);
+
+    return (pHdr + 1);
+}
+
+/**
+*  Give a buffer back to the pool.
+*  @param [in]  pBuf  Buffer pointer from @ref comm_poolAlloc.
+*/
+void comm_poolFree(void *pBuf)
+{
+    tPoolCache *pCache;
+    tPoolClass *pClass;
+    tPoolHdr *pHdr;
+    int cls;
+
+
+    if (NULL == pBuf)
+    {
+        return;
+    }
+
+    pHdr = ((tPoolHdr *)pBuf) - 1;
+    cls = pHdr->h.cls;
+
+    if (POOL_CLASS_LARGE == cls)
+    {
+        __sync_fetch_and_sub(&g_poolLargeNum, 1);
+        __sync_fetch_and_sub(&g_poolLargeMemory, pHdr->h.size);
+        free( pHdr );
+        return;
+    }
+
+    pClass = &(g_poolClass[cls]);
+    __sync_fetch_and_sub(&(pClass->usedNum), 1);
+
+    if (pHdr->h.size != pClass->size)
+    {
+        /* the size classes were changed */
+        __sync_fetch_and_sub(&(pClass->totalNum), 1);
+        free( pHdr );
+        return;
+    }
+
+    pCache = t_pPoolCache;
+    if (( pCache ) && (pCache->freeNum[cls] < POOL_CACHE_NUM))
+    {
+        pHdr->h.pNext = pCache->pFree[cls];
+        pCache->pFree[cls] = pHdr;
+        pCache->freeNum[cls]++;
+        return;
+    }
+
+    _poolPut(pClass, pHdr);
+}
+
+/**
+*  Get the usable size of a pool buffer.
+*  @param [in]  pBuf  Buffer pointer from @ref comm_poolAlloc.
+*  @returns  Buffer size.
+*/
+unsigned int comm_poolSize(void *pBuf)
+{
+    return (((tPoolHdr *)pBuf) - 1)->h.size;
+}
+
+/**
+*  Set the buffer size classes of the pool, before any handle is created.
+*  @param [in]  pSize  Ascending buffer sizes.
+*  @param [in]  num    Number of size classes (max. @ref POOL_CLASS_NUM).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_poolSetClass(unsigned int *pSize, int num)
+{
+    tPoolHdr *pHdr;
+    int i;
+
+
+    if ((NULL == pSize) || (num <= 0) || (num > POOL_CLASS_NUM))
+    {
+        LOG_ERROR("%s: wrong class number %d\n", __func__, num);
+        return -1;
+    }
+
+    for (i=0; i<num; i++)
+    {
+        if ((0 == pSize[i]) || ((i > 0) && (pSize[i] <= pSize[i-1])))
+        {
+            LOG_ERROR("%s: class sizes must be ascending\n", __func__);
+            return -1;
+        }
+    }
+
+    for (i=0; i<POOL_CLASS_NUM; i++)
+    {
+        pthread_mutex_lock( &(g_poolClass[i].mutex) );
+        while ( g_poolClass[i].pFree )
+        {
+            pHdr = g_poolClass[i].pFree;
+            g_poolClass[i].pFree = pHdr->h.pNext;
+            g_poolClass[i].totalNum--;
+            free( pHdr );
+        }
+        g_poolClass[i].freeNum = 0;
+        g_poolClass[i].size = (i < num) ? pSize[i] : 0;
+        pthread_mutex_unlock( &(g_poolClass[i].mutex) );
+    }
+
+    g_poolClassNum = num;
+
+    LOG_1("pool has %d size classes\n", num);
+    return 0;
+}
+
+/**
+*  Get the memory usage of the pool.
+*  @param [out]  pStat  An array of @ref tPoolStat objects.
+*  @param [in]   num    Array size.
+*  @returns  Number of the filled objects, the last one is the over-sized
+*            buffers (size 0).
+*/
+int comm_poolGetStat(tPoolStat *pStat, int num)
+{
+    int count = 0;
+    int i;
+
+
+    if (NULL == pStat)
+    {
+        LOG_ERROR("%s: pStat is NULL\n", __func__);
+        return -1;
+    }
+
+    for (i=0; (i<g_poolClassNum) && (count<num); i++, count++)
+    {
+        pStat[count].size     = g_poolClass[i].size;
+        pStat[count].totalNum = g_poolClass[i].totalNum;
+        pStat[count].usedNum  = g_poolClass[i].usedNum;
+        pStat[count].memory   = g_poolClass[i].totalNum * g_poolClass[i].size;
+    }
+
+    if (count < num)
+    {
+        pStat[count].size     = 0;
+        pStat[count].totalNum = g_poolLargeNum;
+        pStat[count].usedNum  = g_poolLargeNum;
+        pStat[count].memory   = g_poolLargeMemory;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+*  Get the bytes held by the pool.
+*  @returns  Memory size.
+*/
+unsigned long comm_poolGetMemory(void)
+{
+    unsigned long memory = g_poolLargeMemory;
+    int i;
+
+    for (i=0; i<g_poolClassNum; i++)
+    {
+        memory += (g_poolClass[i].totalNum * g_poolClass[i].size);
+    }
+
+    return memory;
+}
+
+/**
+*  Allocate a reference-counted message buffer from the pool.
+*  @param [in]  capacity  Buffer size.
+*  @returns  A @ref tCommBuf object with one reference (NULL is failed).
+*/
+tCommBuf *comm_bufAlloc(size_t capacity)
+{
+    tPoolHdr *pHdr;
+    void *pData;
+
+
+    if (capacity > UINT_MAX)
+    {
+        LOG_ERROR("%s: capacity %zu is too large\n", __func__, capacity);
+        return NULL;
+    }
+
+    pData = comm_poolAlloc( (unsigned int)capacity );
+    if (NULL == pData)
+    {
+        return NULL;
+    }
+
+    pHdr = ((tPoolHdr *)pData) - 1;
+    pHdr->h.buf.pData    = pData;
+    pHdr->h.buf.size     = 0;
+    pHdr->h.buf.capacity = capacity;
+    pHdr->h.refCount     = 1;
+
+    return &(pHdr->h.buf);
+}
+
+/**
+*  Take one more reference of a message buffer.
+*  @param [in]  pBuf  A @ref tCommBuf object.
+*  @returns  The same @ref tCommBuf object.
+*/
+tCommBuf *comm_bufRetain(tCommBuf *pBuf)
+{
+    if ( pBuf )
+    {
+        __sync_fetch_and_add(&(POOL_BUF_HDR( pBuf )->h.refCount), 1);
+    }
+
+    return pBuf;
+}
+
+/**
+*  Drop one reference of a message buffer, the last one gives it back to
+*  the pool.
+*  @param [in]  pBuf  A @ref tCommBuf object.
+*/
+void comm_bufRelease(tCommBuf *pBuf)
+{
+    if ( pBuf )
+    {
+        tPoolHdr *pHdr = POOL_BUF_HDR( pBuf );
+
+        if (0 == __sync_sub_and_fetch(&(pHdr->h.refCount), 1))
+        {
+            comm_poolFree( pHdr + 1 );
+        }
+    }
+}
+
+/**
+*  Release a message buffer held by a cancelled thread.
+*  @param [in]  pArg  A @ref tCommBuf object.
+*/
+void comm_bufCleanup(void *pArg)
+{
+    comm_bufRelease( (tCommBuf *)pArg );
+}
+
@@ -0,0 +1,34 @@
+#ifndef __COMM_POOL_H__
+#define __COMM_POOL_H__
+
+#include "comm_if.h"
+
+
+/**
+*  Take a buffer from the pool.
+*  @param [in]  size  Required buffer size.
+*  @returns  Buffer pointer (NULL is failed).
+*/
+void *comm_poolAlloc(unsigned int size);
+
+/**
+*  Give a buffer back to the pool.
+*  @param [in]  pBuf  Buffer pointer from @ref comm_poolAlloc.
+*/
+void comm_poolFree(void *pBuf);
+
+/**
+*  Get the usable size of a pool buffer.
+*  @param [in]  pBuf  Buffer pointer from @ref comm_poolAlloc.
+*  @returns  Buffer size.
+*/
+unsigned int comm_poolSize(void *pBuf);
+
+/**
+*  Release a message buffer held by a cancelled thread.
+*  @param [in]  pArg  A @ref tCommBuf object.
+*/
+void comm_bufCleanup(void *pArg);
+
+
+#endif /* __COMM_POOL_H__ */
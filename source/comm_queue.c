@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_frame.h"
+#include "comm_queue.h"
+
+
+#define QUEUE_INIT_SIZE (16)
+
+/* Buffers written by one system call */
+#define QUEUE_IOV_NUM (16)
+
+#ifndef IOV_MAX
+#define IOV_MAX (1024)
+#endif
+
+
+/**
+*  Grow the ring of the pending buffers.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _queueGrow(tSendQueue *pQueue)
+{
+    tCommBuf **ppBuf;
+    int cap;
+    int i;
+
+
+    cap = (pQueue->cap > 0) ? (pQueue->cap << 1) : QUEUE_INIT_SIZE;
+
+    ppBuf = malloc( sizeof( tCommBuf * ) * cap );
+    if (NULL == ppBuf)
+    {
+        LOG_ERROR("fail to grow the send queue to %d buffers\n", cap);
+        return -1;
+    }
+
+    /* unwrap the ring to the front of the new array */
+    for (i=0; i<pQueue->num; i++)
+    {
+        ppBuf[i] = pQueue->ppBuf[(pQueue->head + i) % pQueue->cap];
+    }
+
+    free( pQueue->ppBuf );
+    pQueue->ppBuf = ppBuf;
+    pQueue->cap = cap;
+    pQueue->head = 0;
+
+    return 0;
+}
+
+/**
+*  Append a buffer to the ring.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @param [in]  pBuf    A @ref tCommBuf object owned by the queue afterwards.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _queuePush(tSendQueue *pQueue, tCommBuf *pBuf)
+{
+    if ((pQueue->num == pQueue->cap) && (_queueGrow( pQueue ) != 0))
+    {
+        return -1;
+    }
+
+    pQueue->ppBuf[(pQueue->head + pQueue->num) % pQueue->cap] = pBuf;
+    pQueue->num++;
+    pQueue->bytes += pBuf->size;
+
+    if ((1 == pQueue->num) && comm_reactorAttached( pQueue->pEvent ))
+    {
+        comm_reactorModEvent(pQueue->pEvent, (EPOLLIN | EPOLLOUT));
+    }
+
+    return 0;
+}
+
+/**
+*  Skip the bytes written from the front of a vector.
+*  @param [in]  ppCur  The first unwritten buffer.
+*  @param [in]  pCnt   Number of the unwritten buffers.
+*  @param [in]  len    Written length.
+*/
+static void _queueSkip(struct iovec **ppCur, int *pCnt, size_t len)
+{
+    struct iovec *pCur = *ppCur;
+    int cnt = *pCnt;
+
+    while ((cnt > 0) && (len >= pCur->iov_len))
+    {
+        len -= pCur->iov_len;
+        pCur++;
+        cnt--;
+    }
+    if (cnt > 0)
+    {
+        pCur->iov_base = (unsigned char *)pCur->iov_base + len;
+        pCur->iov_len -= len;
+    }
+
+    *ppCur = pCur;
+    *pCnt = cnt;
+}
+
+/**
+*  Initialize the send queue of a connection. The caller serializes all
+*  the queue functions of one connection, e.g. by its send lock.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @param [in]  pCfg    A @ref tCommQueue object (NULL is no queue).
+*  @param [in]  pEvent  Reactor event of the connection.
+*  @param [in]  pFunc   Watermark callback.
+*  @param [in]  pArg    Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_queueInit(
+    tSendQueue     *pQueue,
+    tCommQueue     *pCfg,
+    tReactorEvent  *pEvent,
+    tQueueWaterCb   pFunc,
+    void           *pArg
+)
+{
+    memset(pQueue, 0x00, sizeof( tSendQueue ));
+
+    if (NULL == pCfg)
+    {
+        return 0;
+    }
+
+    if (0 == pCfg->maxSize)
+    {
+        LOG_ERROR("%s: max. size is 0\n", __func__);
+        return -1;
+    }
+
+    if ((pCfg->highMark > pCfg->maxSize) ||
+        ((pCfg->highMark > 0) && (pCfg->lowMark >= pCfg->highMark)))
+    {
+        LOG_ERROR(
+            "%s: wrong watermarks %zu / %zu\n",
+            __func__,
+            pCfg->lowMark,
+            pCfg->highMark
+        );
+        return -1;
+    }
+
+    pQueue->cfg = *pCfg;
+    pQueue->pEvent = pEvent;
+    pQueue->pWaterFunc = pFunc;
+    pQueue->pWaterArg = pArg;
+
+    return 0;
+}
+
+/**
+*  Release the pending buffers of a connection.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*/
+void comm_queueUninit(tSendQueue *pQueue)
+{
+    int i;
+
+    for (i=0; i<pQueue->num; i++)
+    {
+        comm_bufRelease( pQueue->ppBuf[(pQueue->head + i) % pQueue->cap] );
+    }
+
+    free( pQueue->ppBuf );
+    pQueue->ppBuf = NULL;
+    pQueue->cap = 0;
+    pQueue->head = 0;
+    pQueue->num = 0;
+    pQueue->bytes = 0;
+}
+
+/**
+*  Send one message of several buffers without blocking. What the socket
+*  does not take is copied to the queue and written on EPOLLOUT.
+*  @param [in]   pQueue  A @ref tSendQueue object.
+*  @param [in]   pFrame  A @ref tFrame object of the connection.
+*  @param [in]   fd      Socket file descriptor.
+*  @param [in]   pIov    Data buffers.
+*  @param [in]   num     Number of data buffers.
+*  @param [out]  pWater  Watermark to notify by @ref comm_queueNotify.
+*  @returns  Message length (-1 is failed, errno ENOBUFS is a full queue).
+*/
+ssize_t comm_queueSendv(
+    tSendQueue    *pQueue,
+    tFrame        *pFrame,
+    int            fd,
+    struct iovec  *pIov,
+    int            num,
+    int           *pWater
+)
+{
+    unsigned char hdr[8];
+    struct iovec iov[QUEUE_IOV_NUM];
+    struct iovec *pVec = iov;
+    struct iovec *pCur;
+    struct msghdr msg;
+    tCommBuf *pBuf;
+    size_t size = 0;
+    size_t total;
+    size_t sent = 0;
+    ssize_t len;
+    int hdrSize;
+    int cnt = 0;
+    int i;
+
+
+    *pWater = QUEUE_WATER_NONE;
+
+    if ((num <= 0) || (num >= IOV_MAX))
+    {
+        LOG_ERROR("%s: wrong buffer number %d\n", __func__, num);
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (i=0; i<num; i++)
+    {
+        size += pIov[i].iov_len;
+    }
+
+    hdrSize = comm_frameHeader(pFrame, size, hdr);
+    if (hdrSize < 0)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    total = size + hdrSize;
+
+    /* a message is queued whole or not at all, the stream stays intact */
+    if ((pQueue->bytes + total) > pQueue->cfg.maxSize)
+    {
+        LOG_WARN("%s: send queue is full (%zu bytes)\n", __func__, pQueue->bytes);
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    if ((num + 1) > QUEUE_IOV_NUM)
+    {
+        pVec = malloc(sizeof( struct iovec ) * (num + 1));
+        if (NULL == pVec)
+        {
+            LOG_ERROR("%s: fail to allocate %d iovec\n", __func__, num);
+            return -1;
+        }
+    }
+
+    if (hdrSize > 0)
+    {
+        pVec[0].iov_base = hdr;
+        pVec[0].iov_len  = hdrSize;
+        cnt = 1;
+    }
+    memcpy((pVec + cnt), pIov, (sizeof( struct iovec ) * num));
+    cnt += num;
+    pCur = pVec;
+
+    /* the queued data goes first, then nothing can be written directly */
+    while ((0 == pQueue->num) && (sent < total))
+    {
+        memset(&msg, 0x00, sizeof( struct msghdr ));
+        msg.msg_iov    = pCur;
+        msg.msg_iovlen = cnt;
+
+        len = sendmsg(fd, &msg, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            {
+                break;
+            }
+            if (pVec != iov)
+            {
+                free( pVec );
+            }
+            return -1;
+        }
+        sent += len;
+        _queueSkip(&pCur, &cnt, len);
+    }
+
+    if (sent < total)
+    {
+        pBuf = comm_bufAlloc(total - sent);
+        if (NULL == pBuf)
+        {
+            LOG_ERROR("fail to allocate %zu bytes send queue\n", (total - sent));
+            if (pVec != iov)
+            {
+                free( pVec );
+            }
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        for (i=0; i<cnt; i++)
+        {
+            memcpy((pBuf->pData + pBuf->size), pCur[i].iov_base, pCur[i].iov_len);
+            pBuf->size += pCur[i].iov_len;
+        }
+
+        if (_queuePush(pQueue, pBuf) != 0)
+        {
+            comm_bufRelease( pBuf );
+            if (pVec != iov)
+            {
+                free( pVec );
+            }
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        LOG_3("send queue fd(%d) %zu bytes\n", fd, pQueue->bytes);
+
+        if ((pQueue->cfg.highMark > 0) && ( !pQueue->high ) &&
+            (pQueue->bytes >= pQueue->cfg.highMark))
+        {
+            pQueue->high = 1;
+            *pWater = QUEUE_WATER_HIGH;
+        }
+    }
+
+    if (pVec != iov)
+    {
+        free( pVec );
+    }
+
+    return size;
+}
+
+/**
+*  Write the pending buffers until the socket would block.
+*  @param [in]   pQueue  A @ref tSendQueue object.
+*  @param [in]   fd      Socket file descriptor.
+*  @param [out]  pWater  Watermark to notify by @ref comm_queueNotify.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_queueFlush(tSendQueue *pQueue, int fd, int *pWater)
+{
+    struct iovec iov[QUEUE_IOV_NUM];
+    struct msghdr msg;
+    tCommBuf *pBuf;
+    ssize_t len;
+    int cnt;
+
+
+    *pWater = QUEUE_WATER_NONE;
+
+    while (pQueue->num > 0)
+    {
+        for (cnt=0; (cnt<pQueue->num) && (cnt<QUEUE_IOV_NUM); cnt++)
+        {
+            pBuf = pQueue->ppBuf[(pQueue->head + cnt) % pQueue->cap];
+            iov[cnt].iov_base = pBuf->pData;
+            iov[cnt].iov_len  = pBuf->size;
+        }
+
+        memset(&msg, 0x00, sizeof( struct msghdr ));
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = cnt;
+
+        len = sendmsg(fd, &msg, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            if ((EAGAIN == errno) || (EWOULDBLOCK == errno))
+            {
+                break;
+            }
+            perror( "sendmsg" );
+            return -1;
+        }
+        pQueue->bytes -= len;
+
+        /* release the written buffers, the pool header stays in front */
+        while (len > 0)
+        {
+            pBuf = pQueue->ppBuf[pQueue->head];
+            if ((size_t)len < pBuf->size)
+            {
+                pBuf->pData += len;
+                pBuf->size -= len;
+                pBuf->capacity -= len;
+                break;
+            }
+            len -= pBuf->size;
+            comm_bufRelease( pBuf );
+            pQueue->head = (pQueue->head + 1) % pQueue->cap;
+            pQueue->num--;
+        }
+    }
+
+    if ((0 == pQueue->num) && comm_reactorAttached( pQueue->pEvent ))
+    {
+        comm_reactorModEvent(pQueue->pEvent, EPOLLIN);
+    }
+
+    if (( pQueue->high ) && (pQueue->bytes <= pQueue->cfg.lowMark))
+    {
+        pQueue->high = 0;
+        *pWater = QUEUE_WATER_LOW;
+    }
+
+    return 0;
+}
+
+/**
+*  Ask EPOLLOUT for the buffers queued before the reactor event was attached.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*/
+void comm_queueAttach(tSendQueue *pQueue)
+{
+    if ((pQueue->num > 0) && comm_reactorAttached( pQueue->pEvent ))
+    {
+        comm_reactorModEvent(pQueue->pEvent, (EPOLLIN | EPOLLOUT));
+    }
+}
+
+/**
+*  Call the watermark callback. The caller holds no lock of the library,
+*  neither the send lock nor the user table lock, so the callback may
+*  re-enter the send functions.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @param [in]  water   Watermark from @ref comm_queueSendv or @ref comm_queueFlush.
+*/
+void comm_queueNotify(tSendQueue *pQueue, int water)
+{
+    if ((QUEUE_WATER_NONE == water) || (NULL == pQueue->pWaterFunc))
+    {
+        return;
+    }
+
+    LOG_2(
+        "send queue %s-water mark (%zu bytes)\n",
+        ((QUEUE_WATER_HIGH == water) ? "high" : "low"),
+        pQueue->bytes
+    );
+    pQueue->pWaterFunc(pQueue->pWaterArg, (QUEUE_WATER_HIGH == water));
+}
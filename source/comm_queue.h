@@ -0,0 +1,115 @@
+#ifndef __COMM_QUEUE_H__
+#define __COMM_QUEUE_H__
+
+#include <sys/uio.h>
+#include "comm_if.h"
+#include "comm_reactor.h"
+#include "comm_frame.h"
+
+
+/**
+*  Watermark callback, called with no lock of the library held.
+*  @param [in]  pArg  Owner's argument.
+*  @param [in]  high  Over the high-water mark(1) or drained to the low-water mark(0).
+*/
+typedef void (*tQueueWaterCb)(void *pArg, int high);
+
+/* Watermark crossed by a send or a flush */
+#define QUEUE_WATER_NONE  (0)
+#define QUEUE_WATER_HIGH  (1)
+#define QUEUE_WATER_LOW   (2)
+
+typedef struct _tSendQueue
+{
+    tCommQueue      cfg;  /* maxSize 0 is no queue */
+    tReactorEvent  *pEvent;
+    tQueueWaterCb   pWaterFunc;
+    void           *pWaterArg;
+
+    /* ring of the pending buffers of one connection */
+    tCommBuf      **ppBuf;
+    int             cap;
+    int             head;
+    int             num;
+    size_t          bytes;
+    int             high;
+} tSendQueue;
+
+
+/**
+*  Initialize the send queue of a connection. The caller serializes all
+*  the queue functions of one connection, e.g. by its send lock.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @param [in]  pCfg    A @ref tCommQueue object (NULL is no queue).
+*  @param [in]  pEvent  Reactor event of the connection.
+*  @param [in]  pFunc   Watermark callback.
+*  @param [in]  pArg    Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_queueInit(
+         tSendQueue     *pQueue,
+         tCommQueue     *pCfg,
+         tReactorEvent  *pEvent,
+         tQueueWaterCb   pFunc,
+         void           *pArg
+     );
+
+/**
+*  Release the pending buffers of a connection.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*/
+void comm_queueUninit(tSendQueue *pQueue);
+
+/**
+*  Send one message of several buffers without blocking. What the socket
+*  does not take is copied to the queue and written on EPOLLOUT.
+*  @param [in]   pQueue  A @ref tSendQueue object.
+*  @param [in]   pFrame  A @ref tFrame object of the connection.
+*  @param [in]   fd      Socket file descriptor.
+*  @param [in]   pIov    Data buffers.
+*  @param [in]   num     Number of data buffers.
+*  @param [out]  pWater  Watermark to notify by @ref comm_queueNotify.
+*  @returns  Message length (-1 is failed, errno ENOBUFS is a full queue).
+*/
+ssize_t comm_queueSendv(
+            tSendQueue    *pQueue,
+            tFrame        *pFrame,
+            int            fd,
+            struct iovec  *pIov,
+            int            num,
+            int           *pWater
+        );
+
+/**
+*  Write the pending buffers until the socket would block.
+*  @param [in]   pQueue  A @ref tSendQueue object.
+*  @param [in]   fd      Socket file descriptor.
+*  @param [out]  pWater  Watermark to notify by @ref comm_queueNotify.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_queueFlush(tSendQueue *pQueue, int fd, int *pWater);
+
+/**
+*  Ask EPOLLOUT for the buffers queued before the reactor event was attached.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*/
+void comm_queueAttach(tSendQueue *pQueue);
+
+/**
+*  Call the watermark callback. The caller holds no lock of the library,
+*  neither the send lock nor the user table lock, so the callback may
+*  re-enter the send functions.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @param [in]  water   Watermark from @ref comm_queueSendv or @ref comm_queueFlush.
+*/
+void comm_queueNotify(tSendQueue *pQueue, int water);
+
+/**
+*  Check if the send queue is enabled.
+*  @param [in]  pQueue  A @ref tSendQueue object.
+*  @returns  Enabled(1) or disabled(0).
+*/
+#define comm_queueEnabled(pQueue) ((pQueue)->cfg.maxSize > 0)
+
+
+#endif /* __COMM_QUEUE_H__ */
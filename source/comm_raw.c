@@ -2,7 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <ifaddrs.h>
@@ -12,10 +15,25 @@
 #include <netinet/in.h> /* htons */
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_ring.h"
+#include "comm_bpf.h"
+#include "comm_cpu.h"
+#include "comm_pcap.h"
+#include "comm_ifcache.h"
 
 
 #define ETH_DEVICE "eth0"
 
+/* Max. sockets of one fan-out handle */
+#define RAW_FANOUT_MAX (256)
+
+/* The handle has a receive callback, thus a receiving thread or event */
+#define RAW_RECEIVING(pContext) \
+    (( (pContext)->pRecvFunc ) || ( (pContext)->pBufFunc ) || \
+     ( (pContext)->pRingFunc ) || ( (pContext)->pFanoutFunc ))
+
 
 typedef struct _tRawContext
 {
@@ -27,14 +45,63 @@ typedef struct _tRawContext
     int            fd;
 
     tRawRecvCb     pRecvFunc;
+    tRawBufCb      pBufFunc;
+    tRawRingCb     pRingFunc;
+    tRxRing       *pRing;
+    tTxRing       *pTxRing;
+    unsigned char *pTxData;  /* the reserved slot */
+    int            txFd;
+    tRawFanoutCb   pFanoutFunc;
+    int            member;  /* -1 is not a fan-out member */
+    struct _tRawContext *pNext;  /* next fan-out member */
+    size_t         recvSize;
+    tPcapTap       tap;
     void          *pArg;
     pthread_t      thread;
     int            running;
-
-    unsigned char  recvMsg[COMM_BUF_SIZE+1];
+    tReactorHandle reactor;
+    tReactorEvent  event;
 } tRawContext;
 
 
+/**
+*  Query the interface index, MTU and MAC address by ioctl().
+*  @param [in]  pContext  A @ref tRawContext object.
+*  @param [in]  fd        Socket file descriptor.
+*  @param [in]  pIfReq    A struct ifreq with the interface name.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _rawIfQuery(tRawContext *pContext, int fd, struct ifreq *pIfReq)
+{
+    /* retrieve ethernet interface index */
+    if (ioctl(fd, SIOCGIFINDEX, pIfReq) < 0)
+    {
+        perror( "SIOCGIFINDEX" );
+        return -1;
+    }
+
+    pContext->ifIndex = pIfReq->ifr_ifindex;
+
+    /* retrieve ethernet interface MTU */
+    if (ioctl(fd, SIOCGIFMTU, pIfReq) < 0)
+    {
+        perror( "SIOCGIFMTU" );
+        return -1;
+    }
+
+    pContext->ifMtu = pIfReq->ifr_mtu;
+
+    /* retrieve corresponding MAC */
+    if (ioctl(fd, SIOCGIFHWADDR, pIfReq) < 0)
+    {
+        perror( "SIOCGIFHWADDR" );
+        return -1;
+    }
+
+    memcpy(pContext->ifHwAddr, pIfReq->ifr_hwaddr.sa_data, ETH_ALEN);
+    return 0;
+}
+
 /**
 *  Initialize a raw socket.
 *  @param [in]  pContext  A @ref tRawContext object.
@@ -63,6 +130,7 @@ static int _rawInit(tRawContext *pContext)
      * };
      */
     struct ifreq ifReq;
+    tIfCacheInfo info;
     int fd;
 
 
@@ -77,37 +145,21 @@ static int _rawInit(tRawContext *pContext)
     strncpy(ifReq.ifr_name, pContext->ifName, IFNAMSIZ);
     LOG_2("interface name: %s\n", pContext->ifName);
 
-    /* retrieve ethernet interface index */
-    if (ioctl(fd, SIOCGIFINDEX, &ifReq) < 0)
+    if (0 == comm_ifCacheGet(pContext->ifName, &info))
     {
-        perror( "SIOCGIFINDEX" );
-        close( fd );
-        return -1;
+        /* served by the interface cache */
+        pContext->ifIndex = info.index;
+        pContext->ifMtu   = info.mtu;
+        memcpy(pContext->ifHwAddr, info.hwAddr, ETH_ALEN);
     }
-
-    pContext->ifIndex = ifReq.ifr_ifindex;
-    LOG_2("interface index: %d\n", pContext->ifIndex);
-
-    /* retrieve ethernet interface MTU */
-    if (ioctl(fd, SIOCGIFMTU, &ifReq) < 0)
+    else if (_rawIfQuery(pContext, fd, &ifReq) != 0)
     {
-        perror( "SIOCGIFMTU" );
         close( fd );
         return -1;
     }
 
-    pContext->ifMtu = ifReq.ifr_mtu;
+    LOG_2("interface index: %d\n", pContext->ifIndex);
     LOG_2("interface MTU: %d\n", pContext->ifMtu);
-
-    /* retrieve corresponding MAC */
-    if (ioctl(fd, SIOCGIFHWADDR, &ifReq) < 0)
-    {
-        perror( "SIOCGIFHWADDR" );
-        close( fd );
-        return -1;
-    }
-
-    memcpy(pContext->ifHwAddr, ifReq.ifr_hwaddr.sa_data, ETH_ALEN);
     LOG_2(
         "MAC address: %02X:%02X:%02X:%02X:%02X:%02X\n",
         pContext->ifHwAddr[0],
@@ -139,6 +191,223 @@ static void _rawUninit(tRawContext *pContext)
     LOG_2("Raw socket is closed\n");
 }
 
+/**
+*  Bind a packet socket to the interface, so that only its frames are received.
+*  @param [in]  pContext  A @ref tRawContext object.
+*  @param [in]  fd        Packet socket file descriptor.
+*  @param [in]  protocol  Received protocol in host byte order (0 is none).
+*  @returns  Success(0) or failure(-1).
+*/
+static int _rawBind(tRawContext *pContext, int fd, unsigned short protocol)
+{
+    struct sockaddr_ll sockAddr;
+
+    memset(&sockAddr, 0x00, sizeof( struct sockaddr_ll ));
+    sockAddr.sll_family   = AF_PACKET;
+    sockAddr.sll_protocol = htons(protocol);
+    sockAddr.sll_ifindex  = pContext->ifIndex;
+
+    if (bind(fd, (struct sockaddr *)&sockAddr, sizeof( struct sockaddr_ll )) < 0)
+    {
+        perror( "bind" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Copy a frame to the capture of the raw socket if it is tapped.
+*  @param [in]  pContext  A @ref tRawContext object.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  pData     Frame data.
+*  @param [in]  size      Frame size.
+*/
+static void _rawTap(tRawContext *pContext, int outbound, void *pData, size_t size)
+{
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pData;
+        iov.iov_len  = size;
+        comm_pcapWritev(pTap, outbound, NULL, 0, &iov, 1);
+    }
+}
+
+/**
+*  Ring callback that taps the frames and passes them to the application.
+*  @param [in]  pArg    A @ref tRawContext object.
+*  @param [in]  pFrame  Frames of the receive ring.
+*  @param [in]  num     Number of frames.
+*/
+static void _rawRingFunc(void *pArg, tRawFrame *pFrame, int num)
+{
+    tRawContext *pContext = pArg;
+    int i;
+
+    if ( comm_pcapTapped( &(pContext->tap) ) )
+    {
+        for (i=0; i<num; i++)
+        {
+            _rawTap(pContext, PCAP_IN, pFrame[i].pData, pFrame[i].size);
+        }
+    }
+
+    pContext->pRingFunc(pContext->pArg, pFrame, num);
+}
+
+/**
+*  Pass the frames of the receive ring to the raw socket ring callback.
+*  @param [in]  pContext  A @ref tRawContext object.
+*  @param [in]  flags     MSG_DONTWAIT or 0 to wait for a block.
+*  @returns  Number of frames (0 is no block ready, -1 is failed).
+*/
+static int _rawRecvRing(tRawContext *pContext, int flags)
+{
+    struct pollfd pfd;
+    socklen_t errorLen;
+    int error = 0;
+    int num;
+
+    if (( !(flags & MSG_DONTWAIT) ) && ( !comm_ringRxReady( pContext->pRing ) ))
+    {
+        pfd.fd = pContext->fd;
+        pfd.events = (POLLIN | POLLERR);
+        pfd.revents = 0;
+
+        LOG_3("Raw socket ... poll\n");
+        if ((poll(&pfd, 1, -1) < 0) && (errno != EINTR))
+        {
+            LOG_ERROR("fail to receive raw socket\n");
+            perror( "poll" );
+            return -1;
+        }
+    }
+
+    num = comm_ringRxRead(pContext->pRing, _rawRingFunc, pContext);
+    if (0 == num)
+    {
+        /* a wake-up of no block may be an error, e.g. ENETDOWN, reading clears it */
+        errorLen = sizeof( error );
+        if ((getsockopt(pContext->fd, SOL_SOCKET, SO_ERROR, &error, &errorLen) < 0) ||
+            (error != 0))
+        {
+            LOG_ERROR("%s: socket error(%s)\n", __func__, strerror( (error != 0) ? error : errno ));
+            return -1;
+        }
+    }
+
+    return num;
+}
+
+/**
+*  Unmap and free the receive and transmit rings.
+*  @param [in]  pContext  A @ref tRawContext object.
+*/
+static void _rawCloseRing(tRawContext *pContext)
+{
+    if ( pContext->pRing )
+    {
+        comm_ringRxUninit( pContext->pRing );
+        free( pContext->pRing );
+        pContext->pRing = NULL;
+    }
+
+    if ( pContext->pTxRing )
+    {
+        comm_ringTxUninit( pContext->pTxRing );
+        free( pContext->pTxRing );
+        pContext->pTxRing = NULL;
+    }
+
+    if (pContext->txFd >= 0)
+    {
+        close( pContext->txFd );
+        pContext->txFd = -1;
+    }
+}
+
+/**
+*  Receive a frame and pass it to the raw socket receive callback.
+*  @param [in]  pContext  A @ref tRawContext object.
+*  @param [in]  flags     recvfrom() flags.
+*  @returns  Frame length (-1 is failed).
+*/
+static int _rawRecvMsg(tRawContext *pContext, int flags)
+{
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
+    int len;
+
+
+    if ( pContext->pRingFunc )
+    {
+        return _rawRecvRing(pContext, flags);
+    }
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("Raw socket ... recvfrom\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recvfrom(
+              pContext->fd,
+              pBuf->pData,
+              recvSize,
+              flags,
+              NULL,
+              NULL
+          );
+    pthread_cleanup_pop( 0 );
+    if (len < 0)
+    {
+        if (EAGAIN == errno)
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_ERROR("fail to receive raw socket\n");
+        perror( "recvfrom" );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- Raw socket (%s)\n", pContext->ifName);
+    LOG_DUMP("Raw recv", pBuf->pData, len);
+    _rawTap(pContext, PCAP_IN, pBuf->pData, len);
+
+    if ( pContext->pFanoutFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pFanoutFunc(pContext->pArg, pContext->member, pBuf);
+        return len;
+    }
+
+    if ( pContext->pBufFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pBufFunc(pContext->pArg, pBuf);
+        return len;
+    }
+
+    if ( pContext->pRecvFunc )
+    {
+        pContext->pRecvFunc(pContext->pArg, pBuf->pData, len);
+    }
+
+    comm_bufRelease( pBuf );
+    return len;
+}
+
 /**
 *  Thread function for the raw socket receiving.
 *  @param [in]  pArg  A @ref tRawContext object.
@@ -146,7 +415,6 @@ static void _rawUninit(tRawContext *pContext)
 static void *_rawRecvTask(void *pArg)
 {
     tRawContext *pContext = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -154,31 +422,12 @@ static void *_rawRecvTask(void *pArg)
 
     while ( pContext->running )
     {
-        LOG_3("Raw socket ... recvfrom\n");
         pthread_testcancel();
-        len = recvfrom(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0,
-                  NULL,
-                  NULL
-              );
-        if (len < 0)
+        if (_rawRecvMsg(pContext, 0) < 0)
         {
-            LOG_ERROR("fail to receive raw socket\n");
-            perror( "recvfrom" );
             break;
         }
         pthread_testcancel();
-
-        LOG_3("<- Raw socket (%s)\n", pContext->ifName);
-        LOG_DUMP("Raw recv", pContext->recvMsg, len);
-
-        if ( pContext->pRecvFunc )
-        {
-            pContext->pRecvFunc(pContext->pArg, pContext->recvMsg, len);
-        }
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -187,18 +436,45 @@ static void *_rawRecvTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for the raw socket receiving.
+*  @param [in]  pArg    A @ref tRawContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _rawRecvEvent(void *pArg, unsigned int events)
+{
+    tRawContext *pContext = pArg;
+
+    if (_rawRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        comm_reactorDelEvent( &(pContext->event) );
+        pContext->running = 0;
+    }
+}
 
 /**
 *  Initialize raw socket.
 *  @param [in]  pEthDev    Ethernet device name.
 *  @param [in]  pRecvFunc  Application's receive callback function.
-*  @param [in]  pArg       Application's argument.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pRing      A @ref tRawRing object of the ring callback.
+*  @param [in]  pRingFunc    Application's ring callback function.
+*  @param [in]  pFanoutFunc  Application's fan-out callback function.
+*  @param [in]  member       Fan-out member ID (-1 is not a member).
+*  @param [in]  fanout       PACKET_FANOUT argument, group ID and mode.
+*  @param [in]  pArg         Application's argument.
 *  @returns  Raw socket handle
 */
-tRawHandle comm_rawSockInit(
-    char       *pEthDev,
-    tRawRecvCb  pRecvFunc,
-    void       *pArg
+static tRawHandle _rawSockOpen(
+    char          *pEthDev,
+    tRawRecvCb     pRecvFunc,
+    tRawBufCb      pBufFunc,
+    tRawRing      *pRing,
+    tRawRingCb     pRingFunc,
+    tRawFanoutCb   pFanoutFunc,
+    int            member,
+    int            fanout,
+    void          *pArg
 )
 {
     tRawContext *pContext = NULL;
@@ -222,8 +498,14 @@ tRawHandle comm_rawSockInit(
     memset(pContext, 0x00, sizeof( tRawContext ));
     strncpy(pContext->ifName, pEthDev, IFNAMSIZ);
     pContext->pRecvFunc = pRecvFunc;
+    pContext->pBufFunc = pBufFunc;
+    pContext->pRingFunc = pRingFunc;
+    pContext->pFanoutFunc = pFanoutFunc;
+    pContext->member = member;
     pContext->pArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
+    pContext->txFd = -1;
 
     error = _rawInit( pContext );
     if (error != 0)
@@ -233,7 +515,37 @@ tRawHandle comm_rawSockInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ( pRingFunc )
+    {
+        /* the ring is set up before bind() to miss no frame of the device */
+        pContext->pRing = malloc( sizeof( tRxRing ) );
+        if ((NULL == pContext->pRing) ||
+            (comm_ringRxInit(pContext->pRing, pContext->fd, pRing) != 0) ||
+            (_rawBind(pContext, pContext->fd, ETH_P_ALL) != 0))
+        {
+            LOG_ERROR("failed to create raw socket RX ring\n");
+            _rawCloseRing( pContext );
+            _rawUninit( pContext );
+            free( pContext );
+            return 0;
+        }
+    }
+
+    if (member >= 0)
+    {
+        /* a member takes the frames of its device only */
+        if ((_rawBind(pContext, pContext->fd, ETH_P_ALL) != 0) ||
+            (setsockopt(pContext->fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof( fanout )) < 0))
+        {
+            LOG_ERROR("failed to join raw socket fan-out group\n");
+            perror( "PACKET_FANOUT" );
+            _rawUninit( pContext );
+            free( pContext );
+            return 0;
+        }
+    }
+
+    if ( !RAW_RECEIVING( pContext ) )
     {
         LOG_1("ignore raw socket receive function\n");
         goto _RAW_DONE;
@@ -241,6 +553,31 @@ tRawHandle comm_rawSockInit(
 
     pContext->running = 1;
 
+    /* a member keeps its own thread pinned to one CPU, not a reactor thread */
+    if (( g_reactor ) && (member < 0))
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _rawRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("failed to attach raw socket to reactor\n");
+            _rawUninit( pContext );
+            _rawCloseRing( pContext );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = g_reactor;
+        goto _RAW_DONE;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -254,17 +591,217 @@ tRawHandle comm_rawSockInit(
     {
         LOG_ERROR("failed to create raw socket receiving thread\n");
         _rawUninit( pContext );
+        _rawCloseRing( pContext );
         free( pContext );
         return 0;
     }
 
     pthread_attr_destroy( &tattr );
 
+    if (member >= 0)
+    {
+        comm_cpuPin(pContext->thread, member);
+    }
+
 _RAW_DONE:
     LOG_1("Raw socket initialized\n");
     return ((tRawHandle)pContext);
 }
 
+/**
+*  Initialize raw socket.
+*  @param [in]  pEthDev    Ethernet device name.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  Raw socket handle
+*/
+tRawHandle comm_rawSockInit(
+    char       *pEthDev,
+    tRawRecvCb  pRecvFunc,
+    void       *pArg
+)
+{
+    return _rawSockOpen(pEthDev, pRecvFunc, NULL, NULL, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize raw socket with zero-copy buffers.
+*  @param [in]  pEthDev    Ethernet device name.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  Raw socket handle
+*/
+tRawHandle comm_rawSockInitBuf(
+    char       *pEthDev,
+    tRawBufCb   pBufFunc,
+    void       *pArg
+)
+{
+    return _rawSockOpen(pEthDev, NULL, pBufFunc, NULL, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize raw socket with a TPACKET_V3 memory-mapped receive ring. The
+*  kernel fills the ring blocks without a system call per frame, and the
+*  frames of a block are passed to the callback in place, with the kernel
+*  timestamps. The socket is bound to the device.
+*  @param [in]  pEthDev    Ethernet device name.
+*  @param [in]  pRing      A @ref tRawRing object (NULL is the default ring).
+*  @param [in]  pRingFunc  Application's ring callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  Raw socket handle
+*/
+tRawHandle comm_rawSockInitRing(
+    char       *pEthDev,
+    tRawRing   *pRing,
+    tRawRingCb  pRingFunc,
+    void       *pArg
+)
+{
+    if (NULL == pRingFunc)
+    {
+        LOG_ERROR("%s: pRingFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    return _rawSockOpen(pEthDev, NULL, NULL, pRing, pRingFunc, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize raw sockets joined in a PACKET_FANOUT group. Every member has
+*  its own receiving thread pinned to one CPU, and the kernel spreads the
+*  frames of the device to the members by the fan-out mode. A member's
+*  callbacks run on its own thread only, so the per-member state needs no
+*  lock. In COMM_RAW_FANOUT_HASH mode a flow always goes to one member,
+*  with the IP fragments reassembled, so its frames keep their order. The
+*  members do not use the reactor, and the handle sends by member 0.
+*  @param [in]  pEthDev      Ethernet device name.
+*  @param [in]  memberNum    Number of members (0 is one per CPU).
+*  @param [in]  mode         COMM_RAW_FANOUT_HASH / LB / CPU / ROLLOVER.
+*  @param [in]  pFanoutFunc  Application's fan-out callback function.
+*  @param [in]  pArg         Application's argument.
+*  @returns  Raw socket handle
+*/
+tRawHandle comm_rawSockInitFanout(
+    char          *pEthDev,
+    int            memberNum,
+    int            mode,
+    tRawFanoutCb   pFanoutFunc,
+    void          *pArg
+)
+{
+    tRawContext *pFirst;
+    tRawContext *pLast;
+    tRawContext *pContext;
+    socklen_t len;
+    int fanout;
+    int id;
+    int i;
+
+
+    if (NULL == pFanoutFunc)
+    {
+        LOG_ERROR("%s: pFanoutFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    if (0 == memberNum)
+    {
+        memberNum = comm_cpuNum( RAW_FANOUT_MAX );
+    }
+
+    if ((memberNum < 0) || (memberNum > RAW_FANOUT_MAX))
+    {
+        LOG_ERROR("%s: wrong member number %d\n", __func__, memberNum);
+        return 0;
+    }
+
+    switch ( mode )
+    {
+        case COMM_RAW_FANOUT_HASH:
+            fanout = (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG);
+            break;
+        case COMM_RAW_FANOUT_LB:
+            fanout = PACKET_FANOUT_LB;
+            break;
+        case COMM_RAW_FANOUT_CPU:
+            fanout = PACKET_FANOUT_CPU;
+            break;
+        case COMM_RAW_FANOUT_ROLLOVER:
+            fanout = PACKET_FANOUT_ROLLOVER;
+            break;
+        default:
+            LOG_ERROR("%s: wrong fan-out mode %d\n", __func__, mode);
+            return 0;
+    }
+
+    /* the kernel picks a group ID unused in the network namespace */
+    pFirst = (tRawContext *)_rawSockOpen(
+                 pEthDev,
+                 NULL,
+                 NULL,
+                 NULL,
+                 NULL,
+                 pFanoutFunc,
+                 0,
+                 ((fanout | PACKET_FANOUT_FLAG_UNIQUEID) << 16),
+                 pArg
+             );
+    if (NULL == pFirst)
+    {
+        return 0;
+    }
+
+    len = sizeof( id );
+    if (getsockopt(pFirst->fd, SOL_PACKET, PACKET_FANOUT, &id, &len) < 0)
+    {
+        perror( "getsockopt" );
+        comm_rawSockUninit( (tRawHandle)pFirst );
+        return 0;
+    }
+
+    /* the others join the group by its ID */
+    fanout = (id & 0xFFFF) | (fanout << 16);
+
+    pLast = pFirst;
+    for (i=1; i<memberNum; i++)
+    {
+        pContext = (tRawContext *)_rawSockOpen(
+                       pEthDev, NULL, NULL, NULL, NULL, pFanoutFunc, i, fanout, pArg
+                   );
+        if (NULL == pContext)
+        {
+            LOG_ERROR("fail to open raw socket fan-out member %d\n", i);
+            comm_rawSockUninit( (tRawHandle)pFirst );
+            return 0;
+        }
+
+        pLast->pNext = pContext;
+        pLast = pContext;
+    }
+
+    LOG_1("Raw socket %s has %d fan-out members\n", pFirst->ifName, memberNum);
+    return ((tRawHandle)pFirst);
+}
+
+/**
+*  Release a raw socket when it is no more received.
+*  @param [in]  pArg  A @ref tRawContext object.
+*/
+static void _rawRelease(void *pArg)
+{
+    tRawContext *pContext = pArg;
+
+    if ( pContext->promisc )
+    {
+        comm_rawPromiscMode((tRawHandle)pContext, 0);
+    }
+    _rawUninit( pContext );
+    _rawCloseRing( pContext );
+    free( pContext );
+    LOG_1("Raw socket un-initialized\n");
+}
+
 /**
 *  Un-initialize raw socket library.
 *  @param [in]  handle  Raw socket handle.
@@ -272,29 +809,64 @@ _RAW_DONE:
 void comm_rawSockUninit(tRawHandle handle)
 {
     tRawContext *pContext = (tRawContext *)handle;
+    tRawContext *pNext;
 
-    if ( pContext )
+    /* a fan-out handle closes all of its members */
+    while ( pContext )
     {
-        if ( pContext->pRecvFunc )
-        {
-            pthread_cancel( pContext->thread );
-        }
+        pNext = pContext->pNext;
 
         pContext->running = 0;
-        if ( pContext->promisc )
+
+        if ( pContext->reactor )
         {
-            comm_rawPromiscMode(handle, 0);
+            comm_reactorDelEventFree(&(pContext->event), _rawRelease, pContext);
         }
-        _rawUninit( pContext );
-
-        if ( pContext->pRecvFunc )
+        else
         {
-            pthread_join(pContext->thread, NULL);
+            if ( RAW_RECEIVING( pContext ) )
+            {
+                pthread_cancel( pContext->thread );
+                pthread_join(pContext->thread, NULL);
+            }
+            _rawRelease( pContext );
         }
 
-        free( pContext );
-        LOG_1("Raw socket un-initialized\n");
+        pContext = pNext;
+    }
+}
+
+/**
+*  Set the receive size of the raw socket.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawSockSetRecvSize(tRawHandle handle, size_t size)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
     }
+
+    pContext->recvSize = size;
+    return 0;
 }
 
 /**
@@ -309,12 +881,28 @@ int comm_rawSockSend(
     unsigned char  *pData,
     unsigned short  size
 )
+{
+    return comm_rawSockSendEx(handle, pData, size);
+}
+
+/**
+*  Send data by a raw socket.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_rawSockSendEx(
+    tRawHandle      handle,
+    unsigned char  *pData,
+    size_t          size
+)
 {
     tRawContext *pContext = (tRawContext *)handle;
     unsigned char *pDestMac = pData;
     struct sockaddr_ll sockAddr;
     int sockAddrLen;
-    int error;
+    ssize_t error;
 
 
     if (NULL == pContext)
@@ -373,8 +961,10 @@ int comm_rawSockSend(
     {
         LOG_ERROR("fail to send raw socket\n");
         perror( "sendto" );
+        return error;
     }
 
+    _rawTap(pContext, PCAP_OUT, pData, error);
     return error;
 }
 
@@ -390,9 +980,25 @@ int comm_rawSockRecv(
     unsigned char  *pData,
     unsigned short  size
 )
+{
+    return comm_rawSockRecvEx(handle, pData, size);
+}
+
+/**
+*  Receive data by a raw socket.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data buffer size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_rawSockRecvEx(
+    tRawHandle      handle,
+    unsigned char  *pData,
+    size_t          size
+)
 {
     tRawContext *pContext = (tRawContext *)handle;
-    int len;
+    ssize_t len;
 
 
     if (NULL == pContext)
@@ -407,9 +1013,9 @@ int comm_rawSockRecv(
         return -1;
     }
 
-    if ( pContext->pRecvFunc )
+    if ( RAW_RECEIVING( pContext ) )
     {
-        LOG_WARN("%s: pRecvFunc exists\n", __func__);
+        LOG_WARN("%s: receive function exists\n", __func__);
         return -1;
     }
 
@@ -442,6 +1048,7 @@ int comm_rawSockRecv(
 
     LOG_3("<- Raw socket (%s)\n", pContext->ifName);
     LOG_DUMP("Raw recv", pData, len);
+    _rawTap(pContext, PCAP_IN, pData, len);
 
     return len;
 }
@@ -510,6 +1117,81 @@ int comm_rawPromiscMode(tRawHandle handle, int enable)
     return 0;
 }
 
+/**
+*  Attach a filter to the raw socket, so that the frames it rejects are
+*  dropped in the kernel. See @ref comm_bpfCompile for the expression,
+*  e.g. "udp and dst port 53" or "arp or icmp". All the members of a
+*  fan-out handle get the filter.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  pExpr   Filter expression (NULL or empty removes the filter).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawSetFilter(tRawHandle handle, char *pExpr)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: Raw socket is not ready\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (comm_bpfAttach(pContext->fd, pExpr, BPF_LINK_ETHER) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Tap the raw socket, so that the frames it sends and receives are copied
+*  to a pcapng capture as Ethernet frames. All the members of a fan-out
+*  handle are one interface of the capture.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawSetTap(tRawHandle handle, tPcapHandle pcap)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "raw:%s", pContext->ifName);
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_ETHERNET, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        comm_pcapSetTap(&(pContext->tap), pIf);
+    }
+
+    return 0;
+}
+
 /**
 *  Get the device MTU size.
 *  @param [in]  handle  Raw socket handle.
@@ -518,6 +1200,7 @@ int comm_rawPromiscMode(tRawHandle handle, int enable)
 int comm_rawGetMtu(tRawHandle handle)
 {
     tRawContext *pContext = (tRawContext *)handle;
+    tIfCacheInfo info;
 
 
     if (NULL == pContext)
@@ -532,6 +1215,12 @@ int comm_rawGetMtu(tRawHandle handle)
         return 0;
     }
 
+    /* the current MTU if the interface is cached */
+    if (0 == comm_ifCacheGet(pContext->ifName, &info))
+    {
+        pContext->ifMtu = info.mtu;
+    }
+
     return pContext->ifMtu;
 }
 
@@ -543,6 +1232,7 @@ int comm_rawGetMtu(tRawHandle handle)
 unsigned char *comm_rawGetHwAddr(tRawHandle handle)
 {
     tRawContext *pContext = (tRawContext *)handle;
+    tIfCacheInfo info;
 
 
     if (NULL == pContext)
@@ -557,6 +1247,267 @@ unsigned char *comm_rawGetHwAddr(tRawHandle handle)
         return NULL;
     }
 
+    /* the current address if the interface is cached */
+    if (0 == comm_ifCacheGet(pContext->ifName, &info))
+    {
+        memcpy(pContext->ifHwAddr, info.hwAddr, ETH_ALEN);
+    }
+
     return pContext->ifHwAddr;
 }
 
+/**
+*  Get the receive statistics of the raw socket since the last call.
+*  @param [in]   handle    Raw socket handle.
+*  @param [out]  pPackets  Number of received frames.
+*  @param [out]  pDrops    Number of frames dropped for a full buffer or ring.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawGetStat(
+    tRawHandle     handle,
+    unsigned int  *pPackets,
+    unsigned int  *pDrops
+)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+    struct tpacket_stats_v3 stat;
+    socklen_t statLen = sizeof( stat );
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: Raw socket is not ready\n", __func__);
+        return -1;
+    }
+
+    /* a socket without the V3 ring fills the first two counters only */
+    memset(&stat, 0x00, sizeof( stat ));
+    if (getsockopt(pContext->fd, SOL_PACKET, PACKET_STATISTICS, &stat, &statLen) < 0)
+    {
+        perror( "PACKET_STATISTICS" );
+        return -1;
+    }
+
+    if ( pPackets )
+    {
+        *pPackets = stat.tp_packets;
+    }
+
+    if ( pDrops )
+    {
+        *pDrops = stat.tp_drops;
+    }
+
+    return 0;
+}
+
+/**
+*  Set up a PACKET_TX_RING memory-mapped transmit ring on the raw socket.
+*  The frames are filled in place by @ref comm_rawTxReserve and
+*  @ref comm_rawTxCommit, and sent in a batch by @ref comm_rawTxFlush. The
+*  ring has its own socket bound to the device, and it is used by one
+*  sending thread.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  pRing   A @ref tRawRing object (NULL is the default ring).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawSockSetTxRing(tRawHandle handle, tRawRing *pRing)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+    int fd;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pContext->pTxRing )
+    {
+        LOG_WARN("%s: TX ring exists\n", __func__);
+        return -1;
+    }
+
+    /* protocol 0 receives nothing, and the bind keeps it so */
+    fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd < 0)
+    {
+        perror( "socket" );
+        return -1;
+    }
+
+    pContext->txFd = fd;
+    pContext->pTxRing = malloc( sizeof( tTxRing ) );
+    if ((NULL == pContext->pTxRing) ||
+        (comm_ringTxInit(pContext->pTxRing, fd, pRing) != 0) ||
+        (_rawBind(pContext, fd, 0) != 0))
+    {
+        LOG_ERROR("failed to create raw socket TX ring\n");
+        if ( pContext->pTxRing )
+        {
+            comm_ringTxUninit( pContext->pTxRing );
+            free( pContext->pTxRing );
+            pContext->pTxRing = NULL;
+        }
+        close( fd );
+        pContext->txFd = -1;
+        return -1;
+    }
+
+    LOG_1("Raw socket TX ring ready (%s)\n", pContext->ifName);
+    return 0;
+}
+
+/**
+*  Reserve the next free frame slot of the transmit ring. The frame is
+*  written to the slot in place, then committed by @ref comm_rawTxCommit.
+*  @param [in]   handle  Raw socket handle.
+*  @param [out]  pRoom   Max. frame size of the slot.
+*  @returns  Frame data of the slot (NULL is a full ring).
+*/
+unsigned char *comm_rawTxReserve(tRawHandle handle, size_t *pRoom)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return NULL;
+    }
+
+    if (NULL == pContext->pTxRing)
+    {
+        LOG_ERROR("%s: TX ring is not ready\n", __func__);
+        return NULL;
+    }
+
+    pContext->pTxData = comm_ringTxReserve(pContext->pTxRing, pRoom);
+    return pContext->pTxData;
+}
+
+/**
+*  Commit the reserved frame slot. It belongs to the kernel until it is
+*  sent, and it is sent by the next @ref comm_rawTxFlush.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  size    Frame size.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawTxCommit(tRawHandle handle, size_t size)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pContext->pTxRing)
+    {
+        LOG_ERROR("%s: TX ring is not ready\n", __func__);
+        return -1;
+    }
+
+    if (comm_ringTxCommit(pContext->pTxRing, size) != 0)
+    {
+        LOG_WARN("%s: no reserved slot or wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    /* the slot is not changed until the kernel sends it */
+    _rawTap(pContext, PCAP_OUT, pContext->pTxData, size);
+    return 0;
+}
+
+/**
+*  Send all the committed frames of the transmit ring by one system call.
+*  @param [in]  handle  Raw socket handle.
+*  @param [in]  wait    Wait until the frames are sent(1) or not(0).
+*  @returns  Sent bytes (-1 is failed).
+*/
+ssize_t comm_rawTxFlush(tRawHandle handle, int wait)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+    ssize_t len;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pContext->pTxRing)
+    {
+        LOG_ERROR("%s: TX ring is not ready\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> Raw socket TX ring (%s)\n", pContext->ifName);
+    len = send(pContext->txFd, NULL, 0, (( wait ) ? 0 : MSG_DONTWAIT));
+    if (len < 0)
+    {
+        if ((EAGAIN == errno) || (ENOBUFS == errno))
+        {
+            /* the device queue is full, the frames stay in the ring */
+            len = 0;
+        }
+        else
+        {
+            LOG_ERROR("fail to send raw socket TX ring\n");
+            perror( "send" );
+        }
+    }
+
+    comm_ringTxReap( pContext->pTxRing );
+    return len;
+}
+
+/**
+*  Get the completion status of the transmit ring. A frame slot can be
+*  reserved again once the kernel has sent it.
+*  @param [in]   handle    Raw socket handle.
+*  @param [out]  pPending  Number of committed frames not sent yet.
+*  @param [out]  pErrors   Number of frames the kernel could not send.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_rawTxStatus(
+    tRawHandle     handle,
+    unsigned int  *pPending,
+    unsigned int  *pErrors
+)
+{
+    tRawContext *pContext = (tRawContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pContext->pTxRing)
+    {
+        LOG_ERROR("%s: TX ring is not ready\n", __func__);
+        return -1;
+    }
+
+    if ( pPending )
+    {
+        *pPending = comm_ringTxReap( pContext->pTxRing );
+    }
+
+    if ( pErrors )
+    {
+        *pErrors = pContext->pTxRing->errors;
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,661 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_cpu.h"
+#include "comm_reactor.h"
+
+
+#define REACTOR_EVENT_NUM (64)
+
+
+typedef struct _tReactorLoop
+{
+    int                 epfd;
+    int                 wakeFd;
+
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    tReactorEvent      *pDelList;
+
+    struct epoll_event  batch[REACTOR_EVENT_NUM];
+    int                 batchNum;
+
+    pthread_t           thread;
+    int                 running;  /* cleared by uninit */
+    int                 stopped;  /* the loop thread is gone */
+} tReactorLoop;
+
+typedef struct _tReactorContext
+{
+    tReactorLoop  *pLoop;
+    int            loopNum;
+    unsigned int   nextLoop;
+} tReactorContext;
+
+
+/* The reactor selected by comm_setReactor() (0 is none) */
+tReactorHandle g_reactor = 0;
+
+/* The event loop of the calling thread (NULL is not a loop thread) */
+static __thread tReactorLoop *_pCurLoop = NULL;
+
+
+/**
+*  Drop an event object from the batch being dispatched.
+*  @param [in]  pLoop   A @ref tReactorLoop object.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*/
+static void _reactorForget(tReactorLoop *pLoop, tReactorEvent *pEvent)
+{
+    int i;
+
+    for (i=0; i<pLoop->batchNum; i++)
+    {
+        if (pLoop->batch[i].data.ptr == pEvent)
+        {
+            pLoop->batch[i].data.ptr = NULL;
+        }
+    }
+}
+
+/**
+*  Handle the pending removal requests of other threads.
+*  @param [in]  pLoop  A @ref tReactorLoop object.
+*/
+static void _reactorFlushDelList(tReactorLoop *pLoop)
+{
+    tReactorEvent *pFreeList = NULL;
+    tReactorEvent *pEvent;
+
+    pthread_mutex_lock( &(pLoop->mutex) );
+    while ( pLoop->pDelList )
+    {
+        pEvent = pLoop->pDelList;
+        pLoop->pDelList = pEvent->pNext;
+
+        epoll_ctl(pLoop->epfd, EPOLL_CTL_DEL, pEvent->fd, NULL);
+        _reactorForget(pLoop, pEvent);
+
+        if ( pEvent->pFreeFunc )
+        {
+            /* nobody waits for it, release the owner after the removals */
+            pEvent->pLoop = NULL;
+            pEvent->pNext = pFreeList;
+            pFreeList = pEvent;
+        }
+        else
+        {
+            pEvent->pNext = NULL;
+            pEvent->done = 1;
+        }
+    }
+    pthread_cond_broadcast( &(pLoop->cond) );
+    pthread_mutex_unlock( &(pLoop->mutex) );
+
+    while ( pFreeList )
+    {
+        pEvent = pFreeList;
+        pFreeList = pEvent->pNext;
+        pEvent->pNext = NULL;
+        pEvent->pFreeFunc( pEvent->pFreeArg );
+    }
+}
+
+/**
+*  Thread function for the reactor event loop.
+*  @param [in]  pArg  A @ref tReactorLoop object.
+*/
+static void *_reactorLoopTask(void *pArg)
+{
+    tReactorLoop *pLoop = pArg;
+    tReactorEvent *pEvent;
+    uint64_t count;
+    int num;
+    int i;
+
+
+    LOG_2("start the thread: %s\n", __func__);
+    _pCurLoop = pLoop;
+
+    while ( __atomic_load_n(&(pLoop->running), __ATOMIC_ACQUIRE) )
+    {
+        LOG_3("reactor ... epoll_wait\n");
+        num = epoll_wait(pLoop->epfd, pLoop->batch, REACTOR_EVENT_NUM, -1);
+        if (num < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            LOG_ERROR("fail to wait reactor events\n");
+            perror( "epoll_wait" );
+            break;
+        }
+
+        for (i=0; i<num; i++)
+        {
+            if (pLoop->batch[i].data.ptr == (void *)pLoop)
+            {
+                /* wake-up by comm_reactorDelEvent() or uninit, drained
+                   before the flush so that a later request wakes again */
+                if (read(pLoop->wakeFd, &count, sizeof( count )) < 0)
+                {
+                    perror( "read" );
+                }
+                pLoop->batch[i].data.ptr = NULL;
+            }
+        }
+
+        pLoop->batchNum = num;
+        _reactorFlushDelList( pLoop );
+
+        for (i=0; i<num; i++)
+        {
+            pEvent = pLoop->batch[i].data.ptr;
+
+            if (( pEvent ) && ( pEvent->pEventFunc ))
+            {
+                pEvent->pEventFunc(pEvent->pArg, pLoop->batch[i].events);
+            }
+        }
+
+        pLoop->batchNum = 0;
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
+
+    pthread_mutex_lock( &(pLoop->mutex) );
+    pLoop->stopped = 1;
+    pthread_mutex_unlock( &(pLoop->mutex) );
+    _reactorFlushDelList( pLoop );
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Initialize a reactor event loop.
+*  @param [in]  pLoop  A @ref tReactorLoop object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _reactorInitLoop(tReactorLoop *pLoop)
+{
+    struct epoll_event event;
+
+
+    pLoop->epfd = epoll_create1( EPOLL_CLOEXEC );
+    if (pLoop->epfd < 0)
+    {
+        perror( "epoll_create1" );
+        return -1;
+    }
+
+    pLoop->wakeFd = eventfd(0, (EFD_NONBLOCK | EFD_CLOEXEC));
+    if (pLoop->wakeFd < 0)
+    {
+        perror( "eventfd" );
+        close( pLoop->epfd );
+        return -1;
+    }
+
+    memset(&event, 0x00, sizeof( struct epoll_event ));
+    event.events   = EPOLLIN;
+    event.data.ptr = pLoop;
+    if (epoll_ctl(pLoop->epfd, EPOLL_CTL_ADD, pLoop->wakeFd, &event) < 0)
+    {
+        perror( "epoll_ctl" );
+        close( pLoop->wakeFd );
+        close( pLoop->epfd );
+        return -1;
+    }
+
+    pthread_mutex_init(&(pLoop->mutex), NULL);
+    pthread_cond_init(&(pLoop->cond), NULL);
+
+    return 0;
+}
+
+/**
+*  Un-initialize a reactor event loop.
+*  @param [in]  pLoop  A @ref tReactorLoop object.
+*/
+static void _reactorUninitLoop(tReactorLoop *pLoop)
+{
+    pthread_cond_destroy( &(pLoop->cond) );
+    pthread_mutex_destroy( &(pLoop->mutex) );
+    close( pLoop->wakeFd );
+    close( pLoop->epfd );
+}
+
+/**
+*  Wake up a reactor event loop.
+*  @param [in]  pLoop  A @ref tReactorLoop object.
+*/
+static void _reactorWakeup(tReactorLoop *pLoop)
+{
+    uint64_t count = 1;
+
+    if (write(pLoop->wakeFd, &count, sizeof( count )) < 0)
+    {
+        perror( "write" );
+    }
+}
+
+/**
+*  Register a file descriptor to an event loop.
+*  @param [in]  pLoop       A @ref tReactorLoop object.
+*  @param [in]  pEvent      A @ref tReactorEvent object owned by the caller.
+*  @param [in]  fd          File descriptor.
+*  @param [in]  events      EPOLLIN / EPOLLOUT mask.
+*  @param [in]  pEventFunc  Event callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _reactorAddEvent(
+    tReactorLoop    *pLoop,
+    tReactorEvent   *pEvent,
+    int              fd,
+    unsigned int     events,
+    tReactorEventCb  pEventFunc,
+    void            *pArg
+)
+{
+    struct epoll_event event;
+
+    pEvent->fd = fd;
+    pEvent->events = events;
+    pEvent->pEventFunc = pEventFunc;
+    pEvent->pArg = pArg;
+    pEvent->pLoop = pLoop;
+    pEvent->pNext = NULL;
+    pEvent->done = 0;
+    pEvent->pFreeFunc = NULL;
+
+    memset(&event, 0x00, sizeof( struct epoll_event ));
+    event.events   = events;
+    event.data.ptr = pEvent;
+    if (epoll_ctl(pLoop->epfd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        perror( "epoll_ctl" );
+        pEvent->pLoop = NULL;
+        return -1;
+    }
+
+    LOG_3("reactor add fd(%d)\n", fd);
+    return 0;
+}
+
+/**
+*  Initialize reactor.
+*  @param [in]  threadNum  Number of event loop threads.
+*  @returns  Reactor handle.
+*/
+tReactorHandle comm_reactorInit(int threadNum)
+{
+    tReactorContext *pContext = NULL;
+    pthread_attr_t tattr;
+    int error;
+    int i;
+
+
+    if (threadNum <= 0)
+    {
+        LOG_1("set reactor thread number to 1\n");
+        threadNum = 1;
+    }
+
+    pContext = malloc( sizeof( tReactorContext ) );
+    if (NULL == pContext)
+    {
+        LOG_ERROR("fail to allocate reactor context\n");
+        return 0;
+    }
+
+    memset(pContext, 0x00, sizeof( tReactorContext ));
+
+    pContext->pLoop = malloc( sizeof( tReactorLoop ) * threadNum );
+    if (NULL == pContext->pLoop)
+    {
+        LOG_ERROR("fail to allocate reactor loops\n");
+        free( pContext );
+        return 0;
+    }
+
+    memset(pContext->pLoop, 0x00, sizeof( tReactorLoop ) * threadNum);
+
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+
+    for (i=0; i<threadNum; i++)
+    {
+        tReactorLoop *pLoop = &(pContext->pLoop[i]);
+
+        error = _reactorInitLoop( pLoop );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to create reactor loop %d\n", i);
+            break;
+        }
+
+        pLoop->running = 1;
+
+        error = pthread_create(
+                    &(pLoop->thread),
+                    &tattr,
+                    _reactorLoopTask,
+                    pLoop
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to create reactor thread %d\n", i);
+            _reactorUninitLoop( pLoop );
+            break;
+        }
+
+        pContext->loopNum++;
+    }
+
+    pthread_attr_destroy( &tattr );
+
+    if (pContext->loopNum != threadNum)
+    {
+        comm_reactorUninit( (tReactorHandle)pContext );
+        return 0;
+    }
+
+    LOG_1("reactor initialized (%d threads)\n", threadNum);
+    return ((tReactorHandle)pContext);
+}
+
+/**
+*  Un-initialize reactor.
+*  All the handles attached to the reactor must be un-initialized first.
+*  @param [in]  handle  Reactor handle.
+*/
+void comm_reactorUninit(tReactorHandle handle)
+{
+    tReactorContext *pContext = (tReactorContext *)handle;
+    int i;
+
+    if ( pContext )
+    {
+        if (g_reactor == handle)
+        {
+            g_reactor = 0;
+        }
+
+        for (i=0; i<pContext->loopNum; i++)
+        {
+            pthread_mutex_lock( &(pContext->pLoop[i].mutex) );
+            __atomic_store_n(&(pContext->pLoop[i].running), 0, __ATOMIC_RELEASE);
+            _reactorWakeup( &(pContext->pLoop[i]) );
+            pthread_mutex_unlock( &(pContext->pLoop[i].mutex) );
+        }
+
+        for (i=0; i<pContext->loopNum; i++)
+        {
+            pthread_join(pContext->pLoop[i].thread, NULL);
+            _reactorUninitLoop( &(pContext->pLoop[i]) );
+        }
+
+        free( pContext->pLoop );
+        free( pContext );
+        LOG_1("reactor un-initialized\n");
+    }
+}
+
+/**
+*  Select the reactor used by the following initialization functions.
+*  The handles initialized afterwards are served by the reactor threads
+*  instead of their own receiving threads.
+*  @param [in]  handle  Reactor handle (0 to restore thread per handle).
+*/
+void comm_setReactor(tReactorHandle handle)
+{
+    g_reactor = handle;
+}
+
+/**
+*  Get the selected reactor.
+*  @returns  Reactor handle.
+*/
+tReactorHandle comm_getReactor(void)
+{
+    return g_reactor;
+}
+
+/**
+*  Register a file descriptor to one of the reactor threads.
+*  @param [in]  handle      Reactor handle.
+*  @param [in]  pEvent      A @ref tReactorEvent object owned by the caller.
+*  @param [in]  fd          File descriptor.
+*  @param [in]  events      EPOLLIN / EPOLLOUT mask.
+*  @param [in]  pEventFunc  Event callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_reactorAddEvent(
+    tReactorHandle   handle,
+    tReactorEvent   *pEvent,
+    int              fd,
+    unsigned int     events,
+    tReactorEventCb  pEventFunc,
+    void            *pArg
+)
+{
+    tReactorContext *pContext = (tReactorContext *)handle;
+    tReactorLoop *pLoop;
+    unsigned int index;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pEvent)
+    {
+        LOG_ERROR("%s: pEvent is NULL\n", __func__);
+        return -1;
+    }
+
+    /* spread the descriptors over the event loops */
+    index = __sync_fetch_and_add(&(pContext->nextLoop), 1);
+    pLoop = &(pContext->pLoop[index % pContext->loopNum]);
+
+    return _reactorAddEvent(pLoop, pEvent, fd, events, pEventFunc, pArg);
+}
+
+/**
+*  Register a file descriptor to the reactor thread of another event, so
+*  the callbacks of both never run at the same time.
+*  @param [in]  pNear       A registered @ref tReactorEvent object.
+*  @param [in]  pEvent      A @ref tReactorEvent object owned by the caller.
+*  @param [in]  fd          File descriptor.
+*  @param [in]  events      EPOLLIN / EPOLLOUT mask.
+*  @param [in]  pEventFunc  Event callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_reactorAddEventNear(
+    tReactorEvent   *pNear,
+    tReactorEvent   *pEvent,
+    int              fd,
+    unsigned int     events,
+    tReactorEventCb  pEventFunc,
+    void            *pArg
+)
+{
+    if ((NULL == pNear) || (NULL == pNear->pLoop))
+    {
+        LOG_ERROR("%s: pNear is not registered\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pEvent)
+    {
+        LOG_ERROR("%s: pEvent is NULL\n", __func__);
+        return -1;
+    }
+
+    return _reactorAddEvent(pNear->pLoop, pEvent, fd, events, pEventFunc, pArg);
+}
+
+/**
+*  Pin the reactor threads to the CPUs this process may run on, one CPU
+*  for each thread in turn.
+*  @param [in]  handle  Reactor handle.
+*/
+void comm_reactorPin(tReactorHandle handle)
+{
+    tReactorContext *pContext = (tReactorContext *)handle;
+    int i;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return;
+    }
+
+    for (i=0; i<pContext->loopNum; i++)
+    {
+        comm_cpuPin(pContext->pLoop[i].thread, i);
+    }
+}
+
+/**
+*  Change the event mask of a registered file descriptor.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*  @param [in]  events  EPOLLIN / EPOLLOUT mask.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_reactorModEvent(tReactorEvent *pEvent, unsigned int events)
+{
+    tReactorLoop *pLoop = pEvent->pLoop;
+    struct epoll_event event;
+
+
+    if (NULL == pLoop)
+    {
+        LOG_ERROR("%s: fd(%d) is not attached\n", __func__, pEvent->fd);
+        return -1;
+    }
+
+    memset(&event, 0x00, sizeof( struct epoll_event ));
+    event.events   = events;
+    event.data.ptr = pEvent;
+    if (epoll_ctl(pLoop->epfd, EPOLL_CTL_MOD, pEvent->fd, &event) < 0)
+    {
+        perror( "epoll_ctl" );
+        return -1;
+    }
+
+    pEvent->events = events;
+    return 0;
+}
+
+/**
+*  Remove a file descriptor from the reactor and release its owner when
+*  the event callback is neither running nor will be called again. The
+*  release is done before it returns, except when it is called by a
+*  callback of another loop: then the owning loop removes the event and
+*  releases the owner later, so two loops never wait for each other. The
+*  release function is required there, nothing else knows when the
+*  owner may be freed.
+*  @param [in]  pEvent     A @ref tReactorEvent object.
+*  @param [in]  pFreeFunc  Release function (NULL is none).
+*  @param [in]  pArg       Release function argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_reactorDelEventFree(
+    tReactorEvent   *pEvent,
+    tReactorFreeCb   pFreeFunc,
+    void            *pArg
+)
+{
+    tReactorLoop *pLoop = pEvent->pLoop;
+
+    if (NULL == pLoop)
+    {
+        goto _RELEASE;
+    }
+
+    LOG_3("reactor remove fd(%d)\n", pEvent->fd);
+
+    if ( pthread_equal(pthread_self(), pLoop->thread) )
+    {
+        /* called by an event callback of this loop */
+        epoll_ctl(pLoop->epfd, EPOLL_CTL_DEL, pEvent->fd, NULL);
+        _reactorForget(pLoop, pEvent);
+        pEvent->pLoop = NULL;
+        goto _RELEASE;
+    }
+
+    pthread_mutex_lock( &(pLoop->mutex) );
+    if ( pLoop->stopped )
+    {
+        /* the loop thread is gone */
+        epoll_ctl(pLoop->epfd, EPOLL_CTL_DEL, pEvent->fd, NULL);
+        pthread_mutex_unlock( &(pLoop->mutex) );
+        pEvent->pLoop = NULL;
+        goto _RELEASE;
+    }
+
+    if (( _pCurLoop ) && (NULL == pFreeFunc))
+    {
+        /* the owning loop would remove the event after the caller frees it */
+        LOG_ERROR("%s: fd(%d) of another loop needs a release function\n", __func__, pEvent->fd);
+        pthread_mutex_unlock( &(pLoop->mutex) );
+        return -1;
+    }
+
+    /* let the loop remove it between two dispatches */
+    pEvent->done = 0;
+    pEvent->pFreeFunc = NULL;
+    pEvent->pNext = pLoop->pDelList;
+    pLoop->pDelList = pEvent;
+    _reactorWakeup( pLoop );
+
+    if ( _pCurLoop )
+    {
+        /* a callback of another loop, the owning loop releases it */
+        pEvent->pFreeFunc = pFreeFunc;
+        pEvent->pFreeArg  = pArg;
+        pthread_mutex_unlock( &(pLoop->mutex) );
+        return 0;
+    }
+
+    while ( !pEvent->done )
+    {
+        pthread_cond_wait(&(pLoop->cond), &(pLoop->mutex));
+    }
+    pthread_mutex_unlock( &(pLoop->mutex) );
+    pEvent->pLoop = NULL;
+
+_RELEASE:
+    if ( pFreeFunc )
+    {
+        pFreeFunc( pArg );
+    }
+    return 0;
+}
+
+/**
+*  Remove a file descriptor from the reactor. When it returns the event
+*  callback is neither running nor will be called again, so the caller
+*  may close the descriptor and free the object. Called by a callback of
+*  another loop it fails and removes nothing, use
+*  @ref comm_reactorDelEventFree there.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_reactorDelEvent(tReactorEvent *pEvent)
+{
+    return comm_reactorDelEventFree(pEvent, NULL, NULL);
+}
@@ -0,0 +1,133 @@
+#ifndef __COMM_REACTOR_H__
+#define __COMM_REACTOR_H__
+
+#include <sys/epoll.h>
+#include "comm_if.h"
+
+
+/**
+*  Reactor event callback.
+*  @param [in]  pArg    Owner's argument.
+*  @param [in]  events  EPOLLIN / EPOLLOUT / EPOLLERR / EPOLLHUP mask.
+*/
+typedef void (*tReactorEventCb)(void *pArg, unsigned int events);
+
+/**
+*  Release function of a removed event's owner.
+*  @param [in]  pArg  Owner's argument.
+*/
+typedef void (*tReactorFreeCb)(void *pArg);
+
+typedef struct _tReactorEvent
+{
+    int                    fd;
+    unsigned int           events;
+    tReactorEventCb        pEventFunc;
+    void                  *pArg;
+
+    /* owned by the reactor */
+    void                  *pLoop;
+    struct _tReactorEvent *pNext;
+    int                    done;
+    tReactorFreeCb         pFreeFunc;
+    void                  *pFreeArg;
+} tReactorEvent;
+
+
+/* The reactor selected by comm_setReactor() (0 is none) */
+extern tReactorHandle g_reactor;
+
+
+/**
+*  Register a file descriptor to one of the reactor threads.
+*  @param [in]  handle      Reactor handle.
+*  @param [in]  pEvent      A @ref tReactorEvent object owned by the caller.
+*  @param [in]  fd          File descriptor.
+*  @param [in]  events      EPOLLIN / EPOLLOUT mask.
+*  @param [in]  pEventFunc  Event callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_reactorAddEvent(
+         tReactorHandle   handle,
+         tReactorEvent   *pEvent,
+         int              fd,
+         unsigned int     events,
+         tReactorEventCb  pEventFunc,
+         void            *pArg
+     );
+
+/**
+*  Register a file descriptor to the reactor thread of another event, so
+*  the callbacks of both never run at the same time.
+*  @param [in]  pNear       A registered @ref tReactorEvent object.
+*  @param [in]  pEvent      A @ref tReactorEvent object owned by the caller.
+*  @param [in]  fd          File descriptor.
+*  @param [in]  events      EPOLLIN / EPOLLOUT mask.
+*  @param [in]  pEventFunc  Event callback function.
+*  @param [in]  pArg        Callback argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_reactorAddEventNear(
+         tReactorEvent   *pNear,
+         tReactorEvent   *pEvent,
+         int              fd,
+         unsigned int     events,
+         tReactorEventCb  pEventFunc,
+         void            *pArg
+     );
+
+/**
+*  Change the event mask of a registered file descriptor.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*  @param [in]  events  EPOLLIN / EPOLLOUT mask.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_reactorModEvent(tReactorEvent *pEvent, unsigned int events);
+
+/**
+*  Remove a file descriptor from the reactor. When it returns the event
+*  callback is neither running nor will be called again, so the caller
+*  may close the descriptor and free the object. Called by a callback of
+*  another loop it fails and removes nothing, use
+*  @ref comm_reactorDelEventFree there.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_reactorDelEvent(tReactorEvent *pEvent);
+
+/**
+*  Remove a file descriptor from the reactor and release its owner when
+*  the event callback is neither running nor will be called again. The
+*  release is done before it returns, except when it is called by a
+*  callback of another loop: then the owning loop removes the event and
+*  releases the owner later, so two loops never wait for each other. The
+*  release function is required there, nothing else knows when the
+*  owner may be freed.
+*  @param [in]  pEvent     A @ref tReactorEvent object.
+*  @param [in]  pFreeFunc  Release function (NULL is none).
+*  @param [in]  pArg       Release function argument.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_reactorDelEventFree(
+         tReactorEvent   *pEvent,
+         tReactorFreeCb   pFreeFunc,
+         void            *pArg
+     );
+
+/**
+*  Check whether an event object is registered.
+*  @param [in]  pEvent  A @ref tReactorEvent object.
+*  @returns  Boolean.
+*/
+#define comm_reactorAttached(pEvent) (NULL != (pEvent)->pLoop)
+
+/**
+*  Pin the reactor threads to the CPUs this process may run on, one CPU
+*  for each thread in turn.
+*  @param [in]  handle  Reactor handle.
+*/
+void comm_reactorPin(tReactorHandle handle);
+
+
+#endif /* __COMM_REACTOR_H__ */
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_ring.h"
+
+
+/**
+*  Get a block of the receive ring.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @param [in]  index  Block index.
+*  @returns  Block descriptor.
+*/
+static struct tpacket_block_desc *_ringRxBlock(tRxRing *pRing, unsigned int index)
+{
+    return (struct tpacket_block_desc *)(pRing->pMap + ((size_t)index * pRing->req.tp_block_size));
+}
+
+/**
+*  Get the ring geometry from the configuration.
+*  @param [in]   pCfg  A @ref tRawRing object (NULL is the default ring).
+*  @param [out]  pReq  Block and frame sizes of the ring.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _ringSize(tRawRing *pCfg, struct tpacket_req *pReq)
+{
+    long pageSize = sysconf( _SC_PAGESIZE );
+
+    pReq->tp_block_size = COMM_RAW_RING_BLOCK_SIZE;
+    pReq->tp_block_nr = COMM_RAW_RING_BLOCK_NUM;
+    pReq->tp_frame_size = COMM_RAW_RING_FRAME_SIZE;
+
+    if ( pCfg )
+    {
+        if (pCfg->blockSize > 0)
+        {
+            pReq->tp_block_size = pCfg->blockSize;
+        }
+
+        if (pCfg->blockNum > 0)
+        {
+            pReq->tp_block_nr = pCfg->blockNum;
+        }
+
+        if (pCfg->frameSize > 0)
+        {
+            pReq->tp_frame_size = pCfg->frameSize;
+        }
+    }
+
+    /* the kernel wants page-sized blocks and aligned frames */
+    if ((pReq->tp_block_size % pageSize) ||
+        (pReq->tp_frame_size % TPACKET_ALIGNMENT) ||
+        (pReq->tp_frame_size > pReq->tp_block_size))
+    {
+        LOG_ERROR(
+            "wrong ring block size %u or frame size %u\n",
+            pReq->tp_block_size,
+            pReq->tp_frame_size
+        );
+        return -1;
+    }
+
+    pReq->tp_frame_nr = (pReq->tp_block_size / pReq->tp_frame_size) * pReq->tp_block_nr;
+    return 0;
+}
+
+/**
+*  Map the ring of a packet socket.
+*  @param [in]  fd    Packet socket file descriptor.
+*  @param [in]  size  Ring size.
+*  @returns  Ring memory (NULL is failed).
+*/
+static unsigned char *_ringMap(int fd, size_t size)
+{
+    unsigned char *pMap;
+
+    pMap = mmap(
+               NULL,
+               size,
+               (PROT_READ | PROT_WRITE),
+               (MAP_SHARED | MAP_POPULATE),
+               fd,
+               0
+           );
+    if (MAP_FAILED == pMap)
+    {
+        perror( "mmap" );
+        return NULL;
+    }
+
+    return pMap;
+}
+
+/**
+*  Set up a TPACKET_V3 receive ring on a packet socket and map it.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @param [in]  fd     Packet socket file descriptor, not bound yet.
+*  @param [in]  pCfg   A @ref tRawRing object (NULL is the default ring).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ringRxInit(tRxRing *pRing, int fd, tRawRing *pCfg)
+{
+    struct tpacket_req3 *pReq = &(pRing->req);
+    struct tpacket_req req;
+    int version = TPACKET_V3;
+
+
+    memset(pRing, 0x00, sizeof( tRxRing ));
+    if (_ringSize(pCfg, &req) != 0)
+    {
+        return -1;
+    }
+
+    pReq->tp_block_size = req.tp_block_size;
+    pReq->tp_block_nr = req.tp_block_nr;
+    pReq->tp_frame_size = req.tp_frame_size;
+    pReq->tp_frame_nr = req.tp_frame_nr;
+    pReq->tp_retire_blk_tov = COMM_RAW_RING_TIMEOUT;
+    if (( pCfg ) && (pCfg->timeout > 0))
+    {
+        pReq->tp_retire_blk_tov = pCfg->timeout;
+    }
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof( version )) < 0)
+    {
+        perror( "PACKET_VERSION" );
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, pReq, sizeof( struct tpacket_req3 )) < 0)
+    {
+        perror( "PACKET_RX_RING" );
+        return -1;
+    }
+
+    pRing->mapSize = (size_t)pReq->tp_block_size * pReq->tp_block_nr;
+    pRing->pMap = _ringMap(fd, pRing->mapSize);
+    if (NULL == pRing->pMap)
+    {
+        return -1;
+    }
+
+    LOG_2(
+        "RX ring: %u blocks of %u bytes\n",
+        pReq->tp_block_nr,
+        pReq->tp_block_size
+    );
+    return 0;
+}
+
+/**
+*  Unmap the receive ring.
+*  @param [in]  pRing  A @ref tRxRing object.
+*/
+void comm_ringRxUninit(tRxRing *pRing)
+{
+    if ( pRing->pMap )
+    {
+        munmap(pRing->pMap, pRing->mapSize);
+        pRing->pMap = NULL;
+    }
+}
+
+/**
+*  Check if a block is ready to read.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @returns  Ready(1) or not(0).
+*/
+int comm_ringRxReady(tRxRing *pRing)
+{
+    struct tpacket_block_desc *pDesc = _ringRxBlock(pRing, pRing->block);
+
+    return ((__atomic_load_n(&(pDesc->hdr.bh1.block_status), __ATOMIC_ACQUIRE)
+             & TP_STATUS_USER) != 0);
+}
+
+/**
+*  Pass the frames of all the blocks retired by the kernel to the callback,
+*  and give the blocks back to the kernel.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @param [in]  pFunc  Ring callback.
+*  @param [in]  pArg   Callback argument.
+*  @returns  Number of frames (0 is no block ready).
+*/
+int comm_ringRxRead(tRxRing *pRing, tRawRingCb pFunc, void *pArg)
+{
+    struct tpacket_block_desc *pDesc;
+    struct tpacket3_hdr *pHdr;
+    unsigned int num;
+    unsigned int i;
+    int count = 0;
+    int n;
+
+
+    while ( comm_ringRxReady( pRing ) )
+    {
+        pDesc = _ringRxBlock(pRing, pRing->block);
+        num = pDesc->hdr.bh1.num_pkts;
+        pHdr = (struct tpacket3_hdr *)((unsigned char *)pDesc + pDesc->hdr.bh1.offset_to_first_pkt);
+
+        LOG_3("<- RX ring block %u (%u frames)\n", pRing->block, num);
+
+        for (i=0, n=0; i<num; i++)
+        {
+            pRing->frame[n].pData   = (unsigned char *)pHdr + pHdr->tp_mac;
+            pRing->frame[n].size    = pHdr->tp_snaplen;
+            pRing->frame[n].wireLen = pHdr->tp_len;
+            pRing->frame[n].sec     = pHdr->tp_sec;
+            pRing->frame[n].nsec    = pHdr->tp_nsec;
+            if (++n == RING_BATCH_NUM)
+            {
+                pFunc(pArg, pRing->frame, n);
+                n = 0;
+            }
+
+            pHdr = (struct tpacket3_hdr *)((unsigned char *)pHdr + pHdr->tp_next_offset);
+        }
+
+        if (n > 0)
+        {
+            pFunc(pArg, pRing->frame, n);
+        }
+
+        /* the frames are not valid after the callbacks */
+        __atomic_store_n(&(pDesc->hdr.bh1.block_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        pRing->block = (pRing->block + 1) % pRing->req.tp_block_nr;
+        count += num;
+    }
+
+    return count;
+}
+
+/**
+*  Get a frame slot of the transmit ring.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @param [in]  index  Frame index.
+*  @returns  Frame header.
+*/
+static struct tpacket2_hdr *_ringTxFrame(tTxRing *pRing, unsigned int index)
+{
+    unsigned int perBlock = pRing->req.tp_block_size / pRing->req.tp_frame_size;
+
+    return (struct tpacket2_hdr *)(pRing->pMap +
+                                   ((size_t)(index / perBlock) * pRing->req.tp_block_size) +
+                                   ((size_t)(index % perBlock) * pRing->req.tp_frame_size));
+}
+
+/**
+*  Set up a TPACKET_V2 transmit ring on a packet socket and map it.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @param [in]  fd     Packet socket file descriptor, not bound yet.
+*  @param [in]  pCfg   A @ref tRawRing object (NULL is the default ring).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ringTxInit(tTxRing *pRing, int fd, tRawRing *pCfg)
+{
+    int version = TPACKET_V2;
+
+    memset(pRing, 0x00, sizeof( tTxRing ));
+    if (_ringSize(pCfg, &(pRing->req)) != 0)
+    {
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof( version )) < 0)
+    {
+        perror( "PACKET_VERSION" );
+        return -1;
+    }
+
+    if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &(pRing->req), sizeof( struct tpacket_req )) < 0)
+    {
+        perror( "PACKET_TX_RING" );
+        return -1;
+    }
+
+    pRing->mapSize = (size_t)pRing->req.tp_block_size * pRing->req.tp_block_nr;
+    pRing->pMap = _ringMap(fd, pRing->mapSize);
+    if (NULL == pRing->pMap)
+    {
+        return -1;
+    }
+
+    LOG_2(
+        "TX ring: %u frames of %u bytes\n",
+        pRing->req.tp_frame_nr,
+        pRing->req.tp_frame_size
+    );
+    return 0;
+}
+
+/**
+*  Unmap the transmit ring.
+*  @param [in]  pRing  A @ref tTxRing object.
+*/
+void comm_ringTxUninit(tTxRing *pRing)
+{
+    if ( pRing->pMap )
+    {
+        munmap(pRing->pMap, pRing->mapSize);
+        pRing->pMap = NULL;
+    }
+}
+
+/**
+*  Take back the frame slots the kernel has sent, oldest first.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @returns  Number of frames still owned by the kernel.
+*/
+unsigned int comm_ringTxReap(tTxRing *pRing)
+{
+    struct tpacket2_hdr *pHdr;
+    unsigned int status;
+
+
+    while (pRing->pending > 0)
+    {
+        pHdr = _ringTxFrame(pRing, pRing->tail);
+        status = __atomic_load_n(&(pHdr->tp_status), __ATOMIC_ACQUIRE);
+        if (status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING))
+        {
+            break;
+        }
+
+        if (status & TP_STATUS_WRONG_FORMAT)
+        {
+            /* the kernel stops at a malformed frame, drop it */
+            pRing->errors++;
+            __atomic_store_n(&(pHdr->tp_status), TP_STATUS_AVAILABLE, __ATOMIC_RELEASE);
+        }
+
+        pRing->tail = (pRing->tail + 1) % pRing->req.tp_frame_nr;
+        pRing->pending--;
+    }
+
+    return pRing->pending;
+}
+
+/**
+*  Reserve the next free frame slot to fill in place.
+*  @param [in]   pRing  A @ref tTxRing object.
+*  @param [out]  pRoom  Max. frame size of the slot.
+*  @returns  Frame data of the slot (NULL is a full ring).
+*/
+unsigned char *comm_ringTxReserve(tTxRing *pRing, size_t *pRoom)
+{
+    if ((pRing->pending + pRing->reserved) >= pRing->req.tp_frame_nr)
+    {
+        if ((comm_ringTxReap( pRing ) + pRing->reserved) >= pRing->req.tp_frame_nr)
+        {
+            return NULL;
+        }
+    }
+
+    if ( pRoom )
+    {
+        *pRoom = pRing->req.tp_frame_size - RING_TX_DATA_OFFSET;
+    }
+
+    pRing->reserved = 1;
+    return ((unsigned char *)_ringTxFrame(pRing, pRing->head) + RING_TX_DATA_OFFSET);
+}
+
+/**
+*  Hand the reserved slot to the kernel, it is sent by the next kick.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @param [in]  size   Frame size.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_ringTxCommit(tTxRing *pRing, size_t size)
+{
+    struct tpacket2_hdr *pHdr;
+
+    if (( !pRing->reserved ) ||
+        (size > (pRing->req.tp_frame_size - RING_TX_DATA_OFFSET)))
+    {
+        return -1;
+    }
+
+    pHdr = _ringTxFrame(pRing, pRing->head);
+    pHdr->tp_len = size;
+    __atomic_store_n(&(pHdr->tp_status), TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+    pRing->head = (pRing->head + 1) % pRing->req.tp_frame_nr;
+    pRing->reserved = 0;
+    pRing->pending++;
+    return 0;
+}
@@ -0,0 +1,108 @@
+#ifndef __COMM_RING_H__
+#define __COMM_RING_H__
+
+#include <linux/if_packet.h>
+#include "comm_if.h"
+
+
+/* Frames passed to one ring callback */
+#define RING_BATCH_NUM (256)
+
+/* Frame data of a TPACKET_V2 transmit slot follows the aligned header */
+#define RING_TX_DATA_OFFSET  TPACKET_ALIGN(sizeof( struct tpacket2_hdr ))
+
+typedef struct _tRxRing
+{
+    struct tpacket_req3  req;
+    unsigned char       *pMap;  /* NULL is no ring */
+    size_t               mapSize;
+    unsigned int         block;  /* next block to read */
+
+    tRawFrame            frame[RING_BATCH_NUM];
+} tRxRing;
+
+typedef struct _tTxRing
+{
+    struct tpacket_req   req;
+    unsigned char       *pMap;  /* NULL is no ring */
+    size_t               mapSize;
+    unsigned int         head;      /* next slot to reserve */
+    unsigned int         tail;      /* oldest slot owned by the kernel */
+    unsigned int         pending;   /* slots owned by the kernel */
+    int                  reserved;  /* the head slot is being filled */
+    unsigned int         errors;    /* frames the kernel could not send */
+} tTxRing;
+
+
+/**
+*  Set up a TPACKET_V3 receive ring on a packet socket and map it.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @param [in]  fd     Packet socket file descriptor, not bound yet.
+*  @param [in]  pCfg   A @ref tRawRing object (NULL is the default ring).
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_ringRxInit(tRxRing *pRing, int fd, tRawRing *pCfg);
+
+/**
+*  Unmap the receive ring.
+*  @param [in]  pRing  A @ref tRxRing object.
+*/
+void comm_ringRxUninit(tRxRing *pRing);
+
+/**
+*  Pass the frames of all the blocks retired by the kernel to the callback,
+*  and give the blocks back to the kernel.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @param [in]  pFunc  Ring callback.
+*  @param [in]  pArg   Callback argument.
+*  @returns  Number of frames (0 is no block ready).
+*/
+int  comm_ringRxRead(tRxRing *pRing, tRawRingCb pFunc, void *pArg);
+
+/**
+*  Check if a block is ready to read.
+*  @param [in]  pRing  A @ref tRxRing object.
+*  @returns  Ready(1) or not(0).
+*/
+int  comm_ringRxReady(tRxRing *pRing);
+
+/**
+*  Set up a TPACKET_V2 transmit ring on a packet socket and map it.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @param [in]  fd     Packet socket file descriptor, not bound yet.
+*  @param [in]  pCfg   A @ref tRawRing object (NULL is the default ring).
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_ringTxInit(tTxRing *pRing, int fd, tRawRing *pCfg);
+
+/**
+*  Unmap the transmit ring.
+*  @param [in]  pRing  A @ref tTxRing object.
+*/
+void comm_ringTxUninit(tTxRing *pRing);
+
+/**
+*  Take back the frame slots the kernel has sent, oldest first.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @returns  Number of frames still owned by the kernel.
+*/
+unsigned int comm_ringTxReap(tTxRing *pRing);
+
+/**
+*  Reserve the next free frame slot to fill in place.
+*  @param [in]   pRing  A @ref tTxRing object.
+*  @param [out]  pRoom  Max. frame size of the slot.
+*  @returns  Frame data of the slot (NULL is a full ring).
+*/
+unsigned char *comm_ringTxReserve(tTxRing *pRing, size_t *pRoom);
+
+/**
+*  Hand the reserved slot to the kernel, it is sent by the next kick.
+*  @param [in]  pRing  A @ref tTxRing object.
+*  @param [in]  size   Frame size.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_ringTxCommit(tTxRing *pRing, size_t size);
+
+
+#endif /* __COMM_RING_H__ */
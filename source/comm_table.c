@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "comm_if.h"
+#include "comm_log.h"
+#include "comm_table.h"
+
+
+#define TABLE_INIT_SIZE (64)
+
+#define TABLE_ID(index, gen)  ((((tTableId)(gen)) << 32) | (tTableId)(index))
+#define TABLE_ID_INDEX(id)    ((int)((id) & 0xFFFFFFFF))
+#define TABLE_ID_GEN(id)      ((unsigned int)((id) >> 32))
+
+
+/**
+*  Grow the slot array and chain the new slots to the free list.
+*  @param [in]  pTable  A @ref tTable object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tableGrow(tTable *pTable)
+{
+    tTableSlot *pSlot;
+    int size;
+    int i;
+
+
+    if (pTable->size >= pTable->limit)
+    {
+        return -1;
+    }
+
+    size = (pTable->size > 0) ? (pTable->size << 1) : TABLE_INIT_SIZE;
+    if ((size > pTable->limit) || (size < pTable->size))
+    {
+        size = pTable->limit;
+    }
+
+    pSlot = realloc(pTable->pSlot, (sizeof( tTableSlot ) * size));
+    if (NULL == pSlot)
+    {
+        LOG_ERROR("fail to grow the table to %d slots\n", size);
+        return -1;
+    }
+
+    for (i=pTable->size; i<size; i++)
+    {
+        pSlot[i].pObj = NULL;
+        pSlot[i].gen  = 1;
+        pSlot[i].next = ((i + 1) < size) ? (i + 1) : pTable->freeHead;
+    }
+
+    pTable->freeHead = pTable->size;
+    pTable->pSlot = pSlot;
+    pTable->size = size;
+
+    LOG_3("table grows to %d slots\n", size);
+    return 0;
+}
+
+/**
+*  Release a slot to the free list (the table lock is held).
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  index   Slot index.
+*  @returns  The removed object.
+*/
+static void *_tableRelease(tTable *pTable, int index)
+{
+    tTableSlot *pSlot = &(pTable->pSlot[index]);
+    void *pObj = pSlot->pObj;
+
+    pSlot->pObj = NULL;
+    if (0 == ++pSlot->gen)
+    {
+        pSlot->gen = 1;
+    }
+    pSlot->next = pTable->freeHead;
+    pTable->freeHead = index;
+    pTable->num--;
+
+    return pObj;
+}
+
+/**
+*  Initialize a growable object table.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  limit   Max. number of objects.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_tableInit(tTable *pTable, int limit)
+{
+    if (limit <= 0)
+    {
+        LOG_ERROR("%s: wrong limit %d\n", __func__, limit);
+        return -1;
+    }
+
+    memset(pTable, 0x00, sizeof( tTable ));
+    pTable->limit = limit;
+    pTable->freeHead = -1;
+    pthread_mutex_init(&(pTable->mutex), NULL);
+
+    return 0;
+}
+
+/**
+*  Un-initialize an object table. The objects are not freed.
+*  @param [in]  pTable  A @ref tTable object.
+*/
+void comm_tableUninit(tTable *pTable)
+{
+    if ( pTable->pSlot )
+    {
+        free( pTable->pSlot );
+        pTable->pSlot = NULL;
+    }
+    pTable->size = 0;
+    pTable->num = 0;
+    pTable->freeHead = -1;
+    pthread_mutex_destroy( &(pTable->mutex) );
+}
+
+/**
+*  Put an object into a free slot, growing the table when needed.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  pObj    Object pointer.
+*  @returns  Object ID (0 is full).
+*/
+tTableId comm_tableAdd(tTable *pTable, void *pObj)
+{
+    tTableId id = 0;
+    int index;
+
+    pthread_mutex_lock( &(pTable->mutex) );
+
+    if ((pTable->freeHead < 0) && (_tableGrow( pTable ) != 0))
+    {
+        goto _DONE;
+    }
+
+    index = pTable->freeHead;
+    pTable->freeHead = pTable->pSlot[index].next;
+    pTable->pSlot[index].pObj = pObj;
+    pTable->pSlot[index].next = -1;
+    pTable->num++;
+
+    id = TABLE_ID(index, pTable->pSlot[index].gen);
+
+_DONE:
+    pthread_mutex_unlock( &(pTable->mutex) );
+    return id;
+}
+
+/**
+*  Remove an object by its ID. Only one caller can win a given ID.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  id      Object ID.
+*  @returns  The removed object (NULL if the ID is stale).
+*/
+void *comm_tableDel(tTable *pTable, tTableId id)
+{
+    int index = TABLE_ID_INDEX( id );
+    void *pObj = NULL;
+
+    pthread_mutex_lock( &(pTable->mutex) );
+
+    if ((index < pTable->size) &&
+        (pTable->pSlot[index].pObj) &&
+        (pTable->pSlot[index].gen == TABLE_ID_GEN( id )))
+    {
+        pObj = _tableRelease(pTable, index);
+    }
+
+    pthread_mutex_unlock( &(pTable->mutex) );
+    return pObj;
+}
+
+/**
+*  Remove the object of a slot index.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  index   Slot index.
+*  @returns  The removed object (NULL if the slot is free).
+*/
+void *comm_tableDelAt(tTable *pTable, int index)
+{
+    void *pObj = NULL;
+
+    pthread_mutex_lock( &(pTable->mutex) );
+
+    if ((index >= 0) && (index < pTable->size) && (pTable->pSlot[index].pObj))
+    {
+        pObj = _tableRelease(pTable, index);
+    }
+
+    pthread_mutex_unlock( &(pTable->mutex) );
+    return pObj;
+}
+
+/**
+*  Call a function for every object while holding the table lock, the
+*  callback must not block nor call the other table functions.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  pFunc   Callback function.
+*  @param [in]  pArg    Callback argument.
+*/
+void comm_tableForEach(tTable *pTable, tTableForEachCb pFunc, void *pArg)
+{
+    int i;
+
+    pthread_mutex_lock( &(pTable->mutex) );
+
+    for (i=0; i<pTable->size; i++)
+    {
+        if ( pTable->pSlot[i].pObj )
+        {
+            pFunc(pArg, pTable->pSlot[i].pObj);
+        }
+    }
+
+    pthread_mutex_unlock( &(pTable->mutex) );
+}
+
+/**
+*  Get the object limit from the configuration and RLIMIT_NOFILE.
+*  @param [in]  maxNum  Configured max. number (0 is no limit).
+*  @returns  Object limit.
+*/
+int comm_tableLimit(int maxNum)
+{
+    struct rlimit limit;
+    int fdNum = INT_MAX;
+
+    if (0 == getrlimit(RLIMIT_NOFILE, &limit))
+    {
+        if ((limit.rlim_cur != RLIM_INFINITY) && (limit.rlim_cur < INT_MAX))
+        {
+            fdNum = (int)limit.rlim_cur;
+        }
+    }
+    else
+    {
+        perror( "getrlimit" );
+    }
+
+    if ((maxNum <= 0) || (maxNum > fdNum))
+    {
+        return fdNum;
+    }
+
+    return maxNum;
+}
+
@@ -0,0 +1,99 @@
+#ifndef __COMM_TABLE_H__
+#define __COMM_TABLE_H__
+
+#include <pthread.h>
+
+
+/* Slot index in the low 32 bits, generation in the high 32 bits (0 is invalid) */
+typedef unsigned long long tTableId;
+
+typedef struct _tTableSlot
+{
+    void          *pObj;
+    unsigned int   gen;
+    int            next;
+} tTableSlot;
+
+typedef struct _tTable
+{
+    pthread_mutex_t  mutex;
+    tTableSlot      *pSlot;
+    int              size;
+    int              limit;
+    int              num;
+    int              freeHead;
+} tTable;
+
+typedef void (*tTableForEachCb)(void *pArg, void *pObj);
+
+
+/**
+*  Initialize a growable object table.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  limit   Max. number of objects.
+*  @returns  Success(0) or failure(-1).
+*/
+int  comm_tableInit(tTable *pTable, int limit);
+
+/**
+*  Un-initialize an object table. The objects are not freed.
+*  @param [in]  pTable  A @ref tTable object.
+*/
+void comm_tableUninit(tTable *pTable);
+
+/**
+*  Put an object into a free slot, growing the table when needed.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  pObj    Object pointer.
+*  @returns  Object ID (0 is full).
+*/
+tTableId comm_tableAdd(tTable *pTable, void *pObj);
+
+/**
+*  Remove an object by its ID. Only one caller can win a given ID.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  id      Object ID.
+*  @returns  The removed object (NULL if the ID is stale).
+*/
+void *comm_tableDel(tTable *pTable, tTableId id);
+
+/**
+*  Remove the object of a slot index.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  index   Slot index.
+*  @returns  The removed object (NULL if the slot is free).
+*/
+void *comm_tableDelAt(tTable *pTable, int index);
+
+/**
+*  Call a function for every object while holding the table lock, the
+*  callback must not block nor call the other table functions.
+*  @param [in]  pTable  A @ref tTable object.
+*  @param [in]  pFunc   Callback function.
+*  @param [in]  pArg    Callback argument.
+*/
+void comm_tableForEach(tTable *pTable, tTableForEachCb pFunc, void *pArg);
+
+/**
+*  Get the object limit from the configuration and RLIMIT_NOFILE.
+*  @param [in]  maxNum  Configured max. number (0 is no limit).
+*  @returns  Object limit.
+*/
+int  comm_tableLimit(int maxNum);
+
+/**
+*  Get the number of objects.
+*  @param [in]  pTable  A @ref tTable object.
+*  @returns  Number of objects.
+*/
+#define comm_tableNum(pTable) ((pTable)->num)
+
+/**
+*  Get the number of allocated slots.
+*  @param [in]  pTable  A @ref tTable object.
+*  @returns  Number of slots.
+*/
+#define comm_tableSize(pTable) ((pTable)->size)
+
+
+#endif /* __COMM_TABLE_H__ */
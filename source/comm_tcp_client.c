@@ -2,11 +2,16 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/socket.h>
 #include <ifaddrs.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_frame.h"
+#include "comm_pcap.h"
 
 
 typedef struct _tTcpIpv4ClientContext
@@ -16,12 +21,17 @@ typedef struct _tTcpIpv4ClientContext
     int                 fd;
 
     tTcpClientRecvCb    pClientRecvFunc;
+    tTcpClientBufCb     pClientBufFunc;
+    size_t              recvSize;
+    tFrame              frame;
+    tPcapTap            tap;
+    pthread_mutex_t     sendMutex;
     tTcpClientExitCb    pClientExitFunc;
     void               *pClientArg;
     pthread_t           thread;
     int                 running;
-
-    unsigned char       recvMsg[COMM_BUF_SIZE+1];
+    tReactorHandle      reactor;
+    tReactorEvent       event;
 } tTcpIpv4ClientContext;
 
 
@@ -82,6 +92,114 @@ static void _tcpIpv4UninitClient(tTcpIpv4ClientContext *pContext)
     LOG_2("IPv4 TCP client socket is closed\n");
 }
 
+/**
+*  Pass one message to the IPv4 TCP client receive callback.
+*  @param [in]  pArg  A @ref tTcpIpv4ClientContext object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _tcpIpv4ClientMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tTcpIpv4ClientContext *pContext = pArg;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, 0, &iov, 1);
+    }
+
+    if ( pContext->pClientBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pClientBufFunc(pContext->pClientArg, pBuf);
+        return;
+    }
+
+    if ( pContext->pClientRecvFunc )
+    {
+        pContext->pClientRecvFunc(
+                      pContext->pClientArg,
+                      pBuf->pData,
+                      pBuf->size
+                  );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Receive a message and pass it to the IPv4 TCP client receive callback.
+*  @param [in]  pContext  A @ref tTcpIpv4ClientContext object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _tcpIpv4ClientRecvMsg(tTcpIpv4ClientContext *pContext, int flags)
+{
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(&(pContext->frame), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv4 TCP client ... recv\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pContext->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_ERROR("IPv4 TCP server was terminated\n");
+        comm_reactorDelEvent( &(pContext->event) );
+        close( pContext->fd );
+        pContext->fd = -1;
+        /* notify the client that server is closed */
+        if ( pContext->pClientExitFunc )
+        {
+            pContext->pClientExitFunc(pContext->pClientArg, len);
+        }
+        comm_frameReset( &(pContext->frame) );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- IPv4 TCP server\n");
+    LOG_DUMP("IPv4 TCP client recv", pData, len);
+
+    if ( comm_frameEnabled( &(pContext->frame) ) )
+    {
+        if (comm_framePut(&(pContext->frame), pBuf, len, _tcpIpv4ClientMsgFunc, pContext) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pContext->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _tcpIpv4ClientMsgFunc(pContext, pBuf);
+    return len;
+}
+
 /**
 *  Thread function for IPv4 TCP client receiving.
 *  @param [in]  pArg  A @ref tTcpIpv4ClientContext object.
@@ -89,7 +207,6 @@ static void _tcpIpv4UninitClient(tTcpIpv4ClientContext *pContext)
 static void *_tcpIpv4ClientRecvTask(void *pArg)
 {
     tTcpIpv4ClientContext *pContext = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -97,39 +214,12 @@ static void *_tcpIpv4ClientRecvTask(void *pArg)
 
     while ( pContext->running )
     {
-        LOG_3("IPv4 TCP client ... recv\n");
         pthread_testcancel();
-        len = recv(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len <= 0)
+        if (_tcpIpv4ClientRecvMsg(pContext, 0) < 0)
         {
-            LOG_ERROR("IPv4 TCP server was terminated\n");
-            close( pContext->fd );
-            pContext->fd = -1;
-            /* notify the client that server is closed */
-            if ( pContext->pClientExitFunc )
-            {
-                pContext->pClientExitFunc(pContext->pClientArg, len);
-            }
             break;
         }
         pthread_testcancel();
-
-        LOG_3("<- IPv4 TCP server\n");
-        LOG_DUMP("IPv4 TCP client recv", pContext->recvMsg, len);
-
-        if ( pContext->pClientRecvFunc )
-        {
-            pContext->pClientRecvFunc(
-                          pContext->pClientArg,
-                          pContext->recvMsg,
-                          len
-                      );
-        }
     }
 
     LOG_2("stop the thread: %s\n", __func__);
@@ -138,17 +228,34 @@ static void *_tcpIpv4ClientRecvTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for IPv4 TCP client receiving.
+*  @param [in]  pArg    A @ref tTcpIpv4ClientContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _tcpIpv4ClientRecvEvent(void *pArg, unsigned int events)
+{
+    tTcpIpv4ClientContext *pContext = pArg;
+
+    if (_tcpIpv4ClientRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        pContext->running = 0;
+    }
+}
+
 /**
 *  Initialize IPv4 TCP client.
 *  @param [in]  portNum    Local TCP port number.
 *  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pBufFunc   Application's buffer callback function.
 *  @param [in]  pExitFunc  Application's exit callback function.
 *  @param [in]  pArg       Application's argument.
 *  @returns  IPv4 TCP client handle.
 */
-tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
+static tTcpIpv4ClientHandle _tcpIpv4ClientOpen(
     unsigned short    portNum,
     tTcpClientRecvCb  pRecvFunc,
+    tTcpClientBufCb   pBufFunc,
     tTcpClientExitCb  pExitFunc,
     void             *pArg
 )
@@ -169,8 +276,10 @@ tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
     pContext->localAddr.sin_port        = htons( portNum );
     pContext->localAddr.sin_addr.s_addr = htonl( INADDR_ANY );
     pContext->pClientRecvFunc = pRecvFunc;
+    pContext->pClientBufFunc = pBufFunc;
     pContext->pClientExitFunc = pExitFunc;
     pContext->pClientArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
     error = _tcpIpv4InitClient( pContext );
@@ -181,7 +290,7 @@ tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPv4 TCP receive function\n");
     }
@@ -191,10 +300,64 @@ tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
         LOG_1("ignore IPv4 TCP exit function\n");
     }
 
+    pthread_mutex_init(&(pContext->sendMutex), NULL);
+
     LOG_1("IPv4 TCP client initialized\n");
     return ((tTcpIpv4ClientHandle)pContext);
 }
 
+/**
+*  Initialize IPv4 TCP client.
+*  @param [in]  portNum    Local TCP port number.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv4 TCP client handle.
+*/
+tTcpIpv4ClientHandle comm_tcpIpv4ClientInit(
+    unsigned short    portNum,
+    tTcpClientRecvCb  pRecvFunc,
+    tTcpClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv4ClientOpen(portNum, pRecvFunc, NULL, pExitFunc, pArg);
+}
+
+/**
+*  Initialize IPv4 TCP client with zero-copy buffers.
+*  @param [in]  portNum    Local TCP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv4 TCP client handle.
+*/
+tTcpIpv4ClientHandle comm_tcpIpv4ClientInitBuf(
+    unsigned short    portNum,
+    tTcpClientBufCb   pBufFunc,
+    tTcpClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv4ClientOpen(portNum, NULL, pBufFunc, pExitFunc, pArg);
+}
+
+/**
+*  Release an IPv4 TCP client when it is no more received.
+*  @param [in]  pArg  A @ref tTcpIpv4ClientContext object.
+*/
+static void _tcpIpv4ClientRelease(void *pArg)
+{
+    tTcpIpv4ClientContext *pContext = pArg;
+
+    _tcpIpv4UninitClient( pContext );
+    comm_frameReset( &(pContext->frame) );
+    pthread_mutex_destroy( &(pContext->sendMutex) );
+    free( pContext );
+
+    LOG_1("IPv4 TCP client un-initialized\n");
+}
+
 /**
 *  Un-initialize IPv4 TCP client.
 *  @param [in]  handle  IPv4 TCP client handle.
@@ -205,16 +368,20 @@ void comm_tcpIpv4ClientUninit(tTcpIpv4ClientHandle handle)
 
     if ( pContext )
     {
+        if ( pContext->reactor )
+        {
+            pContext->running = 0;
+            comm_reactorDelEventFree(&(pContext->event), _tcpIpv4ClientRelease, pContext);
+            return;
+        }
+
         if ( pContext->running )
         {
             pthread_cancel( pContext->thread );
             pContext->running = 0;
         }
 
-        _tcpIpv4UninitClient( pContext );
-        free( pContext );
-
-        LOG_1("IPv4 TCP client un-initialized\n");
+        _tcpIpv4ClientRelease( pContext );
     }
 }
 
@@ -278,6 +445,28 @@ int comm_tcpIpv4ClientConnect(
 
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _tcpIpv4ClientRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPv4 TCP client to reactor\n");
+            pContext->running = 0;
+            return -1;
+        }
+
+        pContext->reactor = g_reactor;
+        return 0;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
@@ -301,21 +490,16 @@ int comm_tcpIpv4ClientConnect(
 }
 
 /**
-*  Send message to an IPv4 TCP server.
+*  Set the message framing of the IPv4 TCP client, before connecting.
 *  @param [in]  handle  IPv4 TCP client handle.
-*  @param [in]  pData   A pointer of data buffer.
-*  @param [in]  size    Data size.
-*  @returns  Message length (-1 is failed).
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
 */
-int comm_tcpIpv4ClientSend(
-    tTcpIpv4ClientHandle  handle,
-    unsigned char        *pData,
-    unsigned short        size
-)
+int comm_tcpIpv4ClientSetFrame(tTcpIpv4ClientHandle handle, tCommFrame *pFrame)
 {
     tTcpIpv4ClientContext *pContext = (tTcpIpv4ClientContext *)handle;
-    int error;
-
+    tCommFrame cfg;
+    tFrame frame;
 
     if (NULL == pContext)
     {
@@ -323,188 +507,511 @@ int comm_tcpIpv4ClientSend(
         return -1;
     }
 
-    if (pContext->fd < 0)
+    if ( pContext->running )
     {
-        LOG_ERROR("%s: socket is not ready\n", __func__);
+        LOG_WARN("%s: already connected\n", __func__);
         return -1;
     }
 
-    if (NULL == pData)
+    if ( pFrame )
     {
-        LOG_WARN("%s: pData is NULL\n", __func__);
-        return -1;
+        cfg = *pFrame;
+        if (( pContext->pClientRecvFunc ) && (0 == cfg.maxSize))
+        {
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
+        }
+        pFrame = &cfg;
     }
 
-    if (0 == size)
+    if (comm_frameInit(&frame, pFrame) != 0)
     {
-        LOG_WARN("%s: size is 0\n", __func__);
         return -1;
     }
 
-    LOG_3("-> IPv4 TCP server\n");
-    LOG_DUMP("IPv4 TCP client send", pData, size);
-
-    error = send(
-                pContext->fd,
-                pData,
-                size,
-                0
-            );
-    if (error < 0)
+    if (( pFrame ) && ( pContext->pClientRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
     {
-        LOG_ERROR("fail to send IPv4 TCP server\n");
-        perror( "send" );
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
     }
 
-    return error;
+    comm_frameReset( &(pContext->frame) );
+    pContext->frame = frame;
+    return 0;
 }
 
-
-typedef struct _tTcpIpv6ClientContext
-{
-    struct sockaddr_in6  remoteAddr;
-    struct sockaddr_in6  localAddr;
-    int                  fd;
-
-    tTcpClientRecvCb     pClientRecvFunc;
-    tTcpClientExitCb     pClientExitFunc;
-    void                *pClientArg;
-    pthread_t            thread;
-    int                  running;
-
-    unsigned char        recvMsg[COMM_BUF_SIZE+1];
-} tTcpIpv6ClientContext;
-
-
 /**
-*  Initialize an IPv6 TCP client socket.
-*  @param [in]  pContext  A @ref tTcpIpv6ClientContext object.
+*  Set the receive size of the IPv4 TCP client.
+*  @param [in]  handle  IPv4 TCP client handle.
+*  @param [in]  size    Max. message size of one receive.
 *  @returns  Success(0) or failure(-1).
 */
-static int _tcpIpv6InitClient(tTcpIpv6ClientContext *pContext)
+int comm_tcpIpv4ClientSetRecvSize(tTcpIpv4ClientHandle handle, size_t size)
 {
-    struct sockaddr_in6 bindAddr;
-    int bindAddrLen;
-    int fd;
-
-    int reUseAddr = 1;
-    socklen_t reUseAddrLen;
-
+    tTcpIpv4ClientContext *pContext = (tTcpIpv4ClientContext *)handle;
 
-    fd = socket(AF_INET6, SOCK_STREAM, 0);
-    if (fd < 0)
+    if (NULL == pContext)
     {
-        perror( "socket" );
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
         return -1;
     }
 
-    /* enable the port number re-use */
-    reUseAddrLen = sizeof( reUseAddr );
-    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, reUseAddrLen);
-
-    bindAddrLen = sizeof( struct sockaddr_in6 );
-    bindAddr = pContext->localAddr;
-
-    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    if ((0 == size) || (size > INT_MAX))
     {
-        perror( "bind" );
-        close( fd );
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
         return -1;
     }
 
-    pContext->fd = fd;
-
-    LOG_2("IPv6 TCP client socket is ready\n");
-    return 0;
-}
-
-/**
-*  Un-initialize an IPv6 TCP client socket.
-*  @param [in]  pContext  A @ref tTcpIpv6ClientContext object.
-*/
-static void _tcpIpv6UninitClient(tTcpIpv6ClientContext *pContext)
-{
-    if (pContext->fd > 0)
+    if ((pContext->pClientRecvFunc) && (size > USHRT_MAX))
     {
-        close( pContext->fd );
-        pContext->fd = -1;
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
     }
 
-    LOG_2("IPv6 TCP client socket is closed\n");
+    pContext->recvSize = size;
+    return 0;
 }
 
 /**
-*  Thread function for IPv6 TCP client receiving.
-*  @param [in]  pArg  A @ref tTcpIpv6ClientContext object.
+*  Tap the IPv4 TCP client, so that the messages it sends and receives
+*  are copied to a pcapng capture with the connection ID 0.
+*  @param [in]  handle  IPv4 TCP client handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
 */
-static void *_tcpIpv6ClientRecvTask(void *pArg)
+int comm_tcpIpv4ClientSetTap(tTcpIpv4ClientHandle handle, tPcapHandle pcap)
 {
-    tTcpIpv6ClientContext *pContext = pArg;
-    int len;
-
+    tTcpIpv4ClientContext *pContext = (tTcpIpv4ClientContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
 
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
 
-    while ( pContext->running )
+    if (NULL == pContext)
     {
-        LOG_3("IPv6 TCP client ... recv\n");
-        pthread_testcancel();
-        len = recv(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len <= 0)
-        {
-            LOG_ERROR("IPv6 TCP server was terminated\n");
-            close( pContext->fd );
-            pContext->fd = -1;
-            /* notify the client that server is closed */
-            if ( pContext->pClientExitFunc )
-            {
-                pContext->pClientExitFunc(pContext->pClientArg, len);
-            }
-            break;
-        }
-        pthread_testcancel();
-
-        LOG_3("<- IPv6 TCP server\n");
-        LOG_DUMP("IPv6 TCP client recv", pContext->recvMsg, len);
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        if ( pContext->pClientRecvFunc )
+    if ( pcap )
+    {
+        snprintf(
+            name,
+            sizeof( name ),
+            "tcp4-client:%s:%d",
+            inet_ntoa( pContext->remoteAddr.sin_addr ),
+            ntohs( pContext->remoteAddr.sin_port )
+        );
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
         {
-            pContext->pClientRecvFunc(
-                          pContext->pClientArg,
-                          pContext->recvMsg,
-                          len
-                      );
+            return -1;
         }
     }
 
-    LOG_2("stop the thread: %s\n", __func__);
-    pContext->running = 0;
-
-    pthread_exit(NULL);
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
 }
 
 /**
-*  Initialize IPv6 TCP client.
-*  @param [in]  portNum    Local TCP port number.
-*  @param [in]  pRecvFunc  Application's receive callback function.
-*  @param [in]  pExitFunc  Application's exit callback function.
-*  @param [in]  pArg       Application's argument.
-*  @returns  IPv6 TCP client handle.
+*  Send message to an IPv4 TCP server.
+*  @param [in]  handle  IPv4 TCP client handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
 */
-tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
-    unsigned short    portNum,
-    tTcpClientRecvCb  pRecvFunc,
-    tTcpClientExitCb  pExitFunc,
-    void             *pArg
-)
-{
-    tTcpIpv6ClientContext *pContext = NULL;
+int comm_tcpIpv4ClientSend(
+    tTcpIpv4ClientHandle  handle,
+    unsigned char        *pData,
+    unsigned short        size
+)
+{
+    return comm_tcpIpv4ClientSendEx(handle, pData, size);
+}
+
+/**
+*  Send message to an IPv4 TCP server.
+*  @param [in]  handle  IPv4 TCP client handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv4ClientSendEx(
+    tTcpIpv4ClientHandle  handle,
+    unsigned char        *pData,
+    size_t                size
+)
+{
+    tTcpIpv4ClientContext *pContext = (tTcpIpv4ClientContext *)handle;
+    struct iovec iov;
+    tPcapTap *pTap;
+    ssize_t error;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> IPv4 TCP server\n");
+    LOG_DUMP("IPv4 TCP client send", pData, size);
+
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, &iov, 1);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, &iov, 1);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 TCP server\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to an IPv4 TCP server, the message
+*  is not interleaved with the other senders of the handle.
+*  @param [in]  handle  IPv4 TCP client handle.
+*  @param [in]  pIov    Data buffers.
+*  @param [in]  num     Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv4ClientSendv(
+    tTcpIpv4ClientHandle  handle,
+    struct iovec         *pIov,
+    int                   num
+)
+{
+    tTcpIpv4ClientContext *pContext = (tTcpIpv4ClientContext *)handle;
+    tPcapTap *pTap;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> IPv4 TCP server\n");
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv4 TCP client send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, pIov, num);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, pIov, num);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 TCP server\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+
+typedef struct _tTcpIpv6ClientContext
+{
+    struct sockaddr_in6  remoteAddr;
+    struct sockaddr_in6  localAddr;
+    int                  fd;
+
+    tTcpClientRecvCb     pClientRecvFunc;
+    tTcpClientBufCb      pClientBufFunc;
+    size_t               recvSize;
+    tFrame               frame;
+    tPcapTap             tap;
+    pthread_mutex_t      sendMutex;
+    tTcpClientExitCb     pClientExitFunc;
+    void                *pClientArg;
+    pthread_t            thread;
+    int                  running;
+    tReactorHandle       reactor;
+    tReactorEvent        event;
+} tTcpIpv6ClientContext;
+
+
+/**
+*  Initialize an IPv6 TCP client socket.
+*  @param [in]  pContext  A @ref tTcpIpv6ClientContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tcpIpv6InitClient(tTcpIpv6ClientContext *pContext)
+{
+    struct sockaddr_in6 bindAddr;
+    int bindAddrLen;
+    int fd;
+
+    int reUseAddr = 1;
+    socklen_t reUseAddrLen;
+
+
+    fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror( "socket" );
+        return -1;
+    }
+
+    /* enable the port number re-use */
+    reUseAddrLen = sizeof( reUseAddr );
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, reUseAddrLen);
+
+    bindAddrLen = sizeof( struct sockaddr_in6 );
+    bindAddr = pContext->localAddr;
+
+    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    {
+        perror( "bind" );
+        close( fd );
+        return -1;
+    }
+
+    pContext->fd = fd;
+
+    LOG_2("IPv6 TCP client socket is ready\n");
+    return 0;
+}
+
+/**
+*  Un-initialize an IPv6 TCP client socket.
+*  @param [in]  pContext  A @ref tTcpIpv6ClientContext object.
+*/
+static void _tcpIpv6UninitClient(tTcpIpv6ClientContext *pContext)
+{
+    if (pContext->fd > 0)
+    {
+        close( pContext->fd );
+        pContext->fd = -1;
+    }
+
+    LOG_2("IPv6 TCP client socket is closed\n");
+}
+
+/**
+*  Pass one message to the IPv6 TCP client receive callback.
+*  @param [in]  pArg  A @ref tTcpIpv6ClientContext object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _tcpIpv6ClientMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tTcpIpv6ClientContext *pContext = pArg;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, 0, &iov, 1);
+    }
+
+    if ( pContext->pClientBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pClientBufFunc(pContext->pClientArg, pBuf);
+        return;
+    }
+
+    if ( pContext->pClientRecvFunc )
+    {
+        pContext->pClientRecvFunc(
+                      pContext->pClientArg,
+                      pBuf->pData,
+                      pBuf->size
+                  );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Receive a message and pass it to the IPv6 TCP client receive callback.
+*  @param [in]  pContext  A @ref tTcpIpv6ClientContext object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _tcpIpv6ClientRecvMsg(tTcpIpv6ClientContext *pContext, int flags)
+{
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(&(pContext->frame), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv6 TCP client ... recv\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pContext->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_ERROR("IPv6 TCP server was terminated\n");
+        comm_reactorDelEvent( &(pContext->event) );
+        close( pContext->fd );
+        pContext->fd = -1;
+        /* notify the client that server is closed */
+        if ( pContext->pClientExitFunc )
+        {
+            pContext->pClientExitFunc(pContext->pClientArg, len);
+        }
+        comm_frameReset( &(pContext->frame) );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3("<- IPv6 TCP server\n");
+    LOG_DUMP("IPv6 TCP client recv", pData, len);
+
+    if ( comm_frameEnabled( &(pContext->frame) ) )
+    {
+        if (comm_framePut(&(pContext->frame), pBuf, len, _tcpIpv6ClientMsgFunc, pContext) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pContext->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _tcpIpv6ClientMsgFunc(pContext, pBuf);
+    return len;
+}
+
+/**
+*  Thread function for IPv6 TCP client receiving.
+*  @param [in]  pArg  A @ref tTcpIpv6ClientContext object.
+*/
+static void *_tcpIpv6ClientRecvTask(void *pArg)
+{
+    tTcpIpv6ClientContext *pContext = pArg;
+
+
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    while ( pContext->running )
+    {
+        pthread_testcancel();
+        if (_tcpIpv6ClientRecvMsg(pContext, 0) < 0)
+        {
+            break;
+        }
+        pthread_testcancel();
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
+    pContext->running = 0;
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Reactor event function for IPv6 TCP client receiving.
+*  @param [in]  pArg    A @ref tTcpIpv6ClientContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _tcpIpv6ClientRecvEvent(void *pArg, unsigned int events)
+{
+    tTcpIpv6ClientContext *pContext = pArg;
+
+    if (_tcpIpv6ClientRecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        pContext->running = 0;
+    }
+}
+
+/**
+*  Initialize IPv6 TCP client.
+*  @param [in]  portNum    Local TCP port number.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 TCP client handle.
+*/
+static tTcpIpv6ClientHandle _tcpIpv6ClientOpen(
+    unsigned short    portNum,
+    tTcpClientRecvCb  pRecvFunc,
+    tTcpClientBufCb   pBufFunc,
+    tTcpClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    tTcpIpv6ClientContext *pContext = NULL;
     int error;
 
 
@@ -520,8 +1027,10 @@ tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
     pContext->localAddr.sin6_port   = htons( portNum );
     pContext->localAddr.sin6_addr   = in6addr_any;
     pContext->pClientRecvFunc = pRecvFunc;
+    pContext->pClientBufFunc = pBufFunc;
     pContext->pClientExitFunc = pExitFunc;
     pContext->pClientArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
     error = _tcpIpv6InitClient( pContext );
@@ -532,7 +1041,7 @@ tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
         return 0;
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPv6 TCP receive function\n");
     }
@@ -542,10 +1051,64 @@ tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
         LOG_1("ignore IPv6 TCP exit function\n");
     }
 
+    pthread_mutex_init(&(pContext->sendMutex), NULL);
+
     LOG_1("IPv6 TCP client initialized\n");
     return ((tTcpIpv6ClientHandle)pContext);;
 }
 
+/**
+*  Initialize IPv6 TCP client.
+*  @param [in]  portNum    Local TCP port number.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 TCP client handle.
+*/
+tTcpIpv6ClientHandle comm_tcpIpv6ClientInit(
+    unsigned short    portNum,
+    tTcpClientRecvCb  pRecvFunc,
+    tTcpClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv6ClientOpen(portNum, pRecvFunc, NULL, pExitFunc, pArg);
+}
+
+/**
+*  Initialize IPv6 TCP client with zero-copy buffers.
+*  @param [in]  portNum    Local TCP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pExitFunc  Application's exit callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 TCP client handle.
+*/
+tTcpIpv6ClientHandle comm_tcpIpv6ClientInitBuf(
+    unsigned short    portNum,
+    tTcpClientBufCb   pBufFunc,
+    tTcpClientExitCb  pExitFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv6ClientOpen(portNum, NULL, pBufFunc, pExitFunc, pArg);
+}
+
+/**
+*  Release an IPv6 TCP client when it is no more received.
+*  @param [in]  pArg  A @ref tTcpIpv6ClientContext object.
+*/
+static void _tcpIpv6ClientRelease(void *pArg)
+{
+    tTcpIpv6ClientContext *pContext = pArg;
+
+    _tcpIpv6UninitClient( pContext );
+    comm_frameReset( &(pContext->frame) );
+    pthread_mutex_destroy( &(pContext->sendMutex) );
+    free( pContext );
+
+    LOG_1("IPv6 TCP client un-initialized\n");
+}
+
 /**
 *  Un-initialize IPv6 TCP client.
 *  @param [in]  handle  IPv6 TCP client handle.
@@ -556,16 +1119,20 @@ void comm_tcpIpv6ClientUninit(tTcpIpv6ClientHandle handle)
 
     if ( pContext )
     {
+        if ( pContext->reactor )
+        {
+            pContext->running = 0;
+            comm_reactorDelEventFree(&(pContext->event), _tcpIpv6ClientRelease, pContext);
+            return;
+        }
+
         if ( pContext->running )
         {
             pthread_cancel( pContext->thread );
             pContext->running = 0;
         }
 
-        _tcpIpv6UninitClient( pContext );
-        free( pContext );
-
-        LOG_1("IPv6 TCP client un-initialized\n");
+        _tcpIpv6ClientRelease( pContext );
     }
 }
 
@@ -629,6 +1196,28 @@ int comm_tcpIpv6ClientConnect(
 
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _tcpIpv6ClientRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPv6 TCP client to reactor\n");
+            pContext->running = 0;
+            return -1;
+        }
+
+        pContext->reactor = g_reactor;
+        return 0;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
@@ -651,6 +1240,132 @@ int comm_tcpIpv6ClientConnect(
     return 0;
 }
 
+/**
+*  Set the message framing of the IPv6 TCP client, before connecting.
+*  @param [in]  handle  IPv6 TCP client handle.
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_tcpIpv6ClientSetFrame(tTcpIpv6ClientHandle handle, tCommFrame *pFrame)
+{
+    tTcpIpv6ClientContext *pContext = (tTcpIpv6ClientContext *)handle;
+    tCommFrame cfg;
+    tFrame frame;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pContext->running )
+    {
+        LOG_WARN("%s: already connected\n", __func__);
+        return -1;
+    }
+
+    if ( pFrame )
+    {
+        cfg = *pFrame;
+        if (( pContext->pClientRecvFunc ) && (0 == cfg.maxSize))
+        {
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
+        }
+        pFrame = &cfg;
+    }
+
+    if (comm_frameInit(&frame, pFrame) != 0)
+    {
+        return -1;
+    }
+
+    if (( pFrame ) && ( pContext->pClientRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
+    {
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
+    }
+
+    comm_frameReset( &(pContext->frame) );
+    pContext->frame = frame;
+    return 0;
+}
+
+/**
+*  Set the receive size of the IPv6 TCP client.
+*  @param [in]  handle  IPv6 TCP client handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_tcpIpv6ClientSetRecvSize(tTcpIpv6ClientHandle handle, size_t size)
+{
+    tTcpIpv6ClientContext *pContext = (tTcpIpv6ClientContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pClientRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
+
+    pContext->recvSize = size;
+    return 0;
+}
+
+/**
+*  Tap the IPv6 TCP client, so that the messages it sends and receives
+*  are copied to a pcapng capture with the connection ID 0.
+*  @param [in]  handle  IPv6 TCP client handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_tcpIpv6ClientSetTap(tTcpIpv6ClientHandle handle, tPcapHandle pcap)
+{
+    tTcpIpv6ClientContext *pContext = (tTcpIpv6ClientContext *)handle;
+    tPcapIf *pIf = NULL;
+    char ipStr[INET6_ADDRSTRLEN];
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        inet_ntop(AF_INET6, &(pContext->remoteAddr.sin6_addr), ipStr, INET6_ADDRSTRLEN);
+        snprintf(
+            name,
+            sizeof( name ),
+            "tcp6-client:[%s]:%d",
+            ipStr,
+            ntohs( pContext->remoteAddr.sin6_port )
+        );
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
+}
+
 /**
 *  Send message to an IPv6 TCP server.
 *  @param [in]  handle  IPv6 TCP client handle.
@@ -663,9 +1378,27 @@ int comm_tcpIpv6ClientSend(
     unsigned char        *pData,
     unsigned short        size
 )
+{
+    return comm_tcpIpv6ClientSendEx(handle, pData, size);
+}
+
+/**
+*  Send message to an IPv6 TCP server.
+*  @param [in]  handle  IPv6 TCP client handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv6ClientSendEx(
+    tTcpIpv6ClientHandle  handle,
+    unsigned char        *pData,
+    size_t                size
+)
 {
     tTcpIpv6ClientContext *pContext = (tTcpIpv6ClientContext *)handle;
-    int error;
+    struct iovec iov;
+    tPcapTap *pTap;
+    ssize_t error;
 
 
     if (NULL == pContext)
@@ -695,16 +1428,90 @@ int comm_tcpIpv6ClientSend(
     LOG_3("-> IPv6 TCP server\n");
     LOG_DUMP("IPv6 TCP client send", pData, size);
 
-    error = send(
-                pContext->fd,
-                pData,
-                size,
-                0
-            );
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, &iov, 1);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, &iov, 1);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv6 TCP server\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to an IPv6 TCP server, the message
+*  is not interleaved with the other senders of the handle.
+*  @param [in]  handle  IPv6 TCP client handle.
+*  @param [in]  pIov    Data buffers.
+*  @param [in]  num     Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv6ClientSendv(
+    tTcpIpv6ClientHandle  handle,
+    struct iovec         *pIov,
+    int                   num
+)
+{
+    tTcpIpv6ClientContext *pContext = (tTcpIpv6ClientContext *)handle;
+    tPcapTap *pTap;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> IPv6 TCP server\n");
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv6 TCP client send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pthread_mutex_lock( &(pContext->sendMutex) );
+    error = comm_frameSendv(&(pContext->frame), pContext->fd, pIov, num);
+    pTap = &(pContext->tap);
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, 0, pIov, num);
+    }
+    pthread_mutex_unlock( &(pContext->sendMutex) );
     if (error < 0)
     {
         LOG_ERROR("fail to send IPv6 TCP server\n");
-        perror( "send" );
+        perror( "sendmsg" );
     }
 
     return error;
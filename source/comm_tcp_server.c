@@ -2,15 +2,166 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
 #include <ifaddrs.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_frame.h"
+#include "comm_queue.h"
+#include "comm_table.h"
+#include "comm_pcap.h"
 
 
-#define TCP_USER_NUM (32)
+/* Table ID, reactor event, framing, send lock and send queue of a client, private to the library */
+typedef struct _tTcpUserEntry
+{
+    tTcpUser         user;
+    tTableId         id;
+    tReactorEvent    event;
+    tFrame           frame;
+    pthread_mutex_t  sendMutex;
+    tSendQueue       queue;
+    int              refNum;  /* the user table and the senders to all */
+} tTcpUserEntry;
+
+#define TCP_USER_ID(pUser)    (((tTcpUserEntry *)(pUser))->id)
+#define TCP_USER_EVENT(pUser) (&(((tTcpUserEntry *)(pUser))->event))
+#define TCP_USER_FRAME(pUser) (&(((tTcpUserEntry *)(pUser))->frame))
+#define TCP_USER_MUTEX(pUser) (&(((tTcpUserEntry *)(pUser))->sendMutex))
+#define TCP_USER_QUEUE(pUser) (&(((tTcpUserEntry *)(pUser))->queue))
+#define TCP_USER_REF(pUser)   (((tTcpUserEntry *)(pUser))->refNum)
+
+/* Connection ID of a client in the capture, the slot of its table ID */
+#define TCP_USER_CONN(pUser)  ((unsigned int)TCP_USER_ID(pUser))
+
+typedef struct _tTcpSendAll
+{
+    unsigned char  *pData;
+    size_t          size;
+    tPcapTap       *pTap;
+
+    /* clients referenced under the table lock, sent after it */
+    tTcpUser      **ppUser;
+    int             userNum;
+    int             maxNum;
+} tTcpSendAll;
+
+
+/**
+*  Send one message of several buffers to a client, the message is not
+*  interleaved with the other senders of the client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pIov   Data buffers.
+*  @param [in]  num    Number of data buffers.
+*  @param [in]  pTap   A @ref tPcapTap object of the server.
+*  @returns  Message length (-1 is failed).
+*/
+static ssize_t _tcpServerSendv(
+    tTcpUser      *pUser,
+    struct iovec  *pIov,
+    int            num,
+    tPcapTap      *pTap
+)
+{
+    tSendQueue *pQueue = TCP_USER_QUEUE(pUser);
+    int water = QUEUE_WATER_NONE;
+    ssize_t error;
+
+    pthread_mutex_lock( TCP_USER_MUTEX(pUser) );
+    if ( comm_queueEnabled( pQueue ) )
+    {
+        error = comm_queueSendv(
+                    pQueue,
+                    TCP_USER_FRAME(pUser),
+                    pUser->fd,
+                    pIov,
+                    num,
+                    &water
+                );
+    }
+    else
+    {
+        error = comm_frameSendv(TCP_USER_FRAME(pUser), pUser->fd, pIov, num);
+    }
+    if ((error >= 0) && comm_pcapTapped( pTap ))
+    {
+        /* in the order of the stream */
+        comm_pcapWriteConn(pTap, PCAP_OUT, TCP_USER_CONN(pUser), pIov, num);
+    }
+    pthread_mutex_unlock( TCP_USER_MUTEX(pUser) );
+
+    comm_queueNotify(pQueue, water);
+
+    return error;
+}
+
+/**
+*  Write the send queue of a client on EPOLLOUT.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tcpServerFlush(tTcpUser *pUser)
+{
+    tSendQueue *pQueue = TCP_USER_QUEUE(pUser);
+    int water;
+    int error;
+
+    pthread_mutex_lock( TCP_USER_MUTEX(pUser) );
+    error = comm_queueFlush(pQueue, pUser->fd, &water);
+    pthread_mutex_unlock( TCP_USER_MUTEX(pUser) );
+
+    comm_queueNotify(pQueue, water);
+
+    return error;
+}
+
+/**
+*  Take a reference of one client of the user table, called with the
+*  table lock held.
+*  @param [in]  pArg  A @ref tTcpSendAll object.
+*  @param [in]  pObj  A @ref tTcpUser object.
+*/
+static void _tcpServerHoldFunc(void *pArg, void *pObj)
+{
+    tTcpSendAll *pSendAll = pArg;
+
+    /* the clients accepted after the table size was read are left out */
+    if (pSendAll->userNum < pSendAll->maxNum)
+    {
+        __sync_fetch_and_add(&(TCP_USER_REF(pObj)), 1);
+        pSendAll->ppUser[pSendAll->userNum++] = pObj;
+    }
+}
+
+/**
+*  Send a message to one referenced client of the user table.
+*  @param [in]  pSendAll  A @ref tTcpSendAll object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*/
+static void _tcpServerSendAllFunc(tTcpSendAll *pSendAll, tTcpUser *pUser)
+{
+    struct iovec iov;
+    ssize_t error;
+
+    if (pUser->fd > 0)
+    {
+        iov.iov_base = pSendAll->pData;
+        iov.iov_len  = pSendAll->size;
+
+        error = _tcpServerSendv(pUser, &iov, 1, pSendAll->pTap);
+        if ((error < 0) && (ENOBUFS != errno))
+        {
+            LOG_ERROR("fail to send TCP to fd(%d)\n", pUser->fd);
+            perror( "sendmsg" );
+        }
+    }
+}
 
 
 typedef struct _tTcpIpv4ServerContext
@@ -18,16 +169,25 @@ typedef struct _tTcpIpv4ServerContext
     struct sockaddr_in  localAddr;
     int                 fd;
 
-    tTcpUser           *pUser[TCP_USER_NUM];
-    int                 userNum;
+    tTable              userTable;
     int                 maxUserNum;
 
     tTcpServerAcptCb    pServerAcptFunc;
     tTcpServerExitCb    pServerExitFunc;
     tTcpServerRecvCb    pServerRecvFunc;
+    tTcpServerBufCb     pServerBufFunc;
+    size_t              recvSize;
+    tFrame              frame;
+    tPcapTap            tap;
+    tSendQueue          queue;
+    tTcpServerWaterCb   pServerWaterFunc;
     void               *pServerArg;
     pthread_t           thread;
     int                 running;
+    tReactorHandle      reactor;
+    tReactorEvent       event;
+    int                 paused;
+    int                 refNum;  /* the server and its clients */
 } tTcpIpv4ServerContext;
 
 static tTcpUser *_tcpIpv4AcceptClient(
@@ -39,6 +199,11 @@ static void _tcpIpv4DisconnectClient(
     tTcpIpv4ServerContext *pContext,
     tTcpUser              *pUser
 );
+static void _tcpIpv4FreeClient(
+    tTcpIpv4ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    closed
+);
 
 
 /**
@@ -98,6 +263,135 @@ static void _tcpIpv4UninitServer(tTcpIpv4ServerContext *pContext)
     LOG_2("IPv4 TCP server socket is closed\n");
 }
 
+/**
+*  Pass one message to the IPv4 TCP server receive callback.
+*  @param [in]  pArg  A @ref tTcpUser object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _tcpIpv4ServerMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv4ServerContext *pContext = pUser->pServer;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, TCP_USER_CONN(pUser), &iov, 1);
+    }
+
+    if ( pContext->pServerBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pServerBufFunc(pContext->pServerArg, pUser, pBuf);
+        return;
+    }
+
+    if ( pContext->pServerRecvFunc )
+    {
+        pContext->pServerRecvFunc(
+                     pContext->pServerArg,
+                     pUser,
+                     pBuf->pData,
+                     pBuf->size
+                 );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Pass the send queue watermark to the IPv4 TCP server callback.
+*  @param [in]  pArg  A @ref tTcpUser object.
+*  @param [in]  high  Over the high-water mark(1) or drained to the low-water mark(0).
+*/
+static void _tcpIpv4ServerWaterFunc(void *pArg, int high)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv4ServerContext *pContext = pUser->pServer;
+
+    if ( pContext->pServerWaterFunc )
+    {
+        pContext->pServerWaterFunc(pContext->pServerArg, pUser, high);
+    }
+}
+
+/**
+*  Receive a message and pass it to the IPv4 TCP server receive callback.
+*  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _tcpIpv4ServerRecvMsg(
+    tTcpIpv4ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    flags
+)
+{
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(TCP_USER_FRAME(pUser), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv4 TCP server ... recv\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pUser->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_1(
+            "TCP client %s connection closed\n",
+            inet_ntoa( pUser->addrIpv4.sin_addr )
+        );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    LOG_3(
+        "<- %s:%d\n",
+        inet_ntoa( pUser->addrIpv4.sin_addr ),
+        ntohs( pUser->addrIpv4.sin_port )
+    );
+    LOG_DUMP("IPv4 TCP server recv", pData, len);
+
+    if ( comm_frameEnabled( TCP_USER_FRAME(pUser) ) )
+    {
+        if (comm_framePut(TCP_USER_FRAME(pUser), pBuf, len, _tcpIpv4ServerMsgFunc, pUser) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pUser->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _tcpIpv4ServerMsgFunc(pUser, pBuf);
+    return len;
+}
+
 /**
 *  Thread function for the IPv4 TCP server receiving.
 *  @param [in]  pArg  A @ref tTcpUser object.
@@ -106,7 +400,6 @@ static void *_tcpIpv4ServerRecvTask(void *pArg)
 {
     tTcpIpv4ServerContext *pContext;
     tTcpUser *pUser = pArg;
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -116,54 +409,71 @@ static void *_tcpIpv4ServerRecvTask(void *pArg)
 
     while (pUser->fd > 0)
     {
-        LOG_3("IPv4 TCP server ... recv\n");
         pthread_testcancel();
-        len = recv(
-                  pUser->fd,
-                  pUser->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len <= 0)
+        if (_tcpIpv4ServerRecvMsg(pContext, pUser, 0) < 0)
         {
-            LOG_1(
-                "TCP client %s connection closed\n",
-                inet_ntoa( pUser->addrIpv4.sin_addr )
-            );
-            close( pUser->fd );
-            pUser->fd = -1;
-            /* notify the client object to the server application */
-            if ( pContext->pServerExitFunc )
-            {
-                pContext->pServerExitFunc(pContext->pServerArg, pUser);
-            }
             break;
         }
         pthread_testcancel();
+    }
 
-        LOG_3(
-            "<- %s:%d\n",
-            inet_ntoa( pUser->addrIpv4.sin_addr ),
-            ntohs( pUser->addrIpv4.sin_port )
-        );
-        LOG_DUMP("IPv4 TCP server recv", pUser->recvMsg, len);
+    LOG_2("stop the thread: %s\n", __func__);
+
+    _tcpIpv4DisconnectClient(pContext, pUser);
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Reactor event function for the IPv4 TCP server receiving.
+*  @param [in]  pArg    A @ref tTcpUser object.
+*  @param [in]  events  Reactor events.
+*/
+static void _tcpIpv4ServerRecvEvent(void *pArg, unsigned int events)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv4ServerContext *pContext = pUser->pServer;
 
-        if ( pContext->pServerRecvFunc )
+    if (events & EPOLLOUT)
+    {
+        if (_tcpServerFlush( pUser ) != 0)
         {
-            pContext->pServerRecvFunc(
-                         pContext->pServerArg,
-                         pUser,
-                         pUser->recvMsg,
-                         len
-                     );
+            _tcpIpv4DisconnectClient(pContext, pUser);
+            return;
         }
     }
 
-    LOG_2("stop the thread: %s\n", __func__);
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+        if (_tcpIpv4ServerRecvMsg(pContext, pUser, MSG_DONTWAIT) < 0)
+        {
+            _tcpIpv4DisconnectClient(pContext, pUser);
+        }
+    }
+}
 
-    _tcpIpv4DisconnectClient(pContext, pUser);
+/**
+*  Start listening on the IPv4 TCP server socket.
+*  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tcpIpv4ListenServer(tTcpIpv4ServerContext *pContext)
+{
+    if (listen(pContext->fd, SOMAXCONN) < 0)
+    {
+        perror( "listen" );
+        close( pContext->fd );
+        pContext->fd = -1;
+        return -1;
+    }
 
-    pthread_exit(NULL);
+    LOG_1("\n");
+    LOG_1("Port number: %d\n", ntohs( pContext->localAddr.sin_port ));
+    LOG_1("User limit : %d\n", pContext->maxUserNum);
+    LOG_1("IPv4 TCP server ... listen\n");
+    LOG_1("\n");
+
+    return 0;
 }
 
 /**
@@ -180,20 +490,11 @@ static void *_tcpIpv4ServerListenTask(void *pArg)
     LOG_2("start the thread: %s\n", __func__);
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
 
-    if (listen(pContext->fd, (TCP_USER_NUM << 1)) < 0)
+    if (_tcpIpv4ListenServer( pContext ) != 0)
     {
-        perror( "listen" );
-        close( pContext->fd );
-        pContext->fd = -1;
         return NULL;
     }
 
-    LOG_1("\n");
-    LOG_1("Port number: %d\n", ntohs( pContext->localAddr.sin_port ));
-    LOG_1("User limit : %d\n", pContext->maxUserNum);
-    LOG_1("IPv4 TCP server ... listen\n");
-    LOG_1("\n");
-
     while ( pContext->running )
     {
         tTcpUser *pUser;
@@ -230,6 +531,62 @@ static void *_tcpIpv4ServerListenTask(void *pArg)
     pthread_exit(NULL);
 }
 
+/**
+*  Reactor event function for the IPv4 TCP socket listen.
+*  @param [in]  pArg    A @ref tTcpIpv4ServerContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _tcpIpv4ServerAcptEvent(void *pArg, unsigned int events)
+{
+    tTcpIpv4ServerContext *pContext = pArg;
+    struct sockaddr_in clitAddr;
+    socklen_t clitAddrLen;
+
+
+    while ( pContext->running )
+    {
+        tTcpUser *pUser;
+        int fd;
+
+        LOG_3("IPv4 TCP server ... accept\n");
+        clitAddrLen = sizeof( struct sockaddr_in );
+        fd = accept(
+                 pContext->fd,
+                 (struct sockaddr *)&clitAddr,
+                 &clitAddrLen
+             );
+        if (fd < 0)
+        {
+            if ((EAGAIN == errno) || (EINTR == errno) || (ECONNABORTED == errno))
+            {
+                break;
+            }
+            if ((EMFILE == errno) || (ENFILE == errno))
+            {
+                /* resume when a client is released */
+                LOG_WARN("IPv4 TCP server pauses accepting\n");
+                pContext->paused = 1;
+                comm_reactorModEvent(&(pContext->event), 0);
+                break;
+            }
+            LOG_ERROR("fail to accept IPv4 TCP client\n");
+            perror( "accept" );
+            comm_reactorDelEvent( &(pContext->event) );
+            pContext->running = 0;
+            break;
+        }
+
+        LOG_1("TCP client connect from %s\n", inet_ntoa(clitAddr.sin_addr));
+
+        pUser = _tcpIpv4AcceptClient(pContext, &clitAddr, fd);
+        if (NULL == pUser)
+        {
+            LOG_ERROR("fail to accept client\n");
+            close( fd );
+        }
+    }
+}
+
 /**
 *  Initialize IPv4 TCP server.
 *  @param [in]  portNum     Local TCP port number.
@@ -237,15 +594,17 @@ static void *_tcpIpv4ServerListenTask(void *pArg)
 *  @param [in]  pAcptFunc   Application's accept callback function.
 *  @param [in]  pExitFunc   Application's exit callback function.
 *  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
 *  @param [in]  pArg        Application's argument.
 *  @returns  IPv4 TCP server handle.
 */
-tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
+static tTcpIpv4ServerHandle _tcpIpv4ServerOpen(
     unsigned short    portNum,
     int               maxUserNum,
     tTcpServerAcptCb  pAcptFunc,
     tTcpServerExitCb  pExitFunc,
     tTcpServerRecvCb  pRecvFunc,
+    tTcpServerBufCb   pBufFunc,
     void             *pArg
 )
 {
@@ -269,19 +628,28 @@ tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
     pContext->pServerAcptFunc = pAcptFunc;
     pContext->pServerExitFunc = pExitFunc;
     pContext->pServerRecvFunc = pRecvFunc;
+    pContext->pServerBufFunc = pBufFunc;
     pContext->pServerArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
     pContext->fd = -1;
 
-    if ((0 == pContext->maxUserNum) || (pContext->maxUserNum > TCP_USER_NUM))
+    pContext->maxUserNum = comm_tableLimit( maxUserNum );
+    if (pContext->maxUserNum != maxUserNum)
+    {
+        LOG_1("set user number to the max. value %d\n", pContext->maxUserNum);
+    }
+
+    if (comm_tableInit(&(pContext->userTable), pContext->maxUserNum) != 0)
     {
-        LOG_1("set user number to the max. value %d\n", TCP_USER_NUM);
-        pContext->maxUserNum = TCP_USER_NUM;
+        free( pContext );
+        return 0;
     }
 
     error = _tcpIpv4InitServer( pContext );
     if (error != 0)
     {
         LOG_ERROR("failed to create IPv4 TCP socket\n");
+        comm_tableUninit( &(pContext->userTable) );
         free( pContext );
         return 0;
     }
@@ -296,13 +664,45 @@ tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
         LOG_1("ignore IPv4 TCP exit function\n");
     }
 
-    if (NULL == pRecvFunc)
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
     {
         LOG_1("ignore IPv4 TCP receive function\n");
     }
 
+    pContext->refNum = 1;
     pContext->running = 1;
 
+    if ( g_reactor )
+    {
+        /* accept and serve the clients by the shared reactor threads */
+        pContext->reactor = g_reactor;
+
+        error = _tcpIpv4ListenServer( pContext );
+        if (error == 0)
+        {
+            fcntl(pContext->fd, F_SETFL, (fcntl(pContext->fd, F_GETFL) | O_NONBLOCK));
+            error = comm_reactorAddEvent(
+                        pContext->reactor,
+                        &(pContext->event),
+                        pContext->fd,
+                        EPOLLIN,
+                        _tcpIpv4ServerAcptEvent,
+                        pContext
+                    );
+        }
+        if (error != 0)
+        {
+            LOG_ERROR("failed to attach IPv4 TCP server to reactor\n");
+            _tcpIpv4UninitServer( pContext );
+            comm_tableUninit( &(pContext->userTable) );
+            free( pContext );
+            return 0;
+        }
+
+        LOG_1("IPv4 TCP server initialized\n");
+        return ((tTcpIpv4ServerHandle)pContext);
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -316,6 +716,7 @@ tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
     {
         LOG_ERROR("failed to create IPv4 TCP receiving thread\n");
         _tcpIpv4UninitServer( pContext );
+        comm_tableUninit( &(pContext->userTable) );
         free( pContext );
         return 0;
     }
@@ -327,32 +728,127 @@ tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
 }
 
 /**
-*  Un-initialize IPv4 TCP server.
-*  @param [in]  handle  IPv4 TCP server handle.
+*  Initialize IPv4 TCP server.
+*  @param [in]  portNum     Local TCP port number.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv4 TCP server handle.
 */
-void comm_tcpIpv4ServerUninit(tTcpIpv4ServerHandle handle)
+tTcpIpv4ServerHandle comm_tcpIpv4ServerInit(
+    unsigned short    portNum,
+    int               maxUserNum,
+    tTcpServerAcptCb  pAcptFunc,
+    tTcpServerExitCb  pExitFunc,
+    tTcpServerRecvCb  pRecvFunc,
+    void             *pArg
+)
 {
-    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
-    int i;
-
-    if ( pContext )
-    {
-        pthread_cancel( pContext->thread );
-
-        pContext->running = 0;
-        pContext->userNum = 0;
-        for (i=0; i<pContext->maxUserNum; i++)
-        {
-            _tcpIpv4DisconnectClient(pContext, pContext->pUser[i]);
-        }
-        _tcpIpv4UninitServer( pContext );
+    return _tcpIpv4ServerOpen(
+               portNum,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               pRecvFunc,
+               NULL,
+               pArg
+           );
+}
 
-        pthread_join(pContext->thread, NULL);
-        free( pContext );
+/**
+*  Initialize IPv4 TCP server with zero-copy buffers.
+*  @param [in]  portNum     Local TCP port number.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv4 TCP server handle.
+*/
+tTcpIpv4ServerHandle comm_tcpIpv4ServerInitBuf(
+    unsigned short    portNum,
+    int               maxUserNum,
+    tTcpServerAcptCb  pAcptFunc,
+    tTcpServerExitCb  pExitFunc,
+    tTcpServerBufCb   pBufFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv4ServerOpen(
+               portNum,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               NULL,
+               pBufFunc,
+               pArg
+           );
+}
+
+/**
+*  Drop a reference of an IPv4 TCP server, the last one frees it.
+*  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
+*/
+static void _tcpIpv4ServerPut(tTcpIpv4ServerContext *pContext)
+{
+    if (__sync_sub_and_fetch(&(pContext->refNum), 1) == 0)
+    {
+        comm_tableUninit( &(pContext->userTable) );
+        free( pContext );
         LOG_1("IPv4 TCP server un-initialized\n");
     }
 }
 
+/**
+*  Release an IPv4 TCP server when it no more accepts, the clients
+*  served by other reactor threads are released by them.
+*  @param [in]  pArg  A @ref tTcpIpv4ServerContext object.
+*/
+static void _tcpIpv4ServerRelease(void *pArg)
+{
+    tTcpIpv4ServerContext *pContext = pArg;
+    tTcpUser *pUser;
+    int i;
+
+    for (i=0; i<comm_tableSize( &(pContext->userTable) ); i++)
+    {
+        pUser = comm_tableDelAt(&(pContext->userTable), i);
+        if ( pUser )
+        {
+            _tcpIpv4FreeClient(pContext, pUser, 0);
+        }
+    }
+    _tcpIpv4UninitServer( pContext );
+    _tcpIpv4ServerPut( pContext );
+}
+
+/**
+*  Un-initialize IPv4 TCP server.
+*  @param [in]  handle  IPv4 TCP server handle.
+*/
+void comm_tcpIpv4ServerUninit(tTcpIpv4ServerHandle handle)
+{
+    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
+
+    if ( pContext )
+    {
+        pContext->running = 0;
+
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _tcpIpv4ServerRelease, pContext);
+        }
+        else
+        {
+            pthread_cancel( pContext->thread );
+            pthread_join(pContext->thread, NULL);
+            _tcpIpv4ServerRelease( pContext );
+        }
+    }
+}
+
 /**
 *  Create the connection to an IPv4 TCP client.
 *  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
@@ -366,76 +862,114 @@ static tTcpUser *_tcpIpv4AcceptClient(
     int                    fd
 )
 {
-    tTcpUser *pUser = NULL;
+    tTcpUserEntry *pEntry;
+    tTcpUser *pUser;
     pthread_attr_t tattr;
     int noDelay = 1;
     socklen_t noDelayLen;
     int error;
-    int i;
 
 
-    if (pContext->userNum >= pContext->maxUserNum)
+    pEntry = malloc( sizeof( tTcpUserEntry ) );
+    if (NULL == pEntry)
+    {
+        LOG_ERROR("user memory was exhausted\n");
+        return NULL;
+    }
+
+    memset(pEntry, 0x00, sizeof( tTcpUserEntry ));
+    pEntry->frame = pContext->frame;
+    pthread_mutex_init(&(pEntry->sendMutex), NULL);
+    pEntry->refNum = 1;
+    if ( pContext->reactor )
+    {
+        /* the send queue is written by the reactor on EPOLLOUT */
+        pEntry->queue = pContext->queue;
+        pEntry->queue.pEvent = &(pEntry->event);
+        pEntry->queue.pWaterArg = &(pEntry->user);
+    }
+    pUser = &(pEntry->user);
+    pUser->pServer = pContext;
+    pUser->addrIpv4 = (*pAddr);
+    pUser->fd = fd;
+
+    pEntry->id = comm_tableAdd(&(pContext->userTable), pUser);
+    if (0 == pEntry->id)
     {
         LOG_ERROR("user number was exceeded (%d)\n", pContext->maxUserNum);
+        comm_queueUninit( &(pEntry->queue) );
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
         return NULL;
     }
+    __sync_fetch_and_add(&(pContext->refNum), 1);
+
+    LOG_3("IPv4 TCP create client fd(%d)\n", fd);
+
+    noDelayLen = sizeof( noDelay );
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, noDelayLen);
+
+    /* notify the client object to the server application */
+    if ( pContext->pServerAcptFunc )
+    {
+        pContext->pServerAcptFunc(pContext->pServerArg, pUser);
+    }
 
-    for (i=0; i<pContext->maxUserNum; i++)
+    if ( pContext->reactor )
     {
-        if (NULL == pContext->pUser[i])
+        error = comm_reactorAddEvent(
+                    pContext->reactor,
+                    &(pEntry->event),
+                    fd,
+                    EPOLLIN,
+                    _tcpIpv4ServerRecvEvent,
+                    pUser
+                );
+        if (0 == error)
         {
-            pUser = malloc( sizeof( tTcpUser ) );
+            /* the data queued by the accept callback waits for EPOLLOUT */
+            pthread_mutex_lock( &(pEntry->sendMutex) );
+            comm_queueAttach( &(pEntry->queue) );
+            pthread_mutex_unlock( &(pEntry->sendMutex) );
+        }
+    }
+    else
+    {
+        pthread_attr_init( &tattr );
+        pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
 
-            if ( pUser )
-            {
-                LOG_3("IPv4 TCP create client fd(%d)\n", fd);
-
-                noDelayLen = sizeof( noDelay );
-                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, noDelayLen);
-
-                memset(pUser, 0x00, sizeof( tTcpUser ));
-                pUser->pServer = pContext;
-                pUser->addrIpv4 = (*pAddr);
-                pUser->fd = fd;
-
-                pthread_attr_init( &tattr );
-                pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
-
-                error = pthread_create(
-                            &(pUser->thread),
-                            &tattr,
-                            _tcpIpv4ServerRecvTask,
-                            pUser
-                        );
-                if (error != 0)
-                {
-                    LOG_ERROR("failed to create the client connection thread\n");
-                    free( pUser );
-                    return NULL;
-                }
-
-                pthread_attr_destroy( &tattr );
-
-                /* notify the client object to the server application */
-                if ( pContext->pServerAcptFunc )
-                {
-                    pContext->pServerAcptFunc(pContext->pServerArg, pUser);
-                }
-
-                pContext->pUser[i] = pUser;
-                pContext->userNum++;
-            }
+        error = pthread_create(
+                    &(pUser->thread),
+                    &tattr,
+                    _tcpIpv4ServerRecvTask,
+                    pUser
+                );
+
+        pthread_attr_destroy( &tattr );
+    }
 
-            return pUser;
+    if (error != 0)
+    {
+        LOG_ERROR("failed to serve the client connection\n");
+        comm_tableDel(&(pContext->userTable), pEntry->id);
+        /* the socket is closed by the caller */
+        pUser->fd = -1;
+        if ( pContext->pServerExitFunc )
+        {
+            pContext->pServerExitFunc(pContext->pServerArg, pUser);
         }
+        comm_queueUninit( &(pEntry->queue) );
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
+        __sync_fetch_and_sub(&(pContext->refNum), 1);
+        return NULL;
     }
 
-    LOG_ERROR("user memory was exhausted\n");
-    return NULL;
+    return pUser;
 }
 
 /**
-*  Remove the connection of an IPv4 TCP client.
+*  Remove the connection of an IPv4 TCP client closed by the peer.
 *  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
 *  @param [in]  pUser     A @ref tTcpUser object.
 */
@@ -444,240 +978,554 @@ static void _tcpIpv4DisconnectClient(
     tTcpUser              *pUser
 )
 {
-    int i;
-
-    if ( pUser )
+    /* whoever removes the client from the table releases it */
+    if (comm_tableDel(&(pContext->userTable), TCP_USER_ID(pUser)) == pUser)
     {
-        LOG_3("IPv4 TCP remove client fd(%d)\n", pUser->fd);
-
-        for (i=0; i<pContext->maxUserNum; i++)
-        {
-            if (pContext->pUser[i] == pUser)
-            {
-                pContext->pUser[i] = NULL;
-                if (pContext->userNum > 0)
-                {
-                    pContext->userNum--;
-                }
-                break;
-            }
-        }
-
-        if (pUser->fd > 0)
-        {
-            pthread_cancel( pUser->thread );
-            close( pUser->fd );
-            pUser->fd = -1;
-        }
-
-        free( pUser );
+        _tcpIpv4FreeClient(pContext, pUser, 1);
     }
 }
 
 /**
-*  Send message to an IPv4 TCP client.
-*  @param [in]  pUser  A @ref tTcpUser object.
-*  @param [in]  pData  A pointer of data buffer.
-*  @param [in]  size   Data size.
-*  @returns  Message length (-1 is failed).
+*  Drop a reference of an IPv4 TCP client, the last one closes the
+*  socket, frees the client and drops its server reference.
+*  @param [in]  pArg  A @ref tTcpUser object.
 */
-int comm_tcpIpv4ServerSend(
-    tTcpUser       *pUser,
-    unsigned char  *pData,
-    unsigned short  size
-)
+static void _tcpIpv4PutClient(void *pArg)
 {
-    int error;
-
+    tTcpUser *pUser = pArg;
+    tTcpIpv4ServerContext *pContext = pUser->pServer;
 
-    if (NULL == pUser)
+    if (__sync_sub_and_fetch(&(TCP_USER_REF(pUser)), 1) != 0)
     {
-        LOG_ERROR("%s: pUser is NULL\n", __func__);
-        return -1;
+        return;
     }
 
-    if (pUser->fd < 0)
+    if (pUser->fd > 0)
     {
-        LOG_ERROR("%s: client socket is not ready\n", __func__);
-        return -1;
+        close( pUser->fd );
+        pUser->fd = -1;
     }
 
-    if (NULL == pData)
+    comm_frameReset( TCP_USER_FRAME(pUser) );
+    comm_queueUninit( TCP_USER_QUEUE(pUser) );
+    pthread_mutex_destroy( TCP_USER_MUTEX(pUser) );
+    free( pUser );
+
+    if (( pContext->running ) && __sync_bool_compare_and_swap(&(pContext->paused), 1, 0))
     {
-        LOG_WARN("%s: pData is NULL\n", __func__);
-        return -1;
+        LOG_1("IPv4 TCP server resumes accepting\n");
+        comm_reactorModEvent(&(pContext->event), EPOLLIN);
     }
 
-    if (0 == size)
+    _tcpIpv4ServerPut( pContext );
+}
+
+/**
+*  Release an IPv4 TCP client removed from the user table.
+*  @param [in]  pContext  A @ref tTcpIpv4ServerContext object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*  @param [in]  closed    Closed by the peer in the receiving context.
+*/
+static void _tcpIpv4FreeClient(
+    tTcpIpv4ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    closed
+)
+{
+    LOG_3("IPv4 TCP remove client fd(%d)\n", pUser->fd);
+
+    if (( pContext->reactor ) && ( !closed ))
     {
-        LOG_WARN("%s: size is 0\n", __func__);
-        return -1;
+        /* the client may be on another reactor thread, which releases it */
+        comm_reactorDelEventFree(TCP_USER_EVENT(pUser), _tcpIpv4PutClient, pUser);
+        return;
     }
 
-    LOG_3("-> %s\n", inet_ntoa( pUser->addrIpv4.sin_addr ));
-    LOG_DUMP("IPv4 TCP server send", pData, size);
+    if ( pContext->reactor )
+    {
+        comm_reactorDelEvent( TCP_USER_EVENT(pUser) );
+    }
+    else if ( !closed )
+    {
+        pthread_cancel( pUser->thread );
+    }
 
-    error = send(
-                pUser->fd,
-                pData,
-                size,
-                0
-            );
-    if (error < 0)
+    /* notify the client object to the server application */
+    if (( closed ) && ( pContext->pServerExitFunc ))
     {
-        LOG_ERROR("fail to send IPv4 TCP client\n");
-        perror( "send" );
+        pContext->pServerExitFunc(pContext->pServerArg, pUser);
     }
 
-    return error;
+    /* the socket is closed after the senders to all */
+    _tcpIpv4PutClient( pUser );
 }
 
 /**
-*  Send message to all IPv4 TCP clients.
+*  Set the message framing of the clients accepted afterwards.
 *  @param [in]  handle  IPv4 TCP server handle.
-*  @param [in]  pData   A pointer of data buffer.
-*  @param [in]  size    Data size.
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
 */
-void comm_tcpIpv4ServerSendAllClient(
-    tTcpIpv4ServerHandle  handle,
-    unsigned char        *pData,
-    unsigned short        size
-)
+int comm_tcpIpv4ServerSetFrame(tTcpIpv4ServerHandle handle, tCommFrame *pFrame)
 {
     tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
-    tTcpUser *pUser;
-    int error;
-    int i;
-
+    tCommFrame cfg;
+    tFrame frame;
 
-    if (0 == pContext->userNum)
+    if (NULL == pContext)
     {
-        LOG_WARN("%s: user number is 0\n", __func__);
-        return;
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
     }
 
-    if (NULL == pData)
+    if ( pFrame )
     {
-        LOG_ERROR("%s: pData is NULL\n", __func__);
-        return;
+        cfg = *pFrame;
+        if (( pContext->pServerRecvFunc ) && (0 == cfg.maxSize))
+        {
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
+        }
+        pFrame = &cfg;
     }
 
-    if (0 == size)
+    if (comm_frameInit(&frame, pFrame) != 0)
     {
-        LOG_WARN("%s: size is 0\n", __func__);
-        return;
+        return -1;
     }
 
-    LOG_DUMP("IPv4 TCP send to all clients", pData, size);
-
-    for (i=0; i<pContext->maxUserNum; i++)
+    if (( pFrame ) && ( pContext->pServerRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
     {
-        pUser = pContext->pUser[i];
-
-        if (( pUser ) && (pUser->fd > 0))
-        {
-            error = send(
-                        pUser->fd,
-                        pData,
-                        size,
-                        0
-                    );
-            if (error < 0)
-            {
-                LOG_ERROR("fail to send IPv4 TCP to fd(%d)\n", pUser->fd);
-                perror( "send" );
-            }
-        }
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
     }
+
+    pContext->frame = frame;
+    return 0;
 }
 
 /**
-*  Get the number of connected IPv4 clients.
-*  @param [in]  handle  IPv4 TCP server handle.
-*  @returns  Number of clients.
+*  Set the send queue of the clients accepted afterwards. With the reactor
+*  (@ref comm_setReactor) a send never blocks: what the socket does not
+*  take is queued and written on EPOLLOUT, a send over the queue size
+*  fails. Without the reactor the sends stay blocking. The watermark
+*  callback is called after the send has released its locks, it may call
+*  the server functions again, including the send to all clients.
+*  @param [in]  handle      IPv4 TCP server handle.
+*  @param [in]  pQueue      A @ref tCommQueue object (NULL is blocking send).
+*  @param [in]  pWaterFunc  Application's watermark callback function.
+*  @returns  Success(0) or failure(-1).
 */
-int comm_tcpIpv4ServerGetClientNum(tTcpIpv4ServerHandle handle)
+int comm_tcpIpv4ServerSetSendQueue(
+    tTcpIpv4ServerHandle  handle,
+    tCommQueue           *pQueue,
+    tTcpServerWaterCb     pWaterFunc
+)
 {
     tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
-    return pContext->userNum;
-}
-
-
-typedef struct _tTcpIpv6ServerContext
-{
-    struct sockaddr_in6  localAddr;
-    int                  fd;
+    tSendQueue queue;
 
-    tTcpUser            *pUser[TCP_USER_NUM];
-    int                  userNum;
-    int                  maxUserNum;
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-    tTcpServerAcptCb     pServerAcptFunc;
-    tTcpServerExitCb     pServerExitFunc;
-    tTcpServerRecvCb     pServerRecvFunc;
-    void                *pServerArg;
-    pthread_t            thread;
-    int                  running;
-} tTcpIpv6ServerContext;
+    if (comm_queueInit(&queue, pQueue, NULL, _tcpIpv4ServerWaterFunc, NULL) != 0)
+    {
+        return -1;
+    }
 
-static tTcpUser *_tcpIpv6AcceptClient(
-    tTcpIpv6ServerContext *pContext,
-    struct sockaddr_in6   *pAddr,
-    int                    fd
-);
-static void _tcpIpv6DisconnectClient(
-    tTcpIpv6ServerContext *pContext,
-    tTcpUser              *pUser
-);
+    if (( pQueue ) && (0 == g_reactor) && (0 == pContext->reactor))
+    {
+        LOG_WARN("%s: send queue needs the reactor\n", __func__);
+    }
 
+    pContext->queue = queue;
+    pContext->pServerWaterFunc = pWaterFunc;
+    return 0;
+}
 
 /**
-*  Initialize an IPv6 TCP socket.
-*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  Set the receive size of the IPv4 TCP server clients.
+*  @param [in]  handle  IPv4 TCP server handle.
+*  @param [in]  size    Max. message size of one receive.
 *  @returns  Success(0) or failure(-1).
 */
-static int _tcpIpv6InitServer(tTcpIpv6ServerContext *pContext)
+int comm_tcpIpv4ServerSetRecvSize(tTcpIpv4ServerHandle handle, size_t size)
 {
-    struct sockaddr_in6 bindAddr;
-    int bindAddrLen;
-    int fd;
-
-    int reUseAddr = 1;
-    socklen_t reUseAddrLen;
-
+    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
 
-    fd = socket(AF_INET6, SOCK_STREAM, 0);
-    if (fd < 0)
+    if (NULL == pContext)
     {
-        perror( "socket" );
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
         return -1;
     }
 
-    /* enable the port number re-use */
-    reUseAddrLen = sizeof( reUseAddr );
-    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, reUseAddrLen);
-
-    bindAddrLen = sizeof( struct sockaddr_in6 );
-    bindAddr = pContext->localAddr;
-
-    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    if ((0 == size) || (size > INT_MAX))
     {
-        perror( "bind" );
-        close( fd );
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
         return -1;
     }
 
-    pContext->fd = fd;
+    if ((pContext->pServerRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
 
-    LOG_2("IPv6 TCP server socket is ready\n");
+    pContext->recvSize = size;
     return 0;
 }
 
 /**
-*  Un-initialize an IPv6 TCP socket.
-*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  Tap the IPv4 TCP server, so that the messages it sends to and receives
+*  from the clients are copied to a pcapng capture. The connection ID of a
+*  client is its slot in the user table, reused by the later clients.
+*  @param [in]  handle  IPv4 TCP server handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
 */
-static void _tcpIpv6UninitServer(tTcpIpv6ServerContext *pContext)
+int comm_tcpIpv4ServerSetTap(tTcpIpv4ServerHandle handle, tPcapHandle pcap)
+{
+    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "tcp4-server:%d", ntohs( pContext->localAddr.sin_port ));
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
+}
+
+/**
+*  Send message to an IPv4 TCP client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+int comm_tcpIpv4ServerSend(
+    tTcpUser       *pUser,
+    unsigned char  *pData,
+    unsigned short  size
+)
+{
+    return comm_tcpIpv4ServerSendEx(pUser, pData, size);
+}
+
+/**
+*  Send message to an IPv4 TCP client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv4ServerSendEx(
+    tTcpUser       *pUser,
+    unsigned char  *pData,
+    size_t          size
+)
+{
+    struct iovec iov;
+    tTcpIpv4ServerContext *pContext;
+    ssize_t error;
+
+
+    if (NULL == pUser)
+    {
+        LOG_ERROR("%s: pUser is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pUser->fd < 0)
+    {
+        LOG_ERROR("%s: client socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s\n", inet_ntoa( pUser->addrIpv4.sin_addr ));
+    LOG_DUMP("IPv4 TCP server send", pData, size);
+
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pContext = pUser->pServer;
+    error = _tcpServerSendv(pUser, &iov, 1, &(pContext->tap));
+    /* a full send queue was reported by the queue */
+    if ((error < 0) && (ENOBUFS != errno))
+    {
+        LOG_ERROR("fail to send IPv4 TCP client\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to an IPv4 TCP client, the message
+*  is not interleaved with the other senders of the client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pIov   Data buffers.
+*  @param [in]  num    Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv4ServerSendv(
+    tTcpUser      *pUser,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    tTcpIpv4ServerContext *pContext;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pUser)
+    {
+        LOG_ERROR("%s: pUser is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pUser->fd < 0)
+    {
+        LOG_ERROR("%s: client socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %s\n", inet_ntoa( pUser->addrIpv4.sin_addr ));
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv4 TCP server send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pContext = pUser->pServer;
+    error = _tcpServerSendv(pUser, pIov, num, &(pContext->tap));
+    /* a full send queue was reported by the queue */
+    if ((error < 0) && (ENOBUFS != errno))
+    {
+        LOG_ERROR("fail to send IPv4 TCP client\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send message to all IPv4 TCP clients.
+*  @param [in]  handle  IPv4 TCP server handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*/
+void comm_tcpIpv4ServerSendAllClient(
+    tTcpIpv4ServerHandle  handle,
+    unsigned char        *pData,
+    unsigned short        size
+)
+{
+    comm_tcpIpv4ServerSendAllClientEx(handle, pData, size);
+}
+
+/**
+*  Send message to all IPv4 TCP clients.
+*  @param [in]  handle  IPv4 TCP server handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*/
+void comm_tcpIpv4ServerSendAllClientEx(
+    tTcpIpv4ServerHandle  handle,
+    unsigned char        *pData,
+    size_t                size
+)
+{
+    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
+    tTcpSendAll sendAll;
+    int i;
+
+
+    if (0 == comm_tableNum( &(pContext->userTable) ))
+    {
+        LOG_WARN("%s: user number is 0\n", __func__);
+        return;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_ERROR("%s: pData is NULL\n", __func__);
+        return;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return;
+    }
+
+    LOG_DUMP("IPv4 TCP send to all clients", pData, size);
+
+    sendAll.pData   = pData;
+    sendAll.size    = size;
+    sendAll.pTap    = &(pContext->tap);
+    sendAll.userNum = 0;
+    sendAll.maxNum  = comm_tableSize( &(pContext->userTable) );
+    sendAll.ppUser  = malloc( sizeof( tTcpUser * ) * sendAll.maxNum );
+    if (NULL == sendAll.ppUser)
+    {
+        LOG_ERROR("fail to allocate IPv4 TCP client list\n");
+        return;
+    }
+
+    /* a blocking send must not hold up the accepting and disconnecting */
+    comm_tableForEach(&(pContext->userTable), _tcpServerHoldFunc, &sendAll);
+    for (i=0; i<sendAll.userNum; i++)
+    {
+        _tcpServerSendAllFunc(&sendAll, sendAll.ppUser[i]);
+        _tcpIpv4PutClient( sendAll.ppUser[i] );
+    }
+    free( sendAll.ppUser );
+}
+
+/**
+*  Get the number of connected IPv4 clients.
+*  @param [in]  handle  IPv4 TCP server handle.
+*  @returns  Number of clients.
+*/
+int comm_tcpIpv4ServerGetClientNum(tTcpIpv4ServerHandle handle)
+{
+    tTcpIpv4ServerContext *pContext = (tTcpIpv4ServerContext *)handle;
+    return comm_tableNum( &(pContext->userTable) );
+}
+
+
+typedef struct _tTcpIpv6ServerContext
+{
+    struct sockaddr_in6  localAddr;
+    int                  fd;
+
+    tTable               userTable;
+    int                  maxUserNum;
+
+    tTcpServerAcptCb     pServerAcptFunc;
+    tTcpServerExitCb     pServerExitFunc;
+    tTcpServerRecvCb     pServerRecvFunc;
+    tTcpServerBufCb      pServerBufFunc;
+    size_t               recvSize;
+    tFrame               frame;
+    tPcapTap             tap;
+    tSendQueue           queue;
+    tTcpServerWaterCb    pServerWaterFunc;
+    void                *pServerArg;
+    pthread_t            thread;
+    int                  running;
+    tReactorHandle       reactor;
+    tReactorEvent        event;
+    int                  paused;
+    int                  refNum;  /* the server and its clients */
+} tTcpIpv6ServerContext;
+
+static tTcpUser *_tcpIpv6AcceptClient(
+    tTcpIpv6ServerContext *pContext,
+    struct sockaddr_in6   *pAddr,
+    int                    fd
+);
+static void _tcpIpv6DisconnectClient(
+    tTcpIpv6ServerContext *pContext,
+    tTcpUser              *pUser
+);
+static void _tcpIpv6FreeClient(
+    tTcpIpv6ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    closed
+);
+
+
+/**
+*  Initialize an IPv6 TCP socket.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tcpIpv6InitServer(tTcpIpv6ServerContext *pContext)
+{
+    struct sockaddr_in6 bindAddr;
+    int bindAddrLen;
+    int fd;
+
+    int reUseAddr = 1;
+    socklen_t reUseAddrLen;
+
+
+    fd = socket(AF_INET6, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror( "socket" );
+        return -1;
+    }
+
+    /* enable the port number re-use */
+    reUseAddrLen = sizeof( reUseAddr );
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, reUseAddrLen);
+
+    bindAddrLen = sizeof( struct sockaddr_in6 );
+    bindAddr = pContext->localAddr;
+
+    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    {
+        perror( "bind" );
+        close( fd );
+        return -1;
+    }
+
+    pContext->fd = fd;
+
+    LOG_2("IPv6 TCP server socket is ready\n");
+    return 0;
+}
+
+/**
+*  Un-initialize an IPv6 TCP socket.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*/
+static void _tcpIpv6UninitServer(tTcpIpv6ServerContext *pContext)
 {
     if (pContext->fd > 0)
     {
@@ -688,6 +1536,145 @@ static void _tcpIpv6UninitServer(tTcpIpv6ServerContext *pContext)
     LOG_2("IPv6 TCP server socket is closed\n");
 }
 
+/**
+*  Pass one message to the IPv6 TCP server receive callback.
+*  @param [in]  pArg  A @ref tTcpUser object.
+*  @param [in]  pBuf  A @ref tCommBuf object owned by the callee.
+*/
+static void _tcpIpv6ServerMsgFunc(void *pArg, tCommBuf *pBuf)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv6ServerContext *pContext = pUser->pServer;
+    tPcapTap *pTap = &(pContext->tap);
+    struct iovec iov;
+
+    if ( comm_pcapTapped( pTap ) )
+    {
+        iov.iov_base = pBuf->pData;
+        iov.iov_len  = pBuf->size;
+        comm_pcapWriteConn(pTap, PCAP_IN, TCP_USER_CONN(pUser), &iov, 1);
+    }
+
+    if ( pContext->pServerBufFunc )
+    {
+        /* the callback owns the buffer */
+        pContext->pServerBufFunc(pContext->pServerArg, pUser, pBuf);
+        return;
+    }
+
+    if ( pContext->pServerRecvFunc )
+    {
+        pContext->pServerRecvFunc(
+                     pContext->pServerArg,
+                     pUser,
+                     pBuf->pData,
+                     pBuf->size
+                 );
+    }
+
+    comm_bufRelease( pBuf );
+}
+
+/**
+*  Pass the send queue watermark to the IPv6 TCP server callback.
+*  @param [in]  pArg  A @ref tTcpUser object.
+*  @param [in]  high  Over the high-water mark(1) or drained to the low-water mark(0).
+*/
+static void _tcpIpv6ServerWaterFunc(void *pArg, int high)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv6ServerContext *pContext = pUser->pServer;
+
+    if ( pContext->pServerWaterFunc )
+    {
+        pContext->pServerWaterFunc(pContext->pServerArg, pUser, high);
+    }
+}
+
+/**
+*  Receive a message and pass it to the IPv6 TCP server receive callback.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*  @param [in]  flags     recv() flags.
+*  @returns  Message length (-1 is closed).
+*/
+static int _tcpIpv6ServerRecvMsg(
+    tTcpIpv6ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    flags
+)
+{
+    char ipv6Str[INET6_ADDRSTRLEN];
+    size_t recvSize = pContext->recvSize;
+    unsigned char *pData;
+    size_t room;
+    tCommBuf *pBuf;
+    int len;
+
+
+    pBuf = comm_frameRecvBuf(TCP_USER_FRAME(pUser), recvSize, &pData, &room);
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv6 TCP server ... recv\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recv(
+              pUser->fd,
+              pData,
+              room,
+              flags
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        inet_ntop(
+            AF_INET6,
+            &(pUser->addrIpv6.sin6_addr),
+            ipv6Str,
+            INET6_ADDRSTRLEN
+        );
+        LOG_1("TCP client %s connection closed\n", ipv6Str);
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    inet_ntop(
+        AF_INET6,
+        &(pUser->addrIpv6.sin6_addr),
+        ipv6Str,
+        INET6_ADDRSTRLEN
+    );
+    LOG_3(
+       "<- %s:%d\n",
+        ipv6Str,
+        ntohs( pUser->addrIpv6.sin6_port )
+    );
+    LOG_DUMP("IPv6 TCP server recv", pData, len);
+
+    if ( comm_frameEnabled( TCP_USER_FRAME(pUser) ) )
+    {
+        if (comm_framePut(TCP_USER_FRAME(pUser), pBuf, len, _tcpIpv6ServerMsgFunc, pUser) != 0)
+        {
+            /* drop the connection of a broken frame stream */
+            shutdown(pUser->fd, SHUT_RDWR);
+        }
+        return len;
+    }
+
+    pBuf->size = len;
+    _tcpIpv6ServerMsgFunc(pUser, pBuf);
+    return len;
+}
+
 /**
 *  Thread function for the IPv6 TCP server receiving.
 *  @param [in]  pArg  A @ref tTcpUser object.
@@ -696,8 +1683,6 @@ static void *_tcpIpv6ServerRecvTask(void *pArg)
 {
     tTcpIpv6ServerContext *pContext;
     tTcpUser *pUser = pArg;
-    char ipv6Str[INET6_ADDRSTRLEN];
-    int len;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
@@ -707,93 +1692,147 @@ static void *_tcpIpv6ServerRecvTask(void *pArg)
 
     while (pUser->fd > 0)
     {
-        LOG_3("IPv6 TCP server ... recv\n");
         pthread_testcancel();
-        len = recv(
-                  pUser->fd,
-                  pUser->recvMsg,
-                  COMM_BUF_SIZE,
-                  0
-              );
-        if (len <= 0)
+        if (_tcpIpv6ServerRecvMsg(pContext, pUser, 0) < 0)
         {
-            inet_ntop(
-                AF_INET6,
-                &(pUser->addrIpv6.sin6_addr),
-                ipv6Str,
-                INET6_ADDRSTRLEN
-            );
-            LOG_1("TCP client %s connection closed\n", ipv6Str);
-            close( pUser->fd );
-            pUser->fd = -1;
-            /* notify the client object to the server application */
-            if ( pContext->pServerExitFunc )
-            {
-                pContext->pServerExitFunc(pContext->pServerArg, pUser);
-            }
+            break;
+        }
+        pthread_testcancel();
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
+
+    _tcpIpv6DisconnectClient(pContext, pUser);
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Reactor event function for the IPv6 TCP server receiving.
+*  @param [in]  pArg    A @ref tTcpUser object.
+*  @param [in]  events  Reactor events.
+*/
+static void _tcpIpv6ServerRecvEvent(void *pArg, unsigned int events)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv6ServerContext *pContext = pUser->pServer;
+
+    if (events & EPOLLOUT)
+    {
+        if (_tcpServerFlush( pUser ) != 0)
+        {
+            _tcpIpv6DisconnectClient(pContext, pUser);
+            return;
+        }
+    }
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+        if (_tcpIpv6ServerRecvMsg(pContext, pUser, MSG_DONTWAIT) < 0)
+        {
+            _tcpIpv6DisconnectClient(pContext, pUser);
+        }
+    }
+}
+
+/**
+*  Start listening on the IPv6 TCP server socket.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _tcpIpv6ListenServer(tTcpIpv6ServerContext *pContext)
+{
+    if (listen(pContext->fd, SOMAXCONN) < 0)
+    {
+        perror( "listen" );
+        close( pContext->fd );
+        pContext->fd = -1;
+        return -1;
+    }
+
+    LOG_1("\n");
+    LOG_1("Port number: %d\n", ntohs( pContext->localAddr.sin6_port ));
+    LOG_1("User limit : %d\n", pContext->maxUserNum);
+    LOG_1("IPv6 TCP server ... listen\n");
+    LOG_1("\n");
+
+    return 0;
+}
+
+/**
+*  Thread function for the IPv6 TCP socket listen.
+*  @param [in]  pArg  A @ref tTcpIpv6ServerContext object.
+*/
+static void *_tcpIpv6ServerListenTask(void *pArg)
+{
+    tTcpIpv6ServerContext *pContext = pArg;
+    char ipv6Str[INET6_ADDRSTRLEN];
+    struct sockaddr_in6 clitAddr;
+    socklen_t clitAddrLen = sizeof( struct sockaddr_in6 );
+
+
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    if (_tcpIpv6ListenServer( pContext ) != 0)
+    {
+        return NULL;
+    }
+
+    while ( pContext->running )
+    {
+        tTcpUser *pUser;
+        int fd;
+
+        LOG_3("IPv6 TCP server ... accept\n");
+        pthread_testcancel();
+        fd = accept(
+                 pContext->fd,
+                 (struct sockaddr *)&clitAddr,
+                 &clitAddrLen
+             );
+        if (fd < 0)
+        {
+            LOG_ERROR("fail to accept IPv6 TCP client\n");
+            perror( "accept" );
             break;
         }
         pthread_testcancel();
 
         inet_ntop(
             AF_INET6,
-            &(pUser->addrIpv6.sin6_addr),
+            &(clitAddr.sin6_addr),
             ipv6Str,
             INET6_ADDRSTRLEN
         );
-        LOG_3(
-           "<- %s:%d\n",
-            ipv6Str,
-            ntohs( pUser->addrIpv6.sin6_port )
-        );
-        LOG_DUMP("IPv6 TCP server recv", pUser->recvMsg, len);
+        LOG_1("TCP client connect from %s\n", ipv6Str);
 
-        if ( pContext->pServerRecvFunc )
+        pUser = _tcpIpv6AcceptClient(pContext, &clitAddr, fd);
+        if (NULL == pUser)
         {
-            pContext->pServerRecvFunc(
-                         pContext->pServerArg,
-                         pUser,
-                         pUser->recvMsg,
-                         len
-                     );
+            LOG_ERROR("fail to accept client\n");
+            close( fd );
         }
     }
 
     LOG_2("stop the thread: %s\n", __func__);
-
-    _tcpIpv6DisconnectClient(pContext, pUser);
+    pContext->running = 0;
 
     pthread_exit(NULL);
 }
 
-/**
-*  Thread function for the IPv6 TCP socket listen.
-*  @param [in]  pArg  A @ref tTcpIpv6ServerContext object.
+/**
+*  Reactor event function for the IPv6 TCP socket listen.
+*  @param [in]  pArg    A @ref tTcpIpv6ServerContext object.
+*  @param [in]  events  Reactor events.
 */
-static void *_tcpIpv6ServerListenTask(void *pArg)
+static void _tcpIpv6ServerAcptEvent(void *pArg, unsigned int events)
 {
     tTcpIpv6ServerContext *pContext = pArg;
     char ipv6Str[INET6_ADDRSTRLEN];
     struct sockaddr_in6 clitAddr;
-    socklen_t clitAddrLen = sizeof( struct sockaddr_in6 );
-
-
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
-
-    if (listen(pContext->fd, (TCP_USER_NUM << 1)) < 0)
-    {
-        perror( "listen" );
-        close( pContext->fd );
-        pContext->fd = -1;
-        return NULL;
-    }
+    socklen_t clitAddrLen;
 
-    LOG_1("\n");
-    LOG_1("Port number: %d\n", ntohs( pContext->localAddr.sin6_port ));
-    LOG_1("User limit : %d\n", pContext->maxUserNum);
-    LOG_1("IPv6 TCP server ... listen\n");
-    LOG_1("\n");
 
     while ( pContext->running )
     {
@@ -801,7 +1840,7 @@ static void *_tcpIpv6ServerListenTask(void *pArg)
         int fd;
 
         LOG_3("IPv6 TCP server ... accept\n");
-        pthread_testcancel();
+        clitAddrLen = sizeof( struct sockaddr_in6 );
         fd = accept(
                  pContext->fd,
                  (struct sockaddr *)&clitAddr,
@@ -809,11 +1848,24 @@ static void *_tcpIpv6ServerListenTask(void *pArg)
              );
         if (fd < 0)
         {
+            if ((EAGAIN == errno) || (EINTR == errno) || (ECONNABORTED == errno))
+            {
+                break;
+            }
+            if ((EMFILE == errno) || (ENFILE == errno))
+            {
+                /* resume when a client is released */
+                LOG_WARN("IPv6 TCP server pauses accepting\n");
+                pContext->paused = 1;
+                comm_reactorModEvent(&(pContext->event), 0);
+                break;
+            }
             LOG_ERROR("fail to accept IPv6 TCP client\n");
             perror( "accept" );
+            comm_reactorDelEvent( &(pContext->event) );
+            pContext->running = 0;
             break;
         }
-        pthread_testcancel();
 
         inet_ntop(
             AF_INET6,
@@ -830,11 +1882,146 @@ static void *_tcpIpv6ServerListenTask(void *pArg)
             close( fd );
         }
     }
+}
 
-    LOG_2("stop the thread: %s\n", __func__);
-    pContext->running = 0;
+/**
+*  Initialize IPv6 TCP server.
+*  @param [in]  portNum     Local TCP port number.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv6 TCP server handle.
+*/
+static tTcpIpv6ServerHandle _tcpIpv6ServerOpen(
+    unsigned short    portNum,
+    int               maxUserNum,
+    tTcpServerAcptCb  pAcptFunc,
+    tTcpServerExitCb  pExitFunc,
+    tTcpServerRecvCb  pRecvFunc,
+    tTcpServerBufCb   pBufFunc,
+    void             *pArg
+)
+{
+    tTcpIpv6ServerContext *pContext = NULL;
+    pthread_attr_t tattr;
+    int error;
 
-    pthread_exit(NULL);
+
+    pContext = malloc( sizeof( tTcpIpv6ServerContext ) );
+    if (NULL == pContext)
+    {
+        LOG_ERROR("fail to allocate TCP IPv6 server context\n");
+        return 0;
+    }
+
+    memset(pContext, 0x00, sizeof( tTcpIpv6ServerContext ));
+    pContext->localAddr.sin6_family = AF_INET6;
+    pContext->localAddr.sin6_port   = htons( portNum );
+    pContext->localAddr.sin6_addr   = in6addr_any;
+    pContext->maxUserNum = maxUserNum;
+    pContext->pServerAcptFunc = pAcptFunc;
+    pContext->pServerExitFunc = pExitFunc;
+    pContext->pServerRecvFunc = pRecvFunc;
+    pContext->pServerBufFunc = pBufFunc;
+    pContext->pServerArg = pArg;
+    pContext->recvSize = COMM_BUF_SIZE;
+    pContext->fd = -1;
+
+    pContext->maxUserNum = comm_tableLimit( maxUserNum );
+    if (pContext->maxUserNum != maxUserNum)
+    {
+        LOG_1("set user number to the max. value %d\n", pContext->maxUserNum);
+    }
+
+    if (comm_tableInit(&(pContext->userTable), pContext->maxUserNum) != 0)
+    {
+        free( pContext );
+        return 0;
+    }
+
+    error = _tcpIpv6InitServer( pContext );
+    if (error != 0)
+    {
+        LOG_ERROR("failed to create IPv6 TCP socket\n");
+        comm_tableUninit( &(pContext->userTable) );
+        free( pContext );
+        return 0;
+    }
+
+    if (NULL == pAcptFunc)
+    {
+        LOG_1("ignore IPv6 TCP accept function\n");
+    }
+
+    if (NULL == pExitFunc)
+    {
+        LOG_1("ignore IPv6 TCP exit function\n");
+    }
+
+    if ((NULL == pRecvFunc) && (NULL == pBufFunc))
+    {
+        LOG_1("ignore IPv6 TCP receive function\n");
+    }
+
+    pContext->refNum = 1;
+    pContext->running = 1;
+
+    if ( g_reactor )
+    {
+        /* accept and serve the clients by the shared reactor threads */
+        pContext->reactor = g_reactor;
+
+        error = _tcpIpv6ListenServer( pContext );
+        if (error == 0)
+        {
+            fcntl(pContext->fd, F_SETFL, (fcntl(pContext->fd, F_GETFL) | O_NONBLOCK));
+            error = comm_reactorAddEvent(
+                        pContext->reactor,
+                        &(pContext->event),
+                        pContext->fd,
+                        EPOLLIN,
+                        _tcpIpv6ServerAcptEvent,
+                        pContext
+                    );
+        }
+        if (error != 0)
+        {
+            LOG_ERROR("failed to attach IPv6 TCP server to reactor\n");
+            _tcpIpv6UninitServer( pContext );
+            comm_tableUninit( &(pContext->userTable) );
+            free( pContext );
+            return 0;
+        }
+
+        LOG_1("IPv6 TCP server initialized\n");
+        return ((tTcpIpv6ServerHandle)pContext);
+    }
+
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+
+    error = pthread_create(
+                &(pContext->thread),
+                &tattr,
+                _tcpIpv6ServerListenTask,
+                pContext
+            );
+    if (error != 0)
+    {
+        LOG_ERROR("failed to create IPv6 TCP receiving thread\n");
+        _tcpIpv6UninitServer( pContext );
+        comm_tableUninit( &(pContext->userTable) );
+        free( pContext );
+        return 0;
+    }
+
+    pthread_attr_destroy( &tattr );
+
+    LOG_1("IPv6 TCP server initialized\n");
+    return ((tTcpIpv6ServerHandle)pContext);
 }
 
 /**
@@ -856,229 +2043,472 @@ tTcpIpv6ServerHandle comm_tcpIpv6ServerInit(
     void             *pArg
 )
 {
-    tTcpIpv6ServerContext *pContext = NULL;
-    pthread_attr_t tattr;
-    int error;
-
-
-    pContext = malloc( sizeof( tTcpIpv6ServerContext ) );
-    if (NULL == pContext)
+    return _tcpIpv6ServerOpen(
+               portNum,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               pRecvFunc,
+               NULL,
+               pArg
+           );
+}
+
+/**
+*  Initialize IPv6 TCP server with zero-copy buffers.
+*  @param [in]  portNum     Local TCP port number.
+*  @param [in]  maxUserNum  Max. user number.
+*  @param [in]  pAcptFunc   Application's accept callback function.
+*  @param [in]  pExitFunc   Application's exit callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv6 TCP server handle.
+*/
+tTcpIpv6ServerHandle comm_tcpIpv6ServerInitBuf(
+    unsigned short    portNum,
+    int               maxUserNum,
+    tTcpServerAcptCb  pAcptFunc,
+    tTcpServerExitCb  pExitFunc,
+    tTcpServerBufCb   pBufFunc,
+    void             *pArg
+)
+{
+    return _tcpIpv6ServerOpen(
+               portNum,
+               maxUserNum,
+               pAcptFunc,
+               pExitFunc,
+               NULL,
+               pBufFunc,
+               pArg
+           );
+}
+
+/**
+*  Drop a reference of an IPv6 TCP server, the last one frees it.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*/
+static void _tcpIpv6ServerPut(tTcpIpv6ServerContext *pContext)
+{
+    if (__sync_sub_and_fetch(&(pContext->refNum), 1) == 0)
+    {
+        comm_tableUninit( &(pContext->userTable) );
+        free( pContext );
+        LOG_1("IPv6 TCP server un-initialized\n");
+    }
+}
+
+/**
+*  Release an IPv6 TCP server when it no more accepts, the clients
+*  served by other reactor threads are released by them.
+*  @param [in]  pArg  A @ref tTcpIpv6ServerContext object.
+*/
+static void _tcpIpv6ServerRelease(void *pArg)
+{
+    tTcpIpv6ServerContext *pContext = pArg;
+    tTcpUser *pUser;
+    int i;
+
+    for (i=0; i<comm_tableSize( &(pContext->userTable) ); i++)
+    {
+        pUser = comm_tableDelAt(&(pContext->userTable), i);
+        if ( pUser )
+        {
+            _tcpIpv6FreeClient(pContext, pUser, 0);
+        }
+    }
+    _tcpIpv6UninitServer( pContext );
+    _tcpIpv6ServerPut( pContext );
+}
+
+/**
+*  Un-initialize IPv6 TCP server.
+*  @param [in]  handle  IPv6 TCP server handle.
+*/
+void comm_tcpIpv6ServerUninit(tTcpIpv6ServerHandle handle)
+{
+    tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
+
+    if ( pContext )
+    {
+        pContext->running = 0;
+
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _tcpIpv6ServerRelease, pContext);
+        }
+        else
+        {
+            pthread_cancel( pContext->thread );
+            pthread_join(pContext->thread, NULL);
+            _tcpIpv6ServerRelease( pContext );
+        }
+    }
+}
+
+/**
+*  Create the connection to an IPv6 TCP client.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @param [in]  pAddr     IPv6 address string.
+*  @param [in]  fd        Socket file descriptor.
+*  @returns  A @ref tTcpUser object.
+*/
+static tTcpUser *_tcpIpv6AcceptClient(
+    tTcpIpv6ServerContext *pContext,
+    struct sockaddr_in6   *pAddr,
+    int                    fd
+)
+{
+    tTcpUserEntry *pEntry;
+    tTcpUser *pUser;
+    pthread_attr_t tattr;
+    int noDelay = 1;
+    socklen_t noDelayLen;
+    int error;
+
+
+    pEntry = malloc( sizeof( tTcpUserEntry ) );
+    if (NULL == pEntry)
+    {
+        LOG_ERROR("user memory was exhausted\n");
+        return NULL;
+    }
+
+    memset(pEntry, 0x00, sizeof( tTcpUserEntry ));
+    pEntry->frame = pContext->frame;
+    pthread_mutex_init(&(pEntry->sendMutex), NULL);
+    pEntry->refNum = 1;
+    if ( pContext->reactor )
+    {
+        /* the send queue is written by the reactor on EPOLLOUT */
+        pEntry->queue = pContext->queue;
+        pEntry->queue.pEvent = &(pEntry->event);
+        pEntry->queue.pWaterArg = &(pEntry->user);
+    }
+    pUser = &(pEntry->user);
+    pUser->pServer = pContext;
+    pUser->addrIpv6 = (*pAddr);
+    pUser->fd = fd;
+
+    pEntry->id = comm_tableAdd(&(pContext->userTable), pUser);
+    if (0 == pEntry->id)
+    {
+        LOG_ERROR("user number was exceeded (%d)\n", pContext->maxUserNum);
+        comm_queueUninit( &(pEntry->queue) );
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
+        return NULL;
+    }
+    __sync_fetch_and_add(&(pContext->refNum), 1);
+
+    LOG_3("IPv6 TCP create client fd(%d)\n", fd);
+
+    noDelayLen = sizeof( noDelay );
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, noDelayLen);
+
+    /* notify the client object to the server application */
+    if ( pContext->pServerAcptFunc )
+    {
+        pContext->pServerAcptFunc(pContext->pServerArg, pUser);
+    }
+
+    if ( pContext->reactor )
+    {
+        error = comm_reactorAddEvent(
+                    pContext->reactor,
+                    &(pEntry->event),
+                    fd,
+                    EPOLLIN,
+                    _tcpIpv6ServerRecvEvent,
+                    pUser
+                );
+        if (0 == error)
+        {
+            /* the data queued by the accept callback waits for EPOLLOUT */
+            pthread_mutex_lock( &(pEntry->sendMutex) );
+            comm_queueAttach( &(pEntry->queue) );
+            pthread_mutex_unlock( &(pEntry->sendMutex) );
+        }
+    }
+    else
+    {
+        pthread_attr_init( &tattr );
+        pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
+
+        error = pthread_create(
+                    &(pUser->thread),
+                    &tattr,
+                    _tcpIpv6ServerRecvTask,
+                    pUser
+                );
+
+        pthread_attr_destroy( &tattr );
+    }
+
+    if (error != 0)
+    {
+        LOG_ERROR("failed to serve the client connection\n");
+        comm_tableDel(&(pContext->userTable), pEntry->id);
+        /* the socket is closed by the caller */
+        pUser->fd = -1;
+        if ( pContext->pServerExitFunc )
+        {
+            pContext->pServerExitFunc(pContext->pServerArg, pUser);
+        }
+        comm_queueUninit( &(pEntry->queue) );
+        pthread_mutex_destroy( &(pEntry->sendMutex) );
+        free( pEntry );
+        __sync_fetch_and_sub(&(pContext->refNum), 1);
+        return NULL;
+    }
+
+    return pUser;
+}
+
+/**
+*  Remove the connection of an IPv6 TCP client closed by the peer.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*/
+static void _tcpIpv6DisconnectClient(
+    tTcpIpv6ServerContext *pContext,
+    tTcpUser              *pUser
+)
+{
+    /* whoever removes the client from the table releases it */
+    if (comm_tableDel(&(pContext->userTable), TCP_USER_ID(pUser)) == pUser)
     {
-        LOG_ERROR("fail to allocate TCP IPv6 server context\n");
-        return 0;
+        _tcpIpv6FreeClient(pContext, pUser, 1);
     }
+}
 
-    memset(pContext, 0x00, sizeof( tTcpIpv6ServerContext ));
-    pContext->localAddr.sin6_family = AF_INET6;
-    pContext->localAddr.sin6_port   = htons( portNum );
-    pContext->localAddr.sin6_addr   = in6addr_any;
-    pContext->maxUserNum = maxUserNum;
-    pContext->pServerAcptFunc = pAcptFunc;
-    pContext->pServerExitFunc = pExitFunc;
-    pContext->pServerRecvFunc = pRecvFunc;
-    pContext->pServerArg = pArg;
-    pContext->fd = -1;
+/**
+*  Drop a reference of an IPv6 TCP client, the last one closes the
+*  socket, frees the client and drops its server reference.
+*  @param [in]  pArg  A @ref tTcpUser object.
+*/
+static void _tcpIpv6PutClient(void *pArg)
+{
+    tTcpUser *pUser = pArg;
+    tTcpIpv6ServerContext *pContext = pUser->pServer;
 
-    if ((0 == pContext->maxUserNum) || (pContext->maxUserNum > TCP_USER_NUM))
+    if (__sync_sub_and_fetch(&(TCP_USER_REF(pUser)), 1) != 0)
     {
-        LOG_1("set user number to the max. value %d\n", TCP_USER_NUM);
-        pContext->maxUserNum = TCP_USER_NUM;
+        return;
     }
 
-    error = _tcpIpv6InitServer( pContext );
-    if (error != 0)
+    if (pUser->fd > 0)
     {
-        LOG_ERROR("failed to create IPv6 TCP socket\n");
-        free( pContext );
-        return 0;
+        close( pUser->fd );
+        pUser->fd = -1;
     }
 
-    if (NULL == pAcptFunc)
+    comm_frameReset( TCP_USER_FRAME(pUser) );
+    comm_queueUninit( TCP_USER_QUEUE(pUser) );
+    pthread_mutex_destroy( TCP_USER_MUTEX(pUser) );
+    free( pUser );
+
+    if (( pContext->running ) && __sync_bool_compare_and_swap(&(pContext->paused), 1, 0))
     {
-        LOG_1("ignore IPv6 TCP accept function\n");
+        LOG_1("IPv6 TCP server resumes accepting\n");
+        comm_reactorModEvent(&(pContext->event), EPOLLIN);
     }
 
-    if (NULL == pExitFunc)
+    _tcpIpv6ServerPut( pContext );
+}
+
+/**
+*  Release an IPv6 TCP client removed from the user table.
+*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
+*  @param [in]  pUser     A @ref tTcpUser object.
+*  @param [in]  closed    Closed by the peer in the receiving context.
+*/
+static void _tcpIpv6FreeClient(
+    tTcpIpv6ServerContext *pContext,
+    tTcpUser              *pUser,
+    int                    closed
+)
+{
+    LOG_3("IPv6 TCP remove client fd(%d)\n", pUser->fd);
+
+    if (( pContext->reactor ) && ( !closed ))
     {
-        LOG_1("ignore IPv6 TCP exit function\n");
+        /* the client may be on another reactor thread, which releases it */
+        comm_reactorDelEventFree(TCP_USER_EVENT(pUser), _tcpIpv6PutClient, pUser);
+        return;
     }
 
-    if (NULL == pRecvFunc)
+    if ( pContext->reactor )
     {
-        LOG_1("ignore IPv6 TCP receive function\n");
+        comm_reactorDelEvent( TCP_USER_EVENT(pUser) );
     }
-
-    pContext->running = 1;
-
-    pthread_attr_init( &tattr );
-    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
-
-    error = pthread_create(
-                &(pContext->thread),
-                &tattr,
-                _tcpIpv6ServerListenTask,
-                pContext
-            );
-    if (error != 0)
+    else if ( !closed )
     {
-        LOG_ERROR("failed to create IPv6 TCP receiving thread\n");
-        _tcpIpv6UninitServer( pContext );
-        free( pContext );
-        return 0;
+        pthread_cancel( pUser->thread );
     }
 
-    pthread_attr_destroy( &tattr );
+    /* notify the client object to the server application */
+    if (( closed ) && ( pContext->pServerExitFunc ))
+    {
+        pContext->pServerExitFunc(pContext->pServerArg, pUser);
+    }
 
-    LOG_1("IPv6 TCP server initialized\n");
-    return ((tTcpIpv6ServerHandle)pContext);
+    /* the socket is closed after the senders to all */
+    _tcpIpv6PutClient( pUser );
 }
 
 /**
-*  Un-initialize IPv6 TCP server.
+*  Set the message framing of the clients accepted afterwards.
 *  @param [in]  handle  IPv6 TCP server handle.
+*  @param [in]  pFrame  A @ref tCommFrame object (NULL is no framing).
+*  @returns  Success(0) or failure(-1).
 */
-void comm_tcpIpv6ServerUninit(tTcpIpv6ServerHandle handle)
+int comm_tcpIpv6ServerSetFrame(tTcpIpv6ServerHandle handle, tCommFrame *pFrame)
 {
     tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
-    int i;
+    tCommFrame cfg;
+    tFrame frame;
 
-    if ( pContext )
+    if (NULL == pContext)
     {
-        pthread_cancel( pContext->thread );
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        pContext->running = 0;
-        pContext->userNum = 0;
-        for (i=0; i<pContext->maxUserNum; i++)
+    if ( pFrame )
+    {
+        cfg = *pFrame;
+        if (( pContext->pServerRecvFunc ) && (0 == cfg.maxSize))
         {
-            _tcpIpv6DisconnectClient(pContext, pContext->pUser[i]);
+            /* the receive callback can not take more than 64 KB */
+            cfg.maxSize = USHRT_MAX;
         }
-        _tcpIpv6UninitServer( pContext );
+        pFrame = &cfg;
+    }
 
-        pthread_join(pContext->thread, NULL);
-        free( pContext );
-        LOG_1("IPv6 TCP server un-initialized\n");
+    if (comm_frameInit(&frame, pFrame) != 0)
+    {
+        return -1;
+    }
+
+    if (( pFrame ) && ( pContext->pServerRecvFunc ) && (frame.cfg.maxSize > USHRT_MAX))
+    {
+        LOG_WARN("%s: max. size %zu needs the buffer callback\n", __func__, frame.cfg.maxSize);
+        return -1;
     }
+
+    pContext->frame = frame;
+    return 0;
 }
 
 /**
-*  Create the connection to an IPv6 TCP client.
-*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
-*  @param [in]  pAddr     IPv6 address string.
-*  @param [in]  fd        Socket file descriptor.
-*  @returns  A @ref tTcpUser object.
+*  Set the send queue of the clients accepted afterwards. With the reactor
+*  (@ref comm_setReactor) a send never blocks: what the socket does not
+*  take is queued and written on EPOLLOUT, a send over the queue size
+*  fails. Without the reactor the sends stay blocking. The watermark
+*  callback is called after the send has released its locks, it may call
+*  the server functions again, including the send to all clients.
+*  @param [in]  handle      IPv6 TCP server handle.
+*  @param [in]  pQueue      A @ref tCommQueue object (NULL is blocking send).
+*  @param [in]  pWaterFunc  Application's watermark callback function.
+*  @returns  Success(0) or failure(-1).
 */
-static tTcpUser *_tcpIpv6AcceptClient(
-    tTcpIpv6ServerContext *pContext,
-    struct sockaddr_in6   *pAddr,
-    int                    fd
+int comm_tcpIpv6ServerSetSendQueue(
+    tTcpIpv6ServerHandle  handle,
+    tCommQueue           *pQueue,
+    tTcpServerWaterCb     pWaterFunc
 )
 {
-    tTcpUser *pUser = NULL;
-    pthread_attr_t tattr;
-    int  noDelay = 1;
-    socklen_t noDelayLen;
-    int  error;
-    int  i;
+    tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
+    tSendQueue queue;
 
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-    if (pContext->userNum >= pContext->maxUserNum)
+    if (comm_queueInit(&queue, pQueue, NULL, _tcpIpv6ServerWaterFunc, NULL) != 0)
     {
-        LOG_ERROR("user number was exceeded (%d)\n", pContext->maxUserNum);
-        return NULL;
+        return -1;
     }
 
-    for (i=0; i<pContext->maxUserNum; i++)
+    if (( pQueue ) && (0 == g_reactor) && (0 == pContext->reactor))
     {
-        if (NULL == pContext->pUser[i])
-        {
-            pUser = malloc( sizeof( tTcpUser ) );
+        LOG_WARN("%s: send queue needs the reactor\n", __func__);
+    }
 
-            if ( pUser )
-            {
-                LOG_3("IPv6 TCP create client fd(%d)\n", fd);
-
-                noDelayLen = sizeof( noDelay );
-                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, noDelayLen);
-
-                memset(pUser, 0x00, sizeof( tTcpUser ));
-                pUser->pServer = pContext;
-                pUser->addrIpv6 = (*pAddr);
-                pUser->fd = fd;
-
-                pthread_attr_init( &tattr );
-                pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_DETACHED);
-
-                error = pthread_create(
-                            &(pUser->thread),
-                            &tattr,
-                            _tcpIpv6ServerRecvTask,
-                            pUser
-                        );
-                if (error != 0)
-                {
-                    LOG_ERROR("failed to create the client connection thread\n");
-                    free( pUser );
-                    return NULL;
-                }
-
-                pthread_attr_destroy( &tattr );
-
-                /* notify the client object to the server application */
-                if ( pContext->pServerAcptFunc )
-                {
-                    pContext->pServerAcptFunc(pContext->pServerArg, pUser);
-                }
-
-                pContext->pUser[i] = pUser;
-                pContext->userNum++;
-            }
+    pContext->queue = queue;
+    pContext->pServerWaterFunc = pWaterFunc;
+    return 0;
+}
 
-            return pUser;
-        }
+/**
+*  Set the receive size of the IPv6 TCP server clients.
+*  @param [in]  handle  IPv6 TCP server handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_tcpIpv6ServerSetRecvSize(tTcpIpv6ServerHandle handle, size_t size)
+{
+    tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pServerRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
     }
 
-    LOG_ERROR("user memory was exhausted\n");
-    return NULL;
+    pContext->recvSize = size;
+    return 0;
 }
 
 /**
-*  Remove the connection of an IPv6 TCP client.
-*  @param [in]  pContext  A @ref tTcpIpv6ServerContext object.
-*  @param [in]  pUser     A @ref tTcpUser object.
+*  Tap the IPv6 TCP server, so that the messages it sends to and receives
+*  from the clients are copied to a pcapng capture. The connection ID of a
+*  client is its slot in the user table, reused by the later clients.
+*  @param [in]  handle  IPv6 TCP server handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
 */
-static void _tcpIpv6DisconnectClient(
-    tTcpIpv6ServerContext *pContext,
-    tTcpUser              *pUser
-)
+int comm_tcpIpv6ServerSetTap(tTcpIpv6ServerHandle handle, tPcapHandle pcap)
 {
-    int i;
+    tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
 
-    if ( pUser )
-    {
-        LOG_3("IPv6 TCP remove client fd(%d)\n", pUser->fd);
 
-        for (i=0; i<pContext->maxUserNum; i++)
-        {
-            if (pContext->pUser[i] == pUser)
-            {
-                pContext->pUser[i] = NULL;
-                if (pContext->userNum > 0)
-                {
-                    pContext->userNum--;
-                }
-                break;
-            }
-        }
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        if (pUser->fd > 0)
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "tcp6-server:%d", ntohs( pContext->localAddr.sin6_port ));
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_USER0, name, pContext);
+        if (NULL == pIf)
         {
-            pthread_cancel( pUser->thread );
-            close( pUser->fd );
-            pUser->fd = -1;
+            return -1;
         }
-
-        free( pUser );
     }
+
+    comm_pcapSetTap(&(pContext->tap), pIf);
+    return 0;
 }
 
 /**
@@ -1093,9 +2523,27 @@ int comm_tcpIpv6ServerSend(
     unsigned char  *pData,
     unsigned short  size
 )
+{
+    return comm_tcpIpv6ServerSendEx(pUser, pData, size);
+}
+
+/**
+*  Send message to an IPv6 TCP client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv6ServerSendEx(
+    tTcpUser       *pUser,
+    unsigned char  *pData,
+    size_t          size
+)
 {
     char ipv6Str[INET6_ADDRSTRLEN];
-    int error;
+    struct iovec iov;
+    tTcpIpv6ServerContext *pContext;
+    ssize_t error;
 
 
     if (NULL == pUser)
@@ -1131,16 +2579,84 @@ int comm_tcpIpv6ServerSend(
     LOG_3("-> %s\n", ipv6Str);
     LOG_DUMP("IPv6 TCP server send", pData, size);
 
-    error = send(
-                pUser->fd,
-                pData,
-                size,
-                0
-            );
-    if (error < 0)
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    pContext = pUser->pServer;
+    error = _tcpServerSendv(pUser, &iov, 1, &(pContext->tap));
+    /* a full send queue was reported by the queue */
+    if ((error < 0) && (ENOBUFS != errno))
+    {
+        LOG_ERROR("fail to send IPv6 TCP client\n");
+        perror( "sendmsg" );
+    }
+
+    return error;
+}
+
+/**
+*  Send one message of several buffers to an IPv6 TCP client, the message
+*  is not interleaved with the other senders of the client.
+*  @param [in]  pUser  A @ref tTcpUser object.
+*  @param [in]  pIov   Data buffers.
+*  @param [in]  num    Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_tcpIpv6ServerSendv(
+    tTcpUser      *pUser,
+    struct iovec  *pIov,
+    int            num
+)
+{
+    char ipv6Str[INET6_ADDRSTRLEN];
+    tTcpIpv6ServerContext *pContext;
+    ssize_t error;
+    int i;
+
+
+    if (NULL == pUser)
+    {
+        LOG_ERROR("%s: pUser is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pUser->fd < 0)
+    {
+        LOG_ERROR("%s: client socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    inet_ntop(
+        AF_INET6,
+        &(pUser->addrIpv6.sin6_addr),
+        ipv6Str,
+        INET6_ADDRSTRLEN
+    );
+    LOG_3("-> %s\n", ipv6Str);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv6 TCP server send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    pContext = pUser->pServer;
+    error = _tcpServerSendv(pUser, pIov, num, &(pContext->tap));
+    /* a full send queue was reported by the queue */
+    if ((error < 0) && (ENOBUFS != errno))
     {
         LOG_ERROR("fail to send IPv6 TCP client\n");
-        perror( "send" );
+        perror( "sendmsg" );
     }
 
     return error;
@@ -1157,14 +2673,28 @@ void comm_tcpIpv6ServerSendAllClient(
     unsigned char        *pData,
     unsigned short        size
 )
+{
+    comm_tcpIpv6ServerSendAllClientEx(handle, pData, size);
+}
+
+/**
+*  Send message to all IPv6 TCP clients.
+*  @param [in]  handle  IPv6 TCP server handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data size.
+*/
+void comm_tcpIpv6ServerSendAllClientEx(
+    tTcpIpv6ServerHandle  handle,
+    unsigned char        *pData,
+    size_t                size
+)
 {
     tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
-    tTcpUser *pUser;
-    int error;
+    tTcpSendAll sendAll;
     int i;
 
 
-    if (0 == pContext->userNum)
+    if (0 == comm_tableNum( &(pContext->userTable) ))
     {
         LOG_WARN("%s: user number is 0\n", __func__);
         return;
@@ -1184,25 +2714,26 @@ void comm_tcpIpv6ServerSendAllClient(
 
     LOG_DUMP("IPv6 TCP send to all clients", pData, size);
 
-    for (i=0; i<pContext->maxUserNum; i++)
+    sendAll.pData   = pData;
+    sendAll.size    = size;
+    sendAll.pTap    = &(pContext->tap);
+    sendAll.userNum = 0;
+    sendAll.maxNum  = comm_tableSize( &(pContext->userTable) );
+    sendAll.ppUser  = malloc( sizeof( tTcpUser * ) * sendAll.maxNum );
+    if (NULL == sendAll.ppUser)
     {
-        pUser = pContext->pUser[i];
+        LOG_ERROR("fail to allocate IPv6 TCP client list\n");
+        return;
+    }
 
-        if (( pUser ) && (pUser->fd > 0))
-        {
-            error = send(
-                        pUser->fd,
-                        pData,
-                        size,
-                        0
-                    );
-            if (error < 0)
-            {
-                LOG_ERROR("fail to send IPv6 TCP to fd(%d)\n", pUser->fd);
-                perror( "send" );
-            }
-        }
+    /* a blocking send must not hold up the accepting and disconnecting */
+    comm_tableForEach(&(pContext->userTable), _tcpServerHoldFunc, &sendAll);
+    for (i=0; i<sendAll.userNum; i++)
+    {
+        _tcpServerSendAllFunc(&sendAll, sendAll.ppUser[i]);
+        _tcpIpv6PutClient( sendAll.ppUser[i] );
     }
+    free( sendAll.ppUser );
 }
 
 /**
@@ -1213,6 +2744,6 @@ void comm_tcpIpv6ServerSendAllClient(
 int comm_tcpIpv6ServerGetClientNum(tTcpIpv6ServerHandle handle)
 {
     tTcpIpv6ServerContext *pContext = (tTcpIpv6ServerContext *)handle;
-    return pContext->userNum;
+    return comm_tableNum( &(pContext->userTable) );
 }
 
@@ -1,15 +1,28 @@
+#define _GNU_SOURCE  /* ppoll() */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
+#include <poll.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <termios.h> /*termio.h for serial IO api*/ 
+#include <sys/timerfd.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_decoder.h"
 
 
+typedef struct _tUartGroupContext
+{
+    tReactorHandle  reactor;
+    int             portNum;
+} tUartGroupContext;
+
 typedef struct _tUartContext
 {
     char           devName[32];
@@ -22,78 +35,333 @@ typedef struct _tUartContext
     void          *pArg;
     pthread_t      thread;
     int            running;
+    tReactorHandle reactor;
+    tReactorEvent  event;
+
+    /* bytes received since the line became busy */
+    unsigned char *pRecvBuf;
+    int            recvLen;
+    unsigned int   idleTime;
+    long long      lastTime;
+    pthread_mutex_t recvMutex;
+    int            timerFd;
+    tReactorEvent  timerEvent;
 
-    unsigned char  recvMsg[COMM_BUF_SIZE+1];
+    /* frame decoder, or idle-gap framing of the collected bytes */
+    tDecoder       decoder;
+    int            frameIdle;
+    unsigned int   frameIdleTime;
+    size_t         frameMax;
+    int            discard;
+
+    tUartGroupContext *pGroup;
+    tUartStat      stat;
 } tUartContext;
 
 
 /**
-*  Thread function for the UART receiving.
+*  Get the monotonic time in microseconds.
+*  @returns  Microseconds.
+*/
+static long long _uartNow(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (((long long)now.tv_sec * 1000000) + (now.tv_nsec / 1000));
+}
+
+/**
+*  Pass the received data to the UART receive callback.
+*  @param [in]  pContext  A @ref tUartContext object.
+*  @param [in]  pBuf      A pointer of data buffer.
+*  @param [in]  len       Data length.
+*/
+static void _uartRecvMsg(tUartContext *pContext, unsigned char *pBuf, int len)
+{
+    pBuf[len] = 0x00;
+
+    __sync_fetch_and_add(&(pContext->stat.rxCount), 1);
+    __sync_fetch_and_add(&(pContext->stat.rxBytes), len);
+
+    LOG_3("<- %s\n", pContext->devName);
+    LOG_DUMP("UART read", pBuf, len);
+
+    if ( pContext->pRecvFunc )
+    {
+        pContext->pRecvFunc(
+            pContext->pArg,
+            pBuf,
+            len
+        );
+    }
+}
+
+/**
+*  Pass the collected bytes to the UART receive callback.
+*  @param [in]  pContext  A @ref tUartContext object.
+*/
+static void _uartFlush(tUartContext *pContext)
+{
+    if ( pContext->discard )
+    {
+        /* the over-sized frame ends */
+        pContext->discard = 0;
+        pContext->recvLen = 0;
+        return;
+    }
+
+    if (pContext->recvLen > 0)
+    {
+        _uartRecvMsg(pContext, pContext->pRecvBuf, pContext->recvLen);
+        pContext->recvLen = 0;
+    }
+}
+
+/**
+*  Pass a decoded frame to the UART receive callback.
+*  @param [in]  pArg   A @ref tUartContext object.
+*  @param [in]  pData  Frame bytes.
+*  @param [in]  len    Frame length.
+*/
+static void _uartFrameFunc(void *pArg, unsigned char *pData, int len)
+{
+    _uartRecvMsg((tUartContext *)pArg, pData, len);
+}
+
+/**
+*  Get the idle-gap time of the framing, 3.5 characters of 11 bits at the
+*  baud rate, and a fixed 1750 us over 19200 bps as Modbus RTU does.
+*  @param [in]  pContext  A @ref tUartContext object.
+*  @returns  Micro-seconds.
+*/
+static unsigned int _uartFrameIdleTime(tUartContext *pContext)
+{
+    if (pContext->frameIdleTime > 0)
+    {
+        return pContext->frameIdleTime;
+    }
+
+    if ((pContext->baudRate <= 0) || (pContext->baudRate > 19200))
+    {
+        return 1750;
+    }
+
+    return ((35 * 11 * 100000) / pContext->baudRate);
+}
+
+/**
+*  Get the time until the line is idle for the idle time.
+*  @param [in]  pContext  A @ref tUartContext object.
+*  @returns  Microseconds (-1 is nothing to wait for, 0 is idle already).
+*/
+static long long _uartIdleWait(tUartContext *pContext)
+{
+    unsigned int idleTime = __atomic_load_n(&(pContext->idleTime), __ATOMIC_RELAXED);
+    long long wait;
+
+    if (((0 == pContext->recvLen) && (!pContext->discard)) || (0 == idleTime))
+    {
+        return -1;
+    }
+
+    wait = (pContext->lastTime + idleTime) - _uartNow();
+    return ((wait > 0) ? wait : 0);
+}
+
+/**
+*  Read the available bytes of a readable device. They are passed to the
+*  frame decoder, or to the receive callback at once, or collected until
+*  the line is idle if the idle time is set.
+*  @param [in]  pContext  A @ref tUartContext object.
+*  @returns  Success(0) or the device is lost(-1).
+*/
+static int _uartRead(tUartContext *pContext)
+{
+    int drops;
+    int len;
+
+    if (COMM_BUF_SIZE == pContext->recvLen)
+    {
+        /* an idle-gap frame of the full buffer goes on, it is over-sized */
+        LOG_2("%s: frame is over %d bytes\n", __func__, COMM_BUF_SIZE);
+        __sync_fetch_and_add(&(pContext->stat.errorNum), 1);
+        pContext->discard = 1;
+        pContext->recvLen = 0;
+    }
+
+    LOG_3("UART ... read\n");
+    len = read(
+              pContext->fd,
+              (pContext->pRecvBuf + pContext->recvLen),
+              (COMM_BUF_SIZE - pContext->recvLen)
+          );
+    if (len < 0)
+    {
+        if ((EAGAIN == errno) || (EINTR == errno))
+        {
+            return 0;
+        }
+        /* EIO is a hang-up of the other side */
+        LOG_ERROR("%s: read error(%s)\n", __func__, strerror(errno));
+        __sync_fetch_and_add(&(pContext->stat.errorNum), 1);
+        return -1;
+    }
+
+    if (0 == len)
+    {
+        /* nothing to read on readiness is a hang-up, the device stays readable */
+        LOG_WARN("%s: device is lost\n", __func__);
+        return -1;
+    }
+
+    if (len > 0)
+    {
+        pContext->lastTime = _uartNow();
+
+        if ( comm_decoderEnabled( &(pContext->decoder) ) )
+        {
+            drops = comm_decoderPut(
+                        &(pContext->decoder),
+                        pContext->pRecvBuf,
+                        len,
+                        _uartFrameFunc,
+                        pContext
+                    );
+            if (drops > 0)
+            {
+                __sync_fetch_and_add(&(pContext->stat.errorNum), drops);
+            }
+            return 0;
+        }
+
+        pContext->recvLen += len;
+
+        if ( pContext->frameIdle )
+        {
+            /* the frame ends when the line is idle */
+            if ((size_t)pContext->recvLen > pContext->frameMax)
+            {
+                LOG_2("%s: frame is over %zu bytes\n", __func__, pContext->frameMax);
+                __sync_fetch_and_add(&(pContext->stat.errorNum), 1);
+                pContext->discard = 1;
+                pContext->recvLen = 0;
+            }
+            return 0;
+        }
+
+        if ((0 == __atomic_load_n(&(pContext->idleTime), __ATOMIC_RELAXED)) ||
+            (COMM_BUF_SIZE == pContext->recvLen))
+        {
+            _uartFlush( pContext );
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Cleanup function of the receiving thread, it unlocks the receive mutex.
+*  @param [in]  pArg  A pthread_mutex_t object.
+*/
+static void _uartUnlock(void *pArg)
+{
+    pthread_mutex_unlock( (pthread_mutex_t *)pArg );
+}
+
+/**
+*  Read the device, or pass the collected bytes of an idle line, with the
+*  receive mutex held by the receiving thread.
+*  @param [in]  pContext  A @ref tUartContext object.
+*  @param [in]  idle      Pass the collected bytes(1) or read(0).
+*  @returns  Success(0) or the device is lost(-1).
+*/
+static int _uartRecvLocked(tUartContext *pContext, int idle)
+{
+    int error = 0;
+
+    pthread_cleanup_push(_uartUnlock, &(pContext->recvMutex));
+    pthread_mutex_lock( &(pContext->recvMutex) );
+    if ( idle )
+    {
+        _uartFlush( pContext );
+    }
+    else
+    {
+        error = _uartRead( pContext );
+    }
+    pthread_cleanup_pop( 1 );
+
+    return error;
+}
+
+/**
+*  Thread function for the UART receiving. It sleeps in ppoll() until a
+*  byte arrives or the line becomes idle, thus an idle port costs nothing.
 *  @param [in]  pArg  A @ref tUartContext object.
 */
 static void *_uartRecvTask(void *pArg)
 {
     tUartContext *pContext = pArg;
-    int len;
+    struct pollfd pfd;
+    struct timespec timeout;
+    long long wait;
+    int num;
 
 
     pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
     LOG_2("start the thread: %s\n", __func__);
 
+    pfd.fd     = pContext->fd;
+    pfd.events = POLLIN;
+
     while ( pContext->running )
     {
-        LOG_3("UART ... read\n");
-        pthread_testcancel();
-        len = read(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE
-              );
-        if (len < 0)
+        wait = _uartIdleWait( pContext );
+        if (0 == wait)
         {
-            switch ( errno )
-            {
-                case EAGAIN:
-                    LOG_ERROR("%s: read EAGAIN\n", __func__);
-                    pthread_testcancel();
-                    usleep(5 * 1000);
-                    pthread_testcancel();
-                    continue;
-                    break;
-             
-                default:
-                    LOG_ERROR("%s: read error(%s)\n", __func__, strerror(errno));
-                    pContext->running = 0;
-                    break;  
-            }
+            _uartRecvLocked(pContext, 1);
+            continue;
         }
-        else if (0 == len)
+
+        timeout.tv_sec  = (wait / 1000000);
+        timeout.tv_nsec = ((wait % 1000000) * 1000);
+
+        pthread_testcancel();
+        num = ppoll(&pfd, 1, ((wait > 0) ? &timeout : NULL), NULL);
+        if (num < 0)
         {
-            if (pContext->waitTime < 0)
+            if (EINTR == errno)
             {
-                LOG_WARN("%s: device is lost\n", __func__);
-                pContext->running = 0;
+                continue;
             }
+            LOG_ERROR("%s: poll error(%s)\n", __func__, strerror(errno));
+            break;
         }
-        else
-        {
-            pContext->recvMsg[len] = 0x00;
 
-            LOG_3("<- %s\n", pContext->devName);
-            LOG_DUMP("UART read", pContext->recvMsg, len);
+        if (0 == num)
+        {
+            /* the line is idle */
+            continue;
+        }
 
-            if ( pContext->pRecvFunc )
+        if (pfd.revents & POLLIN)
+        {
+            if (_uartRecvLocked(pContext, 0) != 0)
             {
-                pContext->pRecvFunc(
-                    pContext->pArg,
-                    pContext->recvMsg,
-                    len
-                );
+                break;
             }
         }
+        else if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))
+        {
+            LOG_WARN("%s: device is lost\n", __func__);
+            break;
+        }
         pthread_testcancel();
     }
 
+    _uartRecvLocked(pContext, 1);
+
     LOG_2("stop the thread: %s\n", __func__);
     pContext->running = 0;
 
@@ -101,13 +369,110 @@ static void *_uartRecvTask(void *pArg)
 }
 
 /**
-*  UART open device.
+*  Arm the idle timer of the reactor for the collected bytes.
+*  @param [in]  pContext  A @ref tUartContext object.
+*/
+static void _uartArmTimer(tUartContext *pContext)
+{
+    struct itimerspec timer;
+    long long wait = _uartIdleWait( pContext );
+
+    if (wait < 0)
+    {
+        return;
+    }
+
+    /* 0 disarms the timer, so an idle line fires at once */
+    if (0 == wait)
+    {
+        wait = 1;
+    }
+
+    memset(&timer, 0x00, sizeof( struct itimerspec ));
+    timer.it_value.tv_sec  = (wait / 1000000);
+    timer.it_value.tv_nsec = ((wait % 1000000) * 1000);
+    timerfd_settime(pContext->timerFd, 0, &timer, NULL);
+}
+
+/**
+*  Reactor event function for the UART receiving.
+*  @param [in]  pArg    A @ref tUartContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _uartRecvEvent(void *pArg, unsigned int events)
+{
+    tUartContext *pContext = pArg;
+    int lost = 0;
+
+
+    pthread_mutex_lock( &(pContext->recvMutex) );
+
+    if (events & EPOLLIN)
+    {
+        lost = (_uartRead( pContext ) != 0);
+    }
+    else if (events & (EPOLLHUP | EPOLLERR))
+    {
+        LOG_WARN("%s: device is lost\n", __func__);
+        lost = 1;
+    }
+
+    if ( lost )
+    {
+        comm_reactorDelEvent( &(pContext->event) );
+        _uartFlush( pContext );
+        pContext->running = 0;
+    }
+    else
+    {
+        _uartArmTimer( pContext );
+    }
+
+    pthread_mutex_unlock( &(pContext->recvMutex) );
+}
+
+/**
+*  Reactor event function for the UART idle timer.
+*  @param [in]  pArg    A @ref tUartContext object.
+*  @param [in]  events  Reactor events.
+*/
+static void _uartTimerEvent(void *pArg, unsigned int events)
+{
+    tUartContext *pContext = pArg;
+    unsigned long long expired;
+
+    if (read(pContext->timerFd, &expired, sizeof( expired )) <= 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &(pContext->recvMutex) );
+    if (0 == _uartIdleWait( pContext ))
+    {
+        _uartFlush( pContext );
+    }
+    else
+    {
+        /* more bytes came after the timer was armed */
+        _uartArmTimer( pContext );
+    }
+    pthread_mutex_unlock( &(pContext->recvMutex) );
+}
+
+/**
+*  Open a UART device served by its own thread or a reactor.
 *  @param [in]  pDevName   Device name.
 *  @param [in]  pRecvFunc  Application's receive callback function.
 *  @param [in]  pArg       Application's argument.
-*  @returns  A @ref tUartHandle object.
+*  @param [in]  reactor    Reactor handle (0 is its own thread).
+*  @returns  A @ref tUartContext object (NULL is failed).
 */
-tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
+static tUartContext *_uartOpen(
+    char            *pDevName,
+    tUartRecvCb      pRecvFunc,
+    void            *pArg,
+    tReactorHandle   reactor
+)
 {
     tUartContext *pContext = NULL;
     pthread_attr_t tattr;
@@ -126,6 +491,7 @@ tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
     if (fd < 0)
     {
         LOG_ERROR("fail to open device %s\n", pDevName);
+        free( pContext );
         return 0;
     }
 
@@ -134,6 +500,17 @@ tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
     pContext->fd = fd;
     pContext->pRecvFunc = pRecvFunc;
     pContext->pArg = pArg;
+    pContext->timerFd = -1;
+    pthread_mutex_init(&(pContext->recvMutex), NULL);
+
+    pContext->pRecvBuf = comm_poolAlloc(COMM_BUF_SIZE + 1);
+    if (NULL == pContext->pRecvBuf)
+    {
+        LOG_ERROR("fail to allocate UART receive buffer\n");
+        close( fd );
+        free( pContext );
+        return 0;
+    }
 
     if (NULL == pRecvFunc)
     {
@@ -142,6 +519,54 @@ tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
 
     pContext->running = 1;
 
+    if ( reactor )
+    {
+        /* the idle timer of the collected bytes */
+        pContext->timerFd = timerfd_create(
+                                CLOCK_MONOTONIC,
+                                (TFD_NONBLOCK | TFD_CLOEXEC)
+                            );
+        if (pContext->timerFd < 0)
+        {
+            perror( "timerfd_create" );
+            goto _FAIL;
+        }
+
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    reactor,
+                    &(pContext->event),
+                    fd,
+                    EPOLLIN,
+                    _uartRecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach UART to reactor\n");
+            goto _FAIL;
+        }
+
+        /* on the same thread as the device, the timer never waits for it */
+        error = comm_reactorAddEventNear(
+                    &(pContext->event),
+                    &(pContext->timerEvent),
+                    pContext->timerFd,
+                    EPOLLIN,
+                    _uartTimerEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach UART timer to reactor\n");
+            comm_reactorDelEvent( &(pContext->event) );
+            goto _FAIL;
+        }
+
+        pContext->reactor = reactor;
+        goto _DONE;
+    }
+
     pthread_attr_init( &tattr );
     pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
 
@@ -154,15 +579,71 @@ tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
     if (error != 0)
     {
         LOG_ERROR("fail to create UART receiving thread\n");
-        close( fd );
-        free( pContext );
-        return 0;
+        pthread_attr_destroy( &tattr );
+        goto _FAIL;
     }
 
     pthread_attr_destroy( &tattr );
 
+_DONE:
     LOG_1("UART device open\n");
-    return ((tUartHandle)pContext);
+    return pContext;
+
+_FAIL:
+    if (pContext->timerFd >= 0)
+    {
+        close( pContext->timerFd );
+    }
+    close( fd );
+    comm_poolFree( pContext->pRecvBuf );
+    pthread_mutex_destroy( &(pContext->recvMutex) );
+    free( pContext );
+    return NULL;
+}
+
+/**
+*  UART open device.
+*  @param [in]  pDevName   Device name.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  A @ref tUartHandle object.
+*/
+tUartHandle uart_openDev(char *pDevName, tUartRecvCb pRecvFunc, void *pArg)
+{
+    return ((tUartHandle)_uartOpen(pDevName, pRecvFunc, pArg, g_reactor));
+}
+
+/**
+*  Release a UART device when it is no more received, the timer is on the
+*  same reactor thread and removed without waiting.
+*  @param [in]  pArg  A @ref tUartContext object.
+*/
+static void _uartRelease(void *pArg)
+{
+    tUartContext *pContext = pArg;
+
+    if ( comm_reactorAttached( &(pContext->timerEvent) ) )
+    {
+        comm_reactorDelEvent( &(pContext->timerEvent) );
+    }
+    if (pContext->timerFd >= 0)
+    {
+        close( pContext->timerFd );
+    }
+    if (pContext->fd > 0)
+    {
+        close( pContext->fd );
+    }
+
+    if ( pContext->pGroup )
+    {
+        __sync_fetch_and_sub(&(pContext->pGroup->portNum), 1);
+    }
+    comm_decoderUninit( &(pContext->decoder) );
+    comm_poolFree( pContext->pRecvBuf );
+    pthread_mutex_destroy( &(pContext->recvMutex) );
+    free( pContext );
+    LOG_1("UART device close\n");
 }
 
 /**
@@ -175,17 +656,18 @@ void uart_closeDev(tUartHandle handle)
 
     if ( pContext )
     {
-        pthread_cancel( pContext->thread );
-
         pContext->running = 0;
-        if (pContext->fd > 0)
+
+        if ( pContext->reactor )
         {
-            close( pContext->fd );
+            comm_reactorDelEventFree(&(pContext->event), _uartRelease, pContext);
+        }
+        else
+        {
+            pthread_cancel( pContext->thread );
+            pthread_join(pContext->thread, NULL);
+            _uartRelease( pContext );
         }
-
-        pthread_join(pContext->thread, NULL);
-        free( pContext );
-        LOG_1("UART device close\n");
     }
 }
 
@@ -194,7 +676,10 @@ void uart_closeDev(tUartHandle handle)
 *  @param [in]  handle    UART handle.
 *  @param [in]  baudRate  UART baud rate.
 *  @param [in]  parity    UART parity check.
-*  @param [in]  waitTime  UART wait time (-1 for non-blocking mode).
+*  @param [in]  waitTime  UART wait time (-1 for non-blocking mode), it is
+*                         kept for compatibility only. The receiving waits
+*                         for the readiness of the device, and the bytes
+*                         are grouped by @ref uart_setIdleTime.
 *  @returns  Success(0) or fail(-1).
 */
 int uart_configDev(
@@ -206,7 +691,6 @@ int uart_configDev(
 {
     tUartContext *pContext = (tUartContext *)handle;
     struct termios tty;
-    int blockingMode;
     int speed;
 
 
@@ -230,7 +714,6 @@ int uart_configDev(
     }
 
     if (waitTime > 255) waitTime = 255;
-    blockingMode = (waitTime < 0);
    
     memset(&tty, 0, sizeof tty);
     if (tcgetattr(pContext->fd, &tty) != 0) /* save current serial port settings */
@@ -249,9 +732,10 @@ int uart_configDev(
     tty.c_lflag  = 0;        // no signaling chars, no echo,
                              // no canonical processing
     tty.c_oflag  = 0;        // no remapping, no delays
-    tty.c_cc[VMIN]  = ((1 == blockingMode) ? 1 : 0);         // read doesn't block
-    tty.c_cc[VTIME] = ((1 == blockingMode) ? 0 : waitTime);  // in unit of 100 milli-sec for set timeout value
+    tty.c_cc[VMIN]  = 0;     // read returns what is available, the
+    tty.c_cc[VTIME] = 0;     // readiness comes from poll/epoll
     tty.c_iflag &= ~(IXON | IXOFF | IXANY);  // shut off xon/xoff ctrl
+    tty.c_iflag &= ~(ISTRIP | INLCR | IGNCR | ICRNL);  // binary frames, no CR/NL mapping
     tty.c_cflag |= (CLOCAL | CREAD);    // ignore modem controls,
                                         // enable reading
     tty.c_cflag &= ~(PARENB | PARODD);  // shut off parity
@@ -269,6 +753,92 @@ int uart_configDev(
     pContext->parity   = parity;
     pContext->waitTime = waitTime;
 
+    if ( pContext->frameIdle )
+    {
+        /* the idle gap follows the baud rate */
+        __atomic_store_n(&(pContext->idleTime), _uartFrameIdleTime( pContext ), __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+/**
+*  UART set the idle time of the receiving. The received bytes are
+*  collected until the line is idle for the idle time, or the buffer is
+*  full, and then passed to the receive callback in one call.
+*  @param [in]  handle    A @ref tUartHandle object.
+*  @param [in]  idleTime  Inter-byte idle time in micro-seconds (0 passes
+*                         every read at once).
+*  @returns  Success(0) or fail(-1).
+*/
+int uart_setIdleTime(tUartHandle handle, unsigned int idleTime)
+{
+    tUartContext *pContext = (tUartContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    /* taken at the next read, it may be called by the receive callback */
+    __atomic_store_n(&(pContext->idleTime), idleTime, __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+*  UART set the frame decoder of the receiving, the receive callback is
+*  given one complete frame at a time. The bytes of a frame in progress
+*  are dropped. It must not be called by the receive callback.
+*  @param [in]  handle  A @ref tUartHandle object.
+*  @param [in]  pFrame  A @ref tUartFrame object (NULL is no framing).
+*  @returns  Success(0) or fail(-1).
+*/
+int uart_setFrame(tUartHandle handle, tUartFrame *pFrame)
+{
+    tUartContext *pContext = (tUartContext *)handle;
+    tDecoder decoder;
+    int frameIdle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (comm_decoderInit(&decoder, pFrame) != 0)
+    {
+        return -1;
+    }
+
+    frameIdle = ((NULL != pFrame) && (UART_FRAME_IDLE == pFrame->type));
+
+    pthread_mutex_lock( &(pContext->recvMutex) );
+
+    comm_decoderUninit( &(pContext->decoder) );
+    pContext->decoder = decoder;
+    pContext->recvLen = 0;
+    pContext->discard = 0;
+
+    if ( frameIdle )
+    {
+        pContext->frameIdleTime = pFrame->idleTime;
+        pContext->frameMax = pFrame->maxSize;
+        if ((0 == pContext->frameMax) || (pContext->frameMax > COMM_BUF_SIZE))
+        {
+            pContext->frameMax = COMM_BUF_SIZE;
+        }
+        __atomic_store_n(&(pContext->idleTime), _uartFrameIdleTime( pContext ), __ATOMIC_RELAXED);
+    }
+    else if ( pContext->frameIdle )
+    {
+        __atomic_store_n(&(pContext->idleTime), 0, __ATOMIC_RELAXED);
+    }
+    pContext->frameIdle = frameIdle;
+
+    pthread_mutex_unlock( &(pContext->recvMutex) );
+
     return 0;
 }
 
@@ -316,6 +886,12 @@ int uart_send(tUartHandle handle, unsigned char *pData, unsigned short size)
     {
         LOG_ERROR("fail to write UART device\n");
         perror( "write" );
+        __sync_fetch_and_add(&(pContext->stat.errorNum), 1);
+    }
+    else
+    {
+        __sync_fetch_and_add(&(pContext->stat.txCount), 1);
+        __sync_fetch_and_add(&(pContext->stat.txBytes), error);
     }
 
     usleep(500 * 1000);
@@ -323,6 +899,132 @@ int uart_send(tUartHandle handle, unsigned char *pData, unsigned short size)
     return error;
 }
 
+/**
+*  UART get the statistics of a device.
+*  @param [in]   handle  A @ref tUartHandle object.
+*  @param [out]  pStat   A @ref tUartStat object.
+*  @returns  Success(0) or fail(-1).
+*/
+int uart_getStat(tUartHandle handle, tUartStat *pStat)
+{
+    tUartContext *pContext = (tUartContext *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pStat)
+    {
+        LOG_WARN("%s: pStat is NULL\n", __func__);
+        return -1;
+    }
+
+    pStat->rxBytes  = __atomic_load_n(&(pContext->stat.rxBytes), __ATOMIC_RELAXED);
+    pStat->rxCount  = __atomic_load_n(&(pContext->stat.rxCount), __ATOMIC_RELAXED);
+    pStat->txBytes  = __atomic_load_n(&(pContext->stat.txBytes), __ATOMIC_RELAXED);
+    pStat->txCount  = __atomic_load_n(&(pContext->stat.txCount), __ATOMIC_RELAXED);
+    pStat->errorNum = __atomic_load_n(&(pContext->stat.errorNum), __ATOMIC_RELAXED);
+
+    return 0;
+}
+
+/**
+*  UART initialize a port group. The devices opened in the group are
+*  served by the group's event loop threads instead of a thread for each
+*  device, thus the threads and the wake-ups do not grow with the ports.
+*  @param [in]  threadNum  Number of event loop threads.
+*  @param [in]  pin        Pin the threads to the CPUs (boolean).
+*  @returns  A @ref tUartGroupHandle object.
+*/
+tUartGroupHandle uart_groupInit(int threadNum, int pin)
+{
+    tUartGroupContext *pGroup = NULL;
+
+    pGroup = malloc( sizeof( tUartGroupContext ) );
+    if (NULL == pGroup)
+    {
+        LOG_ERROR("fail to allocate UART group context\n");
+        return 0;
+    }
+
+    memset(pGroup, 0x00, sizeof( tUartGroupContext ));
+
+    pGroup->reactor = comm_reactorInit( threadNum );
+    if (0 == pGroup->reactor)
+    {
+        LOG_ERROR("fail to create UART group threads\n");
+        free( pGroup );
+        return 0;
+    }
+
+    if ( pin )
+    {
+        comm_reactorPin( pGroup->reactor );
+    }
+
+    LOG_1("UART group initialized\n");
+    return ((tUartGroupHandle)pGroup);
+}
+
+/**
+*  UART un-initialize a port group.
+*  All the devices of the group must be closed first.
+*  @param [in]  group  A @ref tUartGroupHandle object.
+*/
+void uart_groupUninit(tUartGroupHandle group)
+{
+    tUartGroupContext *pGroup = (tUartGroupContext *)group;
+
+    if ( pGroup )
+    {
+        if (__atomic_load_n(&(pGroup->portNum), __ATOMIC_RELAXED) != 0)
+        {
+            LOG_WARN("%s: %d devices are still open\n", __func__, pGroup->portNum);
+            return;
+        }
+
+        comm_reactorUninit( pGroup->reactor );
+        free( pGroup );
+        LOG_1("UART group un-initialized\n");
+    }
+}
+
+/**
+*  UART open device in a port group. It is closed by @ref uart_closeDev.
+*  @param [in]  group      A @ref tUartGroupHandle object.
+*  @param [in]  pDevName   Device name.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  A @ref tUartHandle object.
+*/
+tUartHandle uart_groupOpenDev(
+    tUartGroupHandle  group,
+    char             *pDevName,
+    tUartRecvCb       pRecvFunc,
+    void             *pArg
+)
+{
+    tUartGroupContext *pGroup = (tUartGroupContext *)group;
+    tUartContext *pContext;
+
+    if (NULL == pGroup)
+    {
+        LOG_ERROR("%s: pGroup is NULL\n", __func__);
+        return 0;
+    }
+
+    pContext = _uartOpen(pDevName, pRecvFunc, pArg, pGroup->reactor);
+    if ( pContext )
+    {
+        pContext->pGroup = pGroup;
+        __sync_fetch_and_add(&(pGroup->portNum), 1);
+    }
+
+    return ((tUartHandle)pContext);
+}
+
 /**
 *  UART baud rate convert.
 *  @param [in]  baudRate  UART baud rate.
@@ -1,499 +1,741 @@
+#define _GNU_SOURCE  /* recvmmsg(), sendmmsg() */
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include <netinet/udp.h>
+#include <net/if.h>
 #include <ifaddrs.h>
 #include "comm_if.h"
 #include "comm_log.h"
+#include "comm_reactor.h"
+#include "comm_pool.h"
+#include "comm_bpf.h"
+#include "comm_cpu.h"
+#include "comm_pcap.h"
+#include "comm_ifcache.h"
 
 
-typedef struct _tUdpIpv4Context
-{
-    struct sockaddr_in  localAddr;
-    int                 fd;
-
-    tUdpRecvCb          pRecvFunc;
-    void               *pArg;
-    pthread_t           thread;
-    int                 running;
+/* Max. datagrams of one recvmmsg() / sendmmsg() */
+#define UDP_BATCH_MAX (1024)
 
-    unsigned char       recvMsg[COMM_BUF_SIZE+1];
-} tUdpIpv4Context;
+/* Datagrams sent by one sendmmsg() without allocating */
+#define UDP_SEND_BATCH (64)
 
+/* Max. sockets of one sharded handle */
+#define UDP_SHARD_MAX (256)
 
-/**
-*  Initialize an IPv4 UDP socket.
-*  @param [in]  pContext  A @ref tUdpIpv4Context object.
-*  @returns  Success(0) or failure(-1).
-*/
-static int _udpIpv4InitSocket(tUdpIpv4Context *pContext)
-{
-    struct sockaddr_in bindAddr;
-    int bindAddrLen;
-    int fd;
+/* Receive size of a GRO handle, one coalesced train is up to 64 KB */
+#define UDP_GRO_RECV_SIZE (65535)
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT (103)
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO (104)
+#endif
 
-    fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd < 0)
-    {
-        perror( "socket" );
-        return -1;
-    }
+/* Kernel limits of one GSO send, the payload of one IP packet */
+#ifndef UDP_MAX_SEGMENTS
+#define UDP_MAX_SEGMENTS (64)
+#endif
+#define UDP_IPV4_GSO_MAX_SIZE (65535 - 20 - 8)
+#define UDP_IPV6_GSO_MAX_SIZE (65535 - 8)
 
-    /* local host address */
-    bindAddrLen = sizeof( struct sockaddr_in );
-    bindAddr = pContext->localAddr;
+/* The handle has a receive callback, thus a receiving thread or event */
+#define UDP_RECEIVING(pContext) \
+    (( (pContext)->pRecvFunc ) || ( (pContext)->pBufFunc ) || \
+     ( (pContext)->pBatchFunc ) || ( (pContext)->pGroFunc ) || \
+     ( (pContext)->pShardFunc ))
 
-    if (bind(fd, (struct sockaddr*)&bindAddr, bindAddrLen) < 0)
-    {
-        perror( "bind" );
-        close( fd );
-        return -1;
-    }
 
-    pContext->fd = fd;
+/* recvmmsg() state of a batch receiving handle */
+typedef struct _tUdpBatch
+{
+    int              num;
+    struct mmsghdr  *pHdr;
+    struct iovec    *pIov;
+    tUdpMsg         *pMsg;
+    tCommBuf       **ppBuf;  /* receive buffers kept between the calls */
+} tUdpBatch;
 
-    LOG_2("IPv4 UDP socket is ready\n");
-    return 0;
-}
 
 /**
-*  Un-initialize an IPv4 UDP socket.
-*  @param [in]  pContext  A @ref tUdpIpv4Context object.
+*  Allocate the recvmmsg() arrays of a batch receiving handle.
+*  @param [in]  pBatch  A @ref tUdpBatch object.
+*  @param [in]  num     Max. datagrams of one receive.
+*  @returns  Success(0) or failure(-1).
 */
-static void _udpIpv4UninitSocket(tUdpIpv4Context *pContext)
+static int _udpBatchInit(tUdpBatch *pBatch, int num)
 {
-    if (pContext->fd > 0)
+    memset(pBatch, 0x00, sizeof( tUdpBatch ));
+
+    pBatch->pHdr  = calloc(num, sizeof( struct mmsghdr ));
+    pBatch->pIov  = calloc(num, sizeof( struct iovec ));
+    pBatch->pMsg  = calloc(num, sizeof( tUdpMsg ));
+    pBatch->ppBuf = calloc(num, sizeof( tCommBuf * ));
+    if ((NULL == pBatch->pHdr) || (NULL == pBatch->pIov) ||
+        (NULL == pBatch->pMsg) || (NULL == pBatch->ppBuf))
     {
-        close( pContext->fd );
-        pContext->fd = -1;
+        LOG_ERROR("fail to allocate %d UDP batch entries\n", num);
+        free( pBatch->pHdr );
+        free( pBatch->pIov );
+        free( pBatch->pMsg );
+        free( pBatch->ppBuf );
+        return -1;
     }
 
-    LOG_2("IPv4 UDP socket is closed\n");
+    pBatch->num = num;
+    return 0;
 }
 
 /**
-*  Thread function for the IPv4 UDP socket receiving.
-*  @param [in]  pArg  A @ref tUdpIpv4Context object.
+*  Release the recvmmsg() arrays and the kept receive buffers.
+*  @param [in]  pBatch  A @ref tUdpBatch object.
 */
-static void *_udpIpv4RecvTask(void *pArg)
+static void _udpBatchUninit(tUdpBatch *pBatch)
 {
-    tUdpIpv4Context *pContext = pArg;
-    struct sockaddr_in recvAddr;
-    socklen_t recvAddrLen;
-    int len;
-
-
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
-
-    /* source address */
-    recvAddrLen = sizeof( struct sockaddr_in );
-    bzero(&recvAddr, recvAddrLen);
+    int i;
 
-    while ( pContext->running )
+    for (i=0; i<pBatch->num; i++)
     {
-        LOG_3("IPv4 UDP ... recvfrom\n");
-        pthread_testcancel();
-        len = recvfrom(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0,
-                  (struct sockaddr *)(&recvAddr),
-                  &recvAddrLen
-              );
-        if (len <= 0)
-        {
-            LOG_ERROR("fail to receive IPv4 UDP socket\n");
-            perror( "recvfrom" );
-            break;
-        }
-        pthread_testcancel();
-
-        /*
-        * Convert IPv4 address from byte array to string:
-        *   char *inet_ntoa(struct in_addr in);
-        */
-
-        LOG_3(
-            "<- %s:%d\n",
-            inet_ntoa( recvAddr.sin_addr ),
-            ntohs( recvAddr.sin_port )
-        );
-        LOG_DUMP("IPv4 UDP recv", pContext->recvMsg, len);
-
-        if ( pContext->pRecvFunc )
+        if ( pBatch->ppBuf[i] )
         {
-            pContext->pRecvFunc(
-                pContext->pArg,
-                pContext->recvMsg,
-                len,
-                (struct sockaddr *)&recvAddr
-            );
+            comm_bufRelease( pBatch->ppBuf[i] );
         }
     }
 
-    LOG_2("stop the thread: %s\n", __func__);
-    pContext->running = 0;
-
-    pthread_exit(NULL);
+    free( pBatch->pHdr );
+    free( pBatch->pIov );
+    free( pBatch->pMsg );
+    free( pBatch->ppBuf );
+    memset(pBatch, 0x00, sizeof( tUdpBatch ));
 }
 
 /**
-*  Initialize IPv4 UDP socket.
-*  @param [in]  portNum    Local UDP port number.
-*  @param [in]  pRecvFunc  Application's receive callback function.
-*  @param [in]  pArg       Application's argument.
-*  @returns  IPv4 UDP handle.
+*  Receive several datagrams by one system call.
+*  @param [in]  pBatch    A @ref tUdpBatch object.
+*  @param [in]  fd        Socket file descriptor.
+*  @param [in]  recvSize  Receive size of the handle.
+*  @param [in]  flags     recvmmsg() flags.
+*  @returns  Number of datagrams in pBatch->pMsg (0 is no message, -1 is failed).
 */
-tUdpIpv4Handle comm_udpIpv4Init(
-    unsigned short  portNum,
-    tUdpRecvCb      pRecvFunc,
-    void           *pArg
-)
+static int _udpBatchRecv(tUdpBatch *pBatch, int fd, size_t recvSize, int flags)
 {
-    tUdpIpv4Context *pContext = NULL;
-    pthread_attr_t tattr;
-    int error;
+    tCommBuf *pBuf;
+    int num;
+    int i;
 
 
-    pContext = malloc( sizeof( tUdpIpv4Context ) );
-    if (NULL == pContext)
+    /* only the buffers passed to the application are taken again */
+    for (num=0; num<pBatch->num; num++)
     {
-        LOG_ERROR("fail to allocate IPv4 UDP context\n");
-        return 0;
+        pBuf = pBatch->ppBuf[num];
+        if (( pBuf ) && (pBuf->capacity < (recvSize + 1)))
+        {
+            comm_bufRelease( pBuf );
+            pBuf = NULL;
+        }
+        if (NULL == pBuf)
+        {
+            pBuf = comm_bufAlloc( recvSize + 1 );
+            if (NULL == pBuf)
+            {
+                break;
+            }
+        }
+        pBatch->ppBuf[num] = pBuf;
+
+        pBatch->pIov[num].iov_base = pBuf->pData;
+        pBatch->pIov[num].iov_len  = recvSize;
+        memset(&(pBatch->pHdr[num]), 0x00, sizeof( struct mmsghdr ));
+        pBatch->pHdr[num].msg_hdr.msg_name    = &(pBatch->pMsg[num].addr);
+        pBatch->pHdr[num].msg_hdr.msg_namelen = sizeof( pBatch->pMsg[num].addr );
+        pBatch->pHdr[num].msg_hdr.msg_iov     = &(pBatch->pIov[num]);
+        pBatch->pHdr[num].msg_hdr.msg_iovlen  = 1;
     }
 
-    memset(pContext, 0x00, sizeof( tUdpIpv4Context ));
-    pContext->localAddr.sin_family      = AF_INET;
-    pContext->localAddr.sin_port        = htons( portNum );
-    pContext->localAddr.sin_addr.s_addr = htonl( INADDR_ANY );
-    pContext->pRecvFunc = pRecvFunc;
-    pContext->pArg = pArg;
-    pContext->fd = -1;
-
-    error = _udpIpv4InitSocket( pContext );
-    if (error != 0)
+    if (0 == num)
     {
-        LOG_ERROR("fail to create IPv4 UDP socket\n");
-        free( pContext );
-        return 0;
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
     }
 
-    if (NULL == pRecvFunc)
+    /* wait for the first datagram only, then take what is queued */
+    num = recvmmsg(fd, pBatch->pHdr, num, (flags | MSG_WAITFORONE), NULL);
+    if (num <= 0)
     {
-        LOG_1("ignore IPv4 UDP receive function\n");
-        goto _IPV4_DONE;
+        if ((num < 0) && ((EAGAIN == errno) || (EINTR == errno)))
+        {
+            return 0;
+        }
+        perror( "recvmmsg" );
+        return -1;
     }
 
-    pContext->running = 1;
-
-    pthread_attr_init( &tattr );
-    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
-
-    error = pthread_create(
-                &(pContext->thread),
-                &tattr,
-                _udpIpv4RecvTask,
-                pContext
-            );
-    if (error != 0)
+    for (i=0; i<num; i++)
     {
-        LOG_ERROR("fail to create IPv4 UDP receiving thread\n");
-        _udpIpv4UninitSocket( pContext );
-        free( pContext );
-        return 0;
+        pBuf = pBatch->ppBuf[i];
+        pBuf->size = pBatch->pHdr[i].msg_len;
+        pBatch->pMsg[i].pBuf  = pBuf;
+        pBatch->pMsg[i].pData = pBuf->pData;
+        pBatch->pMsg[i].size  = pBuf->size;
+        pBatch->ppBuf[i] = NULL;
     }
 
-    pthread_attr_destroy( &tattr );
-
-_IPV4_DONE:
-    LOG_1("IPv4 UDP initialized\n");
-    return ((tUdpIpv4Handle)pContext);
+    return num;
 }
 
 /**
-*  Un-initialize IPv4 UDP socket.
-*  @param [in]  handle  IPv4 UDP handle.
+*  Send several datagrams by as few system calls as possible.
+*  @param [in]  fd       Socket file descriptor.
+*  @param [in]  pMsg     Datagrams with their destination addresses.
+*  @param [in]  num      Number of datagrams.
+*  @param [in]  addrLen  Destination address length.
+*  @returns  Number of sent datagrams (-1 is failed).
 */
-void comm_udpIpv4Uninit(tUdpIpv4Handle handle)
+static int _udpBatchSend(int fd, tUdpMsg *pMsg, int num, socklen_t addrLen)
 {
-    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct mmsghdr hdr[UDP_SEND_BATCH];
+    struct iovec iov[UDP_SEND_BATCH];
+    int sent = 0;
+    int cnt;
+    int len;
+    int i;
+
 
-    if ( pContext )
+    while (sent < num)
     {
-        if ( pContext->pRecvFunc )
+        cnt = ((num - sent) < UDP_SEND_BATCH) ? (num - sent) : UDP_SEND_BATCH;
+        memset(hdr, 0x00, (sizeof( struct mmsghdr ) * cnt));
+        for (i=0; i<cnt; i++)
         {
-            pthread_cancel( pContext->thread );
+            iov[i].iov_base = pMsg[sent + i].pData;
+            iov[i].iov_len  = pMsg[sent + i].size;
+            hdr[i].msg_hdr.msg_name    = &(pMsg[sent + i].addr);
+            hdr[i].msg_hdr.msg_namelen = addrLen;
+            hdr[i].msg_hdr.msg_iov     = &(iov[i]);
+            hdr[i].msg_hdr.msg_iovlen  = 1;
         }
 
-        pContext->running = 0;
-        _udpIpv4UninitSocket( pContext );
-
-        if ( pContext->pRecvFunc )
+        len = sendmmsg(fd, hdr, cnt, 0);
+        if (len < 0)
         {
-            pthread_join(pContext->thread, NULL);
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            perror( "sendmmsg" );
+            return (sent > 0) ? sent : -1;
         }
-
-        free( pContext );
-        LOG_1("IPv4 UDP un-initialized\n");
+        sent += len;
     }
+
+    return sent;
 }
 
+
 /**
-*  Send message by the IPv4 UDP socket.
-*  @param [in]  handle   IPv4 UDP handle.
-*  @param [in]  pIpStr   A string of an IPv4 address.
-*  @param [in]  portNum  UDP port number.
-*  @param [in]  pData    A pointer of data buffer.
-*  @param [in]  size     Data size.
-*  @returns  Message length (-1 is failed).
+*  Receive one datagram, or one GRO train of equal-sized segments.
+*  @param [in]   fd        Socket file descriptor.
+*  @param [in]   pBuf      A @ref tCommBuf object of the receive size.
+*  @param [in]   recvSize  Receive size of the handle.
+*  @param [in]   flags     recvmsg() flags.
+*  @param [out]  pAddr     Source address.
+*  @param [in]   addrLen   Source address length.
+*  @param [out]  pSegSize  Segment size, the length of one datagram.
+*  @returns  Received length (-1 is failed).
 */
-int comm_udpIpv4Send(
-    tUdpIpv4Handle  handle,
-    char           *pIpStr,
-    unsigned short  portNum,
-    unsigned char  *pData,
-    unsigned short  size
+static ssize_t _udpGroRecv(
+    int               fd,
+    tCommBuf         *pBuf,
+    size_t            recvSize,
+    int               flags,
+    struct sockaddr  *pAddr,
+    socklen_t         addrLen,
+    size_t           *pSegSize
 )
 {
-    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
-    struct sockaddr_in sendAddr;
-    int sendAddrLen;
-    int error;
-
-
-    if (NULL == pContext)
+    char ctrl[CMSG_SPACE(sizeof( int ))];
+    struct cmsghdr *pCmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    ssize_t len;
+
+
+    iov.iov_base = pBuf->pData;
+    iov.iov_len  = recvSize;
+
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    memset(pAddr, 0x00, addrLen);
+    msg.msg_name       = pAddr;
+    msg.msg_namelen    = addrLen;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = ctrl;
+    msg.msg_controllen = sizeof( ctrl );
+
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recvmsg(fd, &msg, flags);
+    pthread_cleanup_pop( 0 );
+    if (len < 0)
     {
-        LOG_ERROR("%s: pContext is NULL\n", __func__);
         return -1;
     }
 
-    if (pContext->fd < 0)
+    /* a single datagram comes without the segment size */
+    *pSegSize = len;
+    for (pCmsg=CMSG_FIRSTHDR(&msg); pCmsg; pCmsg=CMSG_NXTHDR(&msg, pCmsg))
     {
-        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        if ((SOL_UDP == pCmsg->cmsg_level) && (UDP_GRO == pCmsg->cmsg_type))
+        {
+            *pSegSize = *((int *)CMSG_DATA( pCmsg ));
+            break;
+        }
+    }
+
+    return len;
+}
+
+/**
+*  Check a GSO send against the kernel limits.
+*  @param [in]  pFunc    Caller's name.
+*  @param [in]  size     Data size.
+*  @param [in]  segSize  Segment size.
+*  @param [in]  maxSize  Max. data size of the address family.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _udpGsoCheck(
+    const char  *pFunc,
+    size_t       size,
+    size_t       segSize,
+    size_t       maxSize
+)
+{
+    if ((0 == segSize) || (segSize > USHRT_MAX))
+    {
+        LOG_WARN("%s: wrong segment size %zu\n", pFunc, segSize);
         return -1;
     }
 
-    if (NULL == pData)
+    if (size > maxSize)
     {
-        LOG_WARN("%s: pData is NULL\n", __func__);
+        LOG_WARN("%s: size %zu is over %zu bytes\n", pFunc, size, maxSize);
         return -1;
     }
 
-    if (0 == size)
+    if (((size + segSize - 1) / segSize) > UDP_MAX_SEGMENTS)
     {
-        LOG_WARN("%s: size is 0\n", __func__);
+        LOG_WARN(
+            "%s: %zu bytes segments of %zu bytes are over %d segments\n",
+            pFunc,
+            segSize,
+            size,
+            UDP_MAX_SEGMENTS
+        );
         return -1;
     }
 
-    LOG_3("-> %s:%d\n", pIpStr, portNum);
-    LOG_DUMP("IPv4 UDP send", pData, size);
+    return 0;
+}
 
-    /*
-    * Convert IPv4 address from string to 4-byte integer:
-    *   in_addr_t inet_addr(const char *cp);
-    */
+/**
+*  Send a buffer as equal-sized datagrams by one system call (UDP GSO).
+*  @param [in]  fd       Socket file descriptor.
+*  @param [in]  pAddr    Destination address.
+*  @param [in]  addrLen  Destination address length.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @param [in]  segSize  Segment size, the last segment may be shorter.
+*  @returns  Message length (-1 is failed).
+*/
+static ssize_t _udpGsoSend(
+    int               fd,
+    struct sockaddr  *pAddr,
+    socklen_t         addrLen,
+    unsigned char    *pData,
+    size_t            size,
+    size_t            segSize
+)
+{
+    char ctrl[CMSG_SPACE(sizeof( unsigned short ))];
+    struct cmsghdr *pCmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    unsigned short gso = segSize;
 
-    sendAddrLen = sizeof( struct sockaddr_in );
-    bzero(&sendAddr, sendAddrLen);
-    sendAddr.sin_family      = AF_INET;
-    sendAddr.sin_port        = htons( portNum );
-    sendAddr.sin_addr.s_addr = inet_addr( pIpStr );
 
-    error = sendto(
-                pContext->fd,
-                pData,
-                size,
-                0,
-                (struct sockaddr *)(&sendAddr),
-                sendAddrLen
-            );
-    if (error < 0)
+    iov.iov_base = pData;
+    iov.iov_len  = size;
+
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    msg.msg_name    = pAddr;
+    msg.msg_namelen = addrLen;
+    msg.msg_iov     = &iov;
+    msg.msg_iovlen  = 1;
+
+    if (size > segSize)
     {
-        LOG_ERROR("fail to send IPv4 UDP socket\n");
-        perror( "sendto" );
+        memset(ctrl, 0x00, sizeof( ctrl ));
+        msg.msg_control    = ctrl;
+        msg.msg_controllen = sizeof( ctrl );
+
+        pCmsg = CMSG_FIRSTHDR(&msg);
+        pCmsg->cmsg_level = SOL_UDP;
+        pCmsg->cmsg_type  = UDP_SEGMENT;
+        pCmsg->cmsg_len   = CMSG_LEN(sizeof( unsigned short ));
+        memcpy(CMSG_DATA( pCmsg ), &gso, sizeof( unsigned short ));
     }
 
-    return error;
+    return sendmsg(fd, &msg, 0);
 }
 
 /**
-*  Receive message by the IPv4 UDP socket.
-*  @param [in]  handle  IPv4 UDP handle.
-*  @param [in]  pData   A pointer of data buffer.
-*  @param [in]  size    Data buffer size.
-*  @returns  Message length (-1 is failed).
+*  Copy a buffer of datagrams to the capture of a UDP handle if it is tapped.
+*  @param [in]  pTap      A @ref tPcapTap object of the handle.
+*  @param [in]  outbound  Sent(PCAP_OUT) or received(PCAP_IN).
+*  @param [in]  portNum   Local port number in network byte order.
+*  @param [in]  pPeer     Peer's address.
+*  @param [in]  pData     A pointer of data buffer.
+*  @param [in]  size      Data size.
+*  @param [in]  segSize   Segment size of a GSO or GRO buffer (0 is one datagram).
 */
-int comm_udpIpv4Recv(
-    tUdpIpv4Handle  handle,
-    unsigned char  *pData,
-    unsigned short  size
+static void _udpTap(
+    tPcapTap         *pTap,
+    int               outbound,
+    unsigned short    portNum,
+    struct sockaddr  *pPeer,
+    unsigned char    *pData,
+    size_t            size,
+    size_t            segSize
 )
 {
-    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
-    struct sockaddr_in recvAddr;
-    socklen_t recvAddrLen;
-    int len;
-
+    struct iovec iov;
 
-    if (NULL == pContext)
+    if ( !comm_pcapTapped( pTap ) )
     {
-        LOG_ERROR("%s: pContext is NULL\n", __func__);
-        return -1;
+        return;
     }
 
-    if (pContext->fd < 0)
+    if ((0 == segSize) || (segSize > size))
     {
-        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
-        return -1;
+        segSize = size;
     }
 
-    if ( pContext->pRecvFunc )
+    /* each segment is one datagram on the wire */
+    while (size > 0)
     {
-        LOG_WARN("%s: pRecvFunc exists\n", __func__);
-        return -1;
+        iov.iov_base = pData;
+        iov.iov_len  = (size > segSize) ? segSize : size;
+        comm_pcapWriteUdp(pTap, outbound, ntohs( portNum ), pPeer, &iov, 1);
+        pData += iov.iov_len;
+        size  -= iov.iov_len;
     }
+}
 
-    if (NULL == pData)
+/**
+*  Convert an IP address string to a socket address.
+*  @param [in]   family  AF_INET or AF_INET6.
+*  @param [in]   pIpStr  IP address string.
+*  @param [out]  pAddr   Socket address.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _udpStrToAddr(int family, char *pIpStr, struct sockaddr_storage *pAddr)
+{
+    void *pIp;
+
+    memset(pAddr, 0x00, sizeof( struct sockaddr_storage ));
+    pAddr->ss_family = family;
+    if (AF_INET == family)
     {
-        LOG_WARN("%s: pData is NULL\n", __func__);
-        return -1;
+        pIp = &(((struct sockaddr_in *)pAddr)->sin_addr);
+    }
+    else
+    {
+        pIp = &(((struct sockaddr_in6 *)pAddr)->sin6_addr);
     }
 
-    if (0 == size)
+    if ((NULL == pIpStr) || (inet_pton(family, pIpStr, pIp) != 1))
     {
-        LOG_WARN("%s: size is 0\n", __func__);
+        LOG_ERROR("wrong IP address %s\n", (pIpStr ? pIpStr : "(null)"));
         return -1;
     }
 
-    /* source address */
-    recvAddrLen = sizeof( struct sockaddr_in );
-    bzero(&recvAddr, recvAddrLen);
+    return 0;
+}
 
-    len = recvfrom(
-              pContext->fd,
-              pData,
-              size,
-              0,
-              (struct sockaddr *)(&recvAddr),
-              &recvAddrLen
-          );
-    if (len <= 0)
+/**
+*  Get the index of a network interface.
+*  @param [in]   pIfName   Interface name (NULL is chosen by the kernel).
+*  @param [out]  pIfIndex  Interface index (0 is chosen by the kernel).
+*  @returns  Success(0) or failure(-1).
+*/
+static int _udpIfIndex(char *pIfName, unsigned int *pIfIndex)
+{
+    *pIfIndex = 0;
+    if ( pIfName )
     {
-        LOG_ERROR("fail to receive IPv4 UDP socket\n");
-        perror( "recvfrom" );
-        return len;
+        *pIfIndex = if_nametoindex( pIfName );
+        if (0 == *pIfIndex)
+        {
+            perror( "if_nametoindex" );
+            return -1;
+        }
     }
 
-    LOG_3(
-        "<- %s:%d\n",
-        inet_ntoa( recvAddr.sin_addr ),
-        ntohs( recvAddr.sin_port )
-    );
-    LOG_DUMP("IPv4 UDP recv", pData, len);
-
-    return len;
+    return 0;
 }
 
 /**
-*  Get the IPv4 address of local host.
-*  @param [in]      pIfName    A string of network interface name.
-*  @param [in,out]  pIpv4Addr  A pointer of IPv4 address buffer.
+*  Join or leave a multicast group, from any source or from one source.
+*  @param [in]  fd          Socket file descriptor.
+*  @param [in]  family      AF_INET or AF_INET6.
+*  @param [in]  join        Join(1) or leave(0).
+*  @param [in]  pGroupStr   Multicast group address string.
+*  @param [in]  pSourceStr  Source address string (NULL is any source).
+*  @param [in]  pIfName     Interface name (NULL is chosen by the kernel).
 *  @returns  Success(0) or failure(-1).
 */
-int comm_udpIpv4GetAddr(char *pIfName, unsigned char *pIpv4Addr)
+static int _udpMembership(
+    int    fd,
+    int    family,
+    int    join,
+    char  *pGroupStr,
+    char  *pSourceStr,
+    char  *pIfName
+)
 {
-    struct ifaddrs *pIfAddrHdr = NULL;
-    struct ifaddrs *pIf = NULL;
-    unsigned int  sinAddr;
-    int found = 0;
-
+    int level = (AF_INET == family) ? IPPROTO_IP : IPPROTO_IPV6;
+    struct group_source_req gsr;
+    struct sockaddr_storage group;
+    struct ip_mreqn mreq;
+    struct ipv6_mreq mreq6;
+    unsigned int ifIndex;
+    int error;
 
-    memset(pIpv4Addr, 0x00, 4);
 
-    if (getifaddrs( &pIfAddrHdr ) < 0)
+    if ((_udpIfIndex(pIfName, &ifIndex) != 0) ||
+        (_udpStrToAddr(family, pGroupStr, &group) != 0))
     {
-        perror( "getifaddrs" );
         return -1;
     }
 
-    /*
-    *  Walk through linked list, maintaining head pointer so we
-    *  can free list later
-    */
-    for (pIf=pIfAddrHdr; pIf!=NULL; pIf=pIf->ifa_next)
+    if ( pSourceStr )
     {
-        if ((AF_INET == pIf->ifa_addr->sa_family) &&
-            (0 == strcmp(pIf->ifa_name, pIfName)))
+        /* source-specific membership */
+        memset(&gsr, 0x00, sizeof( struct group_source_req ));
+        gsr.gsr_interface = ifIndex;
+        gsr.gsr_group = group;
+        if (_udpStrToAddr(family, pSourceStr, &(gsr.gsr_source)) != 0)
         {
-            sinAddr = ntohl( ((struct sockaddr_in *)pIf->ifa_addr)->sin_addr.s_addr );
-            pIpv4Addr[0] = ((sinAddr >> 24) & 0xFF);
-            pIpv4Addr[1] = ((sinAddr >> 16) & 0xFF);
-            pIpv4Addr[2] = ((sinAddr >>  8) & 0xFF);
-            pIpv4Addr[3] = ((sinAddr      ) & 0xFF);
+            return -1;
+        }
 
-            LOG_2(
-                "IPv4 address of %s is %u.%u.%u.%u\n",
-                pIfName,
-                pIpv4Addr[0],
-                pIpv4Addr[1],
-                pIpv4Addr[2],
-                pIpv4Addr[3]
-            );
+        error = setsockopt(
+                    fd,
+                    level,
+                    (join ? MCAST_JOIN_SOURCE_GROUP : MCAST_LEAVE_SOURCE_GROUP),
+                    &gsr,
+                    sizeof( struct group_source_req )
+                );
+    }
+    else if (AF_INET == family)
+    {
+        memset(&mreq, 0x00, sizeof( struct ip_mreqn ));
+        mreq.imr_multiaddr = ((struct sockaddr_in *)&group)->sin_addr;
+        mreq.imr_address.s_addr = htonl( INADDR_ANY );
+        mreq.imr_ifindex = ifIndex;
+
+        error = setsockopt(
+                    fd,
+                    level,
+                    (join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP),
+                    &mreq,
+                    sizeof( struct ip_mreqn )
+                );
+    }
+    else
+    {
+        memset(&mreq6, 0x00, sizeof( struct ipv6_mreq ));
+        mreq6.ipv6mr_multiaddr = ((struct sockaddr_in6 *)&group)->sin6_addr;
+        mreq6.ipv6mr_interface = ifIndex;
+
+        error = setsockopt(
+                    fd,
+                    level,
+                    (join ? IPV6_JOIN_GROUP : IPV6_LEAVE_GROUP),
+                    &mreq6,
+                    sizeof( struct ipv6_mreq )
+                );
+    }
 
-            found = 1;
-            break;
+    if (error < 0)
+    {
+        perror( "setsockopt" );
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+*  Set the multicast sending options of a socket.
+*  @param [in]  fd       Socket file descriptor.
+*  @param [in]  family   AF_INET or AF_INET6.
+*  @param [in]  ttl      TTL or hop limit (-1 is unchanged).
+*  @param [in]  loop     Loop back to the local host(1) or not(0) (-1 is unchanged).
+*  @param [in]  pIfName  Outgoing interface name (NULL is unchanged).
+*  @returns  Success(0) or failure(-1).
+*/
+static int _udpMulticastOpt(int fd, int family, int ttl, int loop, char *pIfName)
+{
+    struct ip_mreqn mreq;
+    unsigned int ifIndex;
+    int ifIndex6;
+
+
+    if (ttl >= 0)
+    {
+        if (setsockopt(
+                fd,
+                ((AF_INET == family) ? IPPROTO_IP : IPPROTO_IPV6),
+                ((AF_INET == family) ? IP_MULTICAST_TTL : IPV6_MULTICAST_HOPS),
+                &ttl,
+                sizeof( ttl )
+            ) < 0)
+        {
+            perror( "setsockopt" );
+            return -1;
         }
     }
 
-    freeifaddrs( pIfAddrHdr );
+    if (loop >= 0)
+    {
+        if (setsockopt(
+                fd,
+                ((AF_INET == family) ? IPPROTO_IP : IPPROTO_IPV6),
+                ((AF_INET == family) ? IP_MULTICAST_LOOP : IPV6_MULTICAST_LOOP),
+                &loop,
+                sizeof( loop )
+            ) < 0)
+        {
+            perror( "setsockopt" );
+            return -1;
+        }
+    }
 
-    return ( found ) ? 0 : -1;
-}
+    if ( pIfName )
+    {
+        if (_udpIfIndex(pIfName, &ifIndex) != 0)
+        {
+            return -1;
+        }
+
+        if (AF_INET == family)
+        {
+            memset(&mreq, 0x00, sizeof( struct ip_mreqn ));
+            mreq.imr_ifindex = ifIndex;
+            if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mreq, sizeof( mreq )) < 0)
+            {
+                perror( "setsockopt" );
+                return -1;
+            }
+        }
+        else
+        {
+            ifIndex6 = ifIndex;
+            if (setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &ifIndex6, sizeof( ifIndex6 )) < 0)
+            {
+                perror( "setsockopt" );
+                return -1;
+            }
+        }
+    }
 
+    return 0;
+}
 
-typedef struct _tUdpIpv6Context
+typedef struct _tUdpIpv4Context
 {
-    struct sockaddr_in6  localAddr;
-    int                  fd;
+    struct sockaddr_in  localAddr;
+    int                 fd;
 
-    tUdpRecvCb           pRecvFunc;
-    void                *pArg;
-    pthread_t            thread;
-    int                  running;
+    tUdpRecvCb          pRecvFunc;
+    tUdpBufCb           pBufFunc;
+    tUdpBatchCb         pBatchFunc;
+    tUdpBatch           batch;
+    tUdpGroCb           pGroFunc;
+    tUdpShardCb         pShardFunc;
+    int                 shard;  /* -1 is not sharded */
+    int                 reuseAddr;  /* the port is shared by group receivers */
+    struct _tUdpIpv4Context *pNext;  /* next shard */
+    size_t              recvSize;
+    tPcapTap            tap;
+    void               *pArg;
+    pthread_t           thread;
+    int                 running;
+    tReactorHandle      reactor;
+    tReactorEvent       event;
+} tUdpIpv4Context;
 
-    unsigned char        recvMsg[COMM_BUF_SIZE+1];
-} tUdpIpv6Context;
+/* pre-resolved destination of an IPv4 UDP handle */
+typedef struct _tUdpIpv4Dest
+{
+    tUdpIpv4Context    *pContext;
+    struct sockaddr_in addr;
+    char                ipStr[INET6_ADDRSTRLEN];
+    unsigned short      portNum;
+} tUdpIpv4Dest;
 
 
 /**
-*  Initialize an IPv6 UDP socket.
-*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  Initialize an IPv4 UDP socket.
+*  @param [in]  pContext  A @ref tUdpIpv4Context object.
 *  @returns  Success(0) or failure(-1).
 */
-static int _udpIpv6InitSocket(tUdpIpv6Context *pContext)
+static int _udpIpv4InitSocket(tUdpIpv4Context *pContext)
 {
-    struct sockaddr_in6 bindAddr;
+    struct sockaddr_in bindAddr;
     int bindAddrLen;
+    int reUsePort = 1;
+    int reUseAddr = 1;
     int fd;
 
 
-    fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
     if (fd < 0)
     {
         perror( "socket" );
         return -1;
     }
 
+    /* the shards bind the same port, the kernel hashes flows to them */
+    if ((pContext->shard >= 0) &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reUsePort, sizeof( reUsePort )) < 0))
+    {
+        perror( "setsockopt" );
+        close( fd );
+        return -1;
+    }
+
+    /* every receiver of a group on the host binds its port and gets a copy */
+    if (( pContext->reuseAddr ) &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, sizeof( reUseAddr )) < 0))
+    {
+        perror( "setsockopt" );
+        close( fd );
+        return -1;
+    }
+
     /* local host address */
-    bindAddrLen = sizeof( struct sockaddr_in6 );
+    bindAddrLen = sizeof( struct sockaddr_in );
     bindAddr = pContext->localAddr;
 
-    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    if (bind(fd, (struct sockaddr*)&bindAddr, bindAddrLen) < 0)
     {
         perror( "bind" );
         close( fd );
@@ -502,15 +744,15 @@ static int _udpIpv6InitSocket(tUdpIpv6Context *pContext)
 
     pContext->fd = fd;
 
-    LOG_2("IPv6 UDP socket is ready\n");
+    LOG_2("IPv4 UDP socket is ready\n");
     return 0;
 }
 
 /**
-*  Un-initialize an IPv6 UDP socket.
-*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  Un-initialize an IPv4 UDP socket.
+*  @param [in]  pContext  A @ref tUdpIpv4Context object.
 */
-static void _udpIpv6UninitSocket(tUdpIpv6Context *pContext)
+static void _udpIpv4UninitSocket(tUdpIpv4Context *pContext)
 {
     if (pContext->fd > 0)
     {
@@ -518,211 +760,2904 @@ static void _udpIpv6UninitSocket(tUdpIpv6Context *pContext)
         pContext->fd = -1;
     }
 
-    LOG_2("IPv6 UDP socket is closed\n");
+    LOG_2("IPv4 UDP socket is closed\n");
 }
 
 /**
-*  Thread function for the IPv6 UDP socket receiving.
-*  @param [in]  pArg  A @ref tUdpIpv6Context object.
+*  Receive several messages and pass them to the IPv4 UDP batch callback.
+*  @param [in]  pContext  A @ref tUdpIpv4Context object.
+*  @param [in]  flags     recvmmsg() flags.
+*  @returns  Number of messages (0 is no message, -1 is failed).
 */
-static void *_udpIpv6RecvTask(void *pArg)
+static int _udpIpv4RecvBatch(tUdpIpv4Context *pContext, int flags)
 {
-    tUdpIpv6Context *pContext = pArg;
-    char ipv6Str[INET6_ADDRSTRLEN];
-    struct sockaddr_in6 recvAddr;
+    tUdpBatch *pBatch = &(pContext->batch);
+    int num;
+    int i;
+
+
+    LOG_3("IPv4 UDP ... recvmmsg\n");
+    num = _udpBatchRecv(pBatch, pContext->fd, pContext->recvSize, flags);
+    if (num <= 0)
+    {
+        if (num < 0)
+        {
+            LOG_ERROR("fail to receive IPv4 UDP socket\n");
+        }
+        return num;
+    }
+
+    LOG_3("<- %d IPv4 UDP messages\n", num);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv4 UDP recv", pBatch->pMsg[i].pData, pBatch->pMsg[i].size);
+        _udpTap(
+            &(pContext->tap),
+            PCAP_IN,
+            pContext->localAddr.sin_port,
+            &(pBatch->pMsg[i].addr.sa),
+            pBatch->pMsg[i].pData,
+            pBatch->pMsg[i].size,
+            0
+        );
+    }
+
+    /* the callback owns the buffers */
+    pContext->pBatchFunc(pContext->pArg, pBatch->pMsg, num);
+    return num;
+}
+
+/**
+*  Receive coalesced segments and pass them to the IPv4 UDP GRO callback.
+*  @param [in]  pContext  A @ref tUdpIpv4Context object.
+*  @param [in]  flags     recvmsg() flags.
+*  @returns  Message length (0 is no message, -1 is failed).
+*/
+static int _udpIpv4RecvGro(tUdpIpv4Context *pContext, int flags)
+{
+    struct sockaddr_in recvAddr;
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
+    size_t segSize;
+    ssize_t len;
+
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv4 UDP ... recvmsg\n");
+    len = _udpGroRecv(
+              pContext->fd,
+              pBuf,
+              recvSize,
+              flags,
+              (struct sockaddr *)(&recvAddr),
+              sizeof( recvAddr ),
+              &segSize
+          );
+    if (len < 0)
+    {
+        comm_bufRelease( pBuf );
+        if (EAGAIN == errno)
+        {
+            return 0;
+        }
+        LOG_ERROR("fail to receive IPv4 UDP socket\n");
+        perror( "recvmsg" );
+        return -1;
+    }
+
+    LOG_3("<- %zd bytes of %zu bytes segments\n", len, segSize);
+    LOG_DUMP("IPv4 UDP recv", pBuf->pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin_port,
+        (struct sockaddr *)&recvAddr,
+        pBuf->pData,
+        len,
+        segSize
+    );
+
+    /* the callback owns the buffer */
+    pBuf->size = len;
+    pContext->pGroFunc(pContext->pArg, pBuf, segSize, (struct sockaddr *)&recvAddr);
+    return len;
+}
+
+/**
+*  Receive a message and pass it to the IPv4 UDP receive callback.
+*  @param [in]  pContext  A @ref tUdpIpv4Context object.
+*  @param [in]  flags     recvfrom() flags.
+*  @returns  Message length (0 is no message, -1 is failed).
+*/
+static int _udpIpv4RecvMsg(tUdpIpv4Context *pContext, int flags)
+{
+    struct sockaddr_in recvAddr;
     socklen_t recvAddrLen;
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
     int len;
 
 
-    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
-    LOG_2("start the thread: %s\n", __func__);
+    if ( pContext->pBatchFunc )
+    {
+        return _udpIpv4RecvBatch(pContext, flags);
+    }
+
+    if ( pContext->pGroFunc )
+    {
+        return _udpIpv4RecvGro(pContext, flags);
+    }
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
 
     /* source address */
-    recvAddrLen = sizeof( struct sockaddr_in6 );
+    recvAddrLen = sizeof( struct sockaddr_in );
     bzero(&recvAddr, recvAddrLen);
 
-    while ( pContext->running )
+    LOG_3("IPv4 UDP ... recvfrom\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recvfrom(
+              pContext->fd,
+              pBuf->pData,
+              recvSize,
+              flags,
+              (struct sockaddr *)(&recvAddr),
+              &recvAddrLen
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
     {
-        LOG_3("IPv6 UDP ... recvfrom\n");
-        pthread_testcancel();
-        len = recvfrom(
-                  pContext->fd,
-                  pContext->recvMsg,
-                  COMM_BUF_SIZE,
-                  0,
-                  (struct sockaddr *)(&recvAddr),
-                  &recvAddrLen
-              );
-        if (len <= 0)
+        if ((len < 0) && (EAGAIN == errno))
         {
-            LOG_ERROR("fail to receive IPv6 UDP socket\n");
-            perror( "recvfrom" );
-            break;
+            comm_bufRelease( pBuf );
+            return 0;
         }
-        pthread_testcancel();
-
-        /*
-        * Convert IPv6 address from byte array to string:
-        *   const char *inet_ntop(
-        *                   int af,
-        *                   const void *src,
-        *                   char *dst,
-        *                   socklen_t size
-        *               );
-        */
-        inet_ntop(
-            AF_INET6,
-            &(recvAddr.sin6_addr),
-            ipv6Str,
-            INET6_ADDRSTRLEN
-        );
+        LOG_ERROR("fail to receive IPv4 UDP socket\n");
+        perror( "recvfrom" );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
 
-        LOG_3(
-            "<- %s:%d\n",
-            ipv6Str,
-            ntohs( recvAddr.sin6_port )
-        );
-        LOG_DUMP("IPv6 UDP recv", pContext->recvMsg, len);
+    /*
+    * Convert IPv4 address from byte array to string:
+    *   char *inet_ntoa(struct in_addr in);
+    */
 
-        if ( pContext->pRecvFunc )
-        {
-            pContext->pRecvFunc(
-                pContext->pArg,
-                pContext->recvMsg,
-                len,
-                (struct sockaddr *)&recvAddr
+    LOG_3(
+        "<- %s:%d\n",
+        inet_ntoa( recvAddr.sin_addr ),
+        ntohs( recvAddr.sin_port )
+    );
+    LOG_DUMP("IPv4 UDP recv", pBuf->pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin_port,
+        (struct sockaddr *)&recvAddr,
+        pBuf->pData,
+        len,
+        0
+    );
+
+    if ( pContext->pShardFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pShardFunc(
+            pContext->pArg,
+            pContext->shard,
+            pBuf,
+            (struct sockaddr *)&recvAddr
+        );
+        return len;
+    }
+
+    if ( pContext->pBufFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pBufFunc(pContext->pArg, pBuf, (struct sockaddr *)&recvAddr);
+        return len;
+    }
+
+    if ( pContext->pRecvFunc )
+    {
+        pContext->pRecvFunc(
+            pContext->pArg,
+            pBuf->pData,
+            len,
+            (struct sockaddr *)&recvAddr
+        );
+    }
+
+    comm_bufRelease( pBuf );
+    return len;
+}
+
+/**
+*  Thread function for the IPv4 UDP socket receiving.
+*  @param [in]  pArg  A @ref tUdpIpv4Context object.
+*/
+static void *_udpIpv4RecvTask(void *pArg)
+{
+    tUdpIpv4Context *pContext = pArg;
+
+
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    while ( pContext->running )
+    {
+        pthread_testcancel();
+        if (_udpIpv4RecvMsg(pContext, 0) < 0)
+        {
+            break;
+        }
+        pthread_testcancel();
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
+    pContext->running = 0;
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Reactor event function for the IPv4 UDP socket receiving.
+*  @param [in]  pArg    A @ref tUdpIpv4Context object.
+*  @param [in]  events  Reactor events.
+*/
+static void _udpIpv4RecvEvent(void *pArg, unsigned int events)
+{
+    tUdpIpv4Context *pContext = pArg;
+
+    if (_udpIpv4RecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        comm_reactorDelEvent( &(pContext->event) );
+        pContext->running = 0;
+    }
+}
+
+/**
+*  Initialize IPv4 UDP socket.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  batchNum    Max. messages of one batch callback.
+*  @param [in]  pGroFunc    Application's GRO callback function.
+*  @param [in]  pShardFunc  Application's shard callback function.
+*  @param [in]  shard       Shard ID (-1 is not sharded).
+*  @param [in]  reuseAddr   Share the port with other group receivers(1) or not(0).
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+static tUdpIpv4Handle _udpIpv4Open(
+    unsigned short  portNum,
+    tUdpRecvCb      pRecvFunc,
+    tUdpBufCb       pBufFunc,
+    tUdpBatchCb     pBatchFunc,
+    int             batchNum,
+    tUdpGroCb       pGroFunc,
+    tUdpShardCb     pShardFunc,
+    int             shard,
+    int             reuseAddr,
+    void           *pArg
+)
+{
+    tUdpIpv4Context *pContext = NULL;
+    int gro = 1;
+    pthread_attr_t tattr;
+    int error;
+
+
+    pContext = malloc( sizeof( tUdpIpv4Context ) );
+    if (NULL == pContext)
+    {
+        LOG_ERROR("fail to allocate IPv4 UDP context\n");
+        return 0;
+    }
+
+    memset(pContext, 0x00, sizeof( tUdpIpv4Context ));
+    pContext->localAddr.sin_family      = AF_INET;
+    pContext->localAddr.sin_port        = htons( portNum );
+    pContext->localAddr.sin_addr.s_addr = htonl( INADDR_ANY );
+    pContext->pRecvFunc = pRecvFunc;
+    pContext->pBufFunc = pBufFunc;
+    pContext->pBatchFunc = pBatchFunc;
+    pContext->pGroFunc = pGroFunc;
+    pContext->pShardFunc = pShardFunc;
+    pContext->shard = shard;
+    pContext->reuseAddr = reuseAddr;
+    pContext->pArg = pArg;
+    pContext->recvSize = ( pGroFunc ) ? UDP_GRO_RECV_SIZE : COMM_BUF_SIZE;
+    pContext->fd = -1;
+
+    error = _udpIpv4InitSocket( pContext );
+    if (error != 0)
+    {
+        LOG_ERROR("fail to create IPv4 UDP socket\n");
+        free( pContext );
+        return 0;
+    }
+
+    if (( pBatchFunc ) && (_udpBatchInit(&(pContext->batch), batchNum) != 0))
+    {
+        _udpIpv4UninitSocket( pContext );
+        free( pContext );
+        return 0;
+    }
+
+    if ( pGroFunc )
+    {
+        /* the kernel passes the coalesced segments as one buffer */
+        if (setsockopt(pContext->fd, SOL_UDP, UDP_GRO, &gro, sizeof( gro )) < 0)
+        {
+            perror( "setsockopt" );
+            _udpIpv4UninitSocket( pContext );
+            _udpBatchUninit( &(pContext->batch) );
+            free( pContext );
+            return 0;
+        }
+    }
+
+    if ( !UDP_RECEIVING( pContext ) )
+    {
+        LOG_1("ignore IPv4 UDP receive function\n");
+        goto _IPV4_DONE;
+    }
+
+    pContext->running = 1;
+
+    /* a shard keeps its own thread pinned to one CPU, not a reactor thread */
+    if (( g_reactor ) && (shard < 0))
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _udpIpv4RecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPv4 UDP to reactor\n");
+            _udpIpv4UninitSocket( pContext );
+            _udpBatchUninit( &(pContext->batch) );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = g_reactor;
+        goto _IPV4_DONE;
+    }
+
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+
+    error = pthread_create(
+                &(pContext->thread),
+                &tattr,
+                _udpIpv4RecvTask,
+                pContext
+            );
+    if (error != 0)
+    {
+        LOG_ERROR("fail to create IPv4 UDP receiving thread\n");
+        _udpIpv4UninitSocket( pContext );
+        _udpBatchUninit( &(pContext->batch) );
+        free( pContext );
+        return 0;
+    }
+
+    pthread_attr_destroy( &tattr );
+
+    if (shard >= 0)
+    {
+        comm_cpuPin(pContext->thread, shard);
+    }
+
+_IPV4_DONE:
+    LOG_1("IPv4 UDP initialized\n");
+    return ((tUdpIpv4Handle)pContext);
+}
+
+/**
+*  Initialize IPv4 UDP socket.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4Init(
+    unsigned short  portNum,
+    tUdpRecvCb      pRecvFunc,
+    void           *pArg
+)
+{
+    return _udpIpv4Open(portNum, pRecvFunc, NULL, NULL, 0, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv4 UDP socket with zero-copy buffers.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4InitBuf(
+    unsigned short  portNum,
+    tUdpBufCb       pBufFunc,
+    void           *pArg
+)
+{
+    return _udpIpv4Open(portNum, NULL, pBufFunc, NULL, 0, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv4 UDP socket of a multicast receiver with zero-copy
+*  buffers. The port is bound with SO_REUSEADDR, so the other receivers
+*  of the group on the host bind it too, and each one that joins by
+*  @ref comm_udpIpv4JoinGroup gets a copy of the group's datagrams. A
+*  unicast datagram to the port goes to one of them only.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4InitGroup(
+    unsigned short  portNum,
+    tUdpBufCb       pBufFunc,
+    void           *pArg
+)
+{
+    return _udpIpv4Open(portNum, NULL, pBufFunc, NULL, 0, NULL, NULL, -1, 1, pArg);
+}
+
+/**
+*  Initialize IPv4 UDP socket with batch receiving. Up to batchNum
+*  queued datagrams are received by one recvmmsg() and passed to one
+*  callback.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  batchNum    Max. messages of one callback (0 is COMM_UDP_BATCH_NUM).
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4InitBatch(
+    unsigned short  portNum,
+    int             batchNum,
+    tUdpBatchCb     pBatchFunc,
+    void           *pArg
+)
+{
+    if (NULL == pBatchFunc)
+    {
+        LOG_ERROR("%s: pBatchFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    if (0 == batchNum)
+    {
+        batchNum = COMM_UDP_BATCH_NUM;
+    }
+
+    if ((batchNum < 0) || (batchNum > UDP_BATCH_MAX))
+    {
+        LOG_ERROR("%s: wrong batch number %d\n", __func__, batchNum);
+        return 0;
+    }
+
+    return _udpIpv4Open(portNum, NULL, NULL, pBatchFunc, batchNum, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv4 UDP socket with GRO receiving. The kernel coalesces
+*  the datagrams of one flow, and the callback gets them as one buffer
+*  with the segment size (the last segment may be shorter).
+*  @param [in]  portNum   Local UDP port number.
+*  @param [in]  pGroFunc  Application's GRO callback function.
+*  @param [in]  pArg      Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4InitGro(
+    unsigned short  portNum,
+    tUdpGroCb       pGroFunc,
+    void           *pArg
+)
+{
+    if (NULL == pGroFunc)
+    {
+        LOG_ERROR("%s: pGroFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    return _udpIpv4Open(portNum, NULL, NULL, NULL, 0, pGroFunc, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv4 UDP sockets sharded by SO_REUSEPORT. Every shard binds
+*  the same port and has its own receiving thread pinned to one CPU, the
+*  kernel spreads the flows to the shards by hashing. A shard's callbacks
+*  run on its own thread only, so the per-shard state needs no lock. The
+*  shards do not use the reactor, and the handle sends by shard 0.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  shardNum    Number of shards (0 is one per CPU).
+*  @param [in]  pShardFunc  Application's shard callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv4 UDP handle.
+*/
+tUdpIpv4Handle comm_udpIpv4InitSharded(
+    unsigned short  portNum,
+    int             shardNum,
+    tUdpShardCb     pShardFunc,
+    void           *pArg
+)
+{
+    tUdpIpv4Context *pFirst;
+    tUdpIpv4Context *pLast;
+    tUdpIpv4Context *pContext;
+    struct sockaddr_in localAddr;
+    socklen_t localAddrLen;
+    int i;
+
+
+    if (NULL == pShardFunc)
+    {
+        LOG_ERROR("%s: pShardFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    if (0 == shardNum)
+    {
+        shardNum = comm_cpuNum( UDP_SHARD_MAX );
+    }
+
+    if ((shardNum < 0) || (shardNum > UDP_SHARD_MAX))
+    {
+        LOG_ERROR("%s: wrong shard number %d\n", __func__, shardNum);
+        return 0;
+    }
+
+    pFirst = (tUdpIpv4Context *)_udpIpv4Open(
+                 portNum, NULL, NULL, NULL, 0, NULL, pShardFunc, 0, 0, pArg
+             );
+    if (NULL == pFirst)
+    {
+        return 0;
+    }
+
+    if (0 == portNum)
+    {
+        /* the other shards join the port picked for the first one */
+        localAddrLen = sizeof( localAddr );
+        if (getsockname(pFirst->fd, (struct sockaddr *)&localAddr, &localAddrLen) < 0)
+        {
+            perror( "getsockname" );
+            comm_udpIpv4Uninit( (tUdpIpv4Handle)pFirst );
+            return 0;
+        }
+        portNum = ntohs( localAddr.sin_port );
+    }
+
+    pLast = pFirst;
+    for (i=1; i<shardNum; i++)
+    {
+        pContext = (tUdpIpv4Context *)_udpIpv4Open(
+                       portNum, NULL, NULL, NULL, 0, NULL, pShardFunc, i, 0, pArg
+                   );
+        if (NULL == pContext)
+        {
+            LOG_ERROR("fail to open IPv4 UDP shard %d\n", i);
+            comm_udpIpv4Uninit( (tUdpIpv4Handle)pFirst );
+            return 0;
+        }
+
+        pLast->pNext = pContext;
+        pLast = pContext;
+    }
+
+    LOG_1("IPv4 UDP port %d has %d shards\n", portNum, shardNum);
+    return ((tUdpIpv4Handle)pFirst);
+}
+
+/**
+*  Release an IPv4 UDP socket when it is no more received.
+*  @param [in]  pArg  A @ref tUdpIpv4Context object.
+*/
+static void _udpIpv4Release(void *pArg)
+{
+    tUdpIpv4Context *pContext = pArg;
+
+    _udpIpv4UninitSocket( pContext );
+    _udpBatchUninit( &(pContext->batch) );
+    free( pContext );
+    LOG_1("IPv4 UDP un-initialized\n");
+}
+
+/**
+*  Un-initialize IPv4 UDP socket.
+*  @param [in]  handle  IPv4 UDP handle.
+*/
+void comm_udpIpv4Uninit(tUdpIpv4Handle handle)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    tUdpIpv4Context *pNext;
+
+    /* a sharded handle closes all of its shards */
+    while ( pContext )
+    {
+        pNext = pContext->pNext;
+
+        pContext->running = 0;
+
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _udpIpv4Release, pContext);
+        }
+        else
+        {
+            if ( UDP_RECEIVING( pContext ) )
+            {
+                pthread_cancel( pContext->thread );
+                pthread_join(pContext->thread, NULL);
+            }
+            _udpIpv4Release( pContext );
+        }
+
+        pContext = pNext;
+    }
+}
+
+/**
+*  Set the receive size of the IPv4 UDP socket.
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4SetRecvSize(tUdpIpv4Handle handle, size_t size)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
+
+    pContext->recvSize = size;
+    return 0;
+}
+
+/**
+*  Join a multicast group on the IPv4 UDP socket, from any source or from
+*  one source only. All the shards of a sharded handle join. The other
+*  handles bind their port alone, so the receivers of a group that share
+*  the port on the host are initialized by @ref comm_udpIpv4InitGroup.
+*  @param [in]  handle      IPv4 UDP handle.
+*  @param [in]  pGroupStr   Multicast group address string.
+*  @param [in]  pSourceStr  Source address string (NULL is any source).
+*  @param [in]  pIfName     Interface name (NULL is chosen by the kernel).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4JoinGroup(
+    tUdpIpv4Handle  handle,
+    char           *pGroupStr,
+    char           *pSourceStr,
+    char           *pIfName
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMembership(pContext->fd, AF_INET, 1, pGroupStr, pSourceStr, pIfName) != 0)
+        {
+            LOG_ERROR("fail to join IPv4 multicast group %s\n", pGroupStr);
+            return -1;
+        }
+    }
+
+    LOG_1("IPv4 UDP joined %s\n", pGroupStr);
+    return 0;
+}
+
+/**
+*  Leave a multicast group on the IPv4 UDP socket.
+*  @param [in]  handle      IPv4 UDP handle.
+*  @param [in]  pGroupStr   Multicast group address string.
+*  @param [in]  pSourceStr  Source address string (NULL is any source).
+*  @param [in]  pIfName     Interface name (NULL is chosen by the kernel).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4LeaveGroup(
+    tUdpIpv4Handle  handle,
+    char           *pGroupStr,
+    char           *pSourceStr,
+    char           *pIfName
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    int error = 0;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMembership(pContext->fd, AF_INET, 0, pGroupStr, pSourceStr, pIfName) != 0)
+        {
+            LOG_ERROR("fail to leave IPv4 multicast group %s\n", pGroupStr);
+            error = -1;
+        }
+    }
+
+    return error;
+}
+
+/**
+*  Set the multicast sending options of the IPv4 UDP socket.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  ttl      Multicast TTL (-1 is unchanged).
+*  @param [in]  loop     Loop back to the local host(1) or not(0) (-1 is unchanged).
+*  @param [in]  pIfName  Outgoing interface name (NULL is unchanged).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4SetMulticast(
+    tUdpIpv4Handle  handle,
+    int             ttl,
+    int             loop,
+    char           *pIfName
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (ttl > 255)
+    {
+        LOG_WARN("%s: wrong TTL %d\n", __func__, ttl);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMulticastOpt(pContext->fd, AF_INET, ttl, loop, pIfName) != 0)
+        {
+            LOG_ERROR("fail to set IPv4 multicast options\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Attach a filter to the IPv4 UDP socket, so that the datagrams it
+*  rejects are dropped in the kernel. See @ref comm_bpfCompile for the
+*  expression, e.g. "src net 10.0.0.0/8 and not src port 53". All the
+*  shards of a sharded handle get the filter.
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  pExpr   Filter expression (NULL or empty removes the filter).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4SetFilter(tUdpIpv4Handle handle, char *pExpr)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (comm_bpfAttach(pContext->fd, pExpr, BPF_LINK_UDP4) != 0)
+        {
+            LOG_ERROR("fail to set IPv4 UDP filter\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Tap the IPv4 UDP socket, so that the datagrams it sends and receives
+*  are copied to a pcapng capture with synthesized IPv4 and UDP headers.
+*  All the shards of a sharded handle are one interface of the capture.
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4SetTap(tUdpIpv4Handle handle, tPcapHandle pcap)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct sockaddr_in localAddr;
+    socklen_t localAddrLen;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    /* the port the kernel picked for port 0 */
+    localAddrLen = sizeof( localAddr );
+    if (getsockname(pContext->fd, (struct sockaddr *)&localAddr, &localAddrLen) < 0)
+    {
+        perror( "getsockname" );
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "udp4:%d", ntohs( localAddr.sin_port ));
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_RAW, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        pContext->localAddr.sin_port = localAddr.sin_port;
+        comm_pcapSetTap(&(pContext->tap), pIf);
+    }
+
+    return 0;
+}
+
+/**
+*  Send message by the IPv4 UDP socket.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  pIpStr   A string of an IPv4 address.
+*  @param [in]  portNum  UDP port number.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @returns  Message length (-1 is failed).
+*/
+int comm_udpIpv4Send(
+    tUdpIpv4Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    unsigned char  *pData,
+    unsigned short  size
+)
+{
+    return comm_udpIpv4SendEx(handle, pIpStr, portNum, pData, size);
+}
+
+/**
+*  Send message by the IPv4 UDP socket.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  pIpStr   A string of an IPv4 address.
+*  @param [in]  portNum  UDP port number.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv4SendEx(
+    tUdpIpv4Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    unsigned char  *pData,
+    size_t          size
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct sockaddr_in sendAddr;
+    int sendAddrLen;
+    ssize_t error;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s:%d\n", pIpStr, portNum);
+    LOG_DUMP("IPv4 UDP send", pData, size);
+
+    /*
+    * Convert IPv4 address from string to 4-byte integer:
+    *   in_addr_t inet_addr(const char *cp);
+    */
+
+    sendAddrLen = sizeof( struct sockaddr_in );
+    bzero(&sendAddr, sendAddrLen);
+    sendAddr.sin_family      = AF_INET;
+    sendAddr.sin_port        = htons( portNum );
+    sendAddr.sin_addr.s_addr = inet_addr( pIpStr );
+
+    error = sendto(
+                pContext->fd,
+                pData,
+                size,
+                0,
+                (struct sockaddr *)(&sendAddr),
+                sendAddrLen
+            );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 UDP socket\n");
+        perror( "sendto" );
+        return error;
+    }
+
+    _udpTap(
+        &(pContext->tap),
+        PCAP_OUT,
+        pContext->localAddr.sin_port,
+        (struct sockaddr *)(&sendAddr),
+        pData,
+        error,
+        0
+    );
+    return error;
+}
+
+/**
+*  Send one message of several buffers by the IPv4 UDP socket.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  pIpStr   Destination IPv4 address string.
+*  @param [in]  portNum  Destination port number.
+*  @param [in]  pIov     Data buffers.
+*  @param [in]  num      Number of data buffers.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv4Sendv(
+    tUdpIpv4Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    struct iovec   *pIov,
+    int             num
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct sockaddr_in sendAddr;
+    int sendAddrLen;
+    struct msghdr msg;
+    ssize_t error;
+    tPcapTap *pTap;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pIov)
+    {
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %s:%d\n", pIpStr, portNum);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv4 UDP send", pIov[i].iov_base, pIov[i].iov_len);
+    }
+
+    /*
+    * Convert IPv4 address from string to 4-byte integer:
+    *   in_addr_t inet_addr(const char *cp);
+    */
+
+    sendAddrLen = sizeof( struct sockaddr_in );
+    bzero(&sendAddr, sendAddrLen);
+    sendAddr.sin_family      = AF_INET;
+    sendAddr.sin_port        = htons( portNum );
+    sendAddr.sin_addr.s_addr = inet_addr( pIpStr );
+
+    /* one datagram is never interleaved with the other senders */
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    msg.msg_name    = &sendAddr;
+    msg.msg_namelen = sendAddrLen;
+    msg.msg_iov     = pIov;
+    msg.msg_iovlen  = num;
+
+    error = sendmsg(pContext->fd, &msg, 0);
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 UDP socket\n");
+        perror( "sendmsg" );
+        return error;
+    }
+
+    pTap = &(pContext->tap);
+    if ( comm_pcapTapped( pTap ) )
+    {
+        comm_pcapWriteUdp(
+            pTap,
+            PCAP_OUT,
+            ntohs( pContext->localAddr.sin_port ),
+            (struct sockaddr *)(&sendAddr),
+            pIov,
+            num
+        );
+    }
+    return error;
+}
+
+/**
+*  Send several messages by the IPv4 UDP socket with sendmmsg().
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  pMsg    Messages, each with its destination in addr.ipv4.
+*  @param [in]  num     Number of messages.
+*  @returns  Number of sent messages (-1 is failed).
+*/
+int comm_udpIpv4SendBatch(tUdpIpv4Handle handle, tUdpMsg *pMsg, int num)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    int sent;
+    int i;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pMsg)
+    {
+        LOG_WARN("%s: pMsg is NULL\n", __func__);
+        return -1;
+    }
+
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %d IPv4 UDP messages\n", num);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv4 UDP send", pMsg[i].pData, pMsg[i].size);
+    }
+
+    sent = _udpBatchSend(
+               pContext->fd,
+               pMsg,
+               num,
+               sizeof( struct sockaddr_in )
+           );
+
+    for (i=0; i<sent; i++)
+    {
+        _udpTap(
+            &(pContext->tap),
+            PCAP_OUT,
+            pContext->localAddr.sin_port,
+            &(pMsg[i].addr.sa),
+            pMsg[i].pData,
+            pMsg[i].size,
+            0
+        );
+    }
+
+    return sent;
+}
+
+/**
+*  Send a buffer as equal-sized datagrams by the IPv4 UDP socket with
+*  one system call (UDP GSO). The buffer is up to 64 KB (one IP packet)
+*  and 64 segments, a larger one fails without sending.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  pIpStr   Destination IPv4 address string.
+*  @param [in]  portNum  Destination port number.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @param [in]  segSize  Segment size, the last segment may be shorter.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv4SendGso(
+    tUdpIpv4Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    unsigned char  *pData,
+    size_t          size,
+    size_t          segSize
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct sockaddr_in sendAddr;
+    int sendAddrLen;
+    ssize_t error;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    if (_udpGsoCheck(__func__, size, segSize, UDP_IPV4_GSO_MAX_SIZE) != 0)
+    {
+        return -1;
+    }
+
+    LOG_3("-> %s:%d (%zu bytes segments)\n", pIpStr, portNum, segSize);
+    LOG_DUMP("IPv4 UDP send", pData, size);
+
+    /*
+    * Convert IPv4 address from string to 4-byte integer:
+    *   in_addr_t inet_addr(const char *cp);
+    */
+
+    sendAddrLen = sizeof( struct sockaddr_in );
+    bzero(&sendAddr, sendAddrLen);
+    sendAddr.sin_family      = AF_INET;
+    sendAddr.sin_port        = htons( portNum );
+    sendAddr.sin_addr.s_addr = inet_addr( pIpStr );
+
+    error = _udpGsoSend(
+                pContext->fd,
+                (struct sockaddr *)(&sendAddr),
+                sendAddrLen,
+                pData,
+                size,
+                segSize
+            );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 UDP socket\n");
+        perror( "sendmsg" );
+        return error;
+    }
+
+    _udpTap(
+        &(pContext->tap),
+        PCAP_OUT,
+        pContext->localAddr.sin_port,
+        (struct sockaddr *)(&sendAddr),
+        pData,
+        error,
+        segSize
+    );
+    return error;
+}
+
+/**
+*  Open a pre-resolved destination of the IPv4 UDP handle. The address is
+*  parsed once, and @ref comm_udpIpv4SendTo sends without parsing. A
+*  destination sends by the handle's socket, from its bound port, so the
+*  replies are received by the handle. A connected socket of its own would
+*  send from another port, or take the replies if it shared the bound one.
+*  Close the destinations before un-initializing the handle.
+*  @param [in]  handle   IPv4 UDP handle.
+*  @param [in]  pIpStr   Destination IPv4 address string.
+*  @param [in]  portNum  Destination port number.
+*  @returns  IPv4 UDP destination handle.
+*/
+tUdpIpv4DestHandle comm_udpIpv4OpenDest(
+    tUdpIpv4Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    tUdpIpv4Dest *pDest;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return 0;
+    }
+
+    if (NULL == pIpStr)
+    {
+        LOG_ERROR("%s: pIpStr is NULL\n", __func__);
+        return 0;
+    }
+
+    pDest = malloc( sizeof( tUdpIpv4Dest ) );
+    if (NULL == pDest)
+    {
+        LOG_ERROR("fail to allocate IPv4 UDP destination\n");
+        return 0;
+    }
+
+    memset(pDest, 0x00, sizeof( tUdpIpv4Dest ));
+    pDest->pContext = pContext;
+    pDest->portNum = portNum;
+    snprintf(pDest->ipStr, INET6_ADDRSTRLEN, "%s", pIpStr);
+
+    /*
+    * Convert IPv4 address from string to 4-byte integer:
+    *   int inet_pton(int af, const char *src, void *dst);
+    */
+
+    pDest->addr.sin_family = AF_INET;
+    pDest->addr.sin_port   = htons( portNum );
+    if (inet_pton(AF_INET, pIpStr, &(pDest->addr.sin_addr)) != 1)
+    {
+        LOG_ERROR("%s: wrong IPv4 address %s\n", __func__, pIpStr);
+        free( pDest );
+        return 0;
+    }
+
+    LOG_1("IPv4 UDP destination %s:%d opened\n", pIpStr, portNum);
+    return ((tUdpIpv4DestHandle)pDest);
+}
+
+/**
+*  Close a destination of the IPv4 UDP handle.
+*  @param [in]  dest  IPv4 UDP destination handle.
+*/
+void comm_udpIpv4CloseDest(tUdpIpv4DestHandle dest)
+{
+    tUdpIpv4Dest *pDest = (tUdpIpv4Dest *)dest;
+
+    if ( pDest )
+    {
+        free( pDest );
+        LOG_1("IPv4 UDP destination closed\n");
+    }
+}
+
+/**
+*  Send a message to a destination of the IPv4 UDP handle.
+*  @param [in]  dest   IPv4 UDP destination handle.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv4SendTo(
+    tUdpIpv4DestHandle  dest,
+    unsigned char      *pData,
+    size_t              size
+)
+{
+    tUdpIpv4Dest *pDest = (tUdpIpv4Dest *)dest;
+    ssize_t error;
+
+
+    if (NULL == pDest)
+    {
+        LOG_ERROR("%s: pDest is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s:%d\n", pDest->ipStr, pDest->portNum);
+    LOG_DUMP("IPv4 UDP send", pData, size);
+
+    if (pDest->pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    error = sendto(
+                pDest->pContext->fd,
+                pData,
+                size,
+                0,
+                (struct sockaddr *)&(pDest->addr),
+                sizeof( pDest->addr )
+            );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv4 UDP socket\n");
+        perror( "sendto" );
+        return error;
+    }
+
+    _udpTap(
+        &(pDest->pContext->tap),
+        PCAP_OUT,
+        pDest->pContext->localAddr.sin_port,
+        (struct sockaddr *)&(pDest->addr),
+        pData,
+        error,
+        0
+    );
+    return error;
+}
+
+/**
+*  Receive message by the IPv4 UDP socket.
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data buffer size.
+*  @returns  Message length (-1 is failed).
+*/
+int comm_udpIpv4Recv(
+    tUdpIpv4Handle  handle,
+    unsigned char  *pData,
+    unsigned short  size
+)
+{
+    return comm_udpIpv4RecvEx(handle, pData, size);
+}
+
+/**
+*  Receive message by the IPv4 UDP socket.
+*  @param [in]  handle  IPv4 UDP handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data buffer size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv4RecvEx(
+    tUdpIpv4Handle  handle,
+    unsigned char  *pData,
+    size_t          size
+)
+{
+    tUdpIpv4Context *pContext = (tUdpIpv4Context *)handle;
+    struct sockaddr_in recvAddr;
+    socklen_t recvAddrLen;
+    ssize_t len;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if ( UDP_RECEIVING( pContext ) )
+    {
+        LOG_WARN("%s: receive function exists\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    /* source address */
+    recvAddrLen = sizeof( struct sockaddr_in );
+    bzero(&recvAddr, recvAddrLen);
+
+    len = recvfrom(
+              pContext->fd,
+              pData,
+              size,
+              0,
+              (struct sockaddr *)(&recvAddr),
+              &recvAddrLen
+          );
+    if (len <= 0)
+    {
+        LOG_ERROR("fail to receive IPv4 UDP socket\n");
+        perror( "recvfrom" );
+        return len;
+    }
+
+    LOG_3(
+        "<- %s:%d\n",
+        inet_ntoa( recvAddr.sin_addr ),
+        ntohs( recvAddr.sin_port )
+    );
+    LOG_DUMP("IPv4 UDP recv", pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin_port,
+        (struct sockaddr *)&recvAddr,
+        pData,
+        len,
+        0
+    );
+
+    return len;
+}
+
+/**
+*  Get the IPv4 address of local host.
+*  @param [in]      pIfName    A string of network interface name.
+*  @param [in,out]  pIpv4Addr  A pointer of IPv4 address buffer.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv4GetAddr(char *pIfName, unsigned char *pIpv4Addr)
+{
+    struct ifaddrs *pIfAddrHdr = NULL;
+    struct ifaddrs *pIf = NULL;
+    tIfCacheInfo info;
+    unsigned int  sinAddr;
+    int found = 0;
+
+
+    memset(pIpv4Addr, 0x00, 4);
+
+    if (0 == comm_ifCacheGet(pIfName, &info))
+    {
+        if (0 == info.ipv4Num)
+        {
+            return -1;
+        }
+
+        memcpy(pIpv4Addr, info.ipv4Addr[0], 4);
+        LOG_2(
+            "IPv4 address of %s is %u.%u.%u.%u\n",
+            pIfName,
+            pIpv4Addr[0],
+            pIpv4Addr[1],
+            pIpv4Addr[2],
+            pIpv4Addr[3]
+        );
+        return 0;
+    }
+
+    /* an alias, or the cache is unavailable */
+    if (getifaddrs( &pIfAddrHdr ) < 0)
+    {
+        perror( "getifaddrs" );
+        return -1;
+    }
+
+    /*
+    *  Walk through linked list, maintaining head pointer so we
+    *  can free list later
+    */
+    for (pIf=pIfAddrHdr; pIf!=NULL; pIf=pIf->ifa_next)
+    {
+        if ((AF_INET == pIf->ifa_addr->sa_family) &&
+            (0 == strcmp(pIf->ifa_name, pIfName)))
+        {
+            sinAddr = ntohl( ((struct sockaddr_in *)pIf->ifa_addr)->sin_addr.s_addr );
+            pIpv4Addr[0] = ((sinAddr >> 24) & 0xFF);
+            pIpv4Addr[1] = ((sinAddr >> 16) & 0xFF);
+            pIpv4Addr[2] = ((sinAddr >>  8) & 0xFF);
+            pIpv4Addr[3] = ((sinAddr      ) & 0xFF);
+
+            LOG_2(
+                "IPv4 address of %s is %u.%u.%u.%u\n",
+                pIfName,
+                pIpv4Addr[0],
+                pIpv4Addr[1],
+                pIpv4Addr[2],
+                pIpv4Addr[3]
+            );
+
+            found = 1;
+            break;
+        }
+    }
+
+    freeifaddrs( pIfAddrHdr );
+
+    return ( found ) ? 0 : -1;
+}
+
+
+typedef struct _tUdpIpv6Context
+{
+    struct sockaddr_in6  localAddr;
+    int                  fd;
+
+    tUdpRecvCb           pRecvFunc;
+    tUdpBufCb            pBufFunc;
+    tUdpBatchCb          pBatchFunc;
+    tUdpBatch            batch;
+    tUdpGroCb            pGroFunc;
+    tUdpShardCb          pShardFunc;
+    int                  shard;  /* -1 is not sharded */
+    int                  reuseAddr;  /* the port is shared by group receivers */
+    struct _tUdpIpv6Context *pNext;  /* next shard */
+    size_t               recvSize;
+    tPcapTap             tap;
+    void                *pArg;
+    pthread_t            thread;
+    int                  running;
+    tReactorHandle       reactor;
+    tReactorEvent        event;
+} tUdpIpv6Context;
+
+/* pre-resolved destination of an IPv6 UDP handle */
+typedef struct _tUdpIpv6Dest
+{
+    tUdpIpv6Context    *pContext;
+    struct sockaddr_in6  addr;
+    char                ipStr[INET6_ADDRSTRLEN];
+    unsigned short      portNum;
+} tUdpIpv6Dest;
+
+
+/**
+*  Initialize an IPv6 UDP socket.
+*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  @returns  Success(0) or failure(-1).
+*/
+static int _udpIpv6InitSocket(tUdpIpv6Context *pContext)
+{
+    struct sockaddr_in6 bindAddr;
+    int bindAddrLen;
+    int reUsePort = 1;
+    int reUseAddr = 1;
+    int fd;
+
+
+    fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror( "socket" );
+        return -1;
+    }
+
+    /* the shards bind the same port, the kernel hashes flows to them */
+    if ((pContext->shard >= 0) &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &reUsePort, sizeof( reUsePort )) < 0))
+    {
+        perror( "setsockopt" );
+        close( fd );
+        return -1;
+    }
+
+    /* every receiver of a group on the host binds its port and gets a copy */
+    if (( pContext->reuseAddr ) &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reUseAddr, sizeof( reUseAddr )) < 0))
+    {
+        perror( "setsockopt" );
+        close( fd );
+        return -1;
+    }
+
+    /* local host address */
+    bindAddrLen = sizeof( struct sockaddr_in6 );
+    bindAddr = pContext->localAddr;
+
+    if (bind(fd, (struct sockaddr *)&bindAddr, bindAddrLen) < 0)
+    {
+        perror( "bind" );
+        close( fd );
+        return -1;
+    }
+
+    pContext->fd = fd;
+
+    LOG_2("IPv6 UDP socket is ready\n");
+    return 0;
+}
+
+/**
+*  Un-initialize an IPv6 UDP socket.
+*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*/
+static void _udpIpv6UninitSocket(tUdpIpv6Context *pContext)
+{
+    if (pContext->fd > 0)
+    {
+        close( pContext->fd );
+        pContext->fd = -1;
+    }
+
+    LOG_2("IPv6 UDP socket is closed\n");
+}
+
+/**
+*  Receive several messages and pass them to the IPv6 UDP batch callback.
+*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  @param [in]  flags     recvmmsg() flags.
+*  @returns  Number of messages (0 is no message, -1 is failed).
+*/
+static int _udpIpv6RecvBatch(tUdpIpv6Context *pContext, int flags)
+{
+    tUdpBatch *pBatch = &(pContext->batch);
+    int num;
+    int i;
+
+
+    LOG_3("IPv6 UDP ... recvmmsg\n");
+    num = _udpBatchRecv(pBatch, pContext->fd, pContext->recvSize, flags);
+    if (num <= 0)
+    {
+        if (num < 0)
+        {
+            LOG_ERROR("fail to receive IPv6 UDP socket\n");
+        }
+        return num;
+    }
+
+    LOG_3("<- %d IPv6 UDP messages\n", num);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv6 UDP recv", pBatch->pMsg[i].pData, pBatch->pMsg[i].size);
+        _udpTap(
+            &(pContext->tap),
+            PCAP_IN,
+            pContext->localAddr.sin6_port,
+            &(pBatch->pMsg[i].addr.sa),
+            pBatch->pMsg[i].pData,
+            pBatch->pMsg[i].size,
+            0
+        );
+    }
+
+    /* the callback owns the buffers */
+    pContext->pBatchFunc(pContext->pArg, pBatch->pMsg, num);
+    return num;
+}
+
+/**
+*  Receive coalesced segments and pass them to the IPv6 UDP GRO callback.
+*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  @param [in]  flags     recvmsg() flags.
+*  @returns  Message length (0 is no message, -1 is failed).
+*/
+static int _udpIpv6RecvGro(tUdpIpv6Context *pContext, int flags)
+{
+    struct sockaddr_in6 recvAddr;
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
+    size_t segSize;
+    ssize_t len;
+
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    LOG_3("IPv6 UDP ... recvmsg\n");
+    len = _udpGroRecv(
+              pContext->fd,
+              pBuf,
+              recvSize,
+              flags,
+              (struct sockaddr *)(&recvAddr),
+              sizeof( recvAddr ),
+              &segSize
+          );
+    if (len < 0)
+    {
+        comm_bufRelease( pBuf );
+        if (EAGAIN == errno)
+        {
+            return 0;
+        }
+        LOG_ERROR("fail to receive IPv6 UDP socket\n");
+        perror( "recvmsg" );
+        return -1;
+    }
+
+    LOG_3("<- %zd bytes of %zu bytes segments\n", len, segSize);
+    LOG_DUMP("IPv6 UDP recv", pBuf->pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin6_port,
+        (struct sockaddr *)&recvAddr,
+        pBuf->pData,
+        len,
+        segSize
+    );
+
+    /* the callback owns the buffer */
+    pBuf->size = len;
+    pContext->pGroFunc(pContext->pArg, pBuf, segSize, (struct sockaddr *)&recvAddr);
+    return len;
+}
+
+/**
+*  Receive a message and pass it to the IPv6 UDP receive callback.
+*  @param [in]  pContext  A @ref tUdpIpv6Context object.
+*  @param [in]  flags     recvfrom() flags.
+*  @returns  Message length (0 is no message, -1 is failed).
+*/
+static int _udpIpv6RecvMsg(tUdpIpv6Context *pContext, int flags)
+{
+    char ipv6Str[INET6_ADDRSTRLEN];
+    struct sockaddr_in6 recvAddr;
+    socklen_t recvAddrLen;
+    size_t recvSize = pContext->recvSize;
+    tCommBuf *pBuf;
+    int len;
+
+
+    if ( pContext->pBatchFunc )
+    {
+        return _udpIpv6RecvBatch(pContext, flags);
+    }
+
+    if ( pContext->pGroFunc )
+    {
+        return _udpIpv6RecvGro(pContext, flags);
+    }
+
+    pBuf = comm_bufAlloc( recvSize + 1 );
+    if (NULL == pBuf)
+    {
+        LOG_ERROR("fail to allocate receive buffer\n");
+        return -1;
+    }
+
+    /* source address */
+    recvAddrLen = sizeof( struct sockaddr_in6 );
+    bzero(&recvAddr, recvAddrLen);
+
+    LOG_3("IPv6 UDP ... recvfrom\n");
+    /* give the buffer back if the receiving thread is cancelled */
+    pthread_cleanup_push(comm_bufCleanup, pBuf);
+    len = recvfrom(
+              pContext->fd,
+              pBuf->pData,
+              recvSize,
+              flags,
+              (struct sockaddr *)(&recvAddr),
+              &recvAddrLen
+          );
+    pthread_cleanup_pop( 0 );
+    if (len <= 0)
+    {
+        if ((len < 0) && (EAGAIN == errno))
+        {
+            comm_bufRelease( pBuf );
+            return 0;
+        }
+        LOG_ERROR("fail to receive IPv6 UDP socket\n");
+        perror( "recvfrom" );
+        comm_bufRelease( pBuf );
+        return -1;
+    }
+
+    /*
+    * Convert IPv6 address from byte array to string:
+    *   const char *inet_ntop(
+    *                   int af,
+    *                   const void *src,
+    *                   char *dst,
+    *                   socklen_t size
+    *               );
+    */
+    inet_ntop(
+        AF_INET6,
+        &(recvAddr.sin6_addr),
+        ipv6Str,
+        INET6_ADDRSTRLEN
+    );
+
+    LOG_3(
+        "<- %s:%d\n",
+        ipv6Str,
+        ntohs( recvAddr.sin6_port )
+    );
+    LOG_DUMP("IPv6 UDP recv", pBuf->pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin6_port,
+        (struct sockaddr *)&recvAddr,
+        pBuf->pData,
+        len,
+        0
+    );
+
+    if ( pContext->pShardFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pShardFunc(
+            pContext->pArg,
+            pContext->shard,
+            pBuf,
+            (struct sockaddr *)&recvAddr
+        );
+        return len;
+    }
+
+    if ( pContext->pBufFunc )
+    {
+        /* the callback owns the buffer */
+        pBuf->size = len;
+        pContext->pBufFunc(pContext->pArg, pBuf, (struct sockaddr *)&recvAddr);
+        return len;
+    }
+
+    if ( pContext->pRecvFunc )
+    {
+        pContext->pRecvFunc(
+            pContext->pArg,
+            pBuf->pData,
+            len,
+            (struct sockaddr *)&recvAddr
+        );
+    }
+
+    comm_bufRelease( pBuf );
+    return len;
+}
+
+/**
+*  Thread function for the IPv6 UDP socket receiving.
+*  @param [in]  pArg  A @ref tUdpIpv6Context object.
+*/
+static void *_udpIpv6RecvTask(void *pArg)
+{
+    tUdpIpv6Context *pContext = pArg;
+
+
+    pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
+    LOG_2("start the thread: %s\n", __func__);
+
+    while ( pContext->running )
+    {
+        pthread_testcancel();
+        if (_udpIpv6RecvMsg(pContext, 0) < 0)
+        {
+            break;
+        }
+        pthread_testcancel();
+    }
+
+    LOG_2("stop the thread: %s\n", __func__);
+    pContext->running = 0;
+
+    pthread_exit(NULL);
+}
+
+/**
+*  Reactor event function for the IPv6 UDP socket receiving.
+*  @param [in]  pArg    A @ref tUdpIpv6Context object.
+*  @param [in]  events  Reactor events.
+*/
+static void _udpIpv6RecvEvent(void *pArg, unsigned int events)
+{
+    tUdpIpv6Context *pContext = pArg;
+
+    if (_udpIpv6RecvMsg(pContext, MSG_DONTWAIT) < 0)
+    {
+        comm_reactorDelEvent( &(pContext->event) );
+        pContext->running = 0;
+    }
+}
+
+/**
+*  Initialize IPv6 UDP socket.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  pRecvFunc   Application's receive callback function.
+*  @param [in]  pBufFunc    Application's buffer callback function.
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  batchNum    Max. messages of one batch callback.
+*  @param [in]  pGroFunc    Application's GRO callback function.
+*  @param [in]  pShardFunc  Application's shard callback function.
+*  @param [in]  shard       Shard ID (-1 is not sharded).
+*  @param [in]  reuseAddr   Share the port with other group receivers(1) or not(0).
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+static tUdpIpv6Handle _udpIpv6Open(
+    unsigned short  portNum,
+    tUdpRecvCb      pRecvFunc,
+    tUdpBufCb       pBufFunc,
+    tUdpBatchCb     pBatchFunc,
+    int             batchNum,
+    tUdpGroCb       pGroFunc,
+    tUdpShardCb     pShardFunc,
+    int             shard,
+    int             reuseAddr,
+    void           *pArg
+)
+{
+    tUdpIpv6Context *pContext = NULL;
+    int gro = 1;
+    pthread_attr_t tattr;
+    int error;
+
+
+    pContext = malloc( sizeof( tUdpIpv6Context ) );
+    if (NULL == pContext)
+    {
+        LOG_ERROR("fail to allocate IPv6 UDP context\n");
+        return 0;
+    }
+
+    memset(pContext, 0x00, sizeof( tUdpIpv6Context ));
+    pContext->localAddr.sin6_family = AF_INET6;
+    pContext->localAddr.sin6_port   = htons( portNum );
+    pContext->localAddr.sin6_addr   = in6addr_any;
+    pContext->pRecvFunc = pRecvFunc;
+    pContext->pBufFunc = pBufFunc;
+    pContext->pBatchFunc = pBatchFunc;
+    pContext->pGroFunc = pGroFunc;
+    pContext->pShardFunc = pShardFunc;
+    pContext->shard = shard;
+    pContext->reuseAddr = reuseAddr;
+    pContext->pArg = pArg;
+    pContext->recvSize = ( pGroFunc ) ? UDP_GRO_RECV_SIZE : COMM_BUF_SIZE;
+    pContext->fd = -1;
+
+    error = _udpIpv6InitSocket( pContext );
+    if (error != 0)
+    {
+        LOG_ERROR("fail to create IPv6 UDP socket\n");
+        free( pContext );
+        return 0;
+    }
+
+    if (( pBatchFunc ) && (_udpBatchInit(&(pContext->batch), batchNum) != 0))
+    {
+        _udpIpv6UninitSocket( pContext );
+        free( pContext );
+        return 0;
+    }
+
+    if ( pGroFunc )
+    {
+        /* the kernel passes the coalesced segments as one buffer */
+        if (setsockopt(pContext->fd, SOL_UDP, UDP_GRO, &gro, sizeof( gro )) < 0)
+        {
+            perror( "setsockopt" );
+            _udpIpv6UninitSocket( pContext );
+            _udpBatchUninit( &(pContext->batch) );
+            free( pContext );
+            return 0;
+        }
+    }
+
+    if ( !UDP_RECEIVING( pContext ) )
+    {
+        LOG_1("ignore IPv6 UDP receive function\n");
+        goto _IPV6_DONE;
+    }
+
+    pContext->running = 1;
+
+    /* a shard keeps its own thread pinned to one CPU, not a reactor thread */
+    if (( g_reactor ) && (shard < 0))
+    {
+        /* served by the shared reactor threads */
+        error = comm_reactorAddEvent(
+                    g_reactor,
+                    &(pContext->event),
+                    pContext->fd,
+                    EPOLLIN,
+                    _udpIpv6RecvEvent,
+                    pContext
+                );
+        if (error != 0)
+        {
+            LOG_ERROR("fail to attach IPv6 UDP to reactor\n");
+            _udpIpv6UninitSocket( pContext );
+            _udpBatchUninit( &(pContext->batch) );
+            free( pContext );
+            return 0;
+        }
+
+        pContext->reactor = g_reactor;
+        goto _IPV6_DONE;
+    }
+
+    pthread_attr_init( &tattr );
+    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+
+    error = pthread_create(
+                &(pContext->thread),
+                &tattr,
+                _udpIpv6RecvTask,
+                pContext
+            );
+    if (error != 0)
+    {
+        LOG_ERROR("fail to create IPv6 UDP receiving thread\n");
+        _udpIpv6UninitSocket( pContext );
+        _udpBatchUninit( &(pContext->batch) );
+        free( pContext );
+        return 0;
+    }
+
+    pthread_attr_destroy( &tattr );
+
+    if (shard >= 0)
+    {
+        comm_cpuPin(pContext->thread, shard);
+    }
+
+_IPV6_DONE:
+    LOG_1("IPv6 UDP initialized\n");
+    return ((tUdpIpv6Handle)pContext);
+}
+
+/**
+*  Initialize IPv6 UDP socket.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pRecvFunc  Application's receive callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6Init(
+    unsigned short  portNum,
+    tUdpRecvCb      pRecvFunc,
+    void           *pArg
+)
+{
+    return _udpIpv6Open(portNum, pRecvFunc, NULL, NULL, 0, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv6 UDP socket with zero-copy buffers.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6InitBuf(
+    unsigned short  portNum,
+    tUdpBufCb       pBufFunc,
+    void           *pArg
+)
+{
+    return _udpIpv6Open(portNum, NULL, pBufFunc, NULL, 0, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv6 UDP socket of a multicast receiver with zero-copy
+*  buffers. The port is bound with SO_REUSEADDR, so the other receivers
+*  of the group on the host bind it too, and each one that joins by
+*  @ref comm_udpIpv6JoinGroup gets a copy of the group's datagrams. A
+*  unicast datagram to the port goes to one of them only.
+*  @param [in]  portNum    Local UDP port number.
+*  @param [in]  pBufFunc   Application's buffer callback function.
+*  @param [in]  pArg       Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6InitGroup(
+    unsigned short  portNum,
+    tUdpBufCb       pBufFunc,
+    void           *pArg
+)
+{
+    return _udpIpv6Open(portNum, NULL, pBufFunc, NULL, 0, NULL, NULL, -1, 1, pArg);
+}
+
+/**
+*  Initialize IPv6 UDP socket with batch receiving. Up to batchNum
+*  queued datagrams are received by one recvmmsg() and passed to one
+*  callback.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  batchNum    Max. messages of one callback (0 is COMM_UDP_BATCH_NUM).
+*  @param [in]  pBatchFunc  Application's batch callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6InitBatch(
+    unsigned short  portNum,
+    int             batchNum,
+    tUdpBatchCb     pBatchFunc,
+    void           *pArg
+)
+{
+    if (NULL == pBatchFunc)
+    {
+        LOG_ERROR("%s: pBatchFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    if (0 == batchNum)
+    {
+        batchNum = COMM_UDP_BATCH_NUM;
+    }
+
+    if ((batchNum < 0) || (batchNum > UDP_BATCH_MAX))
+    {
+        LOG_ERROR("%s: wrong batch number %d\n", __func__, batchNum);
+        return 0;
+    }
+
+    return _udpIpv6Open(portNum, NULL, NULL, pBatchFunc, batchNum, NULL, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv6 UDP socket with GRO receiving. The kernel coalesces
+*  the datagrams of one flow, and the callback gets them as one buffer
+*  with the segment size (the last segment may be shorter).
+*  @param [in]  portNum   Local UDP port number.
+*  @param [in]  pGroFunc  Application's GRO callback function.
+*  @param [in]  pArg      Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6InitGro(
+    unsigned short  portNum,
+    tUdpGroCb       pGroFunc,
+    void           *pArg
+)
+{
+    if (NULL == pGroFunc)
+    {
+        LOG_ERROR("%s: pGroFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    return _udpIpv6Open(portNum, NULL, NULL, NULL, 0, pGroFunc, NULL, -1, 0, pArg);
+}
+
+/**
+*  Initialize IPv6 UDP sockets sharded by SO_REUSEPORT. Every shard binds
+*  the same port and has its own receiving thread pinned to one CPU, the
+*  kernel spreads the flows to the shards by hashing. A shard's callbacks
+*  run on its own thread only, so the per-shard state needs no lock. The
+*  shards do not use the reactor, and the handle sends by shard 0.
+*  @param [in]  portNum     Local UDP port number.
+*  @param [in]  shardNum    Number of shards (0 is one per CPU).
+*  @param [in]  pShardFunc  Application's shard callback function.
+*  @param [in]  pArg        Application's argument.
+*  @returns  IPv6 UDP handle.
+*/
+tUdpIpv6Handle comm_udpIpv6InitSharded(
+    unsigned short  portNum,
+    int             shardNum,
+    tUdpShardCb     pShardFunc,
+    void           *pArg
+)
+{
+    tUdpIpv6Context *pFirst;
+    tUdpIpv6Context *pLast;
+    tUdpIpv6Context *pContext;
+    struct sockaddr_in6 localAddr;
+    socklen_t localAddrLen;
+    int i;
+
+
+    if (NULL == pShardFunc)
+    {
+        LOG_ERROR("%s: pShardFunc is NULL\n", __func__);
+        return 0;
+    }
+
+    if (0 == shardNum)
+    {
+        shardNum = comm_cpuNum( UDP_SHARD_MAX );
+    }
+
+    if ((shardNum < 0) || (shardNum > UDP_SHARD_MAX))
+    {
+        LOG_ERROR("%s: wrong shard number %d\n", __func__, shardNum);
+        return 0;
+    }
+
+    pFirst = (tUdpIpv6Context *)_udpIpv6Open(
+                 portNum, NULL, NULL, NULL, 0, NULL, pShardFunc, 0, 0, pArg
+             );
+    if (NULL == pFirst)
+    {
+        return 0;
+    }
+
+    if (0 == portNum)
+    {
+        /* the other shards join the port picked for the first one */
+        localAddrLen = sizeof( localAddr );
+        if (getsockname(pFirst->fd, (struct sockaddr *)&localAddr, &localAddrLen) < 0)
+        {
+            perror( "getsockname" );
+            comm_udpIpv6Uninit( (tUdpIpv6Handle)pFirst );
+            return 0;
+        }
+        portNum = ntohs( localAddr.sin6_port );
+    }
+
+    pLast = pFirst;
+    for (i=1; i<shardNum; i++)
+    {
+        pContext = (tUdpIpv6Context *)_udpIpv6Open(
+                       portNum, NULL, NULL, NULL, 0, NULL, pShardFunc, i, 0, pArg
+                   );
+        if (NULL == pContext)
+        {
+            LOG_ERROR("fail to open IPv6 UDP shard %d\n", i);
+            comm_udpIpv6Uninit( (tUdpIpv6Handle)pFirst );
+            return 0;
+        }
+
+        pLast->pNext = pContext;
+        pLast = pContext;
+    }
+
+    LOG_1("IPv6 UDP port %d has %d shards\n", portNum, shardNum);
+    return ((tUdpIpv6Handle)pFirst);
+}
+
+/**
+*  Release an IPv6 UDP socket when it is no more received.
+*  @param [in]  pArg  A @ref tUdpIpv6Context object.
+*/
+static void _udpIpv6Release(void *pArg)
+{
+    tUdpIpv6Context *pContext = pArg;
+
+    _udpIpv6UninitSocket( pContext );
+    _udpBatchUninit( &(pContext->batch) );
+    free( pContext );
+    LOG_1("IPv6 UDP un-initialized\n");
+}
+
+/**
+*  Un-initialize IPv6 UDP library.
+*  @param [in]  handle  IPv6 UDP handle.
+*/
+void comm_udpIpv6Uninit(tUdpIpv6Handle handle)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    tUdpIpv6Context *pNext;
+
+    /* a sharded handle closes all of its shards */
+    while ( pContext )
+    {
+        pNext = pContext->pNext;
+
+        pContext->running = 0;
+
+        if ( pContext->reactor )
+        {
+            comm_reactorDelEventFree(&(pContext->event), _udpIpv6Release, pContext);
+        }
+        else
+        {
+            if ( UDP_RECEIVING( pContext ) )
+            {
+                pthread_cancel( pContext->thread );
+                pthread_join(pContext->thread, NULL);
+            }
+            _udpIpv6Release( pContext );
+        }
+
+        pContext = pNext;
+    }
+}
+
+/**
+*  Set the receive size of the IPv6 UDP socket.
+*  @param [in]  handle  IPv6 UDP handle.
+*  @param [in]  size    Max. message size of one receive.
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6SetRecvSize(tUdpIpv6Handle handle, size_t size)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if ((0 == size) || (size > INT_MAX))
+    {
+        LOG_WARN("%s: wrong size %zu\n", __func__, size);
+        return -1;
+    }
+
+    if ((pContext->pRecvFunc) && (size > USHRT_MAX))
+    {
+        /* the receive callback can not take more than 64 KB */
+        LOG_WARN("%s: size %zu needs the buffer callback\n", __func__, size);
+        return -1;
+    }
+
+    pContext->recvSize = size;
+    return 0;
+}
+
+/**
+*  Join a multicast group on the IPv6 UDP socket, from any source or from
+*  one source only. All the shards of a sharded handle join. The other
+*  handles bind their port alone, so the receivers of a group that share
+*  the port on the host are initialized by @ref comm_udpIpv6InitGroup.
+*  @param [in]  handle      IPv6 UDP handle.
+*  @param [in]  pGroupStr   Multicast group address string.
+*  @param [in]  pSourceStr  Source address string (NULL is any source).
+*  @param [in]  pIfName     Interface name (NULL is chosen by the kernel).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6JoinGroup(
+    tUdpIpv6Handle  handle,
+    char           *pGroupStr,
+    char           *pSourceStr,
+    char           *pIfName
+)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMembership(pContext->fd, AF_INET6, 1, pGroupStr, pSourceStr, pIfName) != 0)
+        {
+            LOG_ERROR("fail to join IPv6 multicast group %s\n", pGroupStr);
+            return -1;
+        }
+    }
+
+    LOG_1("IPv6 UDP joined %s\n", pGroupStr);
+    return 0;
+}
+
+/**
+*  Leave a multicast group on the IPv6 UDP socket.
+*  @param [in]  handle      IPv6 UDP handle.
+*  @param [in]  pGroupStr   Multicast group address string.
+*  @param [in]  pSourceStr  Source address string (NULL is any source).
+*  @param [in]  pIfName     Interface name (NULL is chosen by the kernel).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6LeaveGroup(
+    tUdpIpv6Handle  handle,
+    char           *pGroupStr,
+    char           *pSourceStr,
+    char           *pIfName
+)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    int error = 0;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMembership(pContext->fd, AF_INET6, 0, pGroupStr, pSourceStr, pIfName) != 0)
+        {
+            LOG_ERROR("fail to leave IPv6 multicast group %s\n", pGroupStr);
+            error = -1;
+        }
+    }
+
+    return error;
+}
+
+/**
+*  Set the multicast sending options of the IPv6 UDP socket.
+*  @param [in]  handle   IPv6 UDP handle.
+*  @param [in]  ttl      Multicast hop limit (-1 is unchanged).
+*  @param [in]  loop     Loop back to the local host(1) or not(0) (-1 is unchanged).
+*  @param [in]  pIfName  Outgoing interface name (NULL is unchanged).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6SetMulticast(
+    tUdpIpv6Handle  handle,
+    int             ttl,
+    int             loop,
+    char           *pIfName
+)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (ttl > 255)
+    {
+        LOG_WARN("%s: wrong TTL %d\n", __func__, ttl);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (_udpMulticastOpt(pContext->fd, AF_INET6, ttl, loop, pIfName) != 0)
+        {
+            LOG_ERROR("fail to set IPv6 multicast options\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Attach a filter to the IPv6 UDP socket, so that the datagrams it
+*  rejects are dropped in the kernel. See @ref comm_bpfCompile for the
+*  expression, e.g. "src net 10.0.0.0/8 and not src port 53". All the
+*  shards of a sharded handle get the filter.
+*  @param [in]  handle  IPv6 UDP handle.
+*  @param [in]  pExpr   Filter expression (NULL or empty removes the filter).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6SetFilter(tUdpIpv6Handle handle, char *pExpr)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        if (comm_bpfAttach(pContext->fd, pExpr, BPF_LINK_UDP6) != 0)
+        {
+            LOG_ERROR("fail to set IPv6 UDP filter\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+*  Tap the IPv6 UDP socket, so that the datagrams it sends and receives
+*  are copied to a pcapng capture with synthesized IPv6 and UDP headers.
+*  All the shards of a sharded handle are one interface of the capture.
+*  @param [in]  handle  IPv6 UDP handle.
+*  @param [in]  pcap    Capture handle (0 removes the tap).
+*  @returns  Success(0) or failure(-1).
+*/
+int comm_udpIpv6SetTap(tUdpIpv6Handle handle, tPcapHandle pcap)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    struct sockaddr_in6 localAddr;
+    socklen_t localAddrLen;
+    tPcapIf *pIf = NULL;
+    char name[PCAP_IF_NAME_SIZE];
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    /* the port the kernel picked for port 0 */
+    localAddrLen = sizeof( localAddr );
+    if (getsockname(pContext->fd, (struct sockaddr *)&localAddr, &localAddrLen) < 0)
+    {
+        perror( "getsockname" );
+        return -1;
+    }
+
+    if ( pcap )
+    {
+        snprintf(name, sizeof( name ), "udp6:%d", ntohs( localAddr.sin6_port ));
+        pIf = comm_pcapAddIf(pcap, PCAP_LINK_RAW, name, pContext);
+        if (NULL == pIf)
+        {
+            return -1;
+        }
+    }
+
+    for (; pContext; pContext=pContext->pNext)
+    {
+        pContext->localAddr.sin6_port = localAddr.sin6_port;
+        comm_pcapSetTap(&(pContext->tap), pIf);
+    }
+
+    return 0;
+}
+
+/**
+*  Send message by the IPv6 UDP socket.
+*  @param [in]  handle   IPv6 UDP handle.
+*  @param [in]  pIpStr   A string of an IPv6 address.
+*  @param [in]  portNum  UDP port number.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @returns  Message length (-1 is failed).
+*/
+int comm_udpIpv6Send(
+    tUdpIpv6Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    unsigned char  *pData,
+    unsigned short  size
+)
+{
+    return comm_udpIpv6SendEx(handle, pIpStr, portNum, pData, size);
+}
+
+/**
+*  Send message by the IPv6 UDP socket.
+*  @param [in]  handle   IPv6 UDP handle.
+*  @param [in]  pIpStr   A string of an IPv6 address.
+*  @param [in]  portNum  UDP port number.
+*  @param [in]  pData    A pointer of data buffer.
+*  @param [in]  size     Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv6SendEx(
+    tUdpIpv6Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum,
+    unsigned char  *pData,
+    size_t          size
+)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    struct sockaddr_in6 sendAddr;
+    int sendAddrLen;
+    ssize_t error;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
+
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s:%d\n", pIpStr, portNum);
+    LOG_DUMP("IPv6 UDP send", pData, size);
+
+    /*
+    * Convert IPv6 address from string to byte array:
+    *   int inet_pton(int af, const char *src, void *dst);
+    */
+
+    sendAddrLen = sizeof( struct sockaddr_in6 );
+    bzero(&sendAddr, sendAddrLen);
+    sendAddr.sin6_family = AF_INET6;
+    sendAddr.sin6_port   = htons( portNum );
+    inet_pton(AF_INET6, pIpStr, &sendAddr.sin6_addr);
+
+    error = sendto(
+                pContext->fd,
+                pData,
+                size,
+                0,
+                (struct sockaddr *)(&sendAddr),
+                sendAddrLen
             );
-        }
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv6 UDP socket\n");
+        perror( "sendto" );
+        return error;
     }
 
-    LOG_2("stop the thread: %s\n", __func__);
-    pContext->running = 0;
-
-    pthread_exit(NULL);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_OUT,
+        pContext->localAddr.sin6_port,
+        (struct sockaddr *)(&sendAddr),
+        pData,
+        error,
+        0
+    );
+    return error;
 }
 
 /**
-*  Initialize IPv6 UDP socket.
-*  @param [in]  portNum    Local UDP port number.
-*  @param [in]  pRecvFunc  Application's receive callback function.
-*  @param [in]  pArg       Application's argument.
-*  @returns  IPv6 UDP handle.
+*  Send one message of several buffers by the IPv6 UDP socket.
+*  @param [in]  handle   IPv6 UDP handle.
+*  @param [in]  pIpStr   Destination IPv6 address string.
+*  @param [in]  portNum  Destination port number.
+*  @param [in]  pIov     Data buffers.
+*  @param [in]  num      Number of data buffers.
+*  @returns  Message length (-1 is failed).
 */
-tUdpIpv6Handle comm_udpIpv6Init(
+ssize_t comm_udpIpv6Sendv(
+    tUdpIpv6Handle  handle,
+    char           *pIpStr,
     unsigned short  portNum,
-    tUdpRecvCb      pRecvFunc,
-    void           *pArg
+    struct iovec   *pIov,
+    int             num
 )
 {
-    tUdpIpv6Context *pContext = NULL;
-    pthread_attr_t tattr;
-    int error;
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    struct sockaddr_in6 sendAddr;
+    int sendAddrLen;
+    struct msghdr msg;
+    ssize_t error;
+    tPcapTap *pTap;
+    int i;
 
 
-    pContext = malloc( sizeof( tUdpIpv6Context ) );
     if (NULL == pContext)
     {
-        LOG_ERROR("fail to allocate IPv6 UDP context\n");
-        return 0;
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
     }
 
-    memset(pContext, 0x00, sizeof( tUdpIpv6Context ));
-    pContext->localAddr.sin6_family = AF_INET6;
-    pContext->localAddr.sin6_port   = htons( portNum );
-    pContext->localAddr.sin6_addr   = in6addr_any;
-    pContext->pRecvFunc = pRecvFunc;
-    pContext->pArg = pArg;
-    pContext->fd = -1;
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
 
-    error = _udpIpv6InitSocket( pContext );
-    if (error != 0)
+    if (NULL == pIov)
     {
-        LOG_ERROR("fail to create IPv6 UDP socket\n");
-        free( pContext );
-        return 0;
+        LOG_WARN("%s: pIov is NULL\n", __func__);
+        return -1;
     }
 
-    if (NULL == pRecvFunc)
+    if (num <= 0)
     {
-        LOG_1("ignore IPv6 UDP receive function\n");
-        goto _IPV6_DONE;
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
     }
 
-    pContext->running = 1;
+    LOG_3("-> %s:%d\n", pIpStr, portNum);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv6 UDP send", pIov[i].iov_base, pIov[i].iov_len);
+    }
 
-    pthread_attr_init( &tattr );
-    pthread_attr_setdetachstate(&tattr, PTHREAD_CREATE_JOINABLE);
+    /*
+    * Convert IPv6 address from string to byte array:
+    *   int inet_pton(int af, const char *src, void *dst);
+    */
 
-    error = pthread_create(
-                &(pContext->thread),
-                &tattr,
-                _udpIpv6RecvTask,
-                pContext
-            );
-    if (error != 0)
+    sendAddrLen = sizeof( struct sockaddr_in6 );
+    bzero(&sendAddr, sendAddrLen);
+    sendAddr.sin6_family = AF_INET6;
+    sendAddr.sin6_port   = htons( portNum );
+    inet_pton(AF_INET6, pIpStr, &sendAddr.sin6_addr);
+
+    /* one datagram is never interleaved with the other senders */
+    memset(&msg, 0x00, sizeof( struct msghdr ));
+    msg.msg_name    = &sendAddr;
+    msg.msg_namelen = sendAddrLen;
+    msg.msg_iov     = pIov;
+    msg.msg_iovlen  = num;
+
+    error = sendmsg(pContext->fd, &msg, 0);
+    if (error < 0)
     {
-        LOG_ERROR("fail to create IPv6 UDP receiving thread\n");
-        _udpIpv6UninitSocket( pContext );
-        free( pContext );
-        return 0;
+        LOG_ERROR("fail to send IPv6 UDP socket\n");
+        perror( "sendmsg" );
+        return error;
     }
 
-    pthread_attr_destroy( &tattr );
-
-_IPV6_DONE:
-    LOG_1("IPv6 UDP initialized\n");
-    return ((tUdpIpv6Handle)pContext);
+    pTap = &(pContext->tap);
+    if ( comm_pcapTapped( pTap ) )
+    {
+        comm_pcapWriteUdp(
+            pTap,
+            PCAP_OUT,
+            ntohs( pContext->localAddr.sin6_port ),
+            (struct sockaddr *)(&sendAddr),
+            pIov,
+            num
+        );
+    }
+    return error;
 }
 
 /**
-*  Un-initialize IPv6 UDP library.
+*  Send several messages by the IPv6 UDP socket with sendmmsg().
 *  @param [in]  handle  IPv6 UDP handle.
+*  @param [in]  pMsg    Messages, each with its destination in addr.ipv6.
+*  @param [in]  num     Number of messages.
+*  @returns  Number of sent messages (-1 is failed).
 */
-void comm_udpIpv6Uninit(tUdpIpv6Handle handle)
+int comm_udpIpv6SendBatch(tUdpIpv6Handle handle, tUdpMsg *pMsg, int num)
 {
     tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    int sent;
+    int i;
 
-    if ( pContext )
+
+    if (NULL == pContext)
     {
-        if ( pContext->pRecvFunc )
-        {
-            pthread_cancel( pContext->thread );
-        }
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return -1;
+    }
 
-        pContext->running = 0;
-        _udpIpv6UninitSocket( pContext );
+    if (pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
 
-        if ( pContext->pRecvFunc )
-        {
-            pthread_join(pContext->thread, NULL);
-        }
+    if (NULL == pMsg)
+    {
+        LOG_WARN("%s: pMsg is NULL\n", __func__);
+        return -1;
+    }
 
-        free( pContext );
-        LOG_1("IPv6 UDP un-initialized\n");
+    if (num <= 0)
+    {
+        LOG_WARN("%s: num is %d\n", __func__, num);
+        return -1;
+    }
+
+    LOG_3("-> %d IPv6 UDP messages\n", num);
+    for (i=0; i<num; i++)
+    {
+        LOG_DUMP("IPv6 UDP send", pMsg[i].pData, pMsg[i].size);
+    }
+
+    sent = _udpBatchSend(
+               pContext->fd,
+               pMsg,
+               num,
+               sizeof( struct sockaddr_in6 )
+           );
+
+    for (i=0; i<sent; i++)
+    {
+        _udpTap(
+            &(pContext->tap),
+            PCAP_OUT,
+            pContext->localAddr.sin6_port,
+            &(pMsg[i].addr.sa),
+            pMsg[i].pData,
+            pMsg[i].size,
+            0
+        );
     }
+
+    return sent;
 }
 
 /**
-*  Send message by the IPv6 UDP socket.
+*  Send a buffer as equal-sized datagrams by the IPv6 UDP socket with
+*  one system call (UDP GSO). The buffer is up to 64 KB (one IP packet)
+*  and 64 segments, a larger one fails without sending.
 *  @param [in]  handle   IPv6 UDP handle.
-*  @param [in]  pIpStr   A string of an IPv6 address.
-*  @param [in]  portNum  UDP port number.
+*  @param [in]  pIpStr   Destination IPv6 address string.
+*  @param [in]  portNum  Destination port number.
 *  @param [in]  pData    A pointer of data buffer.
 *  @param [in]  size     Data size.
+*  @param [in]  segSize  Segment size, the last segment may be shorter.
 *  @returns  Message length (-1 is failed).
 */
-int comm_udpIpv6Send(
+ssize_t comm_udpIpv6SendGso(
     tUdpIpv6Handle  handle,
     char           *pIpStr,
     unsigned short  portNum,
     unsigned char  *pData,
-    unsigned short  size
+    size_t          size,
+    size_t          segSize
 )
 {
     tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
     struct sockaddr_in6 sendAddr;
     int sendAddrLen;
-    int error;
+    ssize_t error;
 
 
     if (NULL == pContext)
@@ -749,7 +3684,12 @@ int comm_udpIpv6Send(
         return -1;
     }
 
-    LOG_3("-> %s:%d\n", pIpStr, portNum);
+    if (_udpGsoCheck(__func__, size, segSize, UDP_IPV6_GSO_MAX_SIZE) != 0)
+    {
+        return -1;
+    }
+
+    LOG_3("-> %s:%d (%zu bytes segments)\n", pIpStr, portNum, segSize);
     LOG_DUMP("IPv6 UDP send", pData, size);
 
     /*
@@ -763,20 +3703,180 @@ int comm_udpIpv6Send(
     sendAddr.sin6_port   = htons( portNum );
     inet_pton(AF_INET6, pIpStr, &sendAddr.sin6_addr);
 
-    error = sendto(
+    error = _udpGsoSend(
                 pContext->fd,
+                (struct sockaddr *)(&sendAddr),
+                sendAddrLen,
+                pData,
+                size,
+                segSize
+            );
+    if (error < 0)
+    {
+        LOG_ERROR("fail to send IPv6 UDP socket\n");
+        perror( "sendmsg" );
+        return error;
+    }
+
+    _udpTap(
+        &(pContext->tap),
+        PCAP_OUT,
+        pContext->localAddr.sin6_port,
+        (struct sockaddr *)(&sendAddr),
+        pData,
+        error,
+        segSize
+    );
+    return error;
+}
+
+/**
+*  Open a pre-resolved destination of the IPv6 UDP handle. The address is
+*  parsed once, and @ref comm_udpIpv6SendTo sends without parsing. A
+*  destination sends by the handle's socket, from its bound port, so the
+*  replies are received by the handle. A connected socket of its own would
+*  send from another port, or take the replies if it shared the bound one.
+*  Close the destinations before un-initializing the handle.
+*  @param [in]  handle   IPv6 UDP handle.
+*  @param [in]  pIpStr   Destination IPv6 address string.
+*  @param [in]  portNum  Destination port number.
+*  @returns  IPv6 UDP destination handle.
+*/
+tUdpIpv6DestHandle comm_udpIpv6OpenDest(
+    tUdpIpv6Handle  handle,
+    char           *pIpStr,
+    unsigned short  portNum
+)
+{
+    tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
+    tUdpIpv6Dest *pDest;
+
+
+    if (NULL == pContext)
+    {
+        LOG_ERROR("%s: pContext is NULL\n", __func__);
+        return 0;
+    }
+
+    if (NULL == pIpStr)
+    {
+        LOG_ERROR("%s: pIpStr is NULL\n", __func__);
+        return 0;
+    }
+
+    pDest = malloc( sizeof( tUdpIpv6Dest ) );
+    if (NULL == pDest)
+    {
+        LOG_ERROR("fail to allocate IPv6 UDP destination\n");
+        return 0;
+    }
+
+    memset(pDest, 0x00, sizeof( tUdpIpv6Dest ));
+    pDest->pContext = pContext;
+    pDest->portNum = portNum;
+    snprintf(pDest->ipStr, INET6_ADDRSTRLEN, "%s", pIpStr);
+
+    /*
+    * Convert IPv6 address from string to byte array:
+    *   int inet_pton(int af, const char *src, void *dst);
+    */
+
+    pDest->addr.sin6_family = AF_INET6;
+    pDest->addr.sin6_port   = htons( portNum );
+    if (inet_pton(AF_INET6, pIpStr, &(pDest->addr.sin6_addr)) != 1)
+    {
+        LOG_ERROR("%s: wrong IPv6 address %s\n", __func__, pIpStr);
+        free( pDest );
+        return 0;
+    }
+
+    LOG_1("IPv6 UDP destination %s:%d opened\n", pIpStr, portNum);
+    return ((tUdpIpv6DestHandle)pDest);
+}
+
+/**
+*  Close a destination of the IPv6 UDP handle.
+*  @param [in]  dest  IPv6 UDP destination handle.
+*/
+void comm_udpIpv6CloseDest(tUdpIpv6DestHandle dest)
+{
+    tUdpIpv6Dest *pDest = (tUdpIpv6Dest *)dest;
+
+    if ( pDest )
+    {
+        free( pDest );
+        LOG_1("IPv6 UDP destination closed\n");
+    }
+}
+
+/**
+*  Send a message to a destination of the IPv6 UDP handle.
+*  @param [in]  dest   IPv6 UDP destination handle.
+*  @param [in]  pData  A pointer of data buffer.
+*  @param [in]  size   Data size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv6SendTo(
+    tUdpIpv6DestHandle  dest,
+    unsigned char      *pData,
+    size_t              size
+)
+{
+    tUdpIpv6Dest *pDest = (tUdpIpv6Dest *)dest;
+    ssize_t error;
+
+
+    if (NULL == pDest)
+    {
+        LOG_ERROR("%s: pDest is NULL\n", __func__);
+        return -1;
+    }
+
+    if (NULL == pData)
+    {
+        LOG_WARN("%s: pData is NULL\n", __func__);
+        return -1;
+    }
+
+    if (0 == size)
+    {
+        LOG_WARN("%s: size is 0\n", __func__);
+        return -1;
+    }
+
+    LOG_3("-> %s:%d\n", pDest->ipStr, pDest->portNum);
+    LOG_DUMP("IPv6 UDP send", pData, size);
+
+    if (pDest->pContext->fd < 0)
+    {
+        LOG_ERROR("%s: UDP socket is not ready\n", __func__);
+        return -1;
+    }
+
+    error = sendto(
+                pDest->pContext->fd,
                 pData,
                 size,
                 0,
-                (struct sockaddr *)(&sendAddr),
-                sendAddrLen
+                (struct sockaddr *)&(pDest->addr),
+                sizeof( pDest->addr )
             );
     if (error < 0)
     {
         LOG_ERROR("fail to send IPv6 UDP socket\n");
         perror( "sendto" );
+        return error;
     }
 
+    _udpTap(
+        &(pDest->pContext->tap),
+        PCAP_OUT,
+        pDest->pContext->localAddr.sin6_port,
+        (struct sockaddr *)&(pDest->addr),
+        pData,
+        error,
+        0
+    );
     return error;
 }
 
@@ -792,12 +3892,28 @@ int comm_udpIpv6Recv(
     unsigned char  *pData,
     unsigned short  size
 )
+{
+    return comm_udpIpv6RecvEx(handle, pData, size);
+}
+
+/**
+*  Receive message by the IPv6 UDP socket.
+*  @param [in]  handle  IPv6 UDP handle.
+*  @param [in]  pData   A pointer of data buffer.
+*  @param [in]  size    Data buffer size.
+*  @returns  Message length (-1 is failed).
+*/
+ssize_t comm_udpIpv6RecvEx(
+    tUdpIpv6Handle  handle,
+    unsigned char  *pData,
+    size_t          size
+)
 {
     tUdpIpv6Context *pContext = (tUdpIpv6Context *)handle;
     char ipv6Str[INET6_ADDRSTRLEN];
     struct sockaddr_in6 recvAddr;
     socklen_t recvAddrLen;
-    int len;
+    ssize_t len;
 
 
     if (NULL == pContext)
@@ -812,9 +3928,9 @@ int comm_udpIpv6Recv(
         return -1;
     }
 
-    if ( pContext->pRecvFunc )
+    if ( UDP_RECEIVING( pContext ) )
     {
-        LOG_WARN("%s: pRecvFunc exists\n", __func__);
+        LOG_WARN("%s: receive function exists\n", __func__);
         return -1;
     }
 
@@ -862,6 +3978,15 @@ int comm_udpIpv6Recv(
         ntohs( recvAddr.sin6_port )
     );
     LOG_DUMP("IPv6 UDP recv", pData, len);
+    _udpTap(
+        &(pContext->tap),
+        PCAP_IN,
+        pContext->localAddr.sin6_port,
+        (struct sockaddr *)&recvAddr,
+        pData,
+        len,
+        0
+    );
 
     return len;
 }
@@ -877,12 +4002,37 @@ int comm_udpIpv6GetAddr(char *pIfName, unsigned char *pIpv6Addr)
 {
     struct ifaddrs *pIfAddrHdr = NULL;
     struct ifaddrs *pIf = NULL;
+    tIfCacheInfo info;
     unsigned char *pSin6Addr;
     int found = 0;
 
 
     memset(pIpv6Addr, 0x00, 16);
 
+    if (0 == comm_ifCacheGet(pIfName, &info))
+    {
+        if (0 == info.ipv6Num)
+        {
+            return -1;
+        }
+
+        memcpy(pIpv6Addr, info.ipv6Addr[0], 16);
+        LOG_2(
+            "IPv6 address of %s is %02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X:%02X%02X\n",
+            pIfName,
+            pIpv6Addr[0], pIpv6Addr[1],
+            pIpv6Addr[2], pIpv6Addr[3],
+            pIpv6Addr[4], pIpv6Addr[5],
+            pIpv6Addr[6], pIpv6Addr[7],
+            pIpv6Addr[8], pIpv6Addr[9],
+            pIpv6Addr[10], pIpv6Addr[11],
+            pIpv6Addr[12], pIpv6Addr[13],
+            pIpv6Addr[14], pIpv6Addr[15]
+        );
+        return 0;
+    }
+
+    /* the cache is unavailable */
     if (getifaddrs( &pIfAddrHdr ) < 0)
     {
         perror( "getifaddrs" );
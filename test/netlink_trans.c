@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include "comm_if.h"
+
+
+#define APP_NAME "netlink_trans"
+
+/* Requests of one round, they all time out */
+#define ROUND_NUM  (500)
+
+
+static int _doneNum;
+static int _stuckError;
+
+
+static void _netlinkReplyFunc(
+    void          *pArg,
+    unsigned int   seqNum,
+    int            error,
+    tNetlinkMsg   *pMsg,
+    int            num
+)
+{
+    if (0 == num)
+    {
+        if ( pArg )
+        {
+            *((int *)pArg) = error;
+        }
+        else
+        {
+            __sync_fetch_and_add(&_doneNum, 1);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    tNetlinkHandle handle;
+    tNetlinkMsg msg[ROUND_NUM];
+    struct cn_msg cnMsg;
+    unsigned int stuckSeq;
+    int roundNum = 5;
+    int sent;
+    int i;
+    int j;
+
+
+    if (argc > 1)
+    {
+        /*
+        * argv[0] : netlink_trans
+        * argv[1] : number of rounds
+        */
+        roundNum = atoi( argv[1] );
+    }
+
+    #ifdef QUIET
+    comm_setLogMask( LOG_MASK_NONE );
+    #else
+    comm_setLogMask( LOG_MASK_1 );
+    #endif
+
+    /* the connector drops a message of no callback without a reply */
+    handle = comm_netlinkInitTrans(NETLINK_CONNECTOR, NULL, NULL, NULL);
+    if (0 == handle)
+    {
+        printf("[%s] initial netlink failed\n\n", APP_NAME);
+        return -1;
+    }
+
+    memset(&cnMsg, 0x00, sizeof( cnMsg ));
+    cnMsg.id.idx = 0xFFFFFFFF;
+    cnMsg.id.val = 0xFFFFFFFF;
+
+    for (i=0; i<ROUND_NUM; i++)
+    {
+        memset(&(msg[i]), 0x00, sizeof( tNetlinkMsg ));
+        msg[i].pData = (unsigned char *)&cnMsg;
+        msg[i].size  = sizeof( cnMsg );
+        msg[i].type  = NLMSG_DONE;
+    }
+
+    /* one request keeps its slot to the end */
+    _stuckError = 1;
+    if (comm_netlinkRequest(handle, msg, 1, 60000, _netlinkReplyFunc, &_stuckError) != 1)
+    {
+        printf("[%s] request failed\n\n", APP_NAME);
+        comm_netlinkUninit( handle );
+        return -1;
+    }
+    stuckSeq = msg[0].seqNum;
+
+    /* the others go around the slots while it is outstanding */
+    for (i=0; i<roundNum; i++)
+    {
+        _doneNum = 0;
+        sent = comm_netlinkRequest(handle, msg, ROUND_NUM, 1, _netlinkReplyFunc, NULL);
+        if (sent != ROUND_NUM)
+        {
+            printf("[%s] round %d: %d of %d requests sent\n\n", APP_NAME, i, sent, ROUND_NUM);
+            comm_netlinkUninit( handle );
+            return -1;
+        }
+
+        for (j=0; j<sent; j++)
+        {
+            if (msg[j].seqNum == stuckSeq)
+            {
+                printf("[%s] round %d: sequence %u is reused\n\n", APP_NAME, i, stuckSeq);
+                comm_netlinkUninit( handle );
+                return -1;
+            }
+        }
+
+        while (__sync_fetch_and_add(&_doneNum, 0) < sent)
+        {
+            usleep( 10000 );
+        }
+        printf("[%s] round %d: %d requests timed out\n", APP_NAME, i, sent);
+    }
+
+    printf(
+        "[%s] %d requests around sequence %u (%s)\n\n",
+        APP_NAME,
+        (roundNum * ROUND_NUM),
+        stuckSeq,
+        ((1 == _stuckError) ? "still outstanding" : "completed")
+    );
+
+    comm_netlinkUninit( handle );
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "comm_if.h"
+
+
+#define APP_NAME "reactor_recv"
+
+#define MAX_HANDLE_NUM (64)
+
+
+static void _udpRecvFunc(
+    void            *pArg,
+    unsigned char   *pData,
+    unsigned short   size,
+    struct sockaddr *pAddr
+)
+{
+    pData[ size ] = 0x00;
+    printf("[%s] port %lu \"%s\"\n", APP_NAME, (unsigned long)pArg, (char *)pData);
+}
+
+int main(int argc, char *argv[])
+{
+    tReactorHandle reactor;
+    tUdpIpv4Handle handle[MAX_HANDLE_NUM];
+    unsigned char buf[256];
+    int handleNum = 4;
+    int threadNum = 1;
+    int portNum;
+    int len;
+    int i;
+
+
+    if (argc < 2)
+    {
+        /*
+        * argv[0] : reactor_recv
+        * argv[1] : first port number
+        * argv[2] : number of UDP handles
+        * argv[3] : number of reactor threads
+        */
+        printf("Usage: %s port_num [handle_num] [thread_num]\n\n", APP_NAME);
+        return -1;
+    }
+
+    portNum = atoi( argv[1] );
+    if (argc > 2) handleNum = atoi( argv[2] );
+    if (argc > 3) threadNum = atoi( argv[3] );
+    if ((handleNum <= 0) || (handleNum > MAX_HANDLE_NUM))
+    {
+        handleNum = MAX_HANDLE_NUM;
+    }
+
+    #ifdef QUIET
+    comm_setLogMask( LOG_MASK_NONE );
+    #else
+    comm_setLogMask( LOG_MASK_ALL );
+    #endif
+
+    reactor = comm_reactorInit( threadNum );
+    if (0 == reactor)
+    {
+        printf("[%s] initial reactor failed\n\n", APP_NAME);
+        return -1;
+    }
+
+    /* all the following handles share the reactor threads */
+    comm_setReactor( reactor );
+
+    for (i=0; i<handleNum; i++)
+    {
+        handle[i] = comm_udpIpv4Init(
+                        (portNum + i),
+                        _udpRecvFunc,
+                        (void *)(unsigned long)(portNum + i)
+                    );
+        if (0 == handle[i])
+        {
+            printf("[%s] initial UDP port %d failed\n\n", APP_NAME, (portNum + i));
+            handleNum = i;
+            break;
+        }
+    }
+
+    printf(
+        "[%s] %d UDP ports served by %d threads\n",
+        APP_NAME,
+        handleNum,
+        threadNum
+    );
+
+    while ( 1 )
+    {
+        memset(buf, 0x00, 256);
+        len = read(STDIN_FILENO, buf, 255);
+
+        if (0x0A == buf[len-1])
+        {
+            buf[len-1] = 0x00;
+            len--;
+        }
+
+        if ((0 == strcmp("exit", (char *)buf)) ||
+            (0 == strcmp("quit", (char *)buf)))
+        {
+            printf("\n[%s] terminated\n\n", APP_NAME);
+            break;
+        }
+    }
+
+    for (i=0; i<handleNum; i++)
+    {
+        comm_udpIpv4Uninit( handle[i] );
+    }
+
+    comm_reactorUninit( reactor );
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#define _XOPEN_SOURCE 600  /* posix_openpt() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <semaphore.h>
+#include "comm_if.h"
+
+
+#define APP_NAME "uart_latency"
+
+
+static sem_t _recvSem;
+static long long _recvTime;
+static int _recvSize;
+
+
+static long long _now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (((long long)now.tv_sec * 1000000000) + now.tv_nsec);
+}
+
+static void _uartRecvFunc(
+    void           *pArg,
+    unsigned char  *pData,
+    unsigned short  size
+)
+{
+    _recvTime = _now();
+    _recvSize = size;
+    sem_post( &_recvSem );
+}
+
+int main(int argc, char *argv[])
+{
+    tUartGroupHandle group = 0;
+    tUartHandle handle;
+    unsigned char data[16];
+    long long minTime = -1;
+    long long maxTime = 0;
+    long long sumTime = 0;
+    long long sendTime;
+    long long time;
+    char *pSlave;
+    int master;
+    int count = 1000;
+    int size = 1;
+    int remain;
+    int threadNum = 0;
+    int idleTime = 0;
+    int i;
+
+
+    if (argc < 2)
+    {
+        /*
+        * argv[0] : uart_latency
+        * argv[1] : number of messages
+        * argv[2] : message size (1 ~ 16)
+        * argv[3] : number of port group threads (0 is own thread)
+        * argv[4] : idle time in micro-seconds
+        */
+        printf("Usage: %s count [size] [thread_num] [idle_time]\n\n", APP_NAME);
+        return -1;
+    }
+
+    count = atoi( argv[1] );
+    if (argc > 2) size = atoi( argv[2] );
+    if (argc > 3) threadNum = atoi( argv[3] );
+    if (argc > 4) idleTime = atoi( argv[4] );
+    if ((size <= 0) || (size > 16))
+    {
+        size = 1;
+    }
+
+    comm_setLogMask( LOG_MASK_NONE );
+
+    /* the pty slave stands for a serial port */
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt( master ) < 0) || (unlockpt( master ) < 0))
+    {
+        perror( "posix_openpt" );
+        return -1;
+    }
+    pSlave = ptsname( master );
+
+    sem_init(&_recvSem, 0, 0);
+
+    if (threadNum > 0)
+    {
+        group = uart_groupInit(threadNum, 1);
+        handle = uart_groupOpenDev(group, pSlave, _uartRecvFunc, NULL);
+    }
+    else
+    {
+        handle = uart_openDev(pSlave, _uartRecvFunc, NULL);
+    }
+    if (0 == handle)
+    {
+        printf("[%s] open UART failed\n\n", APP_NAME);
+        return -1;
+    }
+
+    uart_configDev(handle, 115200, 0, -1);
+    uart_setIdleTime(handle, idleTime);
+
+    memset(data, 'a', sizeof( data ));
+    for (i=0; i<count; i++)
+    {
+        sendTime = _now();
+        if (write(master, data, size) != size)
+        {
+            perror( "write" );
+            break;
+        }
+
+        /* wait for the whole message */
+        remain = size;
+        while (remain > 0)
+        {
+            sem_wait( &_recvSem );
+            remain -= _recvSize;
+        }
+
+        time = (_recvTime - sendTime);
+        if ((minTime < 0) || (time < minTime)) minTime = time;
+        if (time > maxTime) maxTime = time;
+        sumTime += time;
+    }
+
+    printf(
+        "[%s] %d messages, latency min %lld.%03lld us, avg %lld.%03lld us, max %lld.%03lld us\n",
+        APP_NAME,
+        i,
+        (minTime / 1000), (minTime % 1000),
+        ((sumTime / i) / 1000), ((sumTime / i) % 1000),
+        (maxTime / 1000), (maxTime % 1000)
+    );
+
+    uart_closeDev( handle );
+    if ( group )
+    {
+        uart_groupUninit( group );
+    }
+    close( master );
+
+    return 0;
+}